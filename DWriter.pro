@@ -1,7 +1,13 @@
 APP_NAME = DWriter
 
 CONFIG += qt warn_on cascades10
+QT += sql
+LIBS += -lbb
 LIBS += -lbbsystem
 LIBS += -lbbdata
+LIBS += -lsqlite3
+LIBS += -lcrypto
+LIBS += -lz
+LIBS += -lasound
 
 include(config.pri)
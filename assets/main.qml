@@ -51,6 +51,30 @@ TabbedPane {
                 
                     onTextChanging: _addevent.text = text
                 }
+                // Words from the journal that complete the one being typed
+                Container {
+                    horizontalAlignment: HorizontalAlignment.Center
+                    visible: _addevent.completions.length > 0
+		            layout: StackLayout {
+		                orientation: LayoutOrientation.LeftToRight
+		            }
+
+	                Button {
+	                    text: _addevent.completions.length > 0 ? _addevent.completions[0] : ""
+	                    visible: _addevent.completions.length > 0
+	                    onClicked: bodyField.text = _addevent.acceptCompletion(0)
+	                }
+	                Button {
+	                    text: _addevent.completions.length > 1 ? _addevent.completions[1] : ""
+	                    visible: _addevent.completions.length > 1
+	                    onClicked: bodyField.text = _addevent.acceptCompletion(1)
+	                }
+	                Button {
+	                    text: _addevent.completions.length > 2 ? _addevent.completions[2] : ""
+	                    visible: _addevent.completions.length > 2
+	                    onClicked: bodyField.text = _addevent.acceptCompletion(2)
+	                }
+                }
                 Container {
                     horizontalAlignment: HorizontalAlignment.Center
 		            layout: StackLayout {
@@ -137,9 +161,50 @@ TabbedPane {
                 layout: DockLayout {
                 }
 		        ListView {
+		            id: eventList
 		            horizontalAlignment: HorizontalAlignment.Center
 		
 		            dataModel: _model
+
+		            attachedObjects: [
+		                ListScrollStateHandler {
+		                    onFirstVisibleItemChanged: {
+		                        if (firstVisibleItem.length > 0)
+		                            _model.scrollRow = firstVisibleItem[0]
+		                    }
+		                }
+		            ]
+		            onCreationCompleted: {
+		                scrollToItem([_model.scrollRow], ScrollAnimation.None)
+		            }
+		        }
+
+		        // Date scrubber: drags the list through the journal by position.
+		        Container {
+		            verticalAlignment: VerticalAlignment.Bottom
+		            horizontalAlignment: HorizontalAlignment.Fill
+		            Label {
+		                id: scrubberDate
+		                horizontalAlignment: HorizontalAlignment.Center
+		                visible: scrubber.pressed
+		            }
+		            Slider {
+		                id: scrubber
+		                property bool pressed: false
+		                fromValue: 0
+		                toValue: 1
+		                onTouch: {
+		                    pressed = !event.isUp() && !event.isCancel()
+		                }
+		                onImmediateValueChanged: {
+		                    var count = _model.childCount([])
+		                    if (count > 0) {
+		                        var row = Math.min(count - 1, Math.floor(immediateValue * count))
+		                        scrubberDate.text = _model.dateAtRow(row)
+		                        eventList.scrollToItem([row], ScrollAnimation.None)
+		                    }
+		                }
+		            }
 		        }
 
                 /*
@@ -170,6 +235,16 @@ TabbedPane {
         title: qsTr("Tab 3")
         Page {
             id: tab3
+            actions: [
+                ActionItem {
+                    title: qsTr("Encrypt journal")
+                    enabled: !_dataio.isJournalEncrypted()
+                    onTriggered: {
+                        passphraseDialog.encrypting = true;
+                        passphraseDialog.open();
+                    }
+                }
+            ]
             Container {
                 // define tab content here
                 Label {
@@ -198,6 +273,88 @@ TabbedPane {
             }
         }
     }
+    attachedObjects: [
+        // Asks for the passphrase of an encrypted journal, or for a new one
+        // when the journal is to be encrypted.
+        Dialog {
+            id: passphraseDialog
+            property bool encrypting: false
+            onClosed: {
+                passphraseField.text = "";
+                confirmField.text = "";
+            }
+
+            Container {
+                horizontalAlignment: HorizontalAlignment.Fill
+                verticalAlignment: VerticalAlignment.Fill
+                background: Color.create("#e0000000")
+                layout: DockLayout {
+                }
+                Container {
+                    horizontalAlignment: HorizontalAlignment.Center
+                    verticalAlignment: VerticalAlignment.Center
+                    leftPadding: 30
+                    rightPadding: 30
+                    Label {
+                        text: passphraseDialog.encrypting ? qsTr("Choose a passphrase for the journal")
+                                                          : qsTr("Enter the passphrase of the journal")
+                        multiline: true
+                        textStyle {
+                            base: SystemDefaults.TextStyles.TitleText
+                            color: Color.White
+                        }
+                    }
+                    TextField {
+                        id: passphraseField
+                        inputMode: TextFieldInputMode.Password
+                        hintText: qsTr("Passphrase")
+                    }
+                    TextField {
+                        id: confirmField
+                        visible: passphraseDialog.encrypting
+                        inputMode: TextFieldInputMode.Password
+                        hintText: qsTr("Passphrase again")
+                    }
+                    Label {
+                        id: passphraseError
+                        visible: false
+                        text: qsTr("Wrong passphrase")
+                        textStyle {
+                            color: Color.Red
+                        }
+                    }
+                    Container {
+                        layout: StackLayout {
+                            orientation: LayoutOrientation.LeftToRight
+                        }
+                        Button {
+                            text: qsTr("Cancel")
+                            // A locked journal has nothing to show without its passphrase.
+                            visible: passphraseDialog.encrypting
+                            onClicked: passphraseDialog.close()
+                        }
+                        Button {
+                            text: passphraseDialog.encrypting ? qsTr("Encrypt") : qsTr("Unlock")
+                            enabled: passphraseField.text.length > 0
+                                     && (!passphraseDialog.encrypting || confirmField.text == passphraseField.text)
+                            onClicked: {
+                                if (passphraseDialog.encrypting) {
+                                    _dataio.encryptJournal(passphraseField.text);
+                                    passphraseDialog.close();
+                                } else if (_dataio.unlockJournal(passphraseField.text)) {
+                                    passphraseError.visible = false;
+                                    passphraseDialog.close();
+                                } else {
+                                    passphraseError.visible = true;
+                                    passphraseField.text = "";
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    ]
     onCreationCompleted: {
         // this slot is called when declarative scene is created
         // write post creation initialization here
@@ -206,5 +363,11 @@ TabbedPane {
         // enable layout to adapt to the device rotation
         // don't forget to enable screen rotation in bar-bescriptor.xml (Application->Orientation->Auto-orient)
         OrientationSupport.supportedDisplayOrientation = SupportedDisplayOrientation.All;
+
+        // An encrypted journal stays closed until its passphrase is given.
+        if (_dataio.isJournalLocked()) {
+            passphraseDialog.encrypting = false;
+            passphraseDialog.open();
+        }
     }
 }
@@ -9,16 +9,80 @@ INCLUDEPATH +=  \
 SOURCES +=  \
     $$BASEDIR/src/AddEvent.cpp \
     $$BASEDIR/src/DWriter.cpp \
+    $$BASEDIR/src/cryptovfs.cpp \
     $$BASEDIR/src/databaseio.cpp \
     $$BASEDIR/src/eventdatamodel.cpp \
-    $$BASEDIR/src/main.cpp
+    $$BASEDIR/src/facetindex.cpp \
+    $$BASEDIR/src/imaadpcm.cpp \
+    $$BASEDIR/src/iovfs.cpp \
+    $$BASEDIR/src/journalencryption.cpp \
+    $$BASEDIR/src/journalexporter.cpp \
+    $$BASEDIR/src/journalimporter.cpp \
+    $$BASEDIR/src/journalkeys.cpp \
+    $$BASEDIR/src/journalstats.cpp \
+    $$BASEDIR/src/logstorage.cpp \
+    $$BASEDIR/src/main.cpp \
+    $$BASEDIR/src/maintenancescheduler.cpp \
+    $$BASEDIR/src/memorybudget.cpp \
+    $$BASEDIR/src/memorystorage.cpp \
+    $$BASEDIR/src/modelsnapshot.cpp \
+    $$BASEDIR/src/querytrace.cpp \
+    $$BASEDIR/src/revisionstore.cpp \
+    $$BASEDIR/src/roaringbitmap.cpp \
+    $$BASEDIR/src/rowindex.cpp \
+    $$BASEDIR/src/schemamigrator.cpp \
+    $$BASEDIR/src/shardedstorage.cpp \
+    $$BASEDIR/src/similarityindex.cpp \
+    $$BASEDIR/src/sqlitestorage.cpp \
+    $$BASEDIR/src/statuschannel.cpp \
+    $$BASEDIR/src/syncclient.cpp \
+    $$BASEDIR/src/textcounter.cpp \
+    $$BASEDIR/src/textdelta.cpp \
+    $$BASEDIR/src/trashstore.cpp \
+    $$BASEDIR/src/typedquery.cpp \
+    $$BASEDIR/src/voicerecorder.cpp \
+    $$BASEDIR/src/voicesource.cpp \
+    $$BASEDIR/src/wordcompleter.cpp
 
 HEADERS +=  \
     $$BASEDIR/src/AddEvent.hpp \
     $$BASEDIR/src/DWriter.hpp \
     $$BASEDIR/src/EventData.hpp \
+    $$BASEDIR/src/cryptovfs.hpp \
     $$BASEDIR/src/databaseio.hpp \
-    $$BASEDIR/src/eventdatamodel.hpp
+    $$BASEDIR/src/eventdatamodel.hpp \
+    $$BASEDIR/src/facetindex.hpp \
+    $$BASEDIR/src/imaadpcm.hpp \
+    $$BASEDIR/src/iovfs.hpp \
+    $$BASEDIR/src/journalencryption.hpp \
+    $$BASEDIR/src/journalexporter.hpp \
+    $$BASEDIR/src/journalimporter.hpp \
+    $$BASEDIR/src/journalkeys.hpp \
+    $$BASEDIR/src/journalqueries.hpp \
+    $$BASEDIR/src/journalstats.hpp \
+    $$BASEDIR/src/logstorage.hpp \
+    $$BASEDIR/src/maintenancescheduler.hpp \
+    $$BASEDIR/src/memorybudget.hpp \
+    $$BASEDIR/src/memorystorage.hpp \
+    $$BASEDIR/src/modelsnapshot.hpp \
+    $$BASEDIR/src/querytrace.hpp \
+    $$BASEDIR/src/revisionstore.hpp \
+    $$BASEDIR/src/roaringbitmap.hpp \
+    $$BASEDIR/src/rowindex.hpp \
+    $$BASEDIR/src/schemamigrator.hpp \
+    $$BASEDIR/src/shardedstorage.hpp \
+    $$BASEDIR/src/similarityindex.hpp \
+    $$BASEDIR/src/sqlitestorage.hpp \
+    $$BASEDIR/src/statuschannel.hpp \
+    $$BASEDIR/src/storagebackend.hpp \
+    $$BASEDIR/src/syncclient.hpp \
+    $$BASEDIR/src/textcounter.hpp \
+    $$BASEDIR/src/textdelta.hpp \
+    $$BASEDIR/src/trashstore.hpp \
+    $$BASEDIR/src/typedquery.hpp \
+    $$BASEDIR/src/voicerecorder.hpp \
+    $$BASEDIR/src/voicesource.hpp \
+    $$BASEDIR/src/wordcompleter.hpp
 
 CONFIG += precompile_header
 PRECOMPILED_HEADER = $$BASEDIR/precompiled.h
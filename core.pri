@@ -0,0 +1,88 @@
+# The storage layer without the BB10 runtime: everything below DatabaseIo that
+# only needs QtCore, QtSql, SQLite, OpenSSL and zlib. The app takes these
+# sources through config.pri; the desktop test and tool targets include this
+# file instead.
+
+CORE_DIR = $$PWD
+
+INCLUDEPATH +=  \
+    $$CORE_DIR/src
+
+SOURCES +=  \
+    $$CORE_DIR/src/crashharness.cpp \
+    $$CORE_DIR/src/cryptovfs.cpp \
+    $$CORE_DIR/src/facetindex.cpp \
+    $$CORE_DIR/src/faultvfs.cpp \
+    $$CORE_DIR/src/iovfs.cpp \
+    $$CORE_DIR/src/journalencryption.cpp \
+    $$CORE_DIR/src/journalexporter.cpp \
+    $$CORE_DIR/src/journalimporter.cpp \
+    $$CORE_DIR/src/journalkeys.cpp \
+    $$CORE_DIR/src/journalstats.cpp \
+    $$CORE_DIR/src/logstorage.cpp \
+    $$CORE_DIR/src/maintenancescheduler.cpp \
+    $$CORE_DIR/src/memorybudget.cpp \
+    $$CORE_DIR/src/memorystorage.cpp \
+    $$CORE_DIR/src/modelsnapshot.cpp \
+    $$CORE_DIR/src/querytrace.cpp \
+    $$CORE_DIR/src/revisionstore.cpp \
+    $$CORE_DIR/src/roaringbitmap.cpp \
+    $$CORE_DIR/src/rowindex.cpp \
+    $$CORE_DIR/src/schemamigrator.cpp \
+    $$CORE_DIR/src/shardedstorage.cpp \
+    $$CORE_DIR/src/similarityindex.cpp \
+    $$CORE_DIR/src/sqlitestorage.cpp \
+    $$CORE_DIR/src/statuschannel.cpp \
+    $$CORE_DIR/src/stressharness.cpp \
+    $$CORE_DIR/src/syncclient.cpp \
+    $$CORE_DIR/src/syncserver.cpp \
+    $$CORE_DIR/src/textcounter.cpp \
+    $$CORE_DIR/src/textdelta.cpp \
+    $$CORE_DIR/src/tracereplay.cpp \
+    $$CORE_DIR/src/trashstore.cpp \
+    $$CORE_DIR/src/typedquery.cpp \
+    $$CORE_DIR/src/wordcompleter.cpp
+
+HEADERS +=  \
+    $$CORE_DIR/src/EventData.hpp \
+    $$CORE_DIR/src/crashharness.hpp \
+    $$CORE_DIR/src/cryptovfs.hpp \
+    $$CORE_DIR/src/facetindex.hpp \
+    $$CORE_DIR/src/faultvfs.hpp \
+    $$CORE_DIR/src/iovfs.hpp \
+    $$CORE_DIR/src/journalencryption.hpp \
+    $$CORE_DIR/src/journalexporter.hpp \
+    $$CORE_DIR/src/journalimporter.hpp \
+    $$CORE_DIR/src/journalkeys.hpp \
+    $$CORE_DIR/src/journalqueries.hpp \
+    $$CORE_DIR/src/journalstats.hpp \
+    $$CORE_DIR/src/logstorage.hpp \
+    $$CORE_DIR/src/maintenancescheduler.hpp \
+    $$CORE_DIR/src/memorybudget.hpp \
+    $$CORE_DIR/src/memorystorage.hpp \
+    $$CORE_DIR/src/modelsnapshot.hpp \
+    $$CORE_DIR/src/querytrace.hpp \
+    $$CORE_DIR/src/revisionstore.hpp \
+    $$CORE_DIR/src/roaringbitmap.hpp \
+    $$CORE_DIR/src/rowindex.hpp \
+    $$CORE_DIR/src/schemamigrator.hpp \
+    $$CORE_DIR/src/shardedstorage.hpp \
+    $$CORE_DIR/src/similarityindex.hpp \
+    $$CORE_DIR/src/sqlitestorage.hpp \
+    $$CORE_DIR/src/statuschannel.hpp \
+    $$CORE_DIR/src/storagebackend.hpp \
+    $$CORE_DIR/src/stressharness.hpp \
+    $$CORE_DIR/src/syncclient.hpp \
+    $$CORE_DIR/src/syncserver.hpp \
+    $$CORE_DIR/src/textcounter.hpp \
+    $$CORE_DIR/src/textdelta.hpp \
+    $$CORE_DIR/src/tracereplay.hpp \
+    $$CORE_DIR/src/trashstore.hpp \
+    $$CORE_DIR/src/typedquery.hpp \
+    $$CORE_DIR/src/wordcompleter.hpp
+
+QT += sql
+QT -= gui
+LIBS += -lsqlite3
+LIBS += -lcrypto
+LIBS += -lz
@@ -8,6 +8,10 @@
 #include <sys/slog.h>
 
 #include "AddEvent.hpp"
+#include "wordcompleter.hpp"
+
+#define COMPLETION_SHOWN 3          // buttons under the editor
+#define COMPLETION_MIN_PREFIX 2
 
 AddEvent::AddEvent(QObject *parent, DatabaseIo *dataio)
 	: QObject(parent)
@@ -25,6 +29,7 @@ void AddEvent::setText(const QString &text)
     m_textEvent = text;
 
     emit textChanged();
+    updateCompletions();
 }
 
 QString AddEvent::text() const
@@ -32,6 +37,51 @@ QString AddEvent::text() const
     return m_textEvent;
 }
 
+QStringList AddEvent::completions() const
+{
+    return m_completions;
+}
+
+int AddEvent::trailingWordStart() const
+{
+    int start = m_textEvent.size();
+    while (start > 0 && (m_textEvent.at(start - 1).isLetterOrNumber()
+                         || (m_textEvent.at(start - 1) == '\'' && start < m_textEvent.size())))
+        --start;
+    return start;
+}
+
+void AddEvent::updateCompletions()
+{
+    // Called at every keystroke: the lookup itself allocates nothing.
+    QStringList completions;
+    WordCompleter *completer = m_dataIo ? m_dataIo->wordCompleter() : 0;
+    const int start = trailingWordStart();
+    if (completer && m_textEvent.size() - start >= COMPLETION_MIN_PREFIX) {
+        CompletionHit hits[COMPLETION_SHOWN];
+        const int found = completer->complete(m_textEvent.mid(start), hits, COMPLETION_SHOWN);
+        for (int i = 0; i < found; ++i)
+            completions << QString(hits[i].text, hits[i].length);
+    }
+
+    if (completions != m_completions) {
+        m_completions = completions;
+        emit completionsChanged();
+    }
+}
+
+QString AddEvent::acceptCompletion(int index)
+{
+    if (index < 0 || index >= m_completions.size())
+        return m_textEvent;
+
+    // The typed letters keep their case; the rest of the word is appended.
+    const int start = trailingWordStart();
+    const QString typed = m_textEvent.mid(start);
+    setText(m_textEvent.left(start) + typed + m_completions.at(index).mid(typed.size()) + ' ');
+    return m_textEvent;
+}
+
 QString AddEvent::currentTime() const
 {
     if (!m_currentTime.isValid())
@@ -47,5 +97,6 @@ void AddEvent::addEventDone()
 		return;
 	}
 
-	m_dataIo->addRecord(m_currentTime.toString(),m_textEvent);
+	// A finished entry has to survive a power loss.
+	m_dataIo->addRecord(m_currentTime.toString(),m_textEvent,StorageBackend::Synced);
 }
@@ -10,6 +10,7 @@
 
 #include <QtCore/QObject>
 #include <QDateTime>
+#include <QStringList>
 #include "databaseio.hpp"
 
 
@@ -19,15 +20,21 @@ class AddEvent : public QObject
     // The data properties of the message that is displayed
     Q_PROPERTY(QString text READ text WRITE setText NOTIFY textChanged)
     Q_PROPERTY(QString currentTime READ currentTime NOTIFY currentTimeChanged)
+    // Words of the journal that complete the one being typed, most used first
+    Q_PROPERTY(QStringList completions READ completions NOTIFY completionsChanged)
 
 
 public:
 	AddEvent(QObject *parent = 0, DatabaseIo *dataio = 0);
 
+    // Replaces the word being typed with the completion and returns the new text.
+    Q_INVOKABLE QString acceptCompletion(int index);
+
 Q_SIGNALS:
     // The change notification signals of the properties
     void textChanged();
     void currentTimeChanged();
+    void completionsChanged();
 
 public Q_SLOTS:
     void addEventDone();
@@ -36,11 +43,16 @@ private:
     // The change notification signals of the properties
     QString text() const;
     QString currentTime() const;
+    QStringList completions() const;
     void setText(const QString &body);
+    // Where the word at the end of the text starts.
+    int trailingWordStart() const;
+    void updateCompletions();
 
     // The property values
     QString m_textEvent;
     QDateTime m_currentTime;
+    QStringList m_completions;
     DatabaseIo *m_dataIo;
 };
 
@@ -4,6 +4,7 @@
 #include <bb/cascades/Application>
 #include <bb/cascades/QmlDocument>
 #include <bb/cascades/AbstractPane>
+#include <bb/MemoryInfo>
 
 #include "AddEvent.hpp"
 #include "eventdatamodel.hpp"
@@ -18,9 +19,24 @@ DWriter::DWriter(bb::cascades::Application *app)
     QmlDocument *qml = QmlDocument::create("asset:///main.qml").parent(this);
 
     DatabaseIo *dataio = new DatabaseIo();
+    // Database maintenance does not wait for an idle period while the app is in the background
+    connect(app, SIGNAL(thumbnail()), dataio, SLOT(onAppBackground()));
+    connect(app, SIGNAL(invisible()), dataio, SLOT(onAppBackground()));
+    connect(app, SIGNAL(fullscreen()), dataio, SLOT(onAppForeground()));
+    // Caches give memory back as soon as the OS warns that it is running low
+    bb::MemoryInfo *memoryInfo = new bb::MemoryInfo(this);
+    connect(memoryInfo, SIGNAL(lowMemory(bb::LowMemoryWarningLevel::Type)),
+            dataio->memoryBudget(), SLOT(onLowMemory()));
+    // The passphrase prompt of an encrypted journal and the "Encrypt journal" action
+    qml->setContextProperty("_dataio", dataio);
     // Make the AddEvent object available to the UI as context property
     qml->setContextProperty("_addevent", new AddEvent(app, dataio));
-    qml->setContextProperty("_model", new EventDataModel(app, dataio));
+    EventDataModel *model = new EventDataModel(app, dataio);
+    qml->setContextProperty("_model", model);
+    // The list is saved where it was left, so the next start can show it before the database opens
+    connect(app, SIGNAL(thumbnail()), model, SLOT(saveSnapshot()));
+    connect(app, SIGNAL(invisible()), model, SLOT(saveSnapshot()));
+    connect(app, SIGNAL(aboutToQuit()), model, SLOT(saveSnapshot()));
 
     // create root object for the UI
     AbstractPane *root = qml->createRootObject<AbstractPane>();
@@ -8,6 +8,9 @@
 #ifndef EVENTDATA_HPP_
 #define EVENTDATA_HPP_
 
+#include <QDateTime>
+#include <QString>
+
 namespace bb { namespace cascades { class Application; }}
 
 typedef struct Position_t
@@ -26,5 +29,18 @@ typedef struct EventData_t
 	Position pos;
 } EventData;
 
+/*
+ * Events are stamped with QDateTime::toString() (Qt::TextDate) by AddEvent.
+ * This turns such a stamp into seconds since the epoch for the createdAt
+ * column; 0 is returned for stamps that cannot be parsed.
+ */
+inline qint64 eventTimeFromString(const QString &timeStamp)
+{
+	const QDateTime time = QDateTime::fromString(timeStamp, Qt::TextDate);
+	if (!time.isValid())
+		return 0;
+	return time.toTime_t();
+}
+
 
 #endif /* EVENTDATA_HPP_ */
@@ -0,0 +1,331 @@
+/*
+ * crashharness.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "crashharness.hpp"
+#include "faultvfs.hpp"
+#include "sqlitestorage.hpp"
+
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QVector>
+#include <QtAlgorithms>
+#include <QtSql/QtSql>
+
+#define CRASH_DEFAULT_WRITES 40
+#define CRASH_DEFAULT_POINTS 50
+#define CRASH_DEFAULT_FLUSH_EVERY 8
+#define CRASH_LATENCY_WRITES 200
+
+#define CRASH_STORAGE_CONNECTION "DWriter-crash"
+#define CRASH_CHECK_CONNECTION "DWriter-crash-check"
+
+static const char *const JOURNAL_SUFFIXES[] = { "", "-wal", "-shm", "-journal" };
+
+static QString levelName(StorageBackend::Durability durability)
+{
+    switch (durability) {
+    case StorageBackend::Buffered: return "buffered";
+    case StorageBackend::Flushed:  return "flushed";
+    default:                       return "synced";
+    }
+}
+
+static QString entryText(int seq)
+{
+    return QString("crash %1").arg(seq);
+}
+
+static quint32 nextRandom(quint32 &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// -----------------------------------------------------------------------------------------------
+// CrashHarness
+
+CrashHarness::CrashHarness(const QString &directory, quint32 seed)
+    : m_directory(QDir(directory).absolutePath())
+    , m_seed(seed ? seed : 1)
+    , m_writes(CRASH_DEFAULT_WRITES)
+    , m_crashPoints(CRASH_DEFAULT_POINTS)
+    , m_flushEvery(CRASH_DEFAULT_FLUSH_EVERY)
+{
+}
+
+void CrashHarness::setWrites(int writes)
+{
+    m_writes = qMax(1, writes);
+}
+
+void CrashHarness::setCrashPoints(int points)
+{
+    m_crashPoints = qMax(0, points);
+}
+
+void CrashHarness::setFlushEvery(int writes)
+{
+    m_flushEvery = qMax(1, writes);
+}
+
+QString CrashHarness::lastError() const
+{
+    return m_lastError;
+}
+
+QList<DurabilityReport> CrashHarness::runAll()
+{
+    QList<DurabilityReport> reports;
+    reports << run(StorageBackend::Buffered) << run(StorageBackend::Flushed)
+            << run(StorageBackend::Synced);
+    return reports;
+}
+
+DurabilityReport CrashHarness::run(StorageBackend::Durability durability)
+{
+    DurabilityReport report;
+    report.durability = durability;
+    report.writes = m_writes;
+    m_lastError.clear();
+
+    if (!QDir().mkpath(m_directory) || !FaultVfs::install(m_directory)) {
+        m_lastError = QString("Cannot set up %1").arg(m_directory);
+        return report;
+    }
+    FaultVfs::stopRecording();
+
+    measureLatency(durability, report);
+
+    // A journal with the schema in place, copied for every run.
+    const QString templatePath = m_directory + "/template.db";
+    const QString path = m_directory + "/crash.db";
+    const QString appCrashPath = m_directory + "/appcrash.db";
+    if (!QFile::exists(templatePath)) {
+        SqliteStorage storage(templatePath, CRASH_STORAGE_CONNECTION);
+        const bool ok = storage.open();
+        storage.close();
+        if (!ok) {
+            m_lastError = storage.lastError();
+            return report;
+        }
+    }
+
+    // The operations one uninterrupted run takes.
+    qint64 operations = 0;
+    {
+        if (!freshJournal(path))
+            return report;
+        SqliteStorage storage(path, CRASH_STORAGE_CONNECTION);
+        if (!storage.open()) {
+            m_lastError = storage.lastError();
+            return report;
+        }
+        Progress progress;
+        FaultVfs::startRecording();
+        write(storage, durability, progress);
+        operations = FaultVfs::operations();
+        storage.close();
+        FaultVfs::stopRecording();
+        if (progress.committed != m_writes) {
+            m_lastError = QString("The %1 run without faults failed: %2")
+                          .arg(levelName(durability), storage.lastError());
+            return report;
+        }
+    }
+
+    quint32 random = m_seed * 2654435761u + quint32(durability) + 1;
+    for (int point = 0; point < m_crashPoints && operations > 0; ++point) {
+        const qint64 crashAt = nextRandom(random) % quint64(operations);
+        const quint32 powerSeed = nextRandom(random);
+        if (!freshJournal(path))
+            return report;
+
+        Progress progress;
+        {
+            SqliteStorage storage(path, CRASH_STORAGE_CONNECTION);
+            if (!storage.open()) {
+                m_lastError = storage.lastError();
+                return report;
+            }
+            FaultVfs::startRecording();
+            FaultVfs::crashAfter(crashAt);
+            write(storage, durability, progress);
+            storage.close();
+        }
+        ++report.crashPoints;
+
+        // What the disk holds once the app is gone; then what survives the power.
+        removeJournal(appCrashPath);
+        for (size_t i = 0; i < sizeof(JOURNAL_SUFFIXES) / sizeof(JOURNAL_SUFFIXES[0]); ++i) {
+            if (QFile::exists(path + JOURNAL_SUFFIXES[i]))
+                QFile::copy(path + JOURNAL_SUFFIXES[i], appCrashPath + JOURNAL_SUFFIXES[i]);
+        }
+        const bool lossOk = FaultVfs::powerLoss(powerSeed);
+        FaultVfs::stopRecording();
+        if (!lossOk) {
+            m_lastError = "Could not roll back the unsynced writes";
+            return report;
+        }
+
+        const QString where = QString("%1 run, crash after operation %2 of %3, %4 of %5 writes acknowledged")
+                              .arg(levelName(durability)).arg(crashAt).arg(operations)
+                              .arg(progress.acknowledged).arg(m_writes);
+        QString errorText;
+        int entries = check(appCrashPath, &errorText);
+        if (entries < 0) {
+            fail(report, report.corruptions, QString("%1: app crash: %2").arg(where, errorText));
+        } else if (entries < progress.committed || entries > progress.attempted) {
+            fail(report, report.appCrashFailures,
+                 QString("%1: app crash left %2 entries").arg(where).arg(entries));
+        }
+
+        // Flushed writes only promise to survive the app.
+        const int promised = durability == StorageBackend::Flushed ? 0 : progress.committed;
+        entries = check(path, &errorText);
+        if (entries < 0) {
+            fail(report, report.corruptions, QString("%1: power loss: %2").arg(where, errorText));
+        } else if (entries < promised || entries > progress.attempted) {
+            fail(report, report.powerLossFailures,
+                 QString("%1: power loss left %2 entries").arg(where).arg(entries));
+        }
+    }
+
+    removeJournal(path);
+    removeJournal(appCrashPath);
+    return report;
+}
+
+void CrashHarness::measureLatency(StorageBackend::Durability durability, DurabilityReport &report)
+{
+    const QString path = m_directory + "/latency.db";
+    removeJournal(path);
+
+    SqliteStorage storage(path, CRASH_STORAGE_CONNECTION);
+    if (!storage.open()) {
+        m_lastError = storage.lastError();
+        return;
+    }
+    report.writeAheadLog = storage.isWriteAheadLog();
+
+    const QString timeStamp = QDateTime::currentDateTime().toString();
+    QVector<qint64> writes;
+    QVector<qint64> flushes;
+    QElapsedTimer timer;
+    for (int i = 0; i < CRASH_LATENCY_WRITES; ++i) {
+        timer.start();
+        if (storage.addRecord(timeStamp, entryText(i), durability) < 0)
+            break;
+        writes << timer.nsecsElapsed() / 1000;
+
+        if (durability == StorageBackend::Buffered && (i + 1) % m_flushEvery == 0) {
+            timer.start();
+            storage.flush();
+            flushes << timer.nsecsElapsed() / 1000;
+        }
+    }
+    storage.close();
+    removeJournal(path);
+
+    if (!writes.isEmpty()) {
+        qint64 total = 0;
+        for (int i = 0; i < writes.size(); ++i)
+            total += writes.at(i);
+        report.meanWriteUs = total / writes.size();
+        qSort(writes);
+        report.p99WriteUs = writes.at(qMin(writes.size() - 1, writes.size() * 99 / 100));
+    }
+    if (!flushes.isEmpty()) {
+        qint64 total = 0;
+        for (int i = 0; i < flushes.size(); ++i)
+            total += flushes.at(i);
+        report.flushUs = total / flushes.size();
+    }
+}
+
+void CrashHarness::write(SqliteStorage &storage, StorageBackend::Durability durability,
+                         Progress &progress)
+{
+    const QString timeStamp = QDateTime::currentDateTime().toString();
+    for (int i = 0; i < m_writes; ++i) {
+        ++progress.attempted;
+        if (storage.addRecord(timeStamp, entryText(i), durability) < 0)
+            return;
+        progress.acknowledged = i + 1;
+
+        if (durability != StorageBackend::Buffered) {
+            progress.committed = i + 1;
+        } else if ((i + 1) % m_flushEvery == 0 || i + 1 == m_writes) {
+            if (!storage.flush())
+                return;
+            progress.committed = i + 1;
+        }
+    }
+}
+
+bool CrashHarness::freshJournal(const QString &path)
+{
+    removeJournal(path);
+    if (!QFile::copy(m_directory + "/template.db", path)) {
+        m_lastError = QString("Cannot copy the template journal to %1").arg(path);
+        return false;
+    }
+    return true;
+}
+
+void CrashHarness::removeJournal(const QString &path)
+{
+    for (size_t i = 0; i < sizeof(JOURNAL_SUFFIXES) / sizeof(JOURNAL_SUFFIXES[0]); ++i)
+        QFile::remove(path + JOURNAL_SUFFIXES[i]);
+}
+
+int CrashHarness::check(const QString &path, QString *errorText)
+{
+    int entries = -1;
+    {
+        QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", CRASH_CHECK_CONNECTION);
+        database.setDatabaseName(path);
+        if (!database.open()) {
+            *errorText = database.lastError().text();
+        } else {
+            QSqlQuery query(database);
+            if (!query.exec("PRAGMA integrity_check") || !query.next()) {
+                *errorText = query.lastError().text();
+            } else if (query.value(0).toString() != "ok") {
+                *errorText = query.value(0).toString();
+            } else if (!query.exec("SELECT textEvent FROM events ORDER BY eventID")) {
+                *errorText = query.lastError().text();
+            } else {
+                // Entries are written one after the other, so only a prefix of
+                // them may be there, in order.
+                entries = 0;
+                while (query.next()) {
+                    if (query.value(0).toString() != entryText(entries)) {
+                        *errorText = QString("Entry %1 is \"%2\"")
+                                     .arg(entries).arg(query.value(0).toString());
+                        entries = -1;
+                        break;
+                    }
+                    ++entries;
+                }
+            }
+        }
+        database.close();
+    }
+    QSqlDatabase::removeDatabase(CRASH_CHECK_CONNECTION);
+    return entries;
+}
+
+void CrashHarness::fail(DurabilityReport &report, int &counter, const QString &message)
+{
+    ++counter;
+    if (report.firstFailure.isEmpty())
+        report.firstFailure = message;
+    qWarning() << "CrashHarness:" << message;
+}
@@ -0,0 +1,105 @@
+/*
+ * crashharness.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef CRASHHARNESS_HPP_
+#define CRASHHARNESS_HPP_
+
+#include "storagebackend.hpp"
+
+#include <QList>
+#include <QString>
+
+class SqliteStorage;
+
+/*
+ * What CrashHarness found for one durability level. Latencies are per
+ * addRecord() on the real disk; for Buffered, flushUs is the group commit.
+ */
+struct DurabilityReport
+{
+    DurabilityReport()
+        : durability(StorageBackend::Synced), writeAheadLog(false), writes(0)
+        , meanWriteUs(0), p99WriteUs(0), flushUs(0)
+        , crashPoints(0), corruptions(0), appCrashFailures(0), powerLossFailures(0) {}
+
+    bool passed() const { return !corruptions && !appCrashFailures && !powerLossFailures; }
+
+    StorageBackend::Durability durability;
+    bool writeAheadLog;       // false: Flushed writes were synced like Synced ones
+    int writes;
+    qint64 meanWriteUs;
+    qint64 p99WriteUs;
+    qint64 flushUs;
+
+    int crashPoints;          // runs cut short at a sampled I/O operation
+    int corruptions;          // integrity_check failed, or entries out of order
+    int appCrashFailures;     // a promised entry missing after the app died
+    int powerLossFailures;    // the same after a simulated power loss
+    QString firstFailure;
+};
+
+/*
+ * @brief Checks that each durability level keeps its promise across crashes.
+ *
+ * Entries are written through SqliteStorage to a scratch journal in
+ * 'directory', which goes through FaultVfs. A first run counts the I/O
+ * operations of the workload; later runs stop it at sampled operations.
+ * After each stop, a copy of the files is checked as the app would find them
+ * after dying there, then the files themselves after a power loss:
+ *
+ *   - the journal passes integrity_check and holds a prefix of the entries;
+ *   - after the app died, every acknowledged write is there (for Buffered,
+ *     every write up to the last flush);
+ *   - after a power loss, every Synced write is there, and every Buffered
+ *     write up to the last flush. Flushed writes may be missing.
+ *
+ * Runs are reproducible for a given seed. Nothing else may use FaultVfs or
+ * the directory meanwhile.
+ */
+class CrashHarness
+{
+public:
+    CrashHarness(const QString &directory, quint32 seed = 1);
+
+    void setWrites(int writes);
+    void setCrashPoints(int points);
+    // Buffered runs call flush() after this many writes.
+    void setFlushEvery(int writes);
+
+    DurabilityReport run(StorageBackend::Durability durability);
+    QList<DurabilityReport> runAll();
+
+    QString lastError() const;
+
+private:
+    struct Progress
+    {
+        Progress() : attempted(0), acknowledged(0), committed(0) {}
+
+        int attempted;
+        int acknowledged;
+        int committed;        // acknowledged and, for Buffered, flushed
+    };
+
+    void measureLatency(StorageBackend::Durability durability, DurabilityReport &report);
+    void write(SqliteStorage &storage, StorageBackend::Durability durability, Progress &progress);
+    bool freshJournal(const QString &path);
+    // -1 if the journal is corrupt, else the number of entries it holds, which
+    // have to be the first ones written.
+    int check(const QString &path, QString *errorText);
+    void removeJournal(const QString &path);
+    void fail(DurabilityReport &report, int &counter, const QString &message);
+
+    QString m_directory;
+    quint32 m_seed;
+    int m_writes;
+    int m_crashPoints;
+    int m_flushEvery;
+    QString m_lastError;
+};
+
+#endif /* CRASHHARNESS_HPP_ */
@@ -0,0 +1,1107 @@
+/*
+ * cryptovfs.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "cryptovfs.hpp"
+
+#include <QAtomicInt>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <openssl/evp.h>
+#include <openssl/opensslv.h>
+#include <openssl/rand.h>
+#include <sqlite3.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L && !defined(OPENSSL_NO_CHACHA) && !defined(OPENSSL_NO_POLY1305)
+#define CRYPT_HAVE_CHACHA
+#endif
+
+#define CRYPT_VFS_NAME "dwriter-crypt"
+#define CRYPT_HEADER_BYTES 64
+#define CRYPT_BLOCK_OVERHEAD 32
+#define CRYPT_NONCE_BYTES 12
+#define CRYPT_TAG_BYTES 16
+#define CRYPT_AAD_BYTES 14
+#define CRYPT_HEADER_AAD_BYTES 25
+#define CRYPT_HEADER_RETRIES 3
+#define CRYPT_DEFAULT_BLOCK 4096
+#define CRYPT_MIN_BLOCK 512
+#define CRYPT_MAX_BLOCK 65536
+#define CRYPT_MAX_KEYS 256
+
+static const char CRYPT_MAGIC[8] = { 'D', 'W', 'C', 'R', 'Y', 'P', 'T', '1' };
+static const char REKEY_MAGIC[4] = { 'D', 'W', 'R', 'K' };
+
+enum { CipherAesGcm = 1, CipherChaChaPoly = 2 };
+
+// Header layout: magic, u8 cipher, 3 reserved, u32 block size, u64 logical size, then the
+// tag over all of these: u8 key id, 3 reserved, 12-byte nonce, 16-byte tag; rest zero
+enum { HeaderCipher = 8, HeaderBlockSize = 12, HeaderLogicalSize = 16, HeaderKeyId = 24,
+       HeaderNonce = 28, HeaderTag = 40 };
+
+// Block prefix layout
+enum { BlockKeyId = 0, BlockNonce = 4, BlockTag = 16 };
+
+// -----------------------------------------------------------------------------------------------
+// Little-endian helpers
+
+static inline void put32(unsigned char *p, quint32 v)
+{
+    for (int i = 0; i < 4; ++i)
+        p[i] = uchar(v >> (8 * i));
+}
+
+static inline quint32 get32(const unsigned char *p)
+{
+    return quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16) | (quint32(p[3]) << 24);
+}
+
+static inline void put64(unsigned char *p, quint64 v)
+{
+    for (int i = 0; i < 8; ++i)
+        p[i] = uchar(v >> (8 * i));
+}
+
+static inline quint64 get64(const unsigned char *p)
+{
+    return quint64(get32(p)) | (quint64(get32(p + 4)) << 32);
+}
+
+// -----------------------------------------------------------------------------------------------
+// Keys and ciphers
+
+static QMutex g_keyLock;
+static unsigned char g_keys[CRYPT_MAX_KEYS][CRYPT_KEY_BYTES];
+static bool g_keyLoaded[CRYPT_MAX_KEYS];
+static int g_currentKey = -1;
+static QAtomicInt g_keyGeneration(0);     // bumped by setKeys(); ids may be reused after it
+
+// Set while this process rewrites blocks for a rekey, see rekeyBlocks().
+static QAtomicInt g_rekeyActive(0);
+
+static bool keyFor(int id, unsigned char *key)
+{
+    QMutexLocker locker(&g_keyLock);
+    if (id < 0 || id >= CRYPT_MAX_KEYS || !g_keyLoaded[id])
+        return false;
+    memcpy(key, g_keys[id], CRYPT_KEY_BYTES);
+    return true;
+}
+
+static int currentKeyId()
+{
+    QMutexLocker locker(&g_keyLock);
+    return g_currentKey;
+}
+
+static bool hasAesInstructions()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 25));
+#elif defined(__aarch64__) && defined(__linux__)
+    return getauxval(AT_HWCAP) & HWCAP_AES;
+#else
+    return false;
+#endif
+}
+
+static int preferredCipherId()
+{
+    static const int cipher =
+#ifdef CRYPT_HAVE_CHACHA
+        hasAesInstructions() ? CipherAesGcm : CipherChaChaPoly;
+#else
+        CipherAesGcm;
+#endif
+    return cipher;
+}
+
+static const EVP_CIPHER *evpCipher(int cipher)
+{
+#ifdef CRYPT_HAVE_CHACHA
+    if (cipher == CipherChaChaPoly)
+        return EVP_chacha20_poly1305();
+#endif
+    if (cipher == CipherAesGcm)
+        return EVP_aes_256_gcm();
+    return 0;
+}
+
+/*
+ * An AEAD context that keeps its key schedule while the key stays the same;
+ * only the nonce changes from block to block.
+ */
+struct AeadContext
+{
+    EVP_CIPHER_CTX *ctx;
+    int cipher;
+    int keyId;        // -1 before the first use
+    int generation;   // g_keyGeneration when the key was set up
+    bool encrypt;
+};
+
+static void initContext(AeadContext *aead, bool encrypt)
+{
+    aead->ctx = EVP_CIPHER_CTX_new();
+    aead->cipher = 0;
+    aead->keyId = -1;
+    aead->generation = -1;
+    aead->encrypt = encrypt;
+}
+
+// True if the context already holds the key with this id, so it needs no key lookup.
+static bool hasKey(const AeadContext *aead, int cipher, int keyId)
+{
+    return aead->cipher == cipher && aead->keyId == keyId && aead->generation == int(g_keyGeneration);
+}
+
+static void freeContext(AeadContext *aead)
+{
+    if (aead->ctx)
+        EVP_CIPHER_CTX_free(aead->ctx);
+    aead->ctx = 0;
+}
+
+// A null 'key' reuses the key the context already holds, see hasKey().
+static bool setupContext(AeadContext *aead, int cipher, int keyId, const unsigned char *key,
+                         const unsigned char *nonce)
+{
+    if (key) {
+        const EVP_CIPHER *evp = evpCipher(cipher);
+        if (!evp)
+            return false;
+        const int ok = aead->encrypt ? EVP_EncryptInit_ex(aead->ctx, evp, 0, 0, 0)
+                                     : EVP_DecryptInit_ex(aead->ctx, evp, 0, 0, 0);
+        if (!ok || !EVP_CIPHER_CTX_ctrl(aead->ctx, EVP_CTRL_GCM_SET_IVLEN, CRYPT_NONCE_BYTES, 0))
+            return false;
+        if (!(aead->encrypt ? EVP_EncryptInit_ex(aead->ctx, 0, 0, key, nonce)
+                            : EVP_DecryptInit_ex(aead->ctx, 0, 0, key, nonce)))
+            return false;
+        aead->cipher = cipher;
+        aead->keyId = keyId;
+        aead->generation = g_keyGeneration;
+        return true;
+    }
+    if (!hasKey(aead, cipher, keyId))
+        return false;
+    return aead->encrypt ? EVP_EncryptInit_ex(aead->ctx, 0, 0, 0, nonce)
+                         : EVP_DecryptInit_ex(aead->ctx, 0, 0, 0, nonce);
+}
+
+static bool aeadSeal(AeadContext *aead, int cipher, int keyId, const unsigned char *key,
+                     const unsigned char *nonce, const unsigned char *aad, int aadLength,
+                     const unsigned char *in, int length, unsigned char *out, unsigned char *tag)
+{
+    int n = 0;
+    if (!setupContext(aead, cipher, keyId, key, nonce)
+        || (aadLength && !EVP_EncryptUpdate(aead->ctx, 0, &n, aad, aadLength))
+        || !EVP_EncryptUpdate(aead->ctx, out, &n, in, length)
+        || !EVP_EncryptFinal_ex(aead->ctx, out + n, &n)
+        || !EVP_CIPHER_CTX_ctrl(aead->ctx, EVP_CTRL_GCM_GET_TAG, CRYPT_TAG_BYTES, tag)) {
+        aead->keyId = -1;
+        return false;
+    }
+    return true;
+}
+
+static bool aeadOpen(AeadContext *aead, int cipher, int keyId, const unsigned char *key,
+                     const unsigned char *nonce, const unsigned char *aad, int aadLength,
+                     const unsigned char *in, int length, unsigned char *out,
+                     const unsigned char *tag)
+{
+    int n = 0;
+    if (!setupContext(aead, cipher, keyId, key, nonce)
+        || (aadLength && !EVP_DecryptUpdate(aead->ctx, 0, &n, aad, aadLength))
+        || !EVP_DecryptUpdate(aead->ctx, out, &n, in, length)
+        || !EVP_CIPHER_CTX_ctrl(aead->ctx, EVP_CTRL_GCM_SET_TAG, CRYPT_TAG_BYTES,
+                                const_cast<unsigned char *>(tag))
+        || EVP_DecryptFinal_ex(aead->ctx, out + n, &n) <= 0) {
+        aead->keyId = -1;
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+// File
+
+struct CryptFile
+{
+    sqlite3_file base;
+    sqlite3_file *real;        // the platform VFS's file, allocated right after this struct
+    const char *path;          // owned by SQLite, valid until xClose
+    bool encrypted;
+    bool headerWritten;
+    int cipher;
+    int blockSize;
+    int headerKeyId;           // the key the header tag was made with
+    sqlite3_int64 logicalSize;
+    AeadContext sealer;
+    AeadContext opener;
+    unsigned char *plain;      // one block
+    unsigned char *physical;   // one block with its prefix
+};
+
+static sqlite3_vfs *g_root = 0;
+
+static inline sqlite3_int64 blockOffset(const CryptFile *file, sqlite3_int64 block)
+{
+    return CRYPT_HEADER_BYTES + block * (CRYPT_BLOCK_OVERHEAD + file->blockSize);
+}
+
+static inline int physicalBlockSize(const CryptFile *file)
+{
+    return CRYPT_BLOCK_OVERHEAD + file->blockSize;
+}
+
+static bool allocateBuffers(CryptFile *file)
+{
+    file->plain = static_cast<unsigned char *>(sqlite3_malloc(file->blockSize));
+    file->physical = static_cast<unsigned char *>(sqlite3_malloc(physicalBlockSize(file)));
+    return file->plain && file->physical;
+}
+
+// The block number and key id, and the cipher and block size from the header.
+static void blockAad(const CryptFile *file, unsigned char *aad, sqlite3_int64 block, int keyId)
+{
+    put64(aad, quint64(block));
+    aad[8] = uchar(keyId);
+    aad[9] = uchar(file->cipher);
+    put32(aad + 10, quint32(file->blockSize));
+}
+
+// Seals 'plain' as block 'block' into file->physical.
+static int sealBlock(CryptFile *file, sqlite3_int64 block, const unsigned char *plain)
+{
+    const int keyId = currentKeyId();
+    unsigned char key[CRYPT_KEY_BYTES];
+    const bool cached = hasKey(&file->sealer, file->cipher, keyId);
+    if (!cached && !keyFor(keyId, key))
+        return SQLITE_IOERR_WRITE;
+
+    unsigned char *prefix = file->physical;
+    memset(prefix, 0, CRYPT_BLOCK_OVERHEAD);
+    prefix[BlockKeyId] = uchar(keyId);
+    if (RAND_bytes(prefix + BlockNonce, CRYPT_NONCE_BYTES) != 1)
+        return SQLITE_IOERR_WRITE;
+
+    unsigned char aad[CRYPT_AAD_BYTES];
+    blockAad(file, aad, block, keyId);
+    const bool ok = aeadSeal(&file->sealer, file->cipher, keyId, cached ? 0 : key, prefix + BlockNonce,
+                             aad, CRYPT_AAD_BYTES, plain, file->blockSize,
+                             prefix + CRYPT_BLOCK_OVERHEAD, prefix + BlockTag);
+    memset(key, 0, sizeof(key));
+    return ok ? SQLITE_OK : SQLITE_IOERR_WRITE;
+}
+
+// Opens file->physical, read from block 'block', into 'plain'. Every block
+// below the logical size has been sealed, so one that does not open is an error.
+static int openBlock(CryptFile *file, sqlite3_int64 block, unsigned char *plain)
+{
+    const unsigned char *prefix = file->physical;
+    const int keyId = prefix[BlockKeyId];
+    unsigned char key[CRYPT_KEY_BYTES];
+    const bool cached = hasKey(&file->opener, file->cipher, keyId);
+    if (!cached && !keyFor(keyId, key))
+        return SQLITE_IOERR_READ;
+
+    unsigned char aad[CRYPT_AAD_BYTES];
+    blockAad(file, aad, block, keyId);
+    const bool ok = aeadOpen(&file->opener, file->cipher, keyId, cached ? 0 : key, prefix + BlockNonce,
+                             aad, CRYPT_AAD_BYTES, prefix + CRYPT_BLOCK_OVERHEAD,
+                             file->blockSize, plain, prefix + BlockTag);
+    memset(key, 0, sizeof(key));
+    return ok ? SQLITE_OK : SQLITE_IOERR_READ;
+}
+
+static int readBlock(CryptFile *file, sqlite3_int64 block, unsigned char *plain)
+{
+    const int rc = file->real->pMethods->xRead(file->real, file->physical,
+                                               physicalBlockSize(file), blockOffset(file, block));
+    if (rc != SQLITE_OK && rc != SQLITE_IOERR_SHORT_READ)
+        return rc;
+    return openBlock(file, block, plain);
+}
+
+static int writeBlock(CryptFile *file, sqlite3_int64 block, const unsigned char *plain)
+{
+    const int rc = sealBlock(file, block, plain);
+    if (rc != SQLITE_OK)
+        return rc;
+    return file->real->pMethods->xWrite(file->real, file->physical,
+                                        physicalBlockSize(file), blockOffset(file, block));
+}
+
+// Seals blocks 'from' up to 'to' as zeros, for the part of the file a write or
+// truncate past the end skips over.
+static int writeZeroBlocks(CryptFile *file, sqlite3_int64 from, sqlite3_int64 to)
+{
+    int rc = SQLITE_OK;
+    memset(file->plain, 0, file->blockSize);
+    for (sqlite3_int64 block = from; rc == SQLITE_OK && block < to; ++block)
+        rc = writeBlock(file, block, file->plain);
+    return rc;
+}
+
+/*
+ * Writes the header with a tag over its fields, made with the current key.
+ * The logical size changes with every write past the end, so it is bound
+ * here rather than in the associated data of each block; the cipher and
+ * block size are bound in both.
+ */
+static int writeHeaderFields(CryptFile *file)
+{
+    const int keyId = currentKeyId();
+    unsigned char key[CRYPT_KEY_BYTES];
+    const bool cached = hasKey(&file->sealer, file->cipher, keyId);
+    if (!cached && !keyFor(keyId, key))
+        return SQLITE_IOERR_WRITE;
+
+    unsigned char header[CRYPT_HEADER_BYTES];
+    memset(header, 0, sizeof(header));
+    memcpy(header, CRYPT_MAGIC, sizeof(CRYPT_MAGIC));
+    header[HeaderCipher] = uchar(file->cipher);
+    put32(header + HeaderBlockSize, quint32(file->blockSize));
+    put64(header + HeaderLogicalSize, quint64(file->logicalSize));
+    header[HeaderKeyId] = uchar(keyId);
+    if (RAND_bytes(header + HeaderNonce, CRYPT_NONCE_BYTES) != 1)
+        return SQLITE_IOERR_WRITE;
+
+    unsigned char none[1];
+    const bool ok = aeadSeal(&file->sealer, file->cipher, keyId, cached ? 0 : key, header + HeaderNonce,
+                             header, CRYPT_HEADER_AAD_BYTES, none, 0, none, header + HeaderTag);
+    memset(key, 0, sizeof(key));
+    if (!ok)
+        return SQLITE_IOERR_WRITE;
+
+    const int rc = file->real->pMethods->xWrite(file->real, header, sizeof(header), 0);
+    if (rc == SQLITE_OK)
+        file->headerKeyId = keyId;
+    return rc;
+}
+
+// True if the tag of 'header' verifies; 'cipher' is the one the header names.
+static bool checkHeader(CryptFile *file, int cipher, const unsigned char *header)
+{
+    const int keyId = header[HeaderKeyId];
+    unsigned char key[CRYPT_KEY_BYTES];
+    const bool cached = hasKey(&file->opener, cipher, keyId);
+    if (!cached && !keyFor(keyId, key))
+        return false;
+
+    unsigned char none[1];
+    const bool ok = aeadOpen(&file->opener, cipher, keyId, cached ? 0 : key, header + HeaderNonce,
+                             header, CRYPT_HEADER_AAD_BYTES, none, 0, none, header + HeaderTag);
+    memset(key, 0, sizeof(key));
+    return ok;
+}
+
+/*
+ * Reads the header back from disk. Every connection has its own CryptFile, so
+ * the logical size (and, for a file another connection created, the header
+ * itself) is re-read whenever it may have been changed by someone else.
+ */
+static int refreshHeader(CryptFile *file, bool *found = 0)
+{
+    unsigned char header[CRYPT_HEADER_BYTES];
+    if (found)
+        *found = false;
+
+    // A header read while another connection rewrites it may be torn; it is
+    // read again before the tag counts as wrong.
+    for (int attempt = 0; ; ++attempt) {
+        const int rc = file->real->pMethods->xRead(file->real, header, sizeof(header), 0);
+        if (rc == SQLITE_IOERR_SHORT_READ)
+            return SQLITE_OK;    // nobody has written the header yet
+        if (rc != SQLITE_OK || memcmp(header, CRYPT_MAGIC, sizeof(CRYPT_MAGIC)) != 0)
+            return rc;
+        if (checkHeader(file, header[HeaderCipher], header))
+            break;
+        if (attempt + 1 == CRYPT_HEADER_RETRIES)
+            return SQLITE_IOERR_READ;
+    }
+
+    if (!file->headerWritten) {
+        file->cipher = header[HeaderCipher];
+        file->blockSize = int(get32(header + HeaderBlockSize));
+        if (!evpCipher(file->cipher) || file->blockSize < CRYPT_MIN_BLOCK
+            || file->blockSize > CRYPT_MAX_BLOCK || (file->blockSize & (file->blockSize - 1)))
+            return SQLITE_CANTOPEN;
+        if (!allocateBuffers(file))
+            return SQLITE_NOMEM;
+        file->encrypted = true;
+        file->headerWritten = true;
+    }
+    file->logicalSize = sqlite3_int64(get64(header + HeaderLogicalSize));
+    file->headerKeyId = header[HeaderKeyId];
+    if (found)
+        *found = true;
+    return SQLITE_OK;
+}
+
+static int writeHeader(CryptFile *file, int firstWriteSize, sqlite3_int64 firstWriteOffset)
+{
+    // A database's first write is page 1, so blocks line up with pages.
+    int blockSize = CRYPT_DEFAULT_BLOCK;
+    if (firstWriteOffset == 0 && firstWriteSize >= CRYPT_MIN_BLOCK
+        && firstWriteSize <= CRYPT_MAX_BLOCK && (firstWriteSize & (firstWriteSize - 1)) == 0)
+        blockSize = firstWriteSize;
+
+    file->blockSize = blockSize;
+    file->cipher = preferredCipherId();
+    file->logicalSize = 0;
+    if (!allocateBuffers(file))
+        return SQLITE_NOMEM;
+
+    const int rc = writeHeaderFields(file);
+    if (rc == SQLITE_OK)
+        file->headerWritten = true;
+    return rc;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Rekey log
+//
+// A rekey rewrites blocks in place. The new blocks of a batch are first
+// written to "<file>-rekey" and synced, so a batch cut short by a crash is
+// finished by replaying the log the next time the database is opened.
+
+static quint32 logChecksum(const unsigned char *data, size_t length, quint32 sum)
+{
+    for (size_t i = 0; i < length; ++i)
+        sum = (sum ^ data[i]) * 16777619u;
+    return sum;
+}
+
+static QByteArray rekeyLogPath(const char *path)
+{
+    return QByteArray(path) + "-rekey";
+}
+
+static bool writeAll(int fd, const void *data, size_t length)
+{
+    const char *p = static_cast<const char *>(data);
+    while (length > 0) {
+        const ssize_t n = ::write(fd, p, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        length -= size_t(n);
+    }
+    return true;
+}
+
+static void replayRekeyLog(CryptFile *file)
+{
+    const QByteArray logPath = rekeyLogPath(file->path);
+    QFile log(QString::fromLocal8Bit(logPath));
+    if (!log.exists() || !log.open(QIODevice::ReadOnly))
+        return;
+
+    const QByteArray data = log.readAll();
+    log.close();
+
+    // [magic][u32 count][u32 block bytes] then count x ([u64 offset][block]), then [u32 checksum]
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data.constData());
+    if (data.size() < 16 || memcmp(p, REKEY_MAGIC, 4) != 0)
+        return;
+    const quint32 count = get32(p + 4);
+    const quint32 blockBytes = get32(p + 8);
+    const qint64 expected = 12 + qint64(count) * (8 + blockBytes) + 4;
+    if (data.size() != expected
+        || logChecksum(p, size_t(expected - 4), 2166136261u) != get32(p + expected - 4))
+        return;   // torn: the batch never reached the database file
+
+    const unsigned char *entry = p + 12;
+    for (quint32 i = 0; i < count; ++i, entry += 8 + blockBytes) {
+        if (file->real->pMethods->xWrite(file->real, entry + 8, int(blockBytes),
+                                         sqlite3_int64(get64(entry))) != SQLITE_OK)
+            return;
+    }
+    if (file->real->pMethods->xSync(file->real, SQLITE_SYNC_NORMAL) == SQLITE_OK)
+        ::unlink(logPath.constData());
+}
+
+/*
+ * Re-encrypts the blocks of a batch that are not under the current key.
+ * Called through sqlite3_file_control() while the caller holds an exclusive
+ * lock on the database.
+ */
+static int rekeyBlocks(CryptFile *file, CryptRekeyStep *step)
+{
+    step->rewritten = 0;
+    step->blockSize = file->blockSize;
+    step->pastEnd = true;
+    if (!file->encrypted)
+        return SQLITE_OK;
+    int rc = refreshHeader(file);
+    if (rc != SQLITE_OK || !file->headerWritten)
+        return rc;
+    step->blockSize = file->blockSize;
+
+    const int currentId = currentKeyId();
+    const sqlite3_int64 blocks = (file->logicalSize + file->blockSize - 1) / file->blockSize;
+    const sqlite3_int64 last = qMin<sqlite3_int64>(blocks, step->firstBlock + step->blockCount);
+    step->pastEnd = last >= blocks;
+
+    // The last batch also moves the header tag to the current key.
+    if (step->pastEnd && file->headerKeyId != currentId
+        && (rc = writeHeaderFields(file)) != SQLITE_OK)
+        return rc;
+
+    QByteArray entries;
+    for (sqlite3_int64 block = step->firstBlock; block < last; ++block) {
+        rc = file->real->pMethods->xRead(file->real, file->physical, physicalBlockSize(file),
+                                             blockOffset(file, block));
+        if (rc != SQLITE_OK && rc != SQLITE_IOERR_SHORT_READ)
+            return rc;
+        if (file->physical[BlockKeyId] == currentId)
+            continue;
+        if ((rc = openBlock(file, block, file->plain)) != SQLITE_OK
+            || (rc = sealBlock(file, block, file->plain)) != SQLITE_OK)
+            return rc;
+
+        unsigned char offset[8];
+        put64(offset, quint64(blockOffset(file, block)));
+        entries.append(reinterpret_cast<const char *>(offset), 8);
+        entries.append(reinterpret_cast<const char *>(file->physical), physicalBlockSize(file));
+        ++step->rewritten;
+    }
+    if (!step->rewritten)
+        return SQLITE_OK;
+
+    // 1. The log, synced before anything in the database file changes.
+    unsigned char head[12];
+    memcpy(head, REKEY_MAGIC, 4);
+    put32(head + 4, quint32(step->rewritten));
+    put32(head + 8, quint32(physicalBlockSize(file)));
+    quint32 sum = logChecksum(head, sizeof(head), 2166136261u);
+    sum = logChecksum(reinterpret_cast<const unsigned char *>(entries.constData()),
+                      size_t(entries.size()), sum);
+    unsigned char trailer[4];
+    put32(trailer, sum);
+
+    g_rekeyActive.ref();
+    const QByteArray logPath = rekeyLogPath(file->path);
+    const int fd = ::open(logPath.constData(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    bool ok = fd >= 0 && writeAll(fd, head, sizeof(head))
+              && writeAll(fd, entries.constData(), size_t(entries.size()))
+              && writeAll(fd, trailer, sizeof(trailer)) && ::fsync(fd) == 0;
+    if (fd >= 0)
+        ::close(fd);
+
+    // 2. The blocks in place, then the log goes.
+    rc = ok ? SQLITE_OK : SQLITE_IOERR_WRITE;
+    const unsigned char *entry = reinterpret_cast<const unsigned char *>(entries.constData());
+    for (int i = 0; rc == SQLITE_OK && i < step->rewritten; ++i) {
+        rc = file->real->pMethods->xWrite(file->real, entry + 8, physicalBlockSize(file),
+                                          sqlite3_int64(get64(entry)));
+        entry += 8 + physicalBlockSize(file);
+    }
+    if (rc == SQLITE_OK)
+        rc = file->real->pMethods->xSync(file->real, SQLITE_SYNC_NORMAL);
+    if (rc == SQLITE_OK)
+        ::unlink(logPath.constData());
+    g_rekeyActive.deref();
+    return rc;
+}
+
+// -----------------------------------------------------------------------------------------------
+// sqlite3_io_methods
+
+static int cryptClose(sqlite3_file *pFile)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    const int rc = file->real->pMethods ? file->real->pMethods->xClose(file->real) : SQLITE_OK;
+    freeContext(&file->sealer);
+    freeContext(&file->opener);
+    sqlite3_free(file->plain);
+    sqlite3_free(file->physical);
+    file->plain = 0;
+    file->physical = 0;
+    return rc;
+}
+
+static int cryptRead(sqlite3_file *pFile, void *buffer, int amount, sqlite3_int64 offset)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    if (!file->encrypted)
+        return file->real->pMethods->xRead(file->real, buffer, amount, offset);
+
+    if (!file->headerWritten || offset + amount > file->logicalSize) {
+        const int rc = refreshHeader(file);
+        if (rc != SQLITE_OK)
+            return rc;
+    }
+
+    unsigned char *out = static_cast<unsigned char *>(buffer);
+    const sqlite3_int64 available = file->headerWritten
+                                  ? qMax<sqlite3_int64>(0, file->logicalSize - offset) : 0;
+    const int length = int(qMin<sqlite3_int64>(amount, available));
+
+    int done = 0;
+    while (done < length) {
+        const sqlite3_int64 position = offset + done;
+        const sqlite3_int64 block = position / file->blockSize;
+        const int inner = int(position % file->blockSize);
+        const int n = qMin(file->blockSize - inner, length - done);
+
+        // A whole block, as a page read is, opens straight into the caller's buffer.
+        const bool whole = inner == 0 && n == file->blockSize;
+        const int rc = readBlock(file, block, whole ? out + done : file->plain);
+        if (rc != SQLITE_OK)
+            return rc;
+        if (!whole)
+            memcpy(out + done, file->plain + inner, n);
+        done += n;
+    }
+
+    if (length < amount) {
+        memset(out + length, 0, amount - length);
+        return SQLITE_IOERR_SHORT_READ;
+    }
+    return SQLITE_OK;
+}
+
+static int cryptWrite(sqlite3_file *pFile, const void *buffer, int amount, sqlite3_int64 offset)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    if (!file->encrypted)
+        return file->real->pMethods->xWrite(file->real, buffer, amount, offset);
+
+    int rc = SQLITE_OK;
+    if ((!file->headerWritten || offset + amount > file->logicalSize)
+        && (rc = refreshHeader(file)) != SQLITE_OK)
+        return rc;
+    if (!file->headerWritten && (rc = writeHeader(file, amount, offset)) != SQLITE_OK)
+        return rc;
+
+    // Blocks a write past the end skips over are sealed as zeros first.
+    const sqlite3_int64 endBlock = (file->logicalSize + file->blockSize - 1) / file->blockSize;
+    if (offset / file->blockSize > endBlock
+        && (rc = writeZeroBlocks(file, endBlock, offset / file->blockSize)) != SQLITE_OK)
+        return rc;
+
+    const unsigned char *in = static_cast<const unsigned char *>(buffer);
+    int done = 0;
+    while (done < amount) {
+        const sqlite3_int64 position = offset + done;
+        const sqlite3_int64 block = position / file->blockSize;
+        const int inner = int(position % file->blockSize);
+        const int n = qMin(file->blockSize - inner, amount - done);
+
+        if (inner == 0 && n == file->blockSize) {
+            rc = writeBlock(file, block, in + done);
+        } else {
+            // Partial block: read, modify, write.
+            if (block * file->blockSize < file->logicalSize)
+                rc = readBlock(file, block, file->plain);
+            else
+                memset(file->plain, 0, file->blockSize);
+            if (rc == SQLITE_OK) {
+                memcpy(file->plain + inner, in + done, n);
+                rc = writeBlock(file, block, file->plain);
+            }
+        }
+        if (rc != SQLITE_OK)
+            return rc;
+        done += n;
+    }
+
+    if (offset + amount > file->logicalSize) {
+        file->logicalSize = offset + amount;
+        rc = writeHeaderFields(file);
+    }
+    return rc;
+}
+
+static int cryptTruncate(sqlite3_file *pFile, sqlite3_int64 size)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    if (!file->encrypted)
+        return file->real->pMethods->xTruncate(file->real, size);
+
+    int rc = refreshHeader(file);
+    if (rc != SQLITE_OK || !file->headerWritten)
+        return rc;
+
+    const sqlite3_int64 blocks = (size + file->blockSize - 1) / file->blockSize;
+    const int tail = int(size % file->blockSize);
+
+    // Growing the file seals the new blocks as zeros.
+    const sqlite3_int64 endBlock = (file->logicalSize + file->blockSize - 1) / file->blockSize;
+    if (blocks > endBlock)
+        rc = writeZeroBlocks(file, endBlock, blocks);
+
+    // Clear the rest of a cut block, so growing the file again reads zeros.
+    if (rc == SQLITE_OK && tail && size < file->logicalSize) {
+        rc = readBlock(file, blocks - 1, file->plain);
+        if (rc == SQLITE_OK) {
+            memset(file->plain + tail, 0, file->blockSize - tail);
+            rc = writeBlock(file, blocks - 1, file->plain);
+        }
+    }
+    if (rc == SQLITE_OK)
+        rc = file->real->pMethods->xTruncate(file->real, blockOffset(file, blocks));
+    if (rc == SQLITE_OK) {
+        file->logicalSize = size;
+        rc = writeHeaderFields(file);
+    }
+    return rc;
+}
+
+static int cryptSync(sqlite3_file *pFile, int flags)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    return file->real->pMethods->xSync(file->real, flags);
+}
+
+static int cryptFileSize(sqlite3_file *pFile, sqlite3_int64 *size)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    if (!file->encrypted)
+        return file->real->pMethods->xFileSize(file->real, size);
+    const int rc = refreshHeader(file);
+    *size = file->headerWritten ? file->logicalSize : 0;
+    return rc;
+}
+
+static int cryptLock(sqlite3_file *pFile, int lock)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    return file->real->pMethods->xLock(file->real, lock);
+}
+
+static int cryptUnlock(sqlite3_file *pFile, int lock)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    return file->real->pMethods->xUnlock(file->real, lock);
+}
+
+static int cryptCheckReservedLock(sqlite3_file *pFile, int *result)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    return file->real->pMethods->xCheckReservedLock(file->real, result);
+}
+
+static int cryptFileControl(sqlite3_file *pFile, int op, void *arg)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    if (op == CRYPT_FCNTL_REKEY)
+        return rekeyBlocks(file, static_cast<CryptRekeyStep *>(arg));
+    if (file->encrypted && op == SQLITE_FCNTL_SIZE_HINT)
+        return SQLITE_OK;   // in logical bytes; the physical size differs
+    return file->real->pMethods->xFileControl(file->real, op, arg);
+}
+
+static int cryptSectorSize(sqlite3_file *pFile)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    const int sector = file->real->pMethods->xSectorSize(file->real);
+    if (!file->encrypted)
+        return sector;
+    return qMax(sector, file->headerWritten ? file->blockSize : int(CRYPT_DEFAULT_BLOCK));
+}
+
+static int cryptDeviceCharacteristics(sqlite3_file *pFile)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    int flags = file->real->pMethods->xDeviceCharacteristics(file->real);
+    if (file->encrypted) {
+        // A write rewrites whole blocks, so it is neither atomic nor powersafe.
+        flags &= ~(SQLITE_IOCAP_ATOMIC | SQLITE_IOCAP_ATOMIC512 | SQLITE_IOCAP_ATOMIC1K
+                   | SQLITE_IOCAP_ATOMIC2K | SQLITE_IOCAP_ATOMIC4K | SQLITE_IOCAP_ATOMIC8K
+                   | SQLITE_IOCAP_ATOMIC16K | SQLITE_IOCAP_ATOMIC32K | SQLITE_IOCAP_ATOMIC64K);
+#ifdef SQLITE_IOCAP_POWERSAFE_OVERWRITE
+        flags &= ~SQLITE_IOCAP_POWERSAFE_OVERWRITE;
+#endif
+    }
+    return flags;
+}
+
+static int cryptShmMap(sqlite3_file *pFile, int region, int size, int extend, void volatile **pp)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    return file->real->pMethods->xShmMap(file->real, region, size, extend, pp);
+}
+
+static int cryptShmLock(sqlite3_file *pFile, int offset, int n, int flags)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    return file->real->pMethods->xShmLock(file->real, offset, n, flags);
+}
+
+static void cryptShmBarrier(sqlite3_file *pFile)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    file->real->pMethods->xShmBarrier(file->real);
+}
+
+static int cryptShmUnmap(sqlite3_file *pFile, int deleteFlag)
+{
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    return file->real->pMethods->xShmUnmap(file->real, deleteFlag);
+}
+
+// Version 1 and 2 methods only: version 3 adds xFetch (mmap), which would hand
+// SQLite the ciphertext.
+static sqlite3_io_methods g_methodsV1 = {
+    1, cryptClose, cryptRead, cryptWrite, cryptTruncate, cryptSync, cryptFileSize,
+    cryptLock, cryptUnlock, cryptCheckReservedLock, cryptFileControl, cryptSectorSize,
+    cryptDeviceCharacteristics, 0, 0, 0, 0
+};
+
+static sqlite3_io_methods g_methodsV2 = {
+    2, cryptClose, cryptRead, cryptWrite, cryptTruncate, cryptSync, cryptFileSize,
+    cryptLock, cryptUnlock, cryptCheckReservedLock, cryptFileControl, cryptSectorSize,
+    cryptDeviceCharacteristics, cryptShmMap, cryptShmLock, cryptShmBarrier, cryptShmUnmap
+};
+
+// -----------------------------------------------------------------------------------------------
+// sqlite3_vfs
+
+static int cryptOpen(sqlite3_vfs *vfs, const char *name, sqlite3_file *pFile, int flags,
+                     int *outFlags)
+{
+    Q_UNUSED(vfs);
+    CryptFile *file = reinterpret_cast<CryptFile *>(pFile);
+    memset(file, 0, sizeof(CryptFile));
+    file->real = reinterpret_cast<sqlite3_file *>(file + 1);
+    file->path = name;
+
+    int rc = g_root->xOpen(g_root, name, file->real, flags, outFlags);
+    if (rc != SQLITE_OK) {
+        file->real->pMethods = 0;
+        return rc;
+    }
+
+    initContext(&file->sealer, true);
+    initContext(&file->opener, false);
+    file->base.pMethods = file->real->pMethods->iVersion >= 2 ? &g_methodsV2 : &g_methodsV1;
+
+    sqlite3_int64 size = 0;
+    rc = file->real->pMethods->xFileSize(file->real, &size);
+    if (rc != SQLITE_OK) {
+        cryptClose(pFile);
+        file->base.pMethods = 0;
+        return rc;
+    }
+
+    if (size >= CRYPT_HEADER_BYTES) {
+        bool found = false;
+        rc = refreshHeader(file, &found);
+        if (rc != SQLITE_OK) {
+            cryptClose(pFile);
+            file->base.pMethods = 0;
+            return rc;
+        }
+        if (found && name && (flags & SQLITE_OPEN_MAIN_DB) && !g_rekeyActive)
+            replayRekeyLog(file);
+    } else if (size == 0 && CryptoVfs::hasKeys()) {
+        // New (or empty) file: encrypted, header written on the first write.
+        file->encrypted = true;
+    }
+    return SQLITE_OK;
+}
+
+static int cryptDelete(sqlite3_vfs *, const char *name, int syncDir)
+{
+    return g_root->xDelete(g_root, name, syncDir);
+}
+
+static int cryptAccess(sqlite3_vfs *, const char *name, int flags, int *result)
+{
+    return g_root->xAccess(g_root, name, flags, result);
+}
+
+static int cryptFullPathname(sqlite3_vfs *, const char *name, int n, char *out)
+{
+    return g_root->xFullPathname(g_root, name, n, out);
+}
+
+static void *cryptDlOpen(sqlite3_vfs *, const char *name)
+{
+    return g_root->xDlOpen(g_root, name);
+}
+
+static void cryptDlError(sqlite3_vfs *, int n, char *message)
+{
+    g_root->xDlError(g_root, n, message);
+}
+
+static void (*cryptDlSym(sqlite3_vfs *, void *handle, const char *symbol))(void)
+{
+    return g_root->xDlSym(g_root, handle, symbol);
+}
+
+static void cryptDlClose(sqlite3_vfs *, void *handle)
+{
+    g_root->xDlClose(g_root, handle);
+}
+
+static int cryptRandomness(sqlite3_vfs *, int n, char *out)
+{
+    return g_root->xRandomness(g_root, n, out);
+}
+
+static int cryptSleep(sqlite3_vfs *, int microseconds)
+{
+    return g_root->xSleep(g_root, microseconds);
+}
+
+static int cryptCurrentTime(sqlite3_vfs *, double *now)
+{
+    return g_root->xCurrentTime(g_root, now);
+}
+
+static int cryptGetLastError(sqlite3_vfs *, int n, char *message)
+{
+    return g_root->xGetLastError ? g_root->xGetLastError(g_root, n, message) : 0;
+}
+
+static sqlite3_vfs g_vfs;
+
+// -----------------------------------------------------------------------------------------------
+// CryptoVfs
+
+bool CryptoVfs::install()
+{
+    if (g_root)
+        return true;
+
+    sqlite3_vfs *root = sqlite3_vfs_find(0);
+    if (!root)
+        return false;
+
+    // Version 1 of the VFS interface is all this layer needs; the root's
+    // later entry points (xCurrentTimeInt64, syscalls) are not forwarded.
+    memset(&g_vfs, 0, sizeof(g_vfs));
+    g_vfs.iVersion = 1;
+    g_vfs.szOsFile = int(sizeof(CryptFile)) + root->szOsFile;
+    g_vfs.mxPathname = root->mxPathname;
+    g_vfs.zName = CRYPT_VFS_NAME;
+    g_vfs.xOpen = cryptOpen;
+    g_vfs.xDelete = cryptDelete;
+    g_vfs.xAccess = cryptAccess;
+    g_vfs.xFullPathname = cryptFullPathname;
+    g_vfs.xDlOpen = cryptDlOpen;
+    g_vfs.xDlError = cryptDlError;
+    g_vfs.xDlSym = cryptDlSym;
+    g_vfs.xDlClose = cryptDlClose;
+    g_vfs.xRandomness = cryptRandomness;
+    g_vfs.xSleep = cryptSleep;
+    g_vfs.xCurrentTime = cryptCurrentTime;
+    g_vfs.xGetLastError = cryptGetLastError;
+
+    g_root = root;
+    if (sqlite3_vfs_register(&g_vfs, 1) != SQLITE_OK) {
+        g_root = 0;
+        return false;
+    }
+    return true;
+}
+
+void CryptoVfs::setKeys(const QMap<int, QByteArray> &keys, int currentId)
+{
+    QMutexLocker locker(&g_keyLock);
+    g_keyGeneration.ref();
+    memset(g_keys, 0, sizeof(g_keys));
+    memset(g_keyLoaded, 0, sizeof(g_keyLoaded));
+    g_currentKey = -1;
+
+    QMap<int, QByteArray>::const_iterator it;
+    for (it = keys.constBegin(); it != keys.constEnd(); ++it) {
+        if (it.key() < 0 || it.key() >= CRYPT_MAX_KEYS || it.value().size() != CRYPT_KEY_BYTES)
+            continue;
+        memcpy(g_keys[it.key()], it.value().constData(), CRYPT_KEY_BYTES);
+        g_keyLoaded[it.key()] = true;
+    }
+    if (currentId >= 0 && currentId < CRYPT_MAX_KEYS && g_keyLoaded[currentId])
+        g_currentKey = currentId;
+}
+
+bool CryptoVfs::hasKeys()
+{
+    QMutexLocker locker(&g_keyLock);
+    return g_currentKey >= 0;
+}
+
+bool CryptoVfs::isEncrypted(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray magic = file.read(sizeof(CRYPT_MAGIC));
+    return magic == QByteArray(CRYPT_MAGIC, sizeof(CRYPT_MAGIC));
+}
+
+QString CryptoVfs::preferredCipher()
+{
+    return preferredCipherId() == CipherChaChaPoly ? "ChaCha20-Poly1305" : "AES-256-GCM";
+}
+
+QByteArray CryptoVfs::seal(const QByteArray &key, const QByteArray &plain, const QByteArray &aad)
+{
+    if (key.size() != CRYPT_KEY_BYTES)
+        return QByteArray();
+
+    // [nonce][ciphertext][tag]
+    QByteArray sealed(CRYPT_NONCE_BYTES + plain.size() + CRYPT_TAG_BYTES, '\0');
+    unsigned char *out = reinterpret_cast<unsigned char *>(sealed.data());
+    if (RAND_bytes(out, CRYPT_NONCE_BYTES) != 1)
+        return QByteArray();
+
+    AeadContext aead;
+    initContext(&aead, true);
+    const bool ok = aeadSeal(&aead, CipherAesGcm, 0,
+                             reinterpret_cast<const unsigned char *>(key.constData()), out,
+                             reinterpret_cast<const unsigned char *>(aad.constData()), aad.size(),
+                             reinterpret_cast<const unsigned char *>(plain.constData()),
+                             plain.size(), out + CRYPT_NONCE_BYTES,
+                             out + CRYPT_NONCE_BYTES + plain.size());
+    freeContext(&aead);
+    return ok ? sealed : QByteArray();
+}
+
+bool CryptoVfs::open(const QByteArray &key, const QByteArray &sealed, const QByteArray &aad,
+                     QByteArray &plain)
+{
+    if (key.size() != CRYPT_KEY_BYTES || sealed.size() < CRYPT_NONCE_BYTES + CRYPT_TAG_BYTES)
+        return false;
+
+    const int length = sealed.size() - CRYPT_NONCE_BYTES - CRYPT_TAG_BYTES;
+    const unsigned char *in = reinterpret_cast<const unsigned char *>(sealed.constData());
+    plain.resize(length);
+
+    AeadContext aead;
+    initContext(&aead, false);
+    const bool ok = aeadOpen(&aead, CipherAesGcm, 0,
+                             reinterpret_cast<const unsigned char *>(key.constData()), in,
+                             reinterpret_cast<const unsigned char *>(aad.constData()), aad.size(),
+                             in + CRYPT_NONCE_BYTES, length,
+                             reinterpret_cast<unsigned char *>(plain.data()),
+                             in + CRYPT_NONCE_BYTES + length);
+    freeContext(&aead);
+    if (!ok)
+        plain.clear();
+    return ok;
+}
@@ -0,0 +1,78 @@
+/*
+ * cryptovfs.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef CRYPTOVFS_HPP_
+#define CRYPTOVFS_HPP_
+
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+
+#define CRYPT_KEY_BYTES 32
+
+// sqlite3_file_control() opcode: re-encrypts a run of blocks with the current key.
+#define CRYPT_FCNTL_REKEY 0x44570001
+
+struct CryptRekeyStep
+{
+    qint64 firstBlock;    // in
+    int blockCount;       // in
+    int rewritten;        // out
+    int blockSize;        // out
+    bool pastEnd;         // out: firstBlock + blockCount covers the end of the file
+};
+
+/*
+ * @brief SQLite VFS that encrypts database and journal files page by page.
+ *
+ * install() registers the VFS as the default, on top of the platform VFS, so
+ * every QSQLITE connection goes through it without further changes. Files
+ * are stored as a 64-byte header followed by fixed-size blocks:
+ *
+ *   [u8 key id][3 reserved][12-byte nonce][16-byte tag][block ciphertext]
+ *
+ * Each block is sealed with an AEAD cipher (AES-256-GCM, or ChaCha20-Poly1305
+ * on CPUs without AES instructions when OpenSSL has it), with the block
+ * number, key id, cipher and block size as associated data so blocks cannot
+ * be moved, swapped or read under other header fields. The cipher is chosen
+ * when a file is created and recorded in its header, which carries a tag of
+ * its own over the fields and the logical size. Every block below the
+ * logical size is sealed, the ones a write past the end skips over as
+ * zeros, so a block that does not open is always an error.
+ * The block size is the size of the first write (the page size, for a
+ * database), so page writes normally cover whole blocks; the sector size is
+ * reported as the block size so SQLite journals everything a block write
+ * can touch.
+ *
+ * Files without the header are passed through unchanged, which keeps a
+ * plaintext journal readable until it has been converted. New files are
+ * only encrypted while keys are loaded.
+ *
+ * Memory-mapped I/O is not offered, since it would bypass decryption.
+ */
+class CryptoVfs
+{
+public:
+    static bool install();
+
+    // Keys by id; blocks are written with 'currentId'. Empty clears the keys.
+    static void setKeys(const QMap<int, QByteArray> &keys, int currentId);
+    static bool hasKeys();
+
+    // True if the file at 'path' carries the encrypted header.
+    static bool isEncrypted(const QString &path);
+
+    // The cipher new files get on this CPU: "AES-256-GCM" or "ChaCha20-Poly1305".
+    static QString preferredCipher();
+
+    // AEAD helpers shared with the key file.
+    static QByteArray seal(const QByteArray &key, const QByteArray &plain, const QByteArray &aad);
+    static bool open(const QByteArray &key, const QByteArray &sealed, const QByteArray &aad,
+                     QByteArray &plain);
+};
+
+#endif /* CRYPTOVFS_HPP_ */
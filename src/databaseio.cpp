@@ -13,54 +13,219 @@
  * limitations under the License.
  */
 #include "databaseio.hpp"
+#include "cryptovfs.hpp"
+#include "iovfs.hpp"
+#include "journalencryption.hpp"
+#include "journalexporter.hpp"
+#include "journalimporter.hpp"
+#include "journalqueries.hpp"
+#include "maintenancescheduler.hpp"
+#include "schemamigrator.hpp"
+#include "sqlitestorage.hpp"
+#include "textcounter.hpp"
+#include "voicerecorder.hpp"
+#include "voicesource.hpp"
+#include "wordcompleter.hpp"
+#include "EventData.hpp"
 
 
 #include <bb/cascades/QmlDocument>
 #include <bb/data/SqlDataAccess>
-#include <bb/system/SystemDialog>
+#include <bb/system/SystemToast>
 
 #include <QtSql/QtSql>
 
+#include <climits>
+
 using namespace bb::cascades;
 using namespace bb::system;
 using namespace bb::data;
 
 const QString DATABASENAME = "./data/DWriteData.db";
+const QString VOICENOTES = "./data/voice";
+const QString WORDCOMPLETION = "./data/WordCompletion.trie";
 
 #define INITIAL_LOAD_ID 10
 #define ASYNCH_LOAD_ID 20
 
 #define ASYNCH_BATCH_SIZE 10
 
+#define TRASH_PURGE_BATCH 200
+
+// How long Buffered writes wait for a stronger write before they are committed.
+#define WRITE_BUFFER_MS 1000
+
 //! [0]
-DatabaseIo::DatabaseIo()
+DatabaseIo::DatabaseIo(StorageBackend *backend)
     : m_sqlConnection(0)
+    , m_migrator(0)
+    , m_maintenance(0)
+    , m_backend(backend)
+    , m_importer(0)
+    , m_exporter(0)
+    , m_memory(0)
+    , m_pageCache(0)
+    , m_keys(DATABASENAME)
+    , m_encryption(0)
+    , m_voice(0)
+    , m_voiceEventId(-1)
+    , m_flushTimer(0)
+    , m_completer(0)
+    , m_status(0)
+    , m_toast(0)
 {
-    // Since we need read and write access to the database, it has
-    // to be moved to a folder where we have access to it. First,
-    // we check if the file already exists (previously copied).
-    QFile newFile(DATABASENAME);
+    m_status = new StatusChannel(this);
+    connect(m_status, SIGNAL(messagesPosted()), this, SLOT(onStatusMessages()));
+
+    m_memory = new MemoryBudget(MEMORY_DEFAULT_LIMIT, this);
+
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(WRITE_BUFFER_MS);
+    connect(m_flushTimer, SIGNAL(timeout()), this, SLOT(flushWrites()));
+
+    m_migrator = new SchemaMigrator(DATABASENAME, this);
+    connect(m_migrator, SIGNAL(progress(int, qint64, qint64)),
+            this, SIGNAL(migrationProgress(int, qint64, qint64)));
+    connect(m_migrator, SIGNAL(finished()), this, SLOT(onMigrationFinished()));
+    connect(m_migrator, SIGNAL(error(const QString&)), this, SLOT(onMigrationError(const QString&)));
+
+    // A backend handed in by the caller (the in-memory journal used by tests and
+    // benchmarks, or the log-structured store) manages its own storage. Only the
+    // default SQLite journal needs the database file and connections below.
+    if (!m_backend) {
+        // Every SQLite file goes through the encrypting VFS; files stay plaintext
+        // until the journal keys exist. The I/O accounting sits below it and
+        // counts the encrypted blocks.
+        IoVfs::install();
+        CryptoVfs::install();
+
+        m_backend = new SqliteStorage(DATABASENAME);
+
+        // Opened once the data migration is done, see onMigrationFinished().
+        m_completer = new WordCompleter(DATABASENAME, WORDCOMPLETION, this);
+
+        // Started once the data migration is done, see onMigrationFinished().
+        m_maintenance = new MaintenanceScheduler(DATABASENAME, this);
+
+        // 1. Create a new SqlConnection object and point it at the database
+        //    It will automatically open a connection to the database using the QSqlDatabase object
+        //    if necessary. Note that a reference to the SqlConnection object is tracked so that
+        //    it can be freed later. Alternatively, you could assign the SqlConnection
+        m_sqlConnection = new SqlConnection(DATABASENAME);
+
+        // 2. Connect a slot to the SqlConnection objects 'reply' signal which is emitted when the
+        //    executed query is complete.
+        //    Note: types are fully qualified with namespaces (e,g, bb::data::) when used with all
+        //    MOC macros (in this case, SIGNAL and SLOT)
+        connect(m_sqlConnection, SIGNAL(reply(const bb::data::DataAccessReply&)),
+                this, SLOT(onLoadAsyncResultData(const bb::data::DataAccessReply&)));
 
-    if (!newFile.exists()) {
-    	createDatabase();
+        // The passphrase of an encrypted journal is asked for; nothing on the
+        // device can stand in for it. The journal stays closed until then.
+        if (m_keys.exists()) {
+            report(StatusChannel::Notice, StatusChannel::Journal,
+                   tr("Enter the passphrase to open the journal."));
+            return;
+        }
+    }
+    openJournal();
+}
+
+bool DatabaseIo::unlockJournal(const QString &passphrase)
+{
+    if (!m_keys.exists() || m_keys.currentKeyId() >= 0) {
+        return true;
+    }
+    if (!m_keys.unlock(passphrase)) {
+        report(StatusChannel::Error, StatusChannel::Journal,
+               tr("Error unlocking the journal: %1"), m_keys.lastError());
+        return false;
     }
 
-    // 1. Create a new SqlConnection object and point it at the database
-    //    It will automatically open a connection to the database using the QSqlDatabase object
-    //    if necessary. Note that a reference to the SqlConnection object is tracked so that
-    //    it can be freed later. Alternatively, you could assign the SqlConnection
-    m_sqlConnection = new SqlConnection(DATABASENAME);
+    // A finished conversion to encrypted pages replaces the plaintext journal
+    // here, before anything has it open.
+    JournalEncryption::finishConversion(DATABASENAME);
+    openJournal();
+    emit journalUnlocked();
+    return true;
+}
+
+bool DatabaseIo::isJournalLocked() const
+{
+    return m_sqlConnection && m_keys.exists() && m_keys.currentKeyId() < 0;
+}
+
+void DatabaseIo::openJournal()
+{
+    if (m_sqlConnection) {
+        // Since we need read and write access to the database, it has
+        // to be moved to a folder where we have access to it. First,
+        // we check if the file already exists (previously copied).
+        QFile newFile(DATABASENAME);
+
+        if (!newFile.exists()) {
+            createDatabase();
+        } else {
+            upgradeDatabase();
+        }
+
+        // Existing rows are brought up to the current schema version in small batches
+        // on a worker thread. An upgrade that was interrupted picks up where it stopped.
+        m_migrator->startBackgroundMigration();
+
+        if (m_completer) {
+            m_completer->rebuild();
+        }
+    }
 
-    // 2. Connect a slot to the SqlConnection objects 'reply' signal which is emitted when the
-    //    executed query is complete.
-    //    Note: types are fully qualified with namespaces (e,g, bb::data::) when used with all
-    //    MOC macros (in this case, SIGNAL and SLOT)
-    connect(m_sqlConnection, SIGNAL(reply(const bb::data::DataAccessReply&)),
-            this, SLOT(onLoadAsyncResultData(const bb::data::DataAccessReply&)));
+    if (!m_backend->open()) {
+        report(StatusChannel::Error, StatusChannel::Journal,
+               tr("Error opening the journal: %1"), m_backend->lastError());
+    } else if (m_backend->database().isValid()) {
+        m_facets.load(m_backend->database());
+        m_rowIndex.load(m_backend->database());
+        m_pageCache = new SqliteCacheConsumer(m_backend->database(), "sqlite pages");
+        m_memory->addConsumer(m_pageCache);
+    }
 }
 
 DatabaseIo::~DatabaseIo()
 {
+    m_migrator->stopBackgroundMigration();
+    if (m_maintenance) {
+        m_maintenance->stop();
+    }
+    if (m_importer) {
+        m_importer->stop();
+    }
+    if (m_exporter) {
+        m_exporter->stop();
+    }
+    if (m_encryption) {
+        m_encryption->stop();
+    }
+    if (m_voice) {
+        m_voice->stop();
+    }
+    if (m_completer) {
+        m_completer->stop();
+    }
+
+    if (m_pageCache) {
+        m_memory->removeConsumer(m_pageCache);
+        delete m_pageCache;
+        m_pageCache = 0;
+    }
+
+    m_backend->close();
+    delete m_backend;
+    m_backend = 0;
+
+    if (!m_sqlConnection) {
+        return;
+    }
+
     if (m_sqlConnection->isRunning()) {
     	m_sqlConnection->stop();
     }
@@ -94,38 +259,29 @@ bool DatabaseIo::createDatabase()
     // 3. Open a connection to the database, if the database does not exist
     //    one will be created if permitted.
     if (database.open()) {
-        alert(tr("Database created/registered."));
+        report(StatusChannel::Info, StatusChannel::Journal, tr("Database created/registered."));
         success = true;
     } else {
         // If the database fails to open, error information can be accessed via
         // the lastError function.
         const QSqlError error = database.lastError();
-        alert(tr("Error opening connection to the database: %1").arg(error.text()));
-    }
-
-    // 2. Create a query to execute.
-    //    The below query creates a table with customerID, firstName, and lastName columns
-    //    if it does not already exist.
-    const QString createSQL = "CREATE TABLE IF NOT EXISTS events ( "
-                              "                eventID INTEGER PRIMARY KEY AUTOINCREMENT, "
-                              "                timeStamp VARCHAR, "
-                              "                textEvent VARCHAR"
-                              ");";
-
-    // 3. Create an QSqlQuery object with which you can execute queries
-    //    NOTE: The QSqlDatabase function has an 'exec' function, however this
-    //    is deprecated and should be avoided.
-    QSqlQuery query(database);
-    if (query.exec(createSQL)) {
-        alert(tr("Table creation query execute successfully"));
+        report(StatusChannel::Error, StatusChannel::Journal,
+               tr("Error opening connection to the database: %1"), error.text());
+    }
+
+    // 2. Bring the new database up to the current schema version.
+    //    The schema lives in one place (SchemaMigrator) and is versioned with
+    //    PRAGMA user_version, so the same steps also upgrade older databases.
+    QString errorText;
+    if (m_migrator->migrateSchema(database, &errorText)) {
+        report(StatusChannel::Info, StatusChannel::Schema,
+               tr("Table creation query execute successfully"));
     } else {
-        // If 'exec' fails, error information can be accessed via the lastError function
-        // the last error is reset every time exec is called.
-        const QSqlError error = query.lastError();
-        alert(tr("Create table error: %1").arg(error.text()));
+        report(StatusChannel::Error, StatusChannel::Schema,
+               tr("Create table error: %1"), errorText);
     }
 
-    // 4. Close the connection to the database.
+    // 3. Close the connection to the database.
     //    Be warned, closing the database will invalidate any SqlQuery objects (see below)
     database.close();
 
@@ -133,6 +289,33 @@ bool DatabaseIo::createDatabase()
 }
 //! [1]
 
+// Opens an existing database and applies any schema versions it is missing.
+// Row data is migrated later by the background migration.
+bool DatabaseIo::upgradeDatabase()
+{
+    QSqlDatabase database = QSqlDatabase::contains()
+                          ? QSqlDatabase::database()
+                          : QSqlDatabase::addDatabase("QSQLITE");
+    database.setDatabaseName(DATABASENAME);
+
+    if (!database.open()) {
+        const QSqlError error = database.lastError();
+        report(StatusChannel::Error, StatusChannel::Journal,
+               tr("Error opening connection to the database: %1"), error.text());
+        return false;
+    }
+
+    QString errorText;
+    const bool success = m_migrator->migrateSchema(database, &errorText);
+    if (!success) {
+        report(StatusChannel::Error, StatusChannel::Schema,
+               tr("Database upgrade error: %1"), errorText);
+    }
+
+    database.close();
+    return success;
+}
+
 //! [2]
 // -----------------------------------------------------------------------------------------------
 // Synchronous Database Functionality with QSqlDatabase and QSqlQuery
@@ -146,29 +329,17 @@ void DatabaseIo::createTable()
     //    QSqlDatabase db = QSqlDatabase::database(<connectionName>);
     QSqlDatabase database = QSqlDatabase::database();
 
-    // 2. Create a query to execute.
-    //    The below query creates a table with customerID, firstName, and lastName columns
-    //    if it does not already exist.
-    const QString createSQL = "CREATE TABLE IF NOT EXISTS events ( "
-                              "                eventID INTEGER PRIMARY KEY AUTOINCREMENT, "
-                              "                timeStamp VARCHAR, "
-                              "                textEvent VARCHAR"
-                              ");";
-
-    // 3. Create an QSqlQuery object with which you can execute queries
-    //    NOTE: The QSqlDatabase function has an 'exec' function, however this
-    //    is deprecated and should be avoided.
-    QSqlQuery query(database);
-    if (query.exec(createSQL)) {
-        alert(tr("Table creation query execute successfully"));
+    // 2. Create the table (or upgrade it) through the versioned schema.
+    QString errorText;
+    if (m_migrator->migrateSchema(database, &errorText)) {
+        report(StatusChannel::Info, StatusChannel::Schema,
+               tr("Table creation query execute successfully"));
     } else {
-        // If 'exec' fails, error information can be accessed via the lastError function
-        // the last error is reset every time exec is called.
-        const QSqlError error = query.lastError();
-        alert(tr("Create table error: %1").arg(error.text()));
+        report(StatusChannel::Error, StatusChannel::Schema,
+               tr("Create table error: %1"), errorText);
     }
 
-    // 4. Optionally close the database connection if we no longer plan to use it
+    // 3. Optionally close the database connection if we no longer plan to use it
     //    Note that calling QSqlDatabase::database() will automatically re-open
     //    the connection for us.
     //    NOTE: Closing the database invalidates any QSqlQuery objects you have created
@@ -177,7 +348,7 @@ void DatabaseIo::createTable()
 }
 
 // -----------------------------------------------------------------------------------------------
-// Synchronous Database Functionality with QSqlDatabase and QSqlQuery
+// Synchronous Database Functionality with QSqlDatabase and TypedQuery
 void DatabaseIo::queryTable()
 {
     // 1. Get a reference to the database, which will automatically open the connection
@@ -188,29 +359,26 @@ void DatabaseIo::queryTable()
     //    QSqlDatabase db = QSqlDatabase::database(<connectionName>);
     QSqlDatabase database = QSqlDatabase::database();
 
-    // 2. Create a query to execute.
-    //    The below query creates a table with customerID, firstName, and lastName columns
-    //    if it does not already exist.
-    const QString querySQL = "select * from events";
-
-    // 3. Create an QSqlQuery object with which you can execute queries
-    //    NOTE: The QSqlDatabase function has an 'exec' function, however this
-    //    is deprecated and should be avoided.
-    QSqlQuery query(database);
-    if (query.exec(querySQL)) {
-        alert(tr("Table creation query execute successfully"));
+    // 2. Run a query declared in journalqueries.hpp.
+    //    The declaration carries the types of the parameters and result columns,
+    //    so exec() only accepts the declared parameters.
+    TypedQuery<EventCount> query;
+    if (query.prepare(sqliteHandle(database)) && query.exec()) {
+        report(StatusChannel::Info, StatusChannel::Schema,
+               tr("Table creation query execute successfully"));
     } else {
         // If 'exec' fails, error information can be accessed via the lastError function
         // the last error is reset every time exec is called.
-        const QSqlError error = query.lastError();
-        alert(tr("Create table error: %1").arg(error.text()));
+        report(StatusChannel::Error, StatusChannel::Schema,
+               tr("Create table error: %1"), query.lastError());
     }
 
+    // 3. A prepared statement keeps the connection from closing.
+    query.finalize();
+
     // 4. Optionally close the database connection if we no longer plan to use it
     //    Note that calling QSqlDatabase::database() will automatically re-open
     //    the connection for us.
-    //    NOTE: Closing the database invalidates any QSqlQuery objects you have created
-    //    with this database connection.
     database.close();
 }
 
@@ -232,41 +400,57 @@ void DatabaseIo::dropTable()
     // NOTE: If you wish to check if the table exists in code, you can use the
     //    below example:
     //        if(database.tables().contains("customers")) {
-    //            alert(tr("The 'customers' table exists"));
+    //            report(StatusChannel::Info, StatusChannel::Schema, tr("The 'customers' table exists"));
     //      }
 
-    // 3. Create an QSqlQuery object with which you can execute queries
-    //    NOTE: The QSqlDatabase function has an 'exec' function, however this
-    //    is deprecated and should be avoided.
-    QSqlQuery query(database);
-
-    const QString dropSQL = "DROP TABLE IF EXISTS events";
-    if (query.exec(dropSQL)) {
-        alert(tr("Table drop query executed successfully."));
+    // 3. Prepare the declared query on the connection and run it.
+    TypedQuery<DropEvents> query;
+    if (query.prepare(sqliteHandle(database)) && query.exec()) {
+        report(StatusChannel::Info, StatusChannel::Schema,
+               tr("Table drop query executed successfully."));
     } else {
         // If 'exec' fails, error information can be accessed via the lastError function
         // the last error is reset every time exec is called.
-        const QSqlError error = query.lastError();
-        alert(tr("Drop table error: %1").arg(error.text()));
+        report(StatusChannel::Error, StatusChannel::Schema,
+               tr("Drop table error: %1"), query.lastError());
     }
+    query.finalize();
 
     // 4. Optionally close the database connection if we no longer plan to use it
     //    Note that calling QSqlDatabase::database() will automatically re-open
     //    the connection for us.
-    //    NOTE: Closing the database invalidates any QSqlQuery objects you have created
-    //    with this database connection.
+    //    NOTE: A prepared statement that is not finalized keeps the connection open.
     database.close();
 }
 
-void DatabaseIo::addRecord(const QString &timeStamp, const QString &textEvent)
+void DatabaseIo::addRecord(const QString &timeStamp, const QString &textEvent,
+                           StorageBackend::Durability durability)
 {
-   // Execute query with named binding using named placeholders
-    QVariantMap eventsValues;
-    eventsValues["timeStamp"] = timeStamp;
-    eventsValues["textEvent"] = textEvent;
-    m_sqlConnection->execute(
-        "INSERT INTO events (timeStamp, textEvent) VALUES(:timeStamp, :textEvent)",
-        eventsValues);
+    IoScope io("addRecord");
+    TraceScope trace(&m_trace, TraceAdd);
+    trace.arg(textEvent.size());
+    trace.arg(durability);
+    markActivity();
+    const qint64 eventId = m_backend->addRecord(timeStamp, textEvent, durability);
+    trace.arg(eventId);
+    if (eventId < 0) {
+        report(StatusChannel::Error, StatusChannel::Insert,
+               tr("Create record error: %1"), m_backend->lastError());
+        return;
+    }
+    if (durability == StorageBackend::Buffered && !m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+
+    if (m_backend->database().isValid()) {
+        m_facets.addEvent(eventId, eventTimeFromString(timeStamp),
+                          FacetIndex::hashtags(textEvent), -1);
+        m_rowIndex.addEvent(eventId);
+    }
+    emit eventAdded(eventId);
+    if (m_completer) {
+        m_completer->addText(textEvent, eventId);
+    }
 }
 void DatabaseIo::createRecord(const QString &timeStamp, const QString &textEvent)
 {
@@ -283,39 +467,32 @@ void DatabaseIo::createRecord(const QString &timeStamp, const QString &textEvent
     //    and can create or update any that do not. This would allow you to
     //    skip this check to see if a table exists or not in the database.
     if (!database.tables().contains("events")) {
-        alert(tr("Create record error: customers table does not exist."));
+        report(StatusChannel::Error, StatusChannel::Insert,
+               tr("Create record error: customers table does not exist."));
     } else {
-        // 3. Create an QSqlQuery object with which you can execute queries
-        //    In this example we bind parameters in the query. A large advantage to using
-        //    bindings (aside from performance enhancements) is that input is automatically
-        //    escaped avoiding potential issues with odd characters (quotes) and prevents
-        //    SQL Injection attacks.
-        //    Note that for databases that do not support bindings, Qt simulates the binding
-        //    effects.
-        //    IMPORTANT NOTE: If ever accepting user information without using bindings,
-        //    be sure to 'escape' your queries.
-        QSqlQuery query(database);
-        query.prepare("INSERT INTO events (timeStamp, textEvent) VALUES(:timeStamp, :textEvent)");
-        query.bindValue(":timeStamp", timeStamp);
-        query.bindValue(":textEvent", textEvent);
-        query.exec();
-
-        // Note that no SQL Statement is passed to 'exec' as it is a prepared statement.
-        if (query.exec()) {
-            alert(tr("Record created"));
+        // 3. Prepare the declared insert and bind its parameters.
+        //    A large advantage to using bindings (aside from performance enhancements)
+        //    is that input is automatically escaped avoiding potential issues with odd
+        //    characters (quotes) and prevents SQL Injection attacks. The parameters are
+        //    typed: passing them in the wrong order or of the wrong type does not compile.
+        TypedQuery<InsertEvent> query;
+        const TextCounts counts = TextCounter::count(textEvent);
+        if (query.prepare(sqliteHandle(database))
+            && query.exec(timeStamp, textEvent, eventTimeFromString(timeStamp),
+                          counts.words, counts.characters)) {
+            report(StatusChannel::Info, StatusChannel::Insert, tr("Record created"));
         } else {
             // If 'exec' fails, error information can be accessed via the lastError function
             // the last error is reset every time exec is called.
-            const QSqlError error = query.lastError();
-            alert(tr("Create record error: %1").arg(error.text()));
+            report(StatusChannel::Error, StatusChannel::Insert,
+                   tr("Create record error: %1"), query.lastError());
         }
     }
 
     // 4. Optionally close the database connection if we no longer plan to use it
     //    Note that calling QSqlDatabase::database() will automatically re-open
-    //    the connection for us.
-    //    NOTE: Closing the database invalidates any QSqlQuery objects you have created
-    //    with this database connection.
+    //    the connection for us. The statement above was finalized when it went
+    //    out of scope.
     database.close();
 }
 //! [2]
@@ -328,39 +505,11 @@ void DatabaseIo::createRecord(const QString &timeStamp, const QString &textEvent
 // by creating a database table.
 void DatabaseIo::createTableAsync()
 {
-
-    // Sanity check to ensure that we don't execute the m_sqlConnection twice using the same object
-    if (m_sqlConnection) {
-        alert(tr("Error: previous async SqlConnection still executing"));
-        return;
-    }
-
-    // 1. Create a new SqlConnection object and point it at the database
-    //    It will automatically open a connection to the database using the QSqlDatabase object
-    //    if necessary. Note that a reference to the SqlConnection object is tracked so that
-    //    it can be freed later. Alternatively, you could assign the SqlConnection
-    m_sqlConnection = new SqlConnection(DATABASENAME);
-
-    // 2. Connect a slot to the SqlConnection objects 'reply' signal which is emitted when the
-    //    executed query is complete.
-    //    Note: types are fully qualified with namespaces (e,g, bb::data::) when used with all
-    //    MOC macros (in this case, SIGNAL and SLOT)
-    connect(m_sqlConnection, SIGNAL(reply(const bb::data::DataAccessReply&)),
-            this, SLOT(onLoadAsyncResultData(const bb::data::DataAccessReply&)));
-
-    // 3. Create the SQL Query that you wish to execute asynchronously.
-    //    NOTE: The below query does not use the SQL statement 'IF NOT EXISTS'
-    //    Therefore, it will report an error if the table already exists and you
-    //    try to create it.
-    const QString createSQL = "CREATE TABLE IF NOT EXISTS events ( "
-                              "                eventID INTEGER PRIMARY KEY AUTOINCREMENT, "
-                              "                timeStamp VARCHAR, "
-                              "                textEvent VARCHAR "
-                              ");";
-
-    // 4. Execute the query. Note, that upon function return, the query may not have run yet
-    //    You need to wait for the 'reply' signal
-    m_sqlConnection->execute(createSQL);
+    // The table is created (or upgraded) through the versioned schema on the
+    // migration thread, followed by the data steps of every version it gets;
+    // migrationFinished() is emitted when it is done, and a failure is reported
+    // through onMigrationError().
+    m_migrator->startBackgroundMigration(true);
 
     qDebug() << "Create table started...";
 }
@@ -372,9 +521,11 @@ void DatabaseIo::onLoadAsyncResultData(const bb::data::DataAccessReply &reply)
 
     // Check if an error has occurred
     if (reply.hasError()) {
-        alert(tr("Error creating table: %1").arg(reply.errorMessage()));
+        report(StatusChannel::Error, StatusChannel::Schema,
+               tr("Error creating table: %1"), reply.errorMessage());
     } else {
-        alert(tr("Asynchronous createTable query Succeeded!"));
+        report(StatusChannel::Info, StatusChannel::Schema,
+               tr("Asynchronous createTable query Succeeded!"));
         /*
         if (reply.id() >= INITIAL_LOAD_ID) {
             QVariantList resultList = reply.result().value<QVariantList>();
@@ -400,58 +551,842 @@ void DatabaseIo::onLoadAsyncResultData(const bb::data::DataAccessReply &reply)
 
 }
 
+void DatabaseIo::onMigrationFinished()
+{
+    // The last data step may have tagged existing entries.
+    if (m_backend->database().isValid()) {
+        m_facets.load(m_backend->database());
+        m_rowIndex.load(m_backend->database());
+        emit facetsChanged();
+    }
+    if (m_maintenance) {
+        m_maintenance->start();
+    }
+    if (m_completer) {
+        m_completer->open(m_backend->database());
+    }
+
+    // Carry on with a conversion or rekey that the last session did not finish.
+    if (m_sqlConnection && CryptoVfs::hasKeys()) {
+        if (!CryptoVfs::isEncrypted(DATABASENAME)) {
+            flushWrites();
+            encryption()->encrypt();
+        } else if (m_keys.keyCount() > 1) {
+            rekeyJournal();
+        }
+    }
+    emit migrationFinished();
+}
+
+void DatabaseIo::onMigrationError(const QString &message)
+{
+    // Shared by the background workers; the sender tells what failed.
+    StatusChannel::Code code = StatusChannel::Schema;
+    if (sender() == m_importer) {
+        code = StatusChannel::Import;
+    } else if (sender() == m_exporter) {
+        code = StatusChannel::Export;
+    } else if (sender() == m_encryption) {
+        code = StatusChannel::Encryption;
+    } else if (sender() == m_voice) {
+        code = StatusChannel::VoiceNote;
+    }
+    m_status->post(StatusChannel::Error, code, message, message);
+}
+
 // -----------------------------------------------------------------------------------------------
-// Alert Dialog Box Functions
-void DatabaseIo::alert(const QString &message)
+// Revisions
+bool DatabaseIo::editRecord(qint64 eventId, const QString &textEvent,
+                            StorageBackend::Durability durability)
 {
-    SystemDialog *dialog; // SystemDialog uses the BB10 native dialog.
-    dialog = new SystemDialog(tr("OK"), 0); // New dialog with on 'Ok' button, no 'Cancel' button
-    dialog->setTitle(tr("Alert")); // set a title for the message
-    dialog->setBody(message); // set the message itself
-    dialog->setDismissAutomatically(true); // Hides the dialog when a button is pressed.
+    IoScope io("editRecord");
+    TraceScope trace(&m_trace, TraceEdit);
+    trace.arg(eventId);
+    trace.arg(textEvent.size());
+    trace.arg(durability);
+    markActivity();
+    if (!m_backend->updateRecord(eventId, textEvent, durability)) {
+        report(StatusChannel::Error, StatusChannel::Edit,
+               tr("Edit record error: %1"), m_backend->lastError());
+        return false;
+    }
+    if (durability == StorageBackend::Buffered && !m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
 
-    // Setup slot to mark the dialog for deletion in the next event loop after the dialog has been accepted.
-    connect(dialog, SIGNAL(accepted()), dialog, SLOT(deleteLater()));
-    dialog->show();
+    // The edit may have added or removed #hashtags.
+    m_facets.setTags(eventId, FacetIndex::readTags(m_backend->database(), eventId));
+    emit eventChanged(eventId);
+    // The words of the previous text stay counted until the next rebuild.
+    if (m_completer) {
+        m_completer->addText(textEvent, eventId);
+    }
+    return true;
 }
 
-int DatabaseIo::getCount()
+QList<RevisionInfo> DatabaseIo::revisions(qint64 eventId)
 {
-	int ret = 0;
-    QString query = "select COUNT(*) from events";
-    DataAccessReply reply = m_sqlConnection->executeAndWait(query);
+    IoScope io("revisions");
+    markActivity();
+    if (!m_backend->database().isValid()) {
+        return QList<RevisionInfo>();
+    }
+    return RevisionStore(m_backend->database()).revisions(eventId);
+}
 
-    if (reply.hasError()) {
-        qWarning() << "onLoadAsyncResultData: " << reply.id() << ", SQL error: " << reply;
-    } else {
-        QVariantList data = reply.result().value<QVariantList>();
+QString DatabaseIo::revisionText(qint64 eventId, int revision)
+{
+    IoScope io("revisionText");
+    markActivity();
+    QString text;
+    if (!m_backend->database().isValid()) {
+        return text;
+    }
+
+    RevisionStore store(m_backend->database());
+    if (!store.materialize(eventId, revision, text)) {
+        qWarning() << "revisionText: " << store.lastError();
+    }
+    return text;
+}
+
+bool DatabaseIo::deleteRecord(qint64 eventId)
+{
+    IoScope io("deleteRecord");
+    TraceScope trace(&m_trace, TraceDelete);
+    trace.arg(eventId);
+    markActivity();
+    flushWrites();
+    if (!m_backend->database().isValid()) {
+        return false;
+    }
+
+    TrashStore store(m_backend->database());
+    if (!store.trash(eventId, QDateTime::currentDateTime().toTime_t())) {
+        report(StatusChannel::Error, StatusChannel::Delete,
+               tr("Delete record error: %1"), store.lastError());
+        return false;
+    }
+    m_facets.removeEvent(eventId);
+    m_rowIndex.removeEvent(eventId);
+    emit trashChanged();
+    return true;
+}
+
+bool DatabaseIo::restoreRecord(qint64 eventId)
+{
+    IoScope io("restoreRecord");
+    TraceScope trace(&m_trace, TraceRestore);
+    trace.arg(eventId);
+    markActivity();
+    flushWrites();
+    if (!m_backend->database().isValid()) {
+        return false;
+    }
+
+    QSqlDatabase database = m_backend->database();
+    TrashStore store(database);
+    if (!store.restore(eventId)) {
+        report(StatusChannel::Error, StatusChannel::Restore,
+               tr("Restore record error: %1"), store.lastError());
+        return false;
+    }
+
+    TypedQuery<EventFacets> query;
+    EventFacets::Row row;
+    if (query.prepare(sqliteHandle(database)) && query.exec(eventId) && query.next(row)) {
+        m_facets.addEvent(eventId, row.first, FacetIndex::readTags(database, eventId), row.second);
+    }
+    m_rowIndex.addEvent(eventId);
+    emit trashChanged();
+    return true;
+}
+
+QList<TrashedEntry> DatabaseIo::trash()
+{
+    IoScope io("trash");
+    markActivity();
+    if (!m_backend->database().isValid()) {
+        return QList<TrashedEntry>();
+    }
+
+    TrashStore store(m_backend->database());
+    const QList<TrashedEntry> entries = store.entries();
+    if (!store.lastError().isEmpty()) {
+        qWarning() << "trash: " << store.lastError();
+    }
+    return entries;
+}
+
+void DatabaseIo::emptyTrash()
+{
+    IoScope io("emptyTrash");
+    markActivity();
+    flushWrites();
+    if (!m_backend->database().isValid()) {
+        return;
+    }
+
+    // Batch by batch, so the maintenance and the UI get the database in between.
+    TrashStore store(m_backend->database());
+    const qint64 now = QDateTime::currentDateTime().toTime_t();
+    int purged;
+    while ((purged = store.purge(now, TRASH_PURGE_BATCH)) == TRASH_PURGE_BATCH) {}
+    if (purged < 0) {
+        report(StatusChannel::Error, StatusChannel::EmptyTrash,
+               tr("Empty trash error: %1"), store.lastError());
+    }
+}
+
+// -----------------------------------------------------------------------------------------------
+// Bulk import
+void DatabaseIo::importJournal(const QStringList &files)
+{
+    // The importer writes to the journal file over its own connection,
+    // so it needs the default SQLite journal.
+    if (!m_sqlConnection) {
+        report(StatusChannel::Notice, StatusChannel::Import,
+               tr("Import is only available for the journal database."));
+        return;
+    }
 
-        // Check if the city is already in the list, if its not we add it to the model.
-        // The first() function used since in our city data there is only one instance of each city.
-        QVariantMap dataItem = data.first().toMap();
-        ret = dataItem.value("COUNT(*)").toInt();
+    if (!m_importer) {
+        m_importer = new JournalImporter(DATABASENAME, this);
+        connect(m_importer, SIGNAL(progress(const QString&, qint64, qint64, int)),
+                this, SIGNAL(importProgress(const QString&, qint64, qint64, int)));
+        connect(m_importer, SIGNAL(finished(qint64, qint64, int)),
+                this, SLOT(onImportFinished(qint64, qint64, int)));
+        connect(m_importer, SIGNAL(error(const QString&)), this, SLOT(onMigrationError(const QString&)));
     }
-    //alert(tr("there are %1 records in database").arg(ret));
-    return ret;
+    flushWrites();
+    m_importer->start(files);
+}
+
+void DatabaseIo::onImportFinished(qint64 firstEventId, qint64 lastEventId, int entries)
+{
+    qDebug() << "Imported" << entries << "entries, eventID" << firstEventId << "to" << lastEventId;
+
+    // One rebuild instead of an update per imported entry.
+    if (entries > 0) {
+        m_facets.load(m_backend->database());
+        m_rowIndex.load(m_backend->database());
+        emit facetsChanged();
+        if (m_completer) {
+            m_completer->rebuild();
+        }
+    }
+
+    emit importFinished(entries);
+}
+
+// -----------------------------------------------------------------------------------------------
+// Export
+void DatabaseIo::exportJournal(const QString &fileName)
+{
+    if (!m_sqlConnection) {
+        report(StatusChannel::Notice, StatusChannel::Export,
+               tr("Export is only available for the journal database."));
+        return;
+    }
+
+    if (!m_exporter) {
+        m_exporter = new JournalExporter(DATABASENAME, this);
+        connect(m_exporter, SIGNAL(progress(int, int)), this, SIGNAL(exportProgress(int, int)));
+        connect(m_exporter, SIGNAL(finished(const QString&, int)),
+                this, SIGNAL(exportFinished(const QString&, int)));
+        connect(m_exporter, SIGNAL(error(const QString&)), this, SLOT(onMigrationError(const QString&)));
+    }
+    flushWrites();
+    m_exporter->start(fileName);
+}
+
+bool DatabaseIo::verifyExport(const QString &fileName)
+{
+    QString errorText;
+    if (!JournalExporter::verify(fileName, &errorText)) {
+        report(StatusChannel::Error, StatusChannel::Export,
+               tr("Export check failed: %1"), errorText);
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Facets
+bool DatabaseIo::setTags(qint64 eventId, const QStringList &tags)
+{
+    IoScope io("setTags");
+    TraceScope trace(&m_trace, TraceTags);
+    trace.arg(eventId);
+    trace.arg(tags.size());
+    markActivity();
+    flushWrites();
+    QSqlDatabase database = m_backend->database();
+    if (!database.isValid()) {
+        return false;
+    }
+
+    QStringList normalized;
+    for (int i = 0; i < tags.size(); ++i) {
+        QString tag = tags.at(i).trimmed().toLower();
+        if (tag.startsWith('#')) {
+            tag.remove(0, 1);
+        }
+        if (!tag.isEmpty() && !normalized.contains(tag)) {
+            normalized << tag;
+        }
+    }
+
+    QString errorText;
+    database.transaction();
+    if (!FacetIndex::writeTags(database, eventId, normalized, false, &errorText) || !database.commit()) {
+        if (errorText.isEmpty()) {
+            errorText = database.lastError().text();
+        }
+        database.rollback();
+        report(StatusChannel::Error, StatusChannel::Tags, tr("Tag error: %1"), errorText);
+        return false;
+    }
+
+    m_facets.setTags(eventId, FacetIndex::readTags(database, eventId));
+    emit eventChanged(eventId);
+    return true;
+}
+
+bool DatabaseIo::setMood(qint64 eventId, int mood)
+{
+    IoScope io("setMood");
+    TraceScope trace(&m_trace, TraceMood);
+    trace.arg(eventId);
+    trace.arg(mood);
+    markActivity();
+    flushWrites();
+    QSqlDatabase database = m_backend->database();
+    if (!database.isValid()) {
+        return false;
+    }
+
+    // A negative mood clears it.
+    TypedQuery<UpdateEventMood> query;
+    if (!query.prepare(sqliteHandle(database)) || !query.exec(mood, eventId)) {
+        report(StatusChannel::Error, StatusChannel::Mood, tr("Mood error: %1"), query.lastError());
+        return false;
+    }
+
+    m_facets.setMood(eventId, mood);
+    emit eventChanged(eventId);
+    return true;
+}
+
+QList<qint64> DatabaseIo::filterEvents(const FacetFilter &filter)
+{
+    TraceScope trace(&m_trace, TraceFilter);
+    trace.arg(filter.tags.size());
+    const QVector<quint32> ids = m_facets.query(filter).toVector();
+    trace.arg(ids.size());
+
+    QList<qint64> events;
+    events.reserve(ids.size());
+    for (int i = 0; i < ids.size(); ++i) {
+        events << ids.at(i);
+    }
+    return events;
+}
+
+bool DatabaseIo::matchesFilter(qint64 eventId, const FacetFilter &filter)
+{
+    return m_facets.matches(eventId, filter);
+}
+
+QMap<QString, int> DatabaseIo::tagCounts(const FacetFilter &filter)
+{
+    return m_facets.tagCounts(filter);
+}
+
+QMap<int, int> DatabaseIo::moodCounts(const FacetFilter &filter)
+{
+    return m_facets.moodCounts(filter);
+}
+
+// -----------------------------------------------------------------------------------------------
+// Similar entries
+QList<SimilarEntry> DatabaseIo::similarTo(qint64 eventId, int count)
+{
+    IoScope io("similarTo");
+    markActivity();
+    if (!m_backend->database().isValid()) {
+        return QList<SimilarEntry>();
+    }
+
+    SimilarityIndex index(m_backend->database());
+    const QList<SimilarEntry> entries = index.similarTo(eventId, count);
+    if (!index.lastError().isEmpty()) {
+        qWarning() << "similarTo: " << eventId << ", error: " << index.lastError();
+    }
+    return entries;
+}
+
+WritingStats DatabaseIo::stats(const QDate &from, const QDate &to)
+{
+    IoScope io("stats");
+    markActivity();
+    if (!m_backend->database().isValid()) {
+        return WritingStats();
+    }
+
+    JournalStats journalStats(m_backend->database());
+    const WritingStats stats = journalStats.summarize(from, to);
+    if (!journalStats.lastError().isEmpty()) {
+        qWarning() << "stats: " << journalStats.lastError();
+    }
+    return stats;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Durability
+void DatabaseIo::flushWrites()
+{
+    IoScope io("flushWrites");
+    TraceScope trace(&m_trace, TraceFlush);
+    m_flushTimer->stop();
+    if (!m_backend->flush()) {
+        report(StatusChannel::Error, StatusChannel::Save,
+               tr("Error saving the journal: %1"), m_backend->lastError());
+    }
+}
+
+// -----------------------------------------------------------------------------------------------
+// Maintenance
+void DatabaseIo::markActivity()
+{
+    if (m_maintenance) {
+        m_maintenance->notifyActivity();
+    }
+}
+
+void DatabaseIo::onAppBackground()
+{
+    flushWrites();
+    if (m_maintenance) {
+        m_maintenance->setBackground(true);
+    }
+}
+
+void DatabaseIo::onAppForeground()
+{
+    if (m_maintenance) {
+        m_maintenance->setBackground(false);
+    }
+}
+
+QList<MaintenanceStats> DatabaseIo::maintenanceStats()
+{
+    if (!m_backend->database().isValid()) {
+        return QList<MaintenanceStats>();
+    }
+    return MaintenanceScheduler::stats(m_backend->database());
+}
+
+// -----------------------------------------------------------------------------------------------
+// Memory
+MemoryBudget *DatabaseIo::memoryBudget()
+{
+    return m_memory;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Sync
+bool DatabaseIo::syncJournal(SyncTransport *transport, SyncStats *stats)
+{
+    IoScope io("syncJournal");
+    flushWrites();
+    QSqlDatabase database = m_backend->database();
+    if (!database.isValid()) {
+        return false;
+    }
+
+    SyncStats local;
+    if (!stats) {
+        stats = &local;
+    }
+    SyncClient client(database);
+    const bool ok = client.sync(transport, stats);
+    if (!ok) {
+        report(StatusChannel::Error, StatusChannel::Sync,
+               tr("Sync failed: %1"), client.lastError());
+    }
+
+    // Entries from other devices change the counts behind the facets.
+    if (stats->applied > 0) {
+        m_facets.load(database);
+        m_rowIndex.load(database);
+        emit facetsChanged();
+        if (m_completer) {
+            m_completer->rebuild();
+        }
+    }
+    return ok;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Encryption at rest
+void DatabaseIo::encryptJournal(const QString &passphrase)
+{
+    if (!m_sqlConnection) {
+        report(StatusChannel::Notice, StatusChannel::Encryption,
+               tr("Encryption is only available for the journal database."));
+        return;
+    }
+    if (CryptoVfs::isEncrypted(DATABASENAME)) {
+        return;
+    }
+    if (!m_keys.exists() && !m_keys.create(passphrase)) {
+        report(StatusChannel::Error, StatusChannel::Encryption,
+               tr("Error creating the journal keys: %1"), m_keys.lastError());
+        return;
+    }
+
+    flushWrites();
+    encryption()->encrypt();
+}
+
+bool DatabaseIo::isJournalEncrypted() const
+{
+    return CryptoVfs::isEncrypted(DATABASENAME);
+}
+
+void DatabaseIo::rekeyJournal()
+{
+    if (!isJournalEncrypted()) {
+        report(StatusChannel::Notice, StatusChannel::Encryption,
+               tr("The journal is not encrypted yet."));
+        return;
+    }
+
+    if (encryption()->isRunning()) {
+        return;
+    }
+
+    // A rekey that was cut short keeps its new key and simply runs again.
+    if (m_keys.keyCount() == 1 && !m_keys.addKey()) {
+        report(StatusChannel::Error, StatusChannel::Encryption,
+               tr("Error adding a journal key: %1"), m_keys.lastError());
+        return;
+    }
+    m_encryption->rekey();
+}
+
+JournalEncryption *DatabaseIo::encryption()
+{
+    if (!m_encryption) {
+        m_encryption = new JournalEncryption(DATABASENAME, this);
+        connect(m_encryption, SIGNAL(progress(int, qint64, qint64)),
+                this, SIGNAL(encryptionProgress(int, qint64, qint64)));
+        connect(m_encryption, SIGNAL(finished(int, bool)), this, SLOT(onEncryptionFinished(int, bool)));
+        connect(m_encryption, SIGNAL(error(const QString&)), this, SLOT(onMigrationError(const QString&)));
+    }
+    return m_encryption;
+}
+
+void DatabaseIo::onEncryptionFinished(int task, bool complete)
+{
+    if (!complete) {
+        return;
+    }
+    if (task == JournalEncryption::Encrypt) {
+        report(StatusChannel::Notice, StatusChannel::Encryption,
+               tr("The encrypted journal will be used from the next start."));
+        // Drops the plaintext trie file and keeps the words in memory only.
+        if (m_completer) {
+            m_completer->open(m_backend->database());
+        }
+        emit journalEncrypted();
+    } else if (!m_keys.retireOldKeys()) {
+        report(StatusChannel::Error, StatusChannel::Encryption,
+               tr("Error retiring the old journal keys: %1"), m_keys.lastError());
+    }
+}
+
+// -----------------------------------------------------------------------------------------------
+// Voice notes
+bool DatabaseIo::recordVoiceNote(qint64 eventId, VoiceSource *source)
+{
+    markActivity();
+    if (!m_backend->database().isValid() || isRecordingVoiceNote()) {
+        delete source;
+        return false;
+    }
+#ifdef __QNX__
+    if (!source) {
+        source = new PcmCaptureSource();
+    }
+#endif
+    if (!source) {
+        report(StatusChannel::Warning, StatusChannel::VoiceNote, tr("No microphone available."));
+        return false;
+    }
+
+    if (!m_voice) {
+        m_voice = new VoiceRecorder(this);
+        connect(m_voice, SIGNAL(finished(const QString&, const QString&)),
+                this, SLOT(onVoiceNoteFinished(const QString&, const QString&)));
+        connect(m_voice, SIGNAL(error(const QString&)), this, SLOT(onMigrationError(const QString&)));
+    }
+
+    QDir().mkpath(VOICENOTES);
+    const QString fileName = QString("%1/%2-%3.dwv").arg(VOICENOTES).arg(eventId)
+                             .arg(QDateTime::currentMSecsSinceEpoch());
+    m_voiceEventId = eventId;
+    return m_voice->start(source, fileName);
+}
+
+void DatabaseIo::stopVoiceNote()
+{
+    if (m_voice) {
+        m_voice->stop();
+    }
+}
+
+bool DatabaseIo::isRecordingVoiceNote() const
+{
+    return m_voice && m_voice->isRecording();
+}
+
+void DatabaseIo::onVoiceNoteFinished(const QString &fileName, const QString &sha1)
+{
+    const VoiceStats stats = m_voice->stats();
+    qDebug() << "Voice note" << fileName << stats.frames << "frames," << stats.bytesWritten << "bytes,"
+             << stats.droppedSamples << "samples dropped, encoder" << stats.cpuPercent() << "% CPU, max"
+             << stats.maxFrameCpuUs << "us/frame, latency max" << stats.maxLatencyMs << "ms, saved"
+             << stats.stopToSavedMs << "ms after stop";
+
+    if (!stats.frames) {
+        QFile::remove(fileName);
+        return;
+    }
+
+    flushWrites();
+    TypedQuery<InsertAttachment> query;
+    if (!query.prepare(sqliteHandle(m_backend->database()))
+        || !query.exec(m_voiceEventId, "voice", fileName, sha1)) {
+        report(StatusChannel::Error, StatusChannel::VoiceNote,
+               tr("Error saving the voice note: %1"), query.lastError());
+        return;
+    }
+    emit voiceNoteSaved(m_voiceEventId, fileName);
+}
+
+// -----------------------------------------------------------------------------------------------
+// Status
+StatusChannel *DatabaseIo::statusChannel()
+{
+    return m_status;
+}
+
+WordCompleter *DatabaseIo::wordCompleter()
+{
+    return m_completer;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Tracing
+bool DatabaseIo::startTrace(const QString &fileName)
+{
+    if (!m_trace.start(fileName)) {
+        report(StatusChannel::Warning, StatusChannel::Journal,
+               tr("Error starting the trace: %1"), m_trace.lastError());
+        return false;
+    }
+    return true;
+}
+
+void DatabaseIo::stopTrace()
+{
+    m_trace.stop();
+}
+
+QueryTrace *DatabaseIo::queryTrace()
+{
+    return &m_trace;
+}
+
+void DatabaseIo::report(StatusChannel::Severity severity, StatusChannel::Code code,
+                        const QString &text, const QString &detail)
+{
+    // An empty detail still fills the placeholder, rather than showing "%1".
+    m_status->post(severity, code, text.contains("%1") ? text.arg(detail) : text, detail);
+}
+
+void DatabaseIo::onStatusMessages()
+{
+    QStringList lines;
+    const QList<StatusMessage> messages = m_status->takeMessages();
+    for (int i = 0; i < messages.size(); ++i) {
+        qWarning() << "DatabaseIo:" << messages.at(i).text;
+        lines << messages.at(i).text;
+    }
+    if (lines.isEmpty()) {
+        return;
+    }
+
+    // One toast that does not block the UI, whatever came in since the last one.
+    if (!m_toast) {
+        m_toast = new SystemToast(this);
+    }
+    m_toast->setBody(lines.join("\n"));
+    m_toast->show();
+}
+
+int DatabaseIo::getCount()
+{
+    IoScope io("getCount");
+    TraceScope trace(&m_trace, TraceCount);
+    markActivity();
+    return m_backend->count();
+}
+
+qint64 DatabaseIo::journalVersion()
+{
+    TypedQuery<LastChangeSeq> query;
+    if (query.prepare(sqliteHandle(m_backend->database())) && query.exec()) {
+        LastChangeSeq::Row row;
+        return query.next(row) ? row.first : 0;
+    }
+    // Other backends only append; edits there are not noticed.
+    return m_backend->count();
 }
 
 QString DatabaseIo::getEvent(int eventId)
 {
-	QString ret = "Error: no item found";
-	QString eid = QString::number(eventId+1);
-    QString query = "select * from events WHERE eventID='" + eid + "'";
-    DataAccessReply reply = m_sqlConnection->executeAndWait(query);
+    IoScope io("getEvent");
+    TraceScope trace(&m_trace, TraceEvent);
+    trace.arg(eventId);
+    markActivity();
+    EventRecord record;
+    const bool found = m_rowIndex.isLoaded() ? m_backend->eventById(m_rowIndex.eventAt(eventId), record)
+                                             : m_backend->event(eventId, record);
+    if (!found) {
+        qWarning() << "getEvent: " << eventId << ", error: " << m_backend->lastError();
+        return "Error: no item found";
+    }
+    return record.timeStamp + ", " + record.textEvent;
+}
+
+QString DatabaseIo::getEventById(qint64 eventId)
+{
+    IoScope io("getEventById");
+    TraceScope trace(&m_trace, TraceEventById);
+    trace.arg(eventId);
+    markActivity();
+    EventRecord record;
+    if (!m_backend->eventById(eventId, record)) {
+        qWarning() << "getEventById: " << eventId << ", error: " << m_backend->lastError();
+        return "Error: no item found";
+    }
+    return record.timeStamp + ", " + record.textEvent;
+}
 
-    if (reply.hasError()) {
-        qWarning() << "getEvent: " << reply.id() << ", SQL error: " << reply;
-    } else {
-        QVariantList data = reply.result().value<QVariantList>();
+QList<EventRecord> DatabaseIo::getEvents(int firstRow, int count)
+{
+    IoScope io("getEvents");
+    TraceScope trace(&m_trace, TraceRange);
+    trace.arg(firstRow);
+    trace.arg(count);
+    markActivity();
+    if (!m_rowIndex.isLoaded()) {
+        return m_backend->range(firstRow, count);
+    }
 
-        // Check if the city is already in the list, if its not we add it to the model.
-        // The first() function used since in our city data there is only one instance of each city.
-        QVariantMap dataItem = data.first().toMap();
+    // A page far down the list costs the same as the first one.
+    const qint64 firstEventId = m_rowIndex.eventAt(firstRow);
+    if (firstEventId < 0) {
+        return QList<EventRecord>();
+    }
+    return m_backend->rangeFrom(firstEventId, count);
+}
 
-        ret = dataItem.value("timeStamp").toString() + ", " + dataItem.value("textEvent").toString();
+int DatabaseIo::rowForTime(qint64 createdAt)
+{
+    IoScope io("rowForTime");
+    TraceScope trace(&m_trace, TraceRowForTime);
+    trace.arg(createdAt);
+    const qint64 eventId = eventAtTime(createdAt);
+    if (eventId < 0) {
+        return getCount();
     }
-    return ret;
+    return rowOfEvent(eventId);
+}
+
+int DatabaseIo::rowOfEvent(qint64 eventId)
+{
+    if (m_rowIndex.isLoaded()) {
+        return m_rowIndex.rowOf(eventId);
+    }
+    // Backends that never delete keep eventIDs in row order.
+    return int(eventId - 1);
+}
+
+qint64 DatabaseIo::eventAtRow(int row)
+{
+    if (m_rowIndex.isLoaded()) {
+        return m_rowIndex.eventAt(row);
+    }
+    return row >= 0 ? row + 1 : -1;
+}
+
+qint64 DatabaseIo::timeAtRow(int row)
+{
+    IoScope io("timeAtRow");
+    TraceScope trace(&m_trace, TraceTimeAtRow);
+    trace.arg(row);
+    markActivity();
+    EventRecord record;
+    const bool found = m_rowIndex.isLoaded() ? m_backend->eventById(m_rowIndex.eventAt(row), record)
+                                             : m_backend->event(row, record);
+    return found ? record.createdAt : -1;
+}
+
+qint64 DatabaseIo::eventAtTime(qint64 createdAt)
+{
+    IoScope io("eventAtTime");
+    markActivity();
+    QSqlDatabase database = m_backend->database();
+    if (!database.isValid()) {
+        // Without an index on the times, the entries are searched from the start;
+        // the first of them in list order is the one with the lowest eventID.
+        const QList<EventRecord> found = m_backend->search(createdAt, LLONG_MAX, QString());
+        qint64 eventId = -1;
+        for (int i = 0; i < found.size(); ++i) {
+            if (eventId < 0 || found.at(i).eventId < eventId)
+                eventId = found.at(i).eventId;
+        }
+        return eventId;
+    }
+
+    TypedQuery<FirstEventAt> query;
+    FirstEventAt::Row row;
+    if (!query.prepare(sqliteHandle(database)) || !query.exec(createdAt)) {
+        qWarning() << "eventAtTime: " << createdAt << ", error: " << query.lastError();
+        return -1;
+    }
+    return query.next(row) ? row.first : -1;
+}
+
+qint64 DatabaseIo::eventTime(qint64 eventId)
+{
+    IoScope io("eventTime");
+    markActivity();
+    EventRecord record;
+    return m_backend->eventById(eventId, record) ? record.createdAt : -1;
+}
+
+QList<EventRecord> DatabaseIo::search(qint64 from, qint64 to, const QString &text)
+{
+    IoScope io("search");
+    TraceScope trace(&m_trace, TraceSearch);
+    trace.arg(from);
+    trace.arg(to);
+    trace.arg(text.size());
+    markActivity();
+    return m_backend->search(from, to, text);
 }
@@ -17,8 +17,33 @@
 #define DATABASEIO_HPP
 
 #include <QObject>
+#include <QTimer>
 #include <bb/data/SqlConnection>
 
+#include "facetindex.hpp"
+#include "journalkeys.hpp"
+#include "journalstats.hpp"
+#include "maintenancescheduler.hpp"
+#include "memorybudget.hpp"
+#include "querytrace.hpp"
+#include "revisionstore.hpp"
+#include "rowindex.hpp"
+#include "similarityindex.hpp"
+#include "statuschannel.hpp"
+#include "storagebackend.hpp"
+#include "syncclient.hpp"
+#include "trashstore.hpp"
+
+class SchemaMigrator;
+class JournalImporter;
+class JournalExporter;
+class JournalEncryption;
+class VoiceRecorder;
+class VoiceSource;
+class WordCompleter;
+
+namespace bb { namespace system { class SystemToast; } }
+
 /*
  * @brief Declaration of our application's class (as opposed to the BB Cascades
  *  application class that contains our application).
@@ -31,31 +56,235 @@ class DatabaseIo: public QObject
     Q_OBJECT
 
 public:
-    DatabaseIo();
+    // Takes ownership of 'backend'; entries are kept in the SQLite database if none is given.
+    DatabaseIo(StorageBackend *backend = 0);
     ~DatabaseIo();
 
     // "Q_INVOKABLE" allows these functions to be called from main.qml
     bool createDatabase();
+    bool upgradeDatabase();
     void dropTable();
     void createTable();
     void queryTable();
     void createRecord(const QString &firstName, const QString &lastName);
-    void addRecord(const QString &firstName, const QString &lastName);
+    // Entries are synced unless asked otherwise; see StorageBackend::Durability.
+    // Buffered writes are committed within a second, before any other write
+    // and when the app goes to the background.
+    void addRecord(const QString &firstName, const QString &lastName,
+                   StorageBackend::Durability durability = StorageBackend::Synced);
     void createTableAsync(); // This is an example of how you make asynchronous calls to the database.
 
     int getCount();
+    // Changes whenever an entry is added, edited, tagged or deleted.
+    qint64 journalVersion();
     QString getEvent(int eventId);
+    QList<EventRecord> getEvents(int firstRow, int count);
+
+    // Jumping to a date and the date scrubber; O(log n) with the row index.
+    // The row of the first entry written at or after 'createdAt', or
+    // getCount() if there is none.
+    int rowForTime(qint64 createdAt);
+    // -1 past the end of the list.
+    qint64 timeAtRow(int row);
+    qint64 eventAtTime(qint64 createdAt);
+    // The row of an entry in the list and back; -1 past the end of the list.
+    int rowOfEvent(qint64 eventId);
+    qint64 eventAtRow(int row);
+    qint64 eventTime(qint64 eventId);
+    // Entries created between 'from' and 'to' containing 'text', oldest first.
+    QList<EventRecord> search(qint64 from, qint64 to, const QString &text);
+
+    // Editing keeps the previous text in the entry's revision history.
+    bool editRecord(qint64 eventId, const QString &textEvent,
+                    StorageBackend::Durability durability = StorageBackend::Synced);
+    QList<RevisionInfo> revisions(qint64 eventId);
+    QString revisionText(qint64 eventId, int revision);
+
+    // Deleted entries stay in the trash, where they can be restored, until the
+    // maintenance purges them after the retention period or emptyTrash().
+    bool deleteRecord(qint64 eventId);
+    bool restoreRecord(qint64 eventId);
+    QList<TrashedEntry> trash();
+    void emptyTrash();
+
+    // Imports JSON-lines, CSV or plain-text day files in the background.
+    // Calling it again after an interruption resumes the unfinished files.
+    void importJournal(const QStringList &files);
+
+    // Streams the journal to a .jsonl file or a .dwa archive in the background.
+    // Exporting to a file that holds a partial export continues it.
+    void exportJournal(const QString &fileName);
+    bool verifyExport(const QString &fileName);
+
+    // Tags and mood. #hashtags typed in the text are tagged automatically.
+    bool setTags(qint64 eventId, const QStringList &tags);
+    bool setMood(qint64 eventId, int mood);
+    QList<qint64> filterEvents(const FacetFilter &filter);
+    bool matchesFilter(qint64 eventId, const FacetFilter &filter);
+    QMap<QString, int> tagCounts(const FacetFilter &filter = FacetFilter());
+    QMap<int, int> moodCounts(const FacetFilter &filter = FacetFilter());
+    QString getEventById(qint64 eventId);
+
+    // Past entries whose wording is closest to the given one, best first.
+    QList<SimilarEntry> similarTo(qint64 eventId, int count);
+
+    // Entries, words, words per day and streaks of the days from 'from' to 'to'.
+    WritingStats stats(const QDate &from, const QDate &to);
+
+    // Timings of the idle-time database maintenance.
+    QList<MaintenanceStats> maintenanceStats();
+
+    // An encrypted journal stays closed from the start until this is given its
+    // passphrase. True once the journal is open, or if it is not encrypted.
+    Q_INVOKABLE bool unlockJournal(const QString &passphrase);
+    // True while the journal waits for unlockJournal().
+    Q_INVOKABLE bool isJournalLocked() const;
+    // Encrypts the journal at rest under 'passphrase', which the next start
+    // asks for. The encrypted copy is made in the background and replaces the
+    // plaintext journal then.
+    Q_INVOKABLE void encryptJournal(const QString &passphrase);
+    Q_INVOKABLE bool isJournalEncrypted() const;
+    // Moves every encrypted page to a fresh data key, in the background.
+    void rekeyJournal();
+
+    // The file I/O of every operation above is counted under its name, and that
+    // of the background workers under theirs; see IoVfs::totals().
+
+    // The cap shared by the row cache, the SQLite page cache and other caches.
+    MemoryBudget *memoryBudget();
+
+    // Errors and notices for the UI, merged and rate-limited. Successes are
+    // only counted there.
+    StatusChannel *statusChannel();
+
+    // Records the operations above, and the rows the list asks for, to a
+    // trace for TraceReplay. Off unless started; the text of entries and
+    // searches is not recorded, only its length.
+    bool startTrace(const QString &fileName);
+    void stopTrace();
+    QueryTrace *queryTrace();
+
+    // Completes words in the editor from the ones written in the journal;
+    // null for backends without SQL.
+    WordCompleter *wordCompleter();
+
+    // Records a voice note for the entry from the microphone, or from 'source'
+    // (a WavFileSource, say), which it takes over. The note is attached to the
+    // entry as soon as the recording stops.
+    bool recordVoiceNote(qint64 eventId, VoiceSource *source = 0);
+    void stopVoiceNote();
+    bool isRecordingVoiceNote() const;
+
+    // Exchanges the changes since the last sync with the server behind 'transport'.
+    bool syncJournal(SyncTransport *transport, SyncStats *stats = 0);
+
+Q_SIGNALS:
+    // Emitted while existing rows are migrated to a new schema version in the background.
+    void migrationProgress(int version, qint64 done, qint64 total);
+    void migrationFinished();
+    // The passphrase was accepted and the journal is open.
+    void journalUnlocked();
+    // The encrypted copy of the journal is complete; plaintext caches of it should go.
+    void journalEncrypted();
+
+    void importProgress(const QString &source, qint64 bytesDone, qint64 bytesTotal, int entries);
+    void importFinished(int entries);
+
+    void exportProgress(int rowsDone, int rowsTotal);
+    void exportFinished(const QString &fileName, int rows);
+
+    // 'task' is JournalEncryption::Encrypt or JournalEncryption::Rekey.
+    void encryptionProgress(int task, qint64 done, qint64 total);
+
+    void voiceNoteSaved(qint64 eventId, const QString &fileName);
+
+    // One entry was written, or its text, tags or mood changed.
+    void eventAdded(qint64 eventId);
+    void eventChanged(qint64 eventId);
+    // Many entries changed at once, by a migration, an import or a sync.
+    void facetsChanged();
+    // An entry was moved to the trash or back out of it.
+    void trashChanged();
+
+public slots:
+    // Connected to the application's thumbnail/invisible and fullscreen signals.
+    void onAppBackground();
+    void onAppForeground();
 
 private slots:
     // This is the callback used for executing asynchronous queries.
     void onLoadAsyncResultData(const bb::data::DataAccessReply &reply);
+    void onMigrationFinished();
+    void onMigrationError(const QString &message);
+    void onImportFinished(qint64 firstEventId, qint64 lastEventId, int entries);
+    void onEncryptionFinished(int task, bool complete);
+    void onVoiceNoteFinished(const QString &fileName, const QString &sha1);
+
+    // Commits Buffered writes; called before anything else writes to the journal.
+    void flushWrites();
+
+    // Shows what the status channel has queued since the last frame.
+    void onStatusMessages();
 
 private:
-    // Helper method to show a alert dialog
-    void alert(const QString &message);
+    // Posts to the status channel; 'detail' fills in the %1 of 'text'.
+    void report(StatusChannel::Severity severity, StatusChannel::Code code,
+                const QString &text, const QString &detail = QString());
+
+    // Creates or upgrades the database file and opens the backend.
+    void openJournal();
+    // Created on the first conversion or rekey
+    JournalEncryption *encryption();
+
+    // Lets the maintenance scheduler know that the UI is using the database
+    void markActivity();
 
     // The connection to the SQL database
     bb::data::SqlConnection* m_sqlConnection;
+
+    // Applies schema upgrades and runs data migrations off the UI thread
+    SchemaMigrator* m_migrator;
+
+    // Runs ANALYZE, incremental vacuum and PRAGMA optimize while the app is idle
+    MaintenanceScheduler* m_maintenance;
+
+    // Where the entries are read from and appended to
+    StorageBackend* m_backend;
+
+    // Created on the first import or export
+    JournalImporter* m_importer;
+    JournalExporter* m_exporter;
+
+    // Bitmaps over tags, moods and months; empty for backends without SQL
+    FacetIndex m_facets;
+
+    // Rows to eventIDs and back; not loaded for backends without SQL
+    RowIndex m_rowIndex;
+
+    // Caps the memory of all caches; owns the SQLite page cache consumer
+    MemoryBudget* m_memory;
+    SqliteCacheConsumer* m_pageCache;
+
+    // Data keys of the encrypted journal, and the worker that converts and rekeys it
+    JournalKeys m_keys;
+    JournalEncryption* m_encryption;
+
+    // Created on the first voice note; the entry it is recorded for
+    VoiceRecorder* m_voice;
+    qint64 m_voiceEventId;
+
+    // Commits Buffered writes that no stronger write has taken along
+    QTimer* m_flushTimer;
+
+    // Operations recorded while tracing
+    QueryTrace m_trace;
+
+    // Words of the journal for completion in the editor
+    WordCompleter* m_completer;
+
+    // Errors and notices, and the toast they are shown in
+    StatusChannel* m_status;
+    bb::system::SystemToast* m_toast;
 };
 
 #endif
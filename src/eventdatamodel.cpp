@@ -14,6 +14,24 @@
 */
 
 #include "eventdatamodel.hpp"
+#include "cryptovfs.hpp"
+
+#include <bb/cascades/DataModelChangeType>
+
+#include <QDateTime>
+#include <QFile>
+#include <QTimer>
+#include <QtAlgorithms>
+
+#define ROW_PAGE 50
+#define ROW_CACHE_MAX_BYTES (2 * 1024 * 1024)
+#define ROW_OVERHEAD_BYTES 48
+
+#define SNAPSHOT_FILE "./data/EventList.snapshot"
+#define SNAPSHOT_ROWS 100
+#define SNAPSHOT_ROWS_ABOVE 20
+#define SNAPSHOT_PREVIEW_CHARS 160
+#define SNAPSHOT_RECONCILE_DELAY_MS 500
 
 /**
  * The data of the EventDataModel have the following form:
@@ -34,7 +52,37 @@
 EventDataModel::EventDataModel(QObject *parent, DatabaseIo *dataio)
     : bb::cascades::DataModel(parent)
 	, m_dataIo(dataio)
+	, m_rows(ROW_CACHE_MAX_BYTES)
+	, m_hits(0)
+	, m_misses(0)
+	, m_filtered(false)
+	, m_scrollRow(0)
+{
+    if (m_dataIo) {
+        connect(m_dataIo, SIGNAL(eventAdded(qint64)), this, SLOT(onEventAdded(qint64)));
+        connect(m_dataIo, SIGNAL(eventChanged(qint64)), this, SLOT(onEventChanged(qint64)));
+        connect(m_dataIo, SIGNAL(facetsChanged()), this, SLOT(onFacetsChanged()));
+        connect(m_dataIo, SIGNAL(trashChanged()), this, SLOT(onTrashChanged()));
+        connect(m_dataIo, SIGNAL(journalUnlocked()), this, SLOT(onJournalUnlocked()));
+        connect(m_dataIo, SIGNAL(journalEncrypted()), this, SLOT(onJournalEncrypted()));
+        m_dataIo->memoryBudget()->addConsumer(this);
+
+        // The list is drawn from the snapshot first; the journal is asked once
+        // the first frames are up.
+        if (!snapshotAllowed()) {
+            removeSnapshot();
+        } else if (m_snapshot.open(SNAPSHOT_FILE)) {
+            m_scrollRow = m_snapshot.scrollRow();
+            QTimer::singleShot(SNAPSHOT_RECONCILE_DELAY_MS, this, SLOT(reconcileSnapshot()));
+        }
+    }
+}
+
+EventDataModel::~EventDataModel()
 {
+    if (m_dataIo) {
+        m_dataIo->memoryBudget()->removeConsumer(this);
+    }
 }
 //! [0]
 
@@ -47,7 +95,9 @@ int EventDataModel::childCount(const QVariantList& indexPath)
      */
     const int level = indexPath.size();
     if (level == 0) { // The number of top-level items is requested
-        return m_dataIo->getCount();
+        if (m_filtered)
+            return m_filteredEvents.size();
+        return m_snapshot.isOpen() ? m_snapshot.rowCount() : m_dataIo->getCount();
     }
 
     // The number of child items for 2nd level items is requested -> always 0
@@ -76,7 +126,16 @@ QVariant EventDataModel::data(const QVariantList& indexPath)
     QString value;
 
     if (indexPath.size() == 1) { // Header requested
-    	value = m_dataIo->getEvent(indexPath[0].toInt());
+        const int row = indexPath[0].toInt();
+        QueryTrace *queryTrace = m_dataIo ? m_dataIo->queryTrace() : 0;
+        TraceScope trace(queryTrace, TraceModelRow);
+        const qint64 eventId = eventAtRow(row);
+        if (queryTrace && queryTrace->isActive()) {
+            trace.arg(row);
+            trace.arg(m_rows.contains(int(eventId)) ? 1 : 0);
+        }
+        if (m_filtered || m_rows.contains(int(eventId)) || !m_snapshot.preview(row, value))
+            value = rowText(row, eventId);
     }
 /*
     if (indexPath.size() == 2) { // 2nd-level item requested
@@ -142,3 +201,340 @@ QString EventDataModel::itemType(const QVariantList& indexPath)
     }
 }
 //! [4]
+
+//! [5]
+void EventDataModel::setFilter(const FacetFilter &filter)
+{
+    // Cached rows are keyed by eventID, so they are shown again in the new list.
+    m_filter = filter;
+    m_filtered = !filter.isEmpty();
+    m_filteredEvents = m_filtered ? m_dataIo->filterEvents(filter) : QList<qint64>();
+
+    emit itemsChanged(bb::cascades::DataModelChangeType::Init);
+}
+
+void EventDataModel::filterByTag(const QString &tag)
+{
+    FacetFilter filter;
+    filter.tags << tag.trimmed().toLower().remove(QRegExp("^#"));
+    setFilter(filter);
+}
+
+void EventDataModel::clearFilter()
+{
+    setFilter(FacetFilter());
+}
+
+// A new entry is the last row of the list, and of the filtered list if it matches.
+void EventDataModel::onEventAdded(qint64 eventId)
+{
+    if (m_snapshot.isOpen()) {
+        reconcileSnapshot();
+        return;
+    }
+    if (!m_filtered) {
+        emit itemAdded(QVariantList() << m_dataIo->rowOfEvent(eventId));
+    } else if (m_dataIo->matchesFilter(eventId, m_filter)) {
+        const int row = int(qLowerBound(m_filteredEvents.begin(), m_filteredEvents.end(), eventId)
+                            - m_filteredEvents.begin());
+        m_filteredEvents.insert(row, eventId);
+        emit itemAdded(QVariantList() << row);
+    }
+}
+
+// An edited, tagged or rated entry is read again, and may now (or no longer)
+// match the filter; the other rows stay as they are.
+void EventDataModel::onEventChanged(qint64 eventId)
+{
+    m_rows.remove(int(eventId));
+    if (m_snapshot.isOpen()) {
+        reconcileSnapshot();
+        return;
+    }
+    if (!m_filtered) {
+        const int row = m_dataIo->rowOfEvent(eventId);
+        if (m_dataIo->eventAtRow(row) == eventId)
+            emit itemUpdated(QVariantList() << row);
+        return;
+    }
+
+    const int row = int(qLowerBound(m_filteredEvents.begin(), m_filteredEvents.end(), eventId)
+                        - m_filteredEvents.begin());
+    const bool listed = row < m_filteredEvents.size() && m_filteredEvents.at(row) == eventId;
+    const bool matches = m_dataIo->matchesFilter(eventId, m_filter);
+    if (listed && matches) {
+        emit itemUpdated(QVariantList() << row);
+    } else if (listed) {
+        m_filteredEvents.removeAt(row);
+        emit itemRemoved(QVariantList() << row);
+    } else if (matches) {
+        m_filteredEvents.insert(row, eventId);
+        emit itemAdded(QVariantList() << row);
+    }
+}
+
+// A migration, an import or a sync may have changed any entry.
+void EventDataModel::onFacetsChanged()
+{
+    m_rows.clear();
+    if (m_snapshot.isOpen()) {
+        reconcileSnapshot();
+    }
+    if (m_filtered) {
+        setFilter(m_filter);
+    }
+}
+
+// The rows after a deleted or restored entry have moved, and the snapshot
+// no longer matches the journal. The cached rows are keyed by eventID and
+// stay valid.
+void EventDataModel::onTrashChanged()
+{
+    m_snapshot.close();
+    if (m_filtered) {
+        m_filteredEvents = m_dataIo->filterEvents(m_filter);
+    }
+    emit itemsChanged(bb::cascades::DataModelChangeType::Init);
+}
+//! [5]
+
+//! [6]
+// The entry shown in a row of the list, filtered or not; -1 past its end.
+qint64 EventDataModel::eventAtRow(int row) const
+{
+    if (!m_filtered)
+        return m_dataIo ? m_dataIo->eventAtRow(row) : -1;
+    return row >= 0 && row < m_filteredEvents.size() ? m_filteredEvents.at(row) : -1;
+}
+
+// Rows of the unfiltered list are read a page at a time, since ListView asks
+// for the rows around the one on screen next.
+QString EventDataModel::rowText(int row, qint64 eventId)
+{
+    if (eventId < 0)
+        return QString();
+    if (const QString *text = m_rows.object(int(eventId))) {
+        ++m_hits;
+        return *text;
+    }
+    ++m_misses;
+
+    if (m_filtered) {
+        const QString text = m_dataIo->getEventById(eventId);
+        cacheRow(eventId, text);
+        return text;
+    }
+
+    const int first = row - row % ROW_PAGE;
+    const QList<EventRecord> page = m_dataIo->getEvents(first, ROW_PAGE);
+    for (int i = 0; i < page.size(); ++i) {
+        const EventRecord &record = page.at(i);
+        cacheRow(record.eventId, record.timeStamp + ", " + record.textEvent);
+    }
+    m_dataIo->memoryBudget()->enforce();
+
+    if (row - first < page.size()) {
+        const EventRecord &record = page.at(row - first);
+        return record.timeStamp + ", " + record.textEvent;
+    }
+    return m_dataIo->getEvent(row);
+}
+
+void EventDataModel::cacheRow(qint64 eventId, const QString &text)
+{
+    const int cost = text.size() * int(sizeof(QChar)) + ROW_OVERHEAD_BYTES;
+
+    // Grow back into whatever the budget has left, up to ROW_CACHE_MAX_BYTES.
+    if (m_rows.totalCost() + cost > m_rows.maxCost()) {
+        const qint64 allowed = m_rows.totalCost() + m_dataIo->memoryBudget()->headroom();
+        m_rows.setMaxCost(int(qBound<qint64>(cost, allowed, ROW_CACHE_MAX_BYTES)));
+    }
+    m_rows.insert(int(eventId), new QString(text), cost);
+}
+
+QString EventDataModel::consumerName() const
+{
+    return "model rows";
+}
+
+qint64 EventDataModel::bytesUsed() const
+{
+    return m_rows.totalCost();
+}
+
+int EventDataModel::priority() const
+{
+    return 1;
+}
+
+double EventDataModel::valuePerByte() const
+{
+    const qint64 bytes = bytesUsed();
+    if (bytes <= 0)
+        return 0;
+    return double(m_hits) / (m_hits + m_misses + 1) / bytes * 1024;
+}
+
+qint64 EventDataModel::shrink(qint64 bytes)
+{
+    // QCache drops the least recently used rows to fit the lower cap.
+    const qint64 before = m_rows.totalCost();
+    m_rows.setMaxCost(int(qMax<qint64>(0, before - bytes)));
+    return before - m_rows.totalCost();
+}
+//! [6]
+
+//! [7]
+int EventDataModel::scrollRow() const
+{
+    return m_scrollRow;
+}
+
+void EventDataModel::setScrollRow(int row)
+{
+    // Rows of a filtered list are not rows of the journal.
+    if (m_filtered || row == m_scrollRow)
+        return;
+    m_scrollRow = row;
+    emit scrollRowChanged(row);
+}
+
+int EventDataModel::rowForDate(const QDateTime &date)
+{
+    if (!m_dataIo)
+        return 0;
+    if (!m_filtered)
+        return m_dataIo->rowForTime(date.toTime_t());
+
+    // The filtered entries are in eventID order too.
+    const qint64 eventId = m_dataIo->eventAtTime(date.toTime_t());
+    if (eventId < 0)
+        return m_filteredEvents.size();
+    return int(qLowerBound(m_filteredEvents.begin(), m_filteredEvents.end(), eventId)
+               - m_filteredEvents.begin());
+}
+
+QString EventDataModel::dateAtRow(int row)
+{
+    if (!m_dataIo)
+        return QString();
+
+    qint64 createdAt = -1;
+    if (!m_filtered) {
+        createdAt = m_dataIo->timeAtRow(row);
+    } else if (row >= 0 && row < m_filteredEvents.size()) {
+        createdAt = m_dataIo->eventTime(m_filteredEvents.at(row));
+    }
+    if (createdAt < 0)
+        return QString();
+    return QDateTime::fromTime_t(uint(createdAt)).date().toString("MMMM yyyy");
+}
+
+// The previews are plaintext: an encrypted journal, or one about to be,
+// keeps none of them outside it (as WordCompleter does with its trie).
+bool EventDataModel::snapshotAllowed() const
+{
+    return !CryptoVfs::hasKeys() && !m_dataIo->isJournalLocked() && !m_dataIo->isJournalEncrypted();
+}
+
+void EventDataModel::removeSnapshot()
+{
+    m_snapshot.close();
+    QFile::remove(SNAPSHOT_FILE);
+}
+
+// A locked journal shows no rows; they can be read once the passphrase was taken.
+void EventDataModel::onJournalUnlocked()
+{
+    emit itemsChanged(bb::cascades::DataModelChangeType::Init);
+}
+
+void EventDataModel::onJournalEncrypted()
+{
+    const bool shown = m_snapshot.isOpen();
+    removeSnapshot();
+    if (shown && !m_filtered)
+        emit itemsChanged(bb::cascades::DataModelChangeType::Init);
+}
+
+void EventDataModel::saveSnapshot()
+{
+    if (!m_dataIo)
+        return;
+    if (!snapshotAllowed()) {
+        removeSnapshot();
+        return;
+    }
+
+    const int count = m_dataIo->getCount();
+    const int first = qBound(0, m_scrollRow - SNAPSHOT_ROWS_ABOVE, qMax(0, count - SNAPSHOT_ROWS));
+    const QList<EventRecord> page = m_dataIo->getEvents(first, SNAPSHOT_ROWS);
+
+    QList<SnapshotRow> rows;
+    for (int i = 0; i < page.size(); ++i) {
+        const EventRecord &record = page.at(i);
+        SnapshotRow row;
+        row.row = first + i;
+        row.eventId = record.eventId;
+        row.createdAt = record.createdAt;
+        const QString text = record.timeStamp + ", " + record.textEvent;
+        row.preview = text.left(SNAPSHOT_PREVIEW_CHARS);
+        row.truncated = text.size() > SNAPSHOT_PREVIEW_CHARS;
+        rows << row;
+    }
+
+    if (!ModelSnapshot::write(SNAPSHOT_FILE, m_dataIo->journalVersion(), count, m_scrollRow, rows)) {
+        qWarning() << "saveSnapshot: could not write " << SNAPSHOT_FILE;
+    }
+}
+
+void EventDataModel::reconcileSnapshot()
+{
+    if (!m_snapshot.isOpen())
+        return;
+
+    // Nothing was written since the snapshot: what is on screen is right, but
+    // for the previews that were cut short, which are read in full now.
+    if (m_snapshot.journalVersion() == m_dataIo->journalVersion()) {
+        const QList<int> truncated = m_snapshot.truncatedRows();
+        m_snapshot.close();
+        if (!m_filtered) {
+            for (int i = 0; i < truncated.size(); ++i) {
+                emit itemUpdated(QVariantList() << truncated.at(i));
+            }
+        }
+        return;
+    }
+
+    const int count = m_dataIo->getCount();
+    if (count != m_snapshot.rowCount()) {
+        m_snapshot.close();
+        if (!m_filtered)
+            emit itemsChanged(bb::cascades::DataModelChangeType::Init);
+        return;
+    }
+
+    // Same rows, some edited: refresh the ones whose preview is out of date,
+    // and the ones that only showed part of their text.
+    const int first = m_snapshot.firstRow();
+    const QList<EventRecord> page = m_dataIo->getEvents(first, m_snapshot.lastRow() - first + 1);
+    QList<int> changed;
+    for (int i = 0; i < page.size(); ++i) {
+        const EventRecord &record = page.at(i);
+        const int row = first + i;
+        const QString text = record.timeStamp + ", " + record.textEvent;
+        QString preview;
+        bool truncated = false;
+        if (m_snapshot.preview(row, preview, &truncated) && (truncated || preview != text))
+            changed << row;
+        cacheRow(record.eventId, text);
+    }
+    m_snapshot.close();
+
+    if (!m_filtered) {
+        for (int i = 0; i < changed.size(); ++i) {
+            emit itemUpdated(QVariantList() << changed.at(i));
+        }
+    }
+}
+//! [7]
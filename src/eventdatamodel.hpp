@@ -17,14 +17,21 @@
 #define EVENTDATAMODEL_HPP
 
 #include "databaseio.hpp"
+#include "memorybudget.hpp"
+#include "modelsnapshot.hpp"
 #include <bb/cascades/DataModel>
 
+#include <QCache>
+
 //! [0]
-class EventDataModel : public bb::cascades::DataModel
+class EventDataModel : public bb::cascades::DataModel, public MemoryConsumer
 {
     Q_OBJECT
+    // First row on screen in the unfiltered list; kept in the snapshot
+    Q_PROPERTY(int scrollRow READ scrollRow WRITE setScrollRow NOTIFY scrollRowChanged)
 public:
     EventDataModel(QObject *parent = 0, DatabaseIo *dataio = 0);
+    ~EventDataModel();
 
     // Required interface implementation
     virtual int childCount(const QVariantList& indexPath);
@@ -32,8 +39,63 @@ public:
     virtual QVariant data(const QVariantList& indexPath);
     virtual QString itemType(const QVariantList& indexPath);
 
+    // Shows only the entries matching 'filter' until clearFilter() is called.
+    void setFilter(const FacetFilter &filter);
+    Q_INVOKABLE void filterByTag(const QString &tag);
+    Q_INVOKABLE void clearFilter();
+
+    int scrollRow() const;
+    void setScrollRow(int row);
+
+    // Jumping to a date and the label of the date scrubber, for the list as shown.
+    Q_INVOKABLE int rowForDate(const QDateTime &date);
+    Q_INVOKABLE QString dateAtRow(int row);
+
+    // Rows read ahead in pages are kept in a cache that the app's memory budget sizes.
+    virtual QString consumerName() const;
+    virtual qint64 bytesUsed() const;
+    virtual int priority() const;
+    virtual double valuePerByte() const;
+    virtual qint64 shrink(qint64 bytes);
+
+public slots:
+    // Writes the rows around scrollRow to the snapshot shown at the next start.
+    void saveSnapshot();
+
+signals:
+    void scrollRowChanged(int row);
+
+private slots:
+    void onEventAdded(qint64 eventId);
+    void onEventChanged(qint64 eventId);
+    void onFacetsChanged();
+    void onTrashChanged();
+    // Checks the rows shown from the snapshot against the journal.
+    void reconcileSnapshot();
+    void onJournalUnlocked();
+    void onJournalEncrypted();
+
 private:
+    qint64 eventAtRow(int row) const;
+    QString rowText(int row, qint64 eventId);
+    void cacheRow(qint64 eventId, const QString &text);
+    bool snapshotAllowed() const;
+    void removeSnapshot();
+
     DatabaseIo *m_dataIo;
+
+    // eventID -> the text shown for it; cost in bytes
+    QCache<int, QString> m_rows;
+    qint64 m_hits;
+    qint64 m_misses;
+
+    bool m_filtered;
+    FacetFilter m_filter;
+    QList<qint64> m_filteredEvents;
+
+    // Open from startup until reconcileSnapshot() has run
+    ModelSnapshot m_snapshot;
+    int m_scrollRow;
 };
 //! [0]
 
@@ -0,0 +1,283 @@
+/*
+ * facetindex.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "facetindex.hpp"
+
+#include <QDateTime>
+#include <QRegExp>
+#include <QtSql/QtSql>
+
+#include <climits>
+
+FacetIndex::FacetIndex()
+{
+}
+
+void FacetIndex::clear()
+{
+    m_all = RoaringBitmap();
+    m_tags.clear();
+    m_moods.clear();
+    m_months.clear();
+}
+
+bool FacetIndex::load(QSqlDatabase database)
+{
+    clear();
+
+    QSqlQuery query(database);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT eventID, createdAt, mood FROM events WHERE deletedAt IS NULL"))
+        return false;
+    while (query.next()) {
+        const quint32 id = quint32(query.value(0).toLongLong());
+        m_all.add(id);
+        const int month = monthOf(query.value(1).toLongLong());
+        if (month)
+            m_months[month].add(id);
+        if (!query.value(2).isNull())
+            m_moods[query.value(2).toInt()].add(id);
+    }
+
+    if (!query.exec("SELECT t.eventID, t.tag FROM event_tags t "
+                    "JOIN events e ON e.eventID = t.eventID WHERE e.deletedAt IS NULL"))
+        return false;
+    while (query.next())
+        m_tags[query.value(1).toString()].add(quint32(query.value(0).toLongLong()));
+
+    qDebug() << "Facet index:" << m_all.cardinality() << "entries," << m_tags.size() << "tags";
+    return true;
+}
+
+void FacetIndex::addEvent(qint64 eventId, qint64 createdAt, const QStringList &tags, int mood)
+{
+    const quint32 id = quint32(eventId);
+    m_all.add(id);
+
+    const int month = monthOf(createdAt);
+    if (month)
+        m_months[month].add(id);
+    if (mood >= 0)
+        m_moods[mood].add(id);
+    for (int i = 0; i < tags.size(); ++i)
+        m_tags[tags.at(i)].add(id);
+}
+
+void FacetIndex::removeEvent(qint64 eventId)
+{
+    const quint32 id = quint32(eventId);
+    m_all.remove(id);
+    setTags(eventId, QStringList());
+    setMood(eventId, -1);
+
+    QMap<int, RoaringBitmap>::iterator it = m_months.begin();
+    while (it != m_months.end()) {
+        it.value().remove(id);
+        if (it.value().isEmpty())
+            it = m_months.erase(it);
+        else
+            ++it;
+    }
+}
+
+void FacetIndex::setTags(qint64 eventId, const QStringList &tags)
+{
+    const quint32 id = quint32(eventId);
+
+    QHash<QString, RoaringBitmap>::iterator it = m_tags.begin();
+    while (it != m_tags.end()) {
+        if (!tags.contains(it.key()))
+            it.value().remove(id);
+        if (it.value().isEmpty())
+            it = m_tags.erase(it);
+        else
+            ++it;
+    }
+    for (int i = 0; i < tags.size(); ++i)
+        m_tags[tags.at(i)].add(id);
+}
+
+void FacetIndex::setMood(qint64 eventId, int mood)
+{
+    const quint32 id = quint32(eventId);
+
+    QMap<int, RoaringBitmap>::iterator it = m_moods.begin();
+    while (it != m_moods.end()) {
+        it.value().remove(id);
+        if (it.value().isEmpty())
+            it = m_moods.erase(it);
+        else
+            ++it;
+    }
+    if (mood >= 0)
+        m_moods[mood].add(id);
+}
+
+RoaringBitmap FacetIndex::unionOf(const QMap<int, RoaringBitmap> &index, int from, int to)
+{
+    RoaringBitmap result;
+    QMap<int, RoaringBitmap>::const_iterator it = index.lowerBound(from);
+    for (; it != index.constEnd() && it.key() <= to; ++it)
+        result |= it.value();
+    return result;
+}
+
+bool FacetIndex::anyContains(const QMap<int, RoaringBitmap> &index, int from, int to, quint32 value)
+{
+    QMap<int, RoaringBitmap>::const_iterator it = index.lowerBound(from);
+    for (; it != index.constEnd() && it.key() <= to; ++it) {
+        if (it.value().contains(value))
+            return true;
+    }
+    return false;
+}
+
+RoaringBitmap FacetIndex::query(const FacetFilter &filter) const
+{
+    RoaringBitmap result = m_all;
+
+    // A tag that no entry carries ends the query early.
+    for (int i = 0; i < filter.tags.size() && !result.isEmpty(); ++i) {
+        QHash<QString, RoaringBitmap>::const_iterator it = m_tags.constFind(filter.tags.at(i));
+        if (it == m_tags.constEnd())
+            return RoaringBitmap();
+        result = result & it.value();
+    }
+
+    if ((filter.minMood >= 0 || filter.maxMood >= 0) && !result.isEmpty()) {
+        result = result & unionOf(m_moods, qMax(filter.minMood, 0),
+                                  filter.maxMood >= 0 ? filter.maxMood : INT_MAX);
+    }
+
+    if ((filter.fromMonth || filter.toMonth) && !result.isEmpty()) {
+        result = result & unionOf(m_months, filter.fromMonth,
+                                  filter.toMonth ? filter.toMonth : INT_MAX);
+    }
+    return result;
+}
+
+bool FacetIndex::matches(qint64 eventId, const FacetFilter &filter) const
+{
+    const quint32 id = quint32(eventId);
+    if (!m_all.contains(id))
+        return false;
+
+    for (int i = 0; i < filter.tags.size(); ++i) {
+        QHash<QString, RoaringBitmap>::const_iterator it = m_tags.constFind(filter.tags.at(i));
+        if (it == m_tags.constEnd() || !it.value().contains(id))
+            return false;
+    }
+
+    if ((filter.minMood >= 0 || filter.maxMood >= 0)
+        && !anyContains(m_moods, qMax(filter.minMood, 0),
+                        filter.maxMood >= 0 ? filter.maxMood : INT_MAX, id)) {
+        return false;
+    }
+
+    if ((filter.fromMonth || filter.toMonth)
+        && !anyContains(m_months, filter.fromMonth,
+                        filter.toMonth ? filter.toMonth : INT_MAX, id)) {
+        return false;
+    }
+    return true;
+}
+
+QMap<QString, int> FacetIndex::tagCounts(const FacetFilter &filter) const
+{
+    QMap<QString, int> counts;
+    const bool all = filter.isEmpty();
+    const RoaringBitmap matching = all ? RoaringBitmap() : query(filter);
+
+    QHash<QString, RoaringBitmap>::const_iterator it;
+    for (it = m_tags.constBegin(); it != m_tags.constEnd(); ++it) {
+        const int count = all ? it.value().cardinality()
+                              : (it.value() & matching).cardinality();
+        if (count)
+            counts.insert(it.key(), count);
+    }
+    return counts;
+}
+
+QMap<int, int> FacetIndex::moodCounts(const FacetFilter &filter) const
+{
+    QMap<int, int> counts;
+    const bool all = filter.isEmpty();
+    const RoaringBitmap matching = all ? RoaringBitmap() : query(filter);
+
+    QMap<int, RoaringBitmap>::const_iterator it;
+    for (it = m_moods.constBegin(); it != m_moods.constEnd(); ++it) {
+        const int count = all ? it.value().cardinality()
+                              : (it.value() & matching).cardinality();
+        if (count)
+            counts.insert(it.key(), count);
+    }
+    return counts;
+}
+
+QStringList FacetIndex::hashtags(const QString &text)
+{
+    // A tag starts with a letter, so "#1" and "C#" are left alone. Called from
+    // the import's parse threads, so the QRegExp is not shared.
+    QRegExp rx("#([^\\W\\d_][\\w-]*)");
+
+    QStringList tags;
+    int pos = 0;
+    while ((pos = rx.indexIn(text, pos)) != -1) {
+        if (pos == 0 || !text.at(pos - 1).isLetterOrNumber()) {
+            const QString tag = rx.cap(1).toLower();
+            if (!tags.contains(tag))
+                tags << tag;
+        }
+        pos += rx.matchedLength();
+    }
+    return tags;
+}
+
+int FacetIndex::monthOf(qint64 createdAt)
+{
+    if (createdAt <= 0)
+        return 0;
+    const QDate date = QDateTime::fromTime_t(uint(createdAt)).date();
+    return date.year() * 100 + date.month();
+}
+
+bool FacetIndex::writeTags(QSqlDatabase database, qint64 eventId, const QStringList &tags,
+                           bool inlineTags, QString *errorText)
+{
+    QSqlQuery query(database);
+    query.prepare("DELETE FROM event_tags WHERE eventID = :eventID AND inline = :inline");
+    query.bindValue(":eventID", eventId);
+    query.bindValue(":inline", inlineTags ? 1 : 0);
+    bool ok = query.exec();
+
+    // An explicit tag takes over an inline one of the same name, so it
+    // survives the hashtag being edited out of the text.
+    query.prepare(inlineTags
+                  ? "INSERT OR IGNORE INTO event_tags (eventID, tag, inline) VALUES(:eventID, :tag, 1)"
+                  : "INSERT OR REPLACE INTO event_tags (eventID, tag, inline) VALUES(:eventID, :tag, 0)");
+    for (int i = 0; ok && i < tags.size(); ++i) {
+        query.bindValue(":eventID", eventId);
+        query.bindValue(":tag", tags.at(i));
+        ok = query.exec();
+    }
+
+    if (!ok && errorText)
+        *errorText = query.lastError().text();
+    return ok;
+}
+
+QStringList FacetIndex::readTags(QSqlDatabase database, qint64 eventId)
+{
+    QStringList tags;
+    QSqlQuery query(database);
+    query.prepare("SELECT tag FROM event_tags WHERE eventID = :eventID");
+    query.bindValue(":eventID", eventId);
+    if (query.exec()) {
+        while (query.next())
+            tags << query.value(0).toString();
+    }
+    return tags;
+}
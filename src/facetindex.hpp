@@ -0,0 +1,90 @@
+/*
+ * facetindex.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef FACETINDEX_HPP_
+#define FACETINDEX_HPP_
+
+#include "roaringbitmap.hpp"
+
+#include <QHash>
+#include <QMap>
+#include <QStringList>
+#include <QtSql/QSqlDatabase>
+
+/*
+ * A filter over the facets of the journal. Every part that is set must
+ * match, e.g. tags "work", minMood 4 and months 202501..202512.
+ */
+struct FacetFilter
+{
+    FacetFilter() : minMood(-1), maxMood(-1), fromMonth(0), toMonth(0) {}
+
+    bool isEmpty() const
+    {
+        return tags.isEmpty() && minMood < 0 && maxMood < 0 && !fromMonth && !toMonth;
+    }
+
+    QStringList tags;     // lower case, without the '#'
+    int minMood;          // -1 for no bound
+    int maxMood;
+    int fromMonth;        // yyyymm, 0 for no bound
+    int toMonth;
+};
+
+/*
+ * @brief In-memory bitmap index over the tags, mood and month of every entry.
+ *
+ * Each tag value, mood value and month has a RoaringBitmap of the eventIDs
+ * that carry it. A filter is an intersection of tag bitmaps with the union
+ * of the mood and month bitmaps in range, so it never touches the events
+ * table. The index is loaded once and then kept current entry by entry.
+ *
+ * Tags live in the event_tags table. Tags typed inline as #hashtags are
+ * stored with inline = 1 and are re-extracted when the text changes; tags
+ * set explicitly are kept.
+ */
+class FacetIndex
+{
+public:
+    FacetIndex();
+
+    bool load(QSqlDatabase database);
+    void clear();
+
+    void addEvent(qint64 eventId, qint64 createdAt, const QStringList &tags, int mood);
+    void removeEvent(qint64 eventId);
+    void setTags(qint64 eventId, const QStringList &tags);
+    void setMood(qint64 eventId, int mood);
+
+    RoaringBitmap query(const FacetFilter &filter) const;
+    // Whether one entry matches 'filter', without building the whole result.
+    bool matches(qint64 eventId, const FacetFilter &filter) const;
+
+    // Number of entries per value among the entries matching 'filter'.
+    QMap<QString, int> tagCounts(const FacetFilter &filter = FacetFilter()) const;
+    QMap<int, int> moodCounts(const FacetFilter &filter = FacetFilter()) const;
+
+    // The #hashtags in 'text', lower case and without duplicates.
+    static QStringList hashtags(const QString &text);
+    static int monthOf(qint64 createdAt);
+
+    // event_tags helpers, used by the storage and the schema migration.
+    static bool writeTags(QSqlDatabase database, qint64 eventId, const QStringList &tags,
+                          bool inlineTags, QString *errorText = 0);
+    static QStringList readTags(QSqlDatabase database, qint64 eventId);
+
+private:
+    static RoaringBitmap unionOf(const QMap<int, RoaringBitmap> &index, int from, int to);
+    static bool anyContains(const QMap<int, RoaringBitmap> &index, int from, int to, quint32 value);
+
+    RoaringBitmap m_all;
+    QHash<QString, RoaringBitmap> m_tags;
+    QMap<int, RoaringBitmap> m_moods;
+    QMap<int, RoaringBitmap> m_months;
+};
+
+#endif /* FACETINDEX_HPP_ */
@@ -0,0 +1,497 @@
+/*
+ * faultvfs.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "faultvfs.hpp"
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <sqlite3.h>
+
+#include <string.h>
+
+#define FAULT_VFS_NAME "dwriter-fault"
+
+// -----------------------------------------------------------------------------------------------
+// Log of unsynced writes
+
+// What a write or truncate replaced: the bytes from 'offset' on that it
+// overwrote or cut off, and the size of the file before it.
+struct UndoRecord
+{
+    sqlite3_int64 offset;
+    sqlite3_int64 length;      // bytes written; -1 for a truncate
+    sqlite3_int64 oldSize;
+    QByteArray before;
+};
+
+static QMutex g_lock;
+static QByteArray g_directory;                       // absolute, with a trailing '/'
+static bool g_recording = false;
+static qint64 g_operations = 0;
+static qint64 g_crashAt = -1;
+static bool g_crashed = false;
+static QMap<QByteArray, QList<UndoRecord> > g_log;   // by path, oldest first
+
+// Counts one operation on a watched file; false once the staged crash has happened.
+static bool survives()
+{
+    if (g_crashed)
+        return false;
+    ++g_operations;
+    if (g_crashAt >= 0 && g_operations > g_crashAt) {
+        g_crashed = true;
+        return false;
+    }
+    return true;
+}
+
+static quint32 nextRandom(quint32 &state)
+{
+    // xorshift32; the seed only has to reproduce a run.
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Undoes 'record' from byte 'kept' of the write on; 0 undoes all of it.
+static bool undo(QFile &file, const UndoRecord &record, sqlite3_int64 kept)
+{
+    if (record.length < 0) {
+        // Truncates are not torn: the cut-off tail comes back whole.
+        return file.seek(record.offset) && file.write(record.before) == record.before.size();
+    }
+
+    if (kept < record.before.size()) {
+        const QByteArray lost = record.before.mid(int(kept));
+        if (!file.seek(record.offset + kept) || file.write(lost) != lost.size())
+            return false;
+    }
+    if (record.offset + record.length > record.oldSize)
+        return file.resize(qMax(record.oldSize, record.offset + kept));
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+// File
+
+struct FaultFile
+{
+    sqlite3_file base;
+    sqlite3_file *real;        // the underlying VFS's file, allocated right after this struct
+    QByteArray *path;          // 0 if the file is not watched
+};
+
+static sqlite3_vfs *g_root = 0;
+
+static int faultClose(sqlite3_file *pFile)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    const int rc = file->real->pMethods ? file->real->pMethods->xClose(file->real) : SQLITE_OK;
+    delete file->path;
+    file->path = 0;
+    return rc;
+}
+
+static int faultRead(sqlite3_file *pFile, void *buffer, int amount, sqlite3_int64 offset)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    return file->real->pMethods->xRead(file->real, buffer, amount, offset);
+}
+
+static int faultWrite(sqlite3_file *pFile, const void *buffer, int amount, sqlite3_int64 offset)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    if (!file->path)
+        return file->real->pMethods->xWrite(file->real, buffer, amount, offset);
+
+    QMutexLocker locker(&g_lock);
+    if (!survives())
+        return SQLITE_IOERR_WRITE;
+
+    if (g_recording) {
+        UndoRecord record;
+        record.offset = offset;
+        record.length = amount;
+        int rc = file->real->pMethods->xFileSize(file->real, &record.oldSize);
+        if (rc != SQLITE_OK)
+            return rc;
+        if (offset < record.oldSize) {
+            record.before.resize(int(qMin<sqlite3_int64>(amount, record.oldSize - offset)));
+            rc = file->real->pMethods->xRead(file->real, record.before.data(),
+                                             record.before.size(), offset);
+            if (rc != SQLITE_OK)
+                return rc;
+        }
+        g_log[*file->path] << record;
+    }
+    return file->real->pMethods->xWrite(file->real, buffer, amount, offset);
+}
+
+static int faultTruncate(sqlite3_file *pFile, sqlite3_int64 size)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    if (!file->path)
+        return file->real->pMethods->xTruncate(file->real, size);
+
+    QMutexLocker locker(&g_lock);
+    if (!survives())
+        return SQLITE_IOERR_TRUNCATE;
+
+    if (g_recording) {
+        UndoRecord record;
+        record.offset = size;
+        record.length = -1;
+        int rc = file->real->pMethods->xFileSize(file->real, &record.oldSize);
+        if (rc != SQLITE_OK)
+            return rc;
+        if (size < record.oldSize) {
+            record.before.resize(int(record.oldSize - size));
+            rc = file->real->pMethods->xRead(file->real, record.before.data(),
+                                             record.before.size(), size);
+            if (rc != SQLITE_OK)
+                return rc;
+            g_log[*file->path] << record;
+        }
+    }
+    return file->real->pMethods->xTruncate(file->real, size);
+}
+
+static int faultSync(sqlite3_file *pFile, int flags)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    if (!file->path)
+        return file->real->pMethods->xSync(file->real, flags);
+
+    QMutexLocker locker(&g_lock);
+    if (!survives())
+        return SQLITE_IOERR_FSYNC;
+
+    // Recorded runs stand in for the disk: what was written is now safe.
+    if (g_recording) {
+        g_log.remove(*file->path);
+        return SQLITE_OK;
+    }
+    return file->real->pMethods->xSync(file->real, flags);
+}
+
+static int faultFileSize(sqlite3_file *pFile, sqlite3_int64 *size)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    return file->real->pMethods->xFileSize(file->real, size);
+}
+
+static int faultLock(sqlite3_file *pFile, int lock)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    return file->real->pMethods->xLock(file->real, lock);
+}
+
+static int faultUnlock(sqlite3_file *pFile, int lock)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    return file->real->pMethods->xUnlock(file->real, lock);
+}
+
+static int faultCheckReservedLock(sqlite3_file *pFile, int *result)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    return file->real->pMethods->xCheckReservedLock(file->real, result);
+}
+
+static int faultFileControl(sqlite3_file *pFile, int op, void *arg)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    return file->real->pMethods->xFileControl(file->real, op, arg);
+}
+
+static int faultSectorSize(sqlite3_file *pFile)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    return file->real->pMethods->xSectorSize(file->real);
+}
+
+static int faultDeviceCharacteristics(sqlite3_file *pFile)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    return file->real->pMethods->xDeviceCharacteristics(file->real);
+}
+
+static int faultShmMap(sqlite3_file *pFile, int region, int size, int extend, void volatile **pp)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    return file->real->pMethods->xShmMap(file->real, region, size, extend, pp);
+}
+
+static int faultShmLock(sqlite3_file *pFile, int offset, int n, int flags)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    return file->real->pMethods->xShmLock(file->real, offset, n, flags);
+}
+
+static void faultShmBarrier(sqlite3_file *pFile)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    file->real->pMethods->xShmBarrier(file->real);
+}
+
+static int faultShmUnmap(sqlite3_file *pFile, int deleteFlag)
+{
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    return file->real->pMethods->xShmUnmap(file->real, deleteFlag);
+}
+
+// Version 1 and 2 methods only: version 3 adds xFetch (mmap), whose writes
+// back to the file would not be logged.
+static sqlite3_io_methods g_methodsV1 = {
+    1, faultClose, faultRead, faultWrite, faultTruncate, faultSync, faultFileSize,
+    faultLock, faultUnlock, faultCheckReservedLock, faultFileControl, faultSectorSize,
+    faultDeviceCharacteristics, 0, 0, 0, 0
+};
+
+static sqlite3_io_methods g_methodsV2 = {
+    2, faultClose, faultRead, faultWrite, faultTruncate, faultSync, faultFileSize,
+    faultLock, faultUnlock, faultCheckReservedLock, faultFileControl, faultSectorSize,
+    faultDeviceCharacteristics, faultShmMap, faultShmLock, faultShmBarrier, faultShmUnmap
+};
+
+// -----------------------------------------------------------------------------------------------
+// sqlite3_vfs
+
+static bool isWatched(const char *name)
+{
+    QMutexLocker locker(&g_lock);
+    return name && !g_directory.isEmpty() && strncmp(name, g_directory.constData(), g_directory.size()) == 0;
+}
+
+static int faultOpen(sqlite3_vfs *vfs, const char *name, sqlite3_file *pFile, int flags,
+                     int *outFlags)
+{
+    Q_UNUSED(vfs);
+    FaultFile *file = reinterpret_cast<FaultFile *>(pFile);
+    memset(file, 0, sizeof(FaultFile));
+    file->real = reinterpret_cast<sqlite3_file *>(file + 1);
+
+    const int rc = g_root->xOpen(g_root, name, file->real, flags, outFlags);
+    if (rc != SQLITE_OK) {
+        file->real->pMethods = 0;
+        return rc;
+    }
+    if (isWatched(name))
+        file->path = new QByteArray(name);
+    file->base.pMethods = file->real->pMethods->iVersion >= 2 ? &g_methodsV2 : &g_methodsV1;
+    return SQLITE_OK;
+}
+
+static int faultDelete(sqlite3_vfs *, const char *name, int syncDir)
+{
+    if (isWatched(name)) {
+        QMutexLocker locker(&g_lock);
+        if (!survives())
+            return SQLITE_IOERR_DELETE;
+        g_log.remove(QByteArray(name));
+    }
+    return g_root->xDelete(g_root, name, syncDir);
+}
+
+static int faultAccess(sqlite3_vfs *, const char *name, int flags, int *result)
+{
+    return g_root->xAccess(g_root, name, flags, result);
+}
+
+static int faultFullPathname(sqlite3_vfs *, const char *name, int n, char *out)
+{
+    return g_root->xFullPathname(g_root, name, n, out);
+}
+
+static void *faultDlOpen(sqlite3_vfs *, const char *name)
+{
+    return g_root->xDlOpen(g_root, name);
+}
+
+static void faultDlError(sqlite3_vfs *, int n, char *message)
+{
+    g_root->xDlError(g_root, n, message);
+}
+
+static void (*faultDlSym(sqlite3_vfs *, void *handle, const char *symbol))(void)
+{
+    return g_root->xDlSym(g_root, handle, symbol);
+}
+
+static void faultDlClose(sqlite3_vfs *, void *handle)
+{
+    g_root->xDlClose(g_root, handle);
+}
+
+static int faultRandomness(sqlite3_vfs *, int n, char *out)
+{
+    return g_root->xRandomness(g_root, n, out);
+}
+
+static int faultSleep(sqlite3_vfs *, int microseconds)
+{
+    return g_root->xSleep(g_root, microseconds);
+}
+
+static int faultCurrentTime(sqlite3_vfs *, double *now)
+{
+    return g_root->xCurrentTime(g_root, now);
+}
+
+static int faultGetLastError(sqlite3_vfs *, int n, char *message)
+{
+    return g_root->xGetLastError ? g_root->xGetLastError(g_root, n, message) : 0;
+}
+
+static sqlite3_vfs g_vfs;
+
+// -----------------------------------------------------------------------------------------------
+// FaultVfs
+
+bool FaultVfs::install(const QString &directory)
+{
+    {
+        QMutexLocker locker(&g_lock);
+        g_directory = QFile::encodeName(QDir(directory).absolutePath() + "/");
+    }
+    if (g_root)
+        return true;
+
+    sqlite3_vfs *root = sqlite3_vfs_find(0);
+    if (!root)
+        return false;
+
+    memset(&g_vfs, 0, sizeof(g_vfs));
+    g_vfs.iVersion = 1;
+    g_vfs.szOsFile = int(sizeof(FaultFile)) + root->szOsFile;
+    g_vfs.mxPathname = root->mxPathname;
+    g_vfs.zName = FAULT_VFS_NAME;
+    g_vfs.xOpen = faultOpen;
+    g_vfs.xDelete = faultDelete;
+    g_vfs.xAccess = faultAccess;
+    g_vfs.xFullPathname = faultFullPathname;
+    g_vfs.xDlOpen = faultDlOpen;
+    g_vfs.xDlError = faultDlError;
+    g_vfs.xDlSym = faultDlSym;
+    g_vfs.xDlClose = faultDlClose;
+    g_vfs.xRandomness = faultRandomness;
+    g_vfs.xSleep = faultSleep;
+    g_vfs.xCurrentTime = faultCurrentTime;
+    g_vfs.xGetLastError = faultGetLastError;
+
+    g_root = root;
+    if (sqlite3_vfs_register(&g_vfs, 1) != SQLITE_OK) {
+        g_root = 0;
+        return false;
+    }
+    return true;
+}
+
+void FaultVfs::uninstall()
+{
+    if (!g_root)
+        return;
+
+    // Open files keep using the methods above, which only need g_root.
+    sqlite3_vfs_unregister(&g_vfs);
+    sqlite3_vfs_register(g_root, 1);
+
+    stopRecording();
+    QMutexLocker locker(&g_lock);
+    g_directory.clear();
+}
+
+void FaultVfs::startRecording()
+{
+    QMutexLocker locker(&g_lock);
+    g_log.clear();
+    g_operations = 0;
+    g_crashAt = -1;
+    g_crashed = false;
+    g_recording = true;
+}
+
+void FaultVfs::stopRecording()
+{
+    QMutexLocker locker(&g_lock);
+    g_log.clear();
+    g_crashAt = -1;
+    g_crashed = false;
+    g_recording = false;
+}
+
+qint64 FaultVfs::operations()
+{
+    QMutexLocker locker(&g_lock);
+    return g_operations;
+}
+
+void FaultVfs::crashAfter(qint64 count)
+{
+    QMutexLocker locker(&g_lock);
+    g_crashAt = g_operations + count;
+}
+
+bool FaultVfs::hasCrashed()
+{
+    QMutexLocker locker(&g_lock);
+    return g_crashed;
+}
+
+bool FaultVfs::powerLoss(quint32 seed)
+{
+    QMutexLocker locker(&g_lock);
+    quint32 state = seed ? seed : 1;
+    bool ok = true;
+
+    QMap<QByteArray, QList<UndoRecord> >::const_iterator it;
+    for (it = g_log.constBegin(); it != g_log.constEnd(); ++it) {
+        const QList<UndoRecord> &records = it.value();
+        const int survivors = int(nextRandom(state) % quint32(records.size() + 1));
+        if (survivors == records.size())
+            continue;
+
+        QFile file(QFile::decodeName(it.key()));
+        if (!file.open(QIODevice::ReadWrite)) {
+            ok = false;
+            continue;
+        }
+
+        // Newest first, so every record finds the file as it left it.
+        for (int i = records.size() - 1; i > survivors; --i)
+            ok = undo(file, records.at(i), 0) && ok;
+
+        // The first lost write may have reached the disk up to some sector.
+        const UndoRecord &torn = records.at(survivors);
+        sqlite3_int64 kept = 0;
+        if (torn.length > 0) {
+            const sqlite3_int64 end = torn.offset + torn.length;
+            const sqlite3_int64 firstBoundary = (torn.offset / FAULT_SECTOR_BYTES + 1) * FAULT_SECTOR_BYTES;
+            const quint32 boundaries = end > firstBoundary
+                                     ? quint32((end - firstBoundary - 1) / FAULT_SECTOR_BYTES + 1) : 0;
+            const quint32 pick = nextRandom(state) % (boundaries + 1);
+            if (pick > 0)
+                kept = firstBoundary + sqlite3_int64(pick - 1) * FAULT_SECTOR_BYTES - torn.offset;
+        }
+        ok = undo(file, torn, kept) && ok;
+        ok = file.flush() && ok;
+    }
+    g_log.clear();
+
+    // The shared-memory index never survives a reboot.
+    const QDir directory(QFile::decodeName(g_directory));
+    const QStringList shm = directory.entryList(QStringList() << "*-shm", QDir::Files);
+    for (int i = 0; i < shm.size(); ++i)
+        ok = QFile::remove(directory.filePath(shm.at(i))) && ok;
+    return ok;
+}
@@ -0,0 +1,58 @@
+/*
+ * faultvfs.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef FAULTVFS_HPP_
+#define FAULTVFS_HPP_
+
+#include <QString>
+
+// Unsynced writes are torn at this granularity by powerLoss().
+#define FAULT_SECTOR_BYTES 512
+
+/*
+ * @brief SQLite VFS that simulates crashes and power loss, for CrashHarness.
+ *
+ * install() registers the VFS as the default, on top of the current default,
+ * and watches the files under one directory; every other file is passed
+ * straight through. While recording, each write and truncate of a watched
+ * file logs the bytes it replaces, and a sync of the file drops its log
+ * instead of reaching the disk. Two kinds of failure can then be staged:
+ *
+ *   crashAfter(n)  the process dies after n more writes, truncates, syncs and
+ *                  deletes: everything after fails, and what was written so
+ *                  far stays (the OS still has it).
+ *   powerLoss()    the files are rolled back to what a disk could hold: per
+ *                  file, a random prefix of the unsynced writes survives and
+ *                  the next one is torn at a FAULT_SECTOR_BYTES boundary. The
+ *                  -shm files, which only live in memory, are removed.
+ *
+ * Creating and deleting files count as durable as soon as they return;
+ * directory syncs are not modelled. Outside recording, syncs are passed on,
+ * so timings taken through the VFS are those of the real disk.
+ */
+class FaultVfs
+{
+public:
+    static bool install(const QString &directory);
+    static void uninstall();
+
+    // Starts a fresh log; clears the operation count and any staged crash.
+    static void startRecording();
+    // Forgets the log and the crash; syncs reach the disk again.
+    static void stopRecording();
+
+    // Writes, truncates, syncs and deletes of watched files since startRecording().
+    static qint64 operations();
+
+    static void crashAfter(qint64 count);
+    static bool hasCrashed();
+
+    // Call once every connection to the watched files is closed.
+    static bool powerLoss(quint32 seed);
+};
+
+#endif /* FAULTVFS_HPP_ */
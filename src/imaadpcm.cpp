@@ -0,0 +1,93 @@
+/*
+ * imaadpcm.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "imaadpcm.hpp"
+
+#include <QtEndian>
+
+#define ADPCM_HEADER_BYTES 4
+
+static const int STEP_TABLE[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767
+};
+
+static const int INDEX_TABLE[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+// Applies one nibble to the predictor and step index, as both ends do.
+static inline void step(int nibble, int &predictor, int &index)
+{
+    const int size = STEP_TABLE[index];
+    int difference = size >> 3;
+    if (nibble & 4) difference += size;
+    if (nibble & 2) difference += size >> 1;
+    if (nibble & 1) difference += size >> 2;
+    predictor += (nibble & 8) ? -difference : difference;
+    predictor = qBound(-32768, predictor, 32767);
+    index = qBound(0, index + INDEX_TABLE[nibble & 7], 88);
+}
+
+ImaAdpcm::ImaAdpcm()
+    : m_predictor(0)
+    , m_index(0)
+{
+}
+
+int ImaAdpcm::frameBytes(int samples)
+{
+    return ADPCM_HEADER_BYTES + (samples + 1) / 2;
+}
+
+int ImaAdpcm::encode(const qint16 *samples, int count, uchar *out)
+{
+    qToLittleEndian<qint16>(qint16(m_predictor), out);
+    out[2] = uchar(m_index);
+    out[3] = 0;
+
+    uchar *packed = out + ADPCM_HEADER_BYTES;
+    for (int i = 0; i < count; ++i) {
+        int difference = samples[i] - m_predictor;
+        int nibble = 0;
+        if (difference < 0) {
+            nibble = 8;
+            difference = -difference;
+        }
+        int size = STEP_TABLE[m_index];
+        if (difference >= size) { nibble |= 4; difference -= size; }
+        size >>= 1;
+        if (difference >= size) { nibble |= 2; difference -= size; }
+        size >>= 1;
+        if (difference >= size) { nibble |= 1; }
+
+        step(nibble, m_predictor, m_index);
+        if (i & 1)
+            packed[i / 2] |= uchar(nibble << 4);
+        else
+            packed[i / 2] = uchar(nibble);
+    }
+    return frameBytes(count);
+}
+
+int ImaAdpcm::decode(const uchar *frame, int bytes, int count, qint16 *out)
+{
+    if (bytes < frameBytes(count))
+        return -1;
+
+    int predictor = qFromLittleEndian<qint16>(frame);
+    int index = qBound(0, int(frame[2]), 88);
+    const uchar *packed = frame + ADPCM_HEADER_BYTES;
+    for (int i = 0; i < count; ++i) {
+        const int nibble = (i & 1) ? packed[i / 2] >> 4 : packed[i / 2] & 0x0f;
+        step(nibble, predictor, index);
+        out[i] = qint16(predictor);
+    }
+    return count;
+}
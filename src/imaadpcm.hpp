@@ -0,0 +1,41 @@
+/*
+ * imaadpcm.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef IMAADPCM_HPP_
+#define IMAADPCM_HPP_
+
+#include <QtGlobal>
+
+/*
+ * @brief IMA ADPCM, 4 bits per 16-bit sample, one frame at a time.
+ *
+ * A frame is [i16 predictor][u8 step index][u8 0][samples packed two per
+ * byte, low nibble first]. The header holds the encoder state at the start
+ * of the frame, so every frame decodes on its own, while the encoder carries
+ * its state over from frame to frame.
+ */
+class ImaAdpcm
+{
+public:
+    ImaAdpcm();
+
+    // Bytes of a frame of 'samples' samples.
+    static int frameBytes(int samples);
+
+    // Writes frameBytes(count) bytes to 'out'.
+    int encode(const qint16 *samples, int count, uchar *out);
+
+    // Decodes 'count' samples from a frame of 'bytes' bytes; returns the
+    // samples decoded, or -1 if the frame is too short.
+    static int decode(const uchar *frame, int bytes, int count, qint16 *out);
+
+private:
+    int m_predictor;
+    int m_index;
+};
+
+#endif /* IMAADPCM_HPP_ */
@@ -0,0 +1,392 @@
+/*
+ * iovfs.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "iovfs.hpp"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadStorage>
+
+#include <sqlite3.h>
+
+#include <string.h>
+
+#define IO_VFS_NAME "dwriter-io"
+
+// -----------------------------------------------------------------------------------------------
+// Tags
+
+// The slot the thread's innermost IoScope charges.
+struct IoThread
+{
+    IoThread() : slot(0) {}
+
+    int slot;
+};
+
+static QMutex g_lock;
+static const char *g_tags[IO_MAX_TAGS] = { IO_UNTAGGED };
+static IoCounters g_counters[IO_MAX_TAGS];
+static int g_tagCount = 1;
+static QThreadStorage<IoThread *> g_thread;
+
+// Call with g_lock held.
+static int slotFor(const char *tag)
+{
+    for (int i = 0; i < g_tagCount; ++i) {
+        if (g_tags[i] == tag || strcmp(g_tags[i], tag) == 0)
+            return i;
+    }
+    if (g_tagCount == IO_MAX_TAGS)
+        return 0;
+    g_tags[g_tagCount] = tag;
+    return g_tagCount++;
+}
+
+static IoThread *thread()
+{
+    if (!g_thread.hasLocalData())
+        g_thread.setLocalData(new IoThread);
+    return g_thread.localData();
+}
+
+// The counters of the calling thread's tag; call with g_lock held.
+static IoCounters &counters()
+{
+    return g_counters[g_thread.hasLocalData() ? g_thread.localData()->slot : 0];
+}
+
+// -----------------------------------------------------------------------------------------------
+// File
+
+struct IoFile
+{
+    sqlite3_file base;
+    sqlite3_file *real;        // the underlying VFS's file, allocated right after this struct
+    bool journal;              // a -wal or -journal file
+};
+
+static sqlite3_vfs *g_root = 0;
+
+static int ioClose(sqlite3_file *pFile)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    return file->real->pMethods ? file->real->pMethods->xClose(file->real) : SQLITE_OK;
+}
+
+static int ioRead(sqlite3_file *pFile, void *buffer, int amount, sqlite3_int64 offset)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    {
+        QMutexLocker locker(&g_lock);
+        IoCounters &io = counters();
+        ++io.reads;
+        io.readBytes += amount;
+    }
+    return file->real->pMethods->xRead(file->real, buffer, amount, offset);
+}
+
+static int ioWrite(sqlite3_file *pFile, const void *buffer, int amount, sqlite3_int64 offset)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    {
+        QMutexLocker locker(&g_lock);
+        IoCounters &io = counters();
+        ++io.writes;
+        io.writeBytes += amount;
+        if (file->journal)
+            io.journalWriteBytes += amount;
+    }
+    return file->real->pMethods->xWrite(file->real, buffer, amount, offset);
+}
+
+static int ioTruncate(sqlite3_file *pFile, sqlite3_int64 size)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    {
+        QMutexLocker locker(&g_lock);
+        ++counters().truncates;
+    }
+    return file->real->pMethods->xTruncate(file->real, size);
+}
+
+static int ioSync(sqlite3_file *pFile, int flags)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    {
+        QMutexLocker locker(&g_lock);
+        ++counters().syncs;
+    }
+    return file->real->pMethods->xSync(file->real, flags);
+}
+
+static int ioFileSize(sqlite3_file *pFile, sqlite3_int64 *size)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    return file->real->pMethods->xFileSize(file->real, size);
+}
+
+static int ioLock(sqlite3_file *pFile, int lock)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    return file->real->pMethods->xLock(file->real, lock);
+}
+
+static int ioUnlock(sqlite3_file *pFile, int lock)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    return file->real->pMethods->xUnlock(file->real, lock);
+}
+
+static int ioCheckReservedLock(sqlite3_file *pFile, int *result)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    return file->real->pMethods->xCheckReservedLock(file->real, result);
+}
+
+static int ioFileControl(sqlite3_file *pFile, int op, void *arg)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    return file->real->pMethods->xFileControl(file->real, op, arg);
+}
+
+static int ioSectorSize(sqlite3_file *pFile)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    return file->real->pMethods->xSectorSize(file->real);
+}
+
+static int ioDeviceCharacteristics(sqlite3_file *pFile)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    return file->real->pMethods->xDeviceCharacteristics(file->real);
+}
+
+static int ioShmMap(sqlite3_file *pFile, int region, int size, int extend, void volatile **pp)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    return file->real->pMethods->xShmMap(file->real, region, size, extend, pp);
+}
+
+static int ioShmLock(sqlite3_file *pFile, int offset, int n, int flags)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    return file->real->pMethods->xShmLock(file->real, offset, n, flags);
+}
+
+static void ioShmBarrier(sqlite3_file *pFile)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    file->real->pMethods->xShmBarrier(file->real);
+}
+
+static int ioShmUnmap(sqlite3_file *pFile, int deleteFlag)
+{
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    return file->real->pMethods->xShmUnmap(file->real, deleteFlag);
+}
+
+// Version 1 and 2 methods only: version 3 adds xFetch (mmap), whose reads
+// would not be counted.
+static sqlite3_io_methods g_methodsV1 = {
+    1, ioClose, ioRead, ioWrite, ioTruncate, ioSync, ioFileSize,
+    ioLock, ioUnlock, ioCheckReservedLock, ioFileControl, ioSectorSize,
+    ioDeviceCharacteristics, 0, 0, 0, 0
+};
+
+static sqlite3_io_methods g_methodsV2 = {
+    2, ioClose, ioRead, ioWrite, ioTruncate, ioSync, ioFileSize,
+    ioLock, ioUnlock, ioCheckReservedLock, ioFileControl, ioSectorSize,
+    ioDeviceCharacteristics, ioShmMap, ioShmLock, ioShmBarrier, ioShmUnmap
+};
+
+// -----------------------------------------------------------------------------------------------
+// sqlite3_vfs
+
+static int ioOpen(sqlite3_vfs *vfs, const char *name, sqlite3_file *pFile, int flags, int *outFlags)
+{
+    Q_UNUSED(vfs);
+    IoFile *file = reinterpret_cast<IoFile *>(pFile);
+    memset(file, 0, sizeof(IoFile));
+    file->real = reinterpret_cast<sqlite3_file *>(file + 1);
+    file->journal = flags & (SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_WAL);
+    {
+        QMutexLocker locker(&g_lock);
+        ++counters().opens;
+    }
+
+    const int rc = g_root->xOpen(g_root, name, file->real, flags, outFlags);
+    if (rc != SQLITE_OK) {
+        file->real->pMethods = 0;
+        return rc;
+    }
+    file->base.pMethods = file->real->pMethods->iVersion >= 2 ? &g_methodsV2 : &g_methodsV1;
+    return SQLITE_OK;
+}
+
+static int ioDelete(sqlite3_vfs *, const char *name, int syncDir)
+{
+    {
+        QMutexLocker locker(&g_lock);
+        ++counters().deletes;
+    }
+    return g_root->xDelete(g_root, name, syncDir);
+}
+
+static int ioAccess(sqlite3_vfs *, const char *name, int flags, int *result)
+{
+    return g_root->xAccess(g_root, name, flags, result);
+}
+
+static int ioFullPathname(sqlite3_vfs *, const char *name, int n, char *out)
+{
+    return g_root->xFullPathname(g_root, name, n, out);
+}
+
+static void *ioDlOpen(sqlite3_vfs *, const char *name)
+{
+    return g_root->xDlOpen(g_root, name);
+}
+
+static void ioDlError(sqlite3_vfs *, int n, char *message)
+{
+    g_root->xDlError(g_root, n, message);
+}
+
+static void (*ioDlSym(sqlite3_vfs *, void *handle, const char *symbol))(void)
+{
+    return g_root->xDlSym(g_root, handle, symbol);
+}
+
+static void ioDlClose(sqlite3_vfs *, void *handle)
+{
+    g_root->xDlClose(g_root, handle);
+}
+
+static int ioRandomness(sqlite3_vfs *, int n, char *out)
+{
+    return g_root->xRandomness(g_root, n, out);
+}
+
+static int ioSleep(sqlite3_vfs *, int microseconds)
+{
+    return g_root->xSleep(g_root, microseconds);
+}
+
+static int ioCurrentTime(sqlite3_vfs *, double *now)
+{
+    return g_root->xCurrentTime(g_root, now);
+}
+
+static int ioGetLastError(sqlite3_vfs *, int n, char *message)
+{
+    return g_root->xGetLastError ? g_root->xGetLastError(g_root, n, message) : 0;
+}
+
+static sqlite3_vfs g_vfs;
+
+// -----------------------------------------------------------------------------------------------
+// IoVfs
+
+bool IoVfs::install()
+{
+    if (g_root)
+        return true;
+
+    sqlite3_vfs *root = sqlite3_vfs_find(0);
+    if (!root)
+        return false;
+
+    memset(&g_vfs, 0, sizeof(g_vfs));
+    g_vfs.iVersion = 1;
+    g_vfs.szOsFile = int(sizeof(IoFile)) + root->szOsFile;
+    g_vfs.mxPathname = root->mxPathname;
+    g_vfs.zName = IO_VFS_NAME;
+    g_vfs.xOpen = ioOpen;
+    g_vfs.xDelete = ioDelete;
+    g_vfs.xAccess = ioAccess;
+    g_vfs.xFullPathname = ioFullPathname;
+    g_vfs.xDlOpen = ioDlOpen;
+    g_vfs.xDlError = ioDlError;
+    g_vfs.xDlSym = ioDlSym;
+    g_vfs.xDlClose = ioDlClose;
+    g_vfs.xRandomness = ioRandomness;
+    g_vfs.xSleep = ioSleep;
+    g_vfs.xCurrentTime = ioCurrentTime;
+    g_vfs.xGetLastError = ioGetLastError;
+
+    g_root = root;
+    if (sqlite3_vfs_register(&g_vfs, 1) != SQLITE_OK) {
+        g_root = 0;
+        return false;
+    }
+    return true;
+}
+
+bool IoVfs::isInstalled()
+{
+    return g_root != 0;
+}
+
+QMap<QString, IoCounters> IoVfs::totals()
+{
+    QMutexLocker locker(&g_lock);
+    QMap<QString, IoCounters> totals;
+    for (int i = 0; i < g_tagCount; ++i)
+        totals.insert(QString::fromLatin1(g_tags[i]), g_counters[i]);
+    return totals;
+}
+
+void IoVfs::reset()
+{
+    // The tags stay, since scopes that are open may still hold their slots.
+    QMutexLocker locker(&g_lock);
+    for (int i = 0; i < g_tagCount; ++i)
+        g_counters[i] = IoCounters();
+}
+
+QByteArray IoVfs::toJson(const QMap<QString, IoCounters> &totals)
+{
+    QByteArray json = "{";
+    for (QMap<QString, IoCounters>::const_iterator it = totals.constBegin(); it != totals.constEnd(); ++it) {
+        const IoCounters &io = it.value();
+        if (it != totals.constBegin())
+            json += ',';
+        // Tags are identifiers; quotes and backslashes are all that need escaping.
+        QByteArray tag = it.key().toUtf8();
+        tag.replace('\\', "\\\\").replace('"', "\\\"");
+        json += '"' + tag + "\":{\"operations\":" + QByteArray::number(io.operations)
+              + ",\"opens\":" + QByteArray::number(io.opens)
+              + ",\"reads\":" + QByteArray::number(io.reads)
+              + ",\"readBytes\":" + QByteArray::number(io.readBytes)
+              + ",\"writes\":" + QByteArray::number(io.writes)
+              + ",\"writeBytes\":" + QByteArray::number(io.writeBytes)
+              + ",\"journalWriteBytes\":" + QByteArray::number(io.journalWriteBytes)
+              + ",\"syncs\":" + QByteArray::number(io.syncs)
+              + ",\"truncates\":" + QByteArray::number(io.truncates)
+              + ",\"deletes\":" + QByteArray::number(io.deletes) + '}';
+    }
+    json += '}';
+    return json;
+}
+
+// -----------------------------------------------------------------------------------------------
+// IoScope
+
+IoScope::IoScope(const char *tag)
+{
+    IoThread *current = thread();
+    m_previous = current->slot;
+
+    QMutexLocker locker(&g_lock);
+    current->slot = slotFor(tag);
+    ++g_counters[current->slot].operations;
+}
+
+IoScope::~IoScope()
+{
+    thread()->slot = m_previous;
+}
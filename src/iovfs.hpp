@@ -0,0 +1,89 @@
+/*
+ * iovfs.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef IOVFS_HPP_
+#define IOVFS_HPP_
+
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+
+// I/O of threads outside any IoScope is counted under this tag.
+#define IO_UNTAGGED "untagged"
+// Tags beyond this many are counted as IO_UNTAGGED.
+#define IO_MAX_TAGS 64
+
+struct IoCounters
+{
+    IoCounters()
+        : operations(0), opens(0), reads(0), readBytes(0), writes(0), writeBytes(0)
+        , journalWriteBytes(0), syncs(0), truncates(0), deletes(0) {}
+
+    qint64 operations;          // IoScopes entered with the tag
+    qint64 opens;
+    qint64 reads;
+    qint64 readBytes;
+    qint64 writes;
+    qint64 writeBytes;
+    qint64 journalWriteBytes;   // the part of writeBytes that went to -wal and -journal files
+    qint64 syncs;
+    qint64 truncates;
+    qint64 deletes;
+};
+
+/*
+ * @brief SQLite VFS that counts the file I/O of each operation.
+ *
+ * install() registers the VFS as the default, on top of the current default,
+ * and passes every call straight through. Opens, reads, writes, bytes, syncs,
+ * truncates and deletes are added to the counters of the tag set by the
+ * innermost IoScope on the calling thread, so the I/O that SQLite does for a
+ * query is charged to the operation that ran it:
+ *
+ *   IoScope io("addRecord");
+ *   ...
+ *   IoVfs::totals()["addRecord"].writeBytes / .operations
+ *
+ * is what one entry costs on flash, journal and checkpoints included. Install
+ * it before CryptoVfs, so it counts what reaches the disk: whole encrypted
+ * blocks, headers and all.
+ *
+ * Memory-mapped I/O is not offered, since its reads would not be counted.
+ */
+class IoVfs
+{
+public:
+    static bool install();
+    static bool isInstalled();
+
+    // By tag, since install() or the last reset().
+    static QMap<QString, IoCounters> totals();
+    static void reset();
+
+    // {"addRecord":{"operations":12,"opens":0,...},...} for benchmark reports.
+    static QByteArray toJson(const QMap<QString, IoCounters> &totals);
+};
+
+/*
+ * @brief Charges the I/O of the calling thread to 'tag' while in scope.
+ *
+ * 'tag' must outlive the scope; a string literal is the usual choice. Scopes
+ * nest, and the I/O goes to the innermost one.
+ */
+class IoScope
+{
+public:
+    explicit IoScope(const char *tag);
+    ~IoScope();
+
+private:
+    Q_DISABLE_COPY(IoScope)
+
+    int m_previous;
+};
+
+#endif /* IOVFS_HPP_ */
@@ -0,0 +1,353 @@
+/*
+ * journalencryption.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "journalencryption.hpp"
+#include "cryptovfs.hpp"
+#include "iovfs.hpp"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QThread>
+
+#include <sqlite3.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define ENCRYPTION_BACKUP_PAGES 64
+#define ENCRYPTION_LOCKED_PAGES 256      // the tail that is copied under a read lock
+#define ENCRYPTION_REKEY_BLOCKS 256
+#define ENCRYPTION_RETRY_MS 50
+#define ENCRYPTION_BUSY_TIMEOUT 5000
+#define ENCRYPTION_DIGEST_BLOCK (64 * 1024)
+
+// -----------------------------------------------------------------------------------------------
+// Helpers
+
+static QString copyPath(const QString &databaseName)
+{
+    return databaseName + ".enc";
+}
+
+static QString readyPath(const QString &databaseName)
+{
+    return databaseName + ".enc.ready";
+}
+
+// A digest of the plaintext database file. The change counter in its header
+// would be cheaper, but commits to a write-ahead log do not always bump it.
+static bool fileDigest(const QString &fileName, QByteArray *digest)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QByteArray block;
+    while (!(block = file.read(ENCRYPTION_DIGEST_BLOCK)).isEmpty())
+        hash.addData(block);
+    if (file.error() != QFile::NoError)
+        return false;
+    *digest = hash.result().toHex();
+    return true;
+}
+
+static bool hasHotJournal(const QString &databaseName)
+{
+    return QFileInfo(databaseName + "-journal").size() > 0
+        || QFileInfo(databaseName + "-wal").size() > 0;
+}
+
+// -----------------------------------------------------------------------------------------------
+// JournalEncryption
+
+JournalEncryption::JournalEncryption(const QString &databaseName, QObject *parent)
+    : QObject(parent)
+    , m_databaseName(databaseName)
+    , m_thread(0)
+    , m_worker(0)
+{
+}
+
+JournalEncryption::~JournalEncryption()
+{
+    stop();
+}
+
+bool JournalEncryption::isRunning() const
+{
+    return m_thread && m_thread->isRunning();
+}
+
+void JournalEncryption::encrypt()
+{
+    start(Encrypt);
+}
+
+void JournalEncryption::rekey()
+{
+    start(Rekey);
+}
+
+void JournalEncryption::start(Task task)
+{
+    if (isRunning())
+        return;
+    stop();
+
+    m_thread = new QThread(this);
+    m_worker = new EncryptionWorker(m_databaseName, task);
+    m_worker->moveToThread(m_thread);
+
+    connect(m_thread, SIGNAL(started()), m_worker, SLOT(run()));
+    connect(m_worker, SIGNAL(finished(int, bool)), m_thread, SLOT(quit()));
+    connect(m_worker, SIGNAL(progress(int, qint64, qint64)), this, SIGNAL(progress(int, qint64, qint64)));
+    connect(m_worker, SIGNAL(finished(int, bool)), this, SIGNAL(finished(int, bool)));
+    connect(m_worker, SIGNAL(error(const QString&)), this, SIGNAL(error(const QString&)));
+
+    m_thread->start(QThread::LowPriority);
+}
+
+void JournalEncryption::stop()
+{
+    if (!m_thread)
+        return;
+
+    m_worker->stop();
+    m_thread->quit();
+    m_thread->wait();
+
+    delete m_worker;
+    m_worker = 0;
+    delete m_thread;
+    m_thread = 0;
+}
+
+bool JournalEncryption::finishConversion(const QString &databaseName)
+{
+    const QString copy = copyPath(databaseName);
+    const QString ready = readyPath(databaseName);
+    if (!QFile::exists(copy)) {
+        QFile::remove(ready);
+        return false;
+    }
+
+    // The copy is only good if no commit reached the journal after it was taken.
+    bool current = false;
+    QFile marker(ready);
+    if (marker.open(QIODevice::ReadOnly)) {
+        const QByteArray expected = marker.readAll().trimmed();
+        QByteArray digest;
+        current = !expected.isEmpty() && !hasHotJournal(databaseName) && CryptoVfs::isEncrypted(copy)
+                  && fileDigest(databaseName, &digest) && digest == expected;
+        marker.close();
+    }
+
+    if (!current
+        || ::rename(QFile::encodeName(copy).constData(),
+                    QFile::encodeName(databaseName).constData()) != 0) {
+        // Taken again by the next encrypt().
+        QFile::remove(copy);
+        QFile::remove(ready);
+        return false;
+    }
+    QFile::remove(ready);
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+// EncryptionWorker
+
+EncryptionWorker::EncryptionWorker(const QString &databaseName, JournalEncryption::Task task)
+    : m_databaseName(databaseName)
+    , m_task(task)
+    , m_stopRequested(0)
+{
+}
+
+void EncryptionWorker::stop()
+{
+    m_stopRequested.fetchAndStoreOrdered(1);
+}
+
+void EncryptionWorker::run()
+{
+    IoScope io("encryption");
+    bool complete = false;
+    if (!CryptoVfs::hasKeys()) {
+        emit error(tr("The journal keys are not loaded"));
+    } else if (m_task == JournalEncryption::Encrypt) {
+        complete = encrypt();
+    } else {
+        complete = rekey();
+    }
+    emit finished(m_task, complete);
+}
+
+bool EncryptionWorker::encrypt()
+{
+    const QString partName = copyPath(m_databaseName) + ".part";
+    QFile::remove(partName);
+    QFile::remove(partName + "-journal");
+
+    // Opened after the keys are loaded, so the new file is created encrypted.
+    sqlite3 *source = 0;
+    sqlite3 *copy = 0;
+    // Read-write only so that it can checkpoint the write-ahead log below.
+    if (sqlite3_open_v2(QFile::encodeName(m_databaseName).constData(), &source,
+                        SQLITE_OPEN_READWRITE, 0) != SQLITE_OK
+        || sqlite3_open_v2(QFile::encodeName(partName).constData(), &copy,
+                           SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, 0) != SQLITE_OK) {
+        emit error(tr("Encryption could not open the journal: %1")
+                   .arg(sqlite3_errmsg(copy ? copy : source)));
+        sqlite3_close(source);
+        sqlite3_close(copy);
+        return false;
+    }
+    sqlite3_busy_timeout(source, ENCRYPTION_BUSY_TIMEOUT);
+
+    sqlite3_backup *backup = sqlite3_backup_init(copy, "main", source, "main");
+    if (!backup) {
+        emit error(tr("Encryption failed: %1").arg(sqlite3_errmsg(copy)));
+        sqlite3_close(source);
+        sqlite3_close(copy);
+        return false;
+    }
+
+    // 1. Most of the pages, a step at a time, without holding any lock in between.
+    //    A commit by the app makes the backup start over.
+    int rc = sqlite3_backup_step(backup, 0);
+    while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+        if (m_stopRequested)
+            break;
+        if (rc != SQLITE_OK)
+            sqlite3_sleep(ENCRYPTION_RETRY_MS);
+        if (sqlite3_backup_remaining(backup) <= ENCRYPTION_LOCKED_PAGES)
+            break;
+        rc = sqlite3_backup_step(backup, ENCRYPTION_BACKUP_PAGES);
+        emit progress(JournalEncryption::Encrypt,
+                      sqlite3_backup_pagecount(backup) - sqlite3_backup_remaining(backup),
+                      sqlite3_backup_pagecount(backup));
+    }
+
+    // 2. The tail inside a read transaction, so the digest recorded below
+    //    belongs to exactly the pages that were copied. With the log
+    //    checkpointed and empty, the read transaction keeps the database file
+    //    itself unchanged: nothing newer can be checkpointed into it meanwhile.
+    QByteArray digest;
+    bool ok = false;
+    if (!m_stopRequested && (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+        && sqlite3_exec(source, "PRAGMA wal_checkpoint(TRUNCATE)", 0, 0, 0) == SQLITE_OK
+        && sqlite3_exec(source, "BEGIN; SELECT COUNT(*) FROM sqlite_master", 0, 0, 0) == SQLITE_OK) {
+        if (QFileInfo(m_databaseName + "-wal").size() == 0) {
+            rc = sqlite3_backup_step(backup, -1);
+            ok = rc == SQLITE_DONE && fileDigest(m_databaseName, &digest);
+        }
+        sqlite3_exec(source, "COMMIT", 0, 0, 0);
+    }
+
+    const int finishRc = sqlite3_backup_finish(backup);
+    if (ok && finishRc != SQLITE_OK)
+        ok = false;
+    // The copy gets the header of a journal kept in write-ahead log mode, which
+    // the encrypting VFS does not support; see SqliteStorage::open().
+    if (ok && sqlite3_exec(copy, "PRAGMA journal_mode = DELETE", 0, 0, 0) != SQLITE_OK)
+        ok = false;
+    const QString errorText = sqlite3_errmsg(copy);
+    sqlite3_close(copy);
+    sqlite3_close(source);
+
+    if (!ok) {
+        QFile::remove(partName);
+        if (!m_stopRequested)
+            emit error(tr("Encryption failed: %1").arg(errorText));
+        return false;
+    }
+
+    // 3. The marker first; the rename makes the copy visible to finishConversion().
+    QFile ready(readyPath(m_databaseName));
+    if (!ready.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        || ready.write(digest) < 0 || !ready.flush()) {
+        emit error(tr("Encryption failed writing %1").arg(ready.fileName()));
+        return false;
+    }
+    ready.close();
+
+    if (::rename(QFile::encodeName(partName).constData(),
+                 QFile::encodeName(copyPath(m_databaseName)).constData()) != 0) {
+        emit error(tr("Encryption failed renaming %1").arg(partName));
+        return false;
+    }
+    emit progress(JournalEncryption::Encrypt, 1, 1);
+    return true;
+}
+
+bool EncryptionWorker::rekey()
+{
+    // The journal and whatever else lives beside it (year shards, ...).
+    const QDir directory = QFileInfo(m_databaseName).absoluteDir();
+    const QStringList names = directory.entryList(QStringList() << "*.db", QDir::Files, QDir::Name);
+
+    QStringList files;
+    qint64 total = 0;
+    for (int i = 0; i < names.size(); ++i) {
+        const QString fileName = directory.filePath(names.at(i));
+        if (CryptoVfs::isEncrypted(fileName)) {
+            files << fileName;
+            total += QFileInfo(fileName).size();
+        }
+    }
+
+    qint64 done = 0;
+    for (int i = 0; i < files.size(); ++i) {
+        if (m_stopRequested || !rekeyFile(files.at(i), done, total))
+            return false;
+    }
+    emit progress(JournalEncryption::Rekey, total, total);
+    return true;
+}
+
+bool EncryptionWorker::rekeyFile(const QString &fileName, qint64 &done, qint64 total)
+{
+    sqlite3 *database = 0;
+    if (sqlite3_open_v2(QFile::encodeName(fileName).constData(), &database,
+                        SQLITE_OPEN_READWRITE, 0) != SQLITE_OK) {
+        emit error(tr("Rekey could not open %1: %2").arg(fileName).arg(sqlite3_errmsg(database)));
+        sqlite3_close(database);
+        return false;
+    }
+    sqlite3_busy_timeout(database, ENCRYPTION_BUSY_TIMEOUT);
+
+    CryptRekeyStep step;
+    memset(&step, 0, sizeof(step));
+    bool ok = true;
+    while (ok && !step.pastEnd && !m_stopRequested) {
+        // Nobody reads a block while it is being rewritten.
+        int rc = sqlite3_exec(database, "BEGIN EXCLUSIVE", 0, 0, 0);
+        if (rc == SQLITE_BUSY) {
+            sqlite3_sleep(ENCRYPTION_RETRY_MS);
+            continue;
+        }
+        if (rc == SQLITE_OK) {
+            step.blockCount = ENCRYPTION_REKEY_BLOCKS;
+            rc = sqlite3_file_control(database, "main", CRYPT_FCNTL_REKEY, &step);
+            sqlite3_exec(database, "COMMIT", 0, 0, 0);
+        }
+        if (rc != SQLITE_OK) {
+            emit error(tr("Rekey failed on %1: error %2").arg(fileName).arg(rc));
+            ok = false;
+            break;
+        }
+
+        step.firstBlock += step.blockCount;
+        done += qint64(step.blockCount) * step.blockSize;
+        emit progress(JournalEncryption::Rekey, qMin(done, total), total);
+    }
+    sqlite3_close(database);
+    return ok && step.pastEnd;
+}
@@ -0,0 +1,95 @@
+/*
+ * journalencryption.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef JOURNALENCRYPTION_HPP_
+#define JOURNALENCRYPTION_HPP_
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QString>
+
+class QThread;
+class EncryptionWorker;
+
+/*
+ * @brief Converts the journal to encrypted pages and rekeys it, in the background.
+ *
+ * Both need the keys loaded into CryptoVfs (see JournalKeys).
+ *
+ *  - encrypt()  copies the plaintext journal into "<db>.enc" with the SQLite
+ *               online backup API, ENCRYPTION_BACKUP_PAGES pages per step so
+ *               the UI keeps working. The copy is taken over at the next
+ *               start by finishConversion(), before any connection opens the
+ *               journal, unless the journal was written to after the copy.
+ *  - rekey()    re-encrypts, in place, every block of the encrypted databases
+ *               in the journal's directory that is not under the current key.
+ *               Each run of ENCRYPTION_REKEY_BLOCKS blocks is done under an
+ *               exclusive lock and is crash safe (see CryptoVfs). This relies
+ *               on the rollback journal; in WAL mode the lock would not keep
+ *               readers out.
+ */
+class JournalEncryption : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Task { Encrypt, Rekey };
+
+    JournalEncryption(const QString &databaseName, QObject *parent = 0);
+    ~JournalEncryption();
+
+    bool isRunning() const;
+
+    void encrypt();
+    void rekey();
+    void stop();
+
+    // Swaps a finished "<db>.enc" in for the plaintext journal. Returns true if it did.
+    static bool finishConversion(const QString &databaseName);
+
+Q_SIGNALS:
+    void progress(int task, qint64 done, qint64 total);
+    // 'complete' is false when the task was stopped before the end.
+    void finished(int task, bool complete);
+    void error(const QString &message);
+
+private:
+    void start(Task task);
+
+    QString m_databaseName;
+    QThread *m_thread;
+    EncryptionWorker *m_worker;
+};
+
+class EncryptionWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    EncryptionWorker(const QString &databaseName, JournalEncryption::Task task);
+
+    void stop();
+
+public Q_SLOTS:
+    void run();
+
+Q_SIGNALS:
+    void progress(int task, qint64 done, qint64 total);
+    void finished(int task, bool complete);
+    void error(const QString &message);
+
+private:
+    bool encrypt();
+    bool rekey();
+    bool rekeyFile(const QString &fileName, qint64 &done, qint64 total);
+
+    QString m_databaseName;
+    JournalEncryption::Task m_task;
+    QAtomicInt m_stopRequested;
+};
+
+#endif /* JOURNALENCRYPTION_HPP_ */
@@ -0,0 +1,516 @@
+/*
+ * journalexporter.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "journalexporter.hpp"
+#include "iovfs.hpp"
+
+#include <QFileInfo>
+#include <QHash>
+#include <QMap>
+#include <QStringList>
+#include <QThread>
+#include <QtEndian>
+#include <QtSql/QtSql>
+
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define EXPORT_CONNECTION "DWriter-export"
+#define EXPORT_PAGE_ROWS 500
+#define EXPORT_BLOCK_BYTES (256 * 1024)
+
+static const char ARCHIVE_MAGIC[4] = { 'D', 'W', 'A', '1' };
+
+enum ArchiveMemberType
+{
+    EntriesMember = 'E',
+    AttachmentMember = 'A'
+};
+
+struct ManifestChunk
+{
+    qint64 firstEventId;
+    qint64 lastEventId;
+    qint64 offset;
+    qint64 length;
+    quint32 crc;
+    int rows;
+};
+
+// -----------------------------------------------------------------------------------------------
+// Helpers
+
+static QString manifestPath(const QString &fileName)
+{
+    return fileName + ".manifest";
+}
+
+static bool isArchive(const QString &fileName)
+{
+    return QFileInfo(fileName).suffix().toLower() == "dwa";
+}
+
+static QByteArray jsonString(const QString &text)
+{
+    QByteArray out;
+    out.reserve(text.size() + 2);
+    out += '"';
+    for (int i = 0; i < text.size(); ++i) {
+        const ushort c = text.at(i).unicode();
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n";  break;
+        case '\r': out += "\\r";  break;
+        case '\t': out += "\\t";  break;
+        default:
+            if (c < 0x20) {
+                out += "\\u" + QByteArray::number(c, 16).rightJustified(4, '0');
+            } else if (c < 0x80) {
+                out += char(c);
+            } else {
+                // Surrogate pairs are kept together so they encode as one code point.
+                int length = 1;
+                if (text.at(i).isHighSurrogate() && i + 1 < text.size())
+                    length = 2;
+                out += text.mid(i, length).toUtf8();
+                i += length - 1;
+            }
+        }
+    }
+    out += '"';
+    return out;
+}
+
+static quint32 crcOfRange(QFile &file, qint64 offset, qint64 length)
+{
+    quint32 crc = crc32(0, 0, 0);
+    file.seek(offset);
+    while (length > 0) {
+        const QByteArray block = file.read(qMin<qint64>(length, EXPORT_BLOCK_BYTES));
+        if (block.isEmpty())
+            break;
+        crc = crc32(crc, reinterpret_cast<const Bytef *>(block.constData()), block.size());
+        length -= block.size();
+    }
+    return length == 0 ? crc : ~crc;
+}
+
+static QList<ManifestChunk> readManifest(const QString &fileName)
+{
+    QList<ManifestChunk> chunks;
+    QFile manifest(manifestPath(fileName));
+    if (!manifest.open(QIODevice::ReadOnly))
+        return chunks;
+
+    while (!manifest.atEnd()) {
+        const QList<QByteArray> fields = manifest.readLine().trimmed().split(' ');
+        if (fields.size() != 6)
+            break; // a torn last line
+        ManifestChunk chunk;
+        chunk.firstEventId = fields.at(0).toLongLong();
+        chunk.lastEventId = fields.at(1).toLongLong();
+        chunk.offset = fields.at(2).toLongLong();
+        chunk.length = fields.at(3).toLongLong();
+        chunk.crc = fields.at(4).toUInt(0, 16);
+        chunk.rows = fields.at(5).toInt();
+        chunks << chunk;
+    }
+    return chunks;
+}
+
+static QByteArray manifestLine(const ManifestChunk &chunk)
+{
+    return QString("%1 %2 %3 %4 %5 %6\n").arg(chunk.firstEventId).arg(chunk.lastEventId)
+           .arg(chunk.offset).arg(chunk.length).arg(chunk.crc, 8, 16, QChar('0'))
+           .arg(chunk.rows).toLatin1();
+}
+
+/*
+ * Appends the bytes of one chunk to the export file and keeps its running
+ * length and crc32 for the manifest.
+ */
+class ChunkWriter
+{
+public:
+    ChunkWriter(QFile &file) : m_file(file), m_crc(crc32(0, 0, 0)), m_length(0) {}
+
+    bool write(const QByteArray &bytes)
+    {
+        if (m_file.write(bytes) != bytes.size())
+            return false;
+        m_crc = crc32(m_crc, reinterpret_cast<const Bytef *>(bytes.constData()), bytes.size());
+        m_length += bytes.size();
+        return true;
+    }
+
+    // Archive member: magic, type, name, block index, last flag, raw length,
+    // stored length, crc32 of the raw bytes, then the zlib-compressed bytes.
+    bool writeMember(char type, const QString &name, quint32 block, bool last, const QByteArray &raw)
+    {
+        const QByteArray encodedName = name.toUtf8();
+        const QByteArray stored = qCompress(raw);
+
+        QByteArray header;
+        header.resize(4 + 1 + 2 + encodedName.size() + 4 + 1 + 4 + 4 + 4);
+        uchar *p = reinterpret_cast<uchar *>(header.data());
+        memcpy(p, ARCHIVE_MAGIC, 4);                                  p += 4;
+        *p++ = uchar(type);
+        qToLittleEndian<quint16>(encodedName.size(), p);              p += 2;
+        memcpy(p, encodedName.constData(), encodedName.size());       p += encodedName.size();
+        qToLittleEndian<quint32>(block, p);                           p += 4;
+        *p++ = last ? 1 : 0;
+        qToLittleEndian<quint32>(raw.size(), p);                      p += 4;
+        qToLittleEndian<quint32>(stored.size(), p);                   p += 4;
+        qToLittleEndian<quint32>(crc32(0, reinterpret_cast<const Bytef *>(raw.constData()), raw.size()), p);
+
+        return write(header) && write(stored);
+    }
+
+    quint32 crc() const { return m_crc; }
+    qint64 length() const { return m_length; }
+
+private:
+    QFile &m_file;
+    quint32 m_crc;
+    qint64 m_length;
+};
+
+// -----------------------------------------------------------------------------------------------
+// JournalExporter
+
+JournalExporter::JournalExporter(const QString &databaseName, QObject *parent)
+    : QObject(parent)
+    , m_databaseNames(QStringList() << databaseName)
+    , m_thread(0)
+    , m_worker(0)
+{
+}
+
+JournalExporter::JournalExporter(const QStringList &databaseNames, QObject *parent)
+    : QObject(parent)
+    , m_databaseNames(databaseNames)
+    , m_thread(0)
+    , m_worker(0)
+{
+}
+
+JournalExporter::~JournalExporter()
+{
+    stop();
+}
+
+bool JournalExporter::isRunning() const
+{
+    return m_thread && m_thread->isRunning();
+}
+
+void JournalExporter::start(const QString &fileName)
+{
+    if (isRunning())
+        return;
+    stop();
+
+    m_thread = new QThread(this);
+    m_worker = new ExportWorker(m_databaseNames, fileName);
+    m_worker->moveToThread(m_thread);
+
+    connect(m_thread, SIGNAL(started()), m_worker, SLOT(run()));
+    connect(m_worker, SIGNAL(finished(const QString&, int)), m_thread, SLOT(quit()));
+    connect(m_worker, SIGNAL(error(const QString&)), m_thread, SLOT(quit()));
+    connect(m_worker, SIGNAL(progress(int, int)), this, SIGNAL(progress(int, int)));
+    connect(m_worker, SIGNAL(finished(const QString&, int)), this, SIGNAL(finished(const QString&, int)));
+    connect(m_worker, SIGNAL(error(const QString&)), this, SIGNAL(error(const QString&)));
+
+    m_thread->start(QThread::LowPriority);
+}
+
+void JournalExporter::stop()
+{
+    if (!m_thread)
+        return;
+
+    m_worker->stop();
+    m_thread->quit();
+    m_thread->wait();
+
+    delete m_worker;
+    m_worker = 0;
+    delete m_thread;
+    m_thread = 0;
+}
+
+bool JournalExporter::verify(const QString &fileName, QString *errorText)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorText)
+            *errorText = file.errorString();
+        return false;
+    }
+
+    const QList<ManifestChunk> chunks = readManifest(fileName);
+    qint64 expectedOffset = 0;
+    for (int i = 0; i < chunks.size(); ++i) {
+        const ManifestChunk &chunk = chunks.at(i);
+        if (chunk.offset != expectedOffset
+            || crcOfRange(file, chunk.offset, chunk.length) != chunk.crc) {
+            if (errorText)
+                *errorText = QString("Chunk %1 (eventID %2 to %3) is damaged")
+                             .arg(i).arg(chunk.firstEventId).arg(chunk.lastEventId);
+            return false;
+        }
+        expectedOffset += chunk.length;
+    }
+    if (expectedOffset != file.size()) {
+        if (errorText)
+            *errorText = QString("%1 bytes after the last chunk").arg(file.size() - expectedOffset);
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+// ExportWorker
+
+ExportWorker::ExportWorker(const QStringList &databaseNames, const QString &fileName)
+    : m_databaseNames(databaseNames)
+    , m_fileName(fileName)
+    , m_stopRequested(0)
+    , m_rows(0)
+{
+}
+
+void ExportWorker::stop()
+{
+    m_stopRequested.fetchAndStoreOrdered(1);
+}
+
+QString ExportWorker::connectionName(int file)
+{
+    return QString("%1-%2").arg(EXPORT_CONNECTION).arg(file);
+}
+
+void ExportWorker::run()
+{
+    IoScope io("export");
+    bool ok = !m_databaseNames.isEmpty();
+    if (!ok)
+        emit error(tr("Export has no database to read"));
+    for (int i = 0; ok && i < m_databaseNames.size(); ++i) {
+        QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", connectionName(i));
+        database.setDatabaseName(m_databaseNames.at(i));
+        database.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000");
+
+        ok = database.open();
+        if (!ok)
+            emit error(tr("Export could not open the database: %1").arg(database.lastError().text()));
+    }
+    ok = ok && exportPages();
+
+    for (int i = 0; i < m_databaseNames.size(); ++i) {
+        if (!QSqlDatabase::contains(connectionName(i)))
+            break;
+        {
+            QSqlDatabase database = QSqlDatabase::database(connectionName(i), false);
+            database.close();
+        }
+        QSqlDatabase::removeDatabase(connectionName(i));
+    }
+
+    // A failed export has reported its error() and is not finished.
+    if (ok)
+        emit finished(m_fileName, m_rows);
+}
+
+bool ExportWorker::exportPages()
+{
+    const bool archive = isArchive(m_fileName);
+
+    QFile out(m_fileName);
+    if (!out.open(QIODevice::ReadWrite)) {
+        emit error(tr("Cannot write %1: %2").arg(m_fileName).arg(out.errorString()));
+        return false;
+    }
+
+    // 1. Resume after the last chunk that is still intact; drop anything after it.
+    QList<ManifestChunk> chunks = readManifest(m_fileName);
+    while (!chunks.isEmpty()
+           && crcOfRange(out, chunks.last().offset, chunks.last().length) != chunks.last().crc)
+        chunks.removeLast();
+
+    qint64 lastEventId = 0;
+    qint64 end = 0;
+    QByteArray manifestBytes;
+    for (int i = 0; i < chunks.size(); ++i) {
+        lastEventId = chunks.at(i).lastEventId;
+        end = chunks.at(i).offset + chunks.at(i).length;
+        m_rows += chunks.at(i).rows;
+        manifestBytes += manifestLine(chunks.at(i));
+    }
+    out.resize(end);
+    out.seek(end);
+
+    QFile manifest(manifestPath(m_fileName));
+    if (!manifest.open(QIODevice::WriteOnly | QIODevice::Truncate) || manifest.write(manifestBytes) < 0) {
+        emit error(tr("Cannot write %1: %2").arg(manifest.fileName()).arg(manifest.errorString()));
+        return false;
+    }
+    manifest.flush();
+
+    // A page and an attachment query on every file.
+    int total = 0;
+    QList<QSqlQuery> pages;
+    QList<QSqlQuery> attachmentQueries;
+    for (int i = 0; i < m_databaseNames.size(); ++i) {
+        QSqlDatabase database = QSqlDatabase::database(connectionName(i));
+        QSqlQuery count(database);
+        if (count.exec("SELECT COUNT(*) FROM events WHERE deletedAt IS NULL") && count.next())
+            total += count.value(0).toInt();
+
+        QSqlQuery page(database);
+        page.setForwardOnly(true);
+        page.prepare("SELECT eventID, timeStamp, createdAt, textEvent FROM events "
+                     "WHERE eventID > ? AND deletedAt IS NULL ORDER BY eventID LIMIT ?");
+        pages << page;
+
+        QSqlQuery attachments(database);
+        attachments.setForwardOnly(true);
+        attachments.prepare("SELECT eventID, kind, path, sha1 FROM attachments "
+                            "WHERE eventID BETWEEN ? AND ? ORDER BY eventID, attachmentID");
+        attachmentQueries << attachments;
+    }
+    emit progress(m_rows, total);
+
+    // 2. One keyset page per chunk. Only the current page is held in memory.
+    while (!m_stopRequested) {
+        // The pages of all files merged by eventID; rows after the first
+        // EXPORT_PAGE_ROWS are read again for the next chunk.
+        QMap<qint64, QByteArray> merged;
+        for (int i = 0; i < pages.size(); ++i) {
+            QSqlQuery &page = pages[i];
+            page.addBindValue(lastEventId);
+            page.addBindValue(EXPORT_PAGE_ROWS);
+            if (!page.exec()) {
+                emit error(tr("Export failed: %1").arg(page.lastError().text()));
+                return false;
+            }
+            while (page.next()) {
+                const qint64 eventId = page.value(0).toLongLong();
+                merged.insert(eventId, "{\"eventID\":" + QByteArray::number(eventId)
+                                       + ",\"timestamp\":" + jsonString(page.value(1).toString())
+                                       + ",\"createdAt\":" + QByteArray::number(page.value(2).toLongLong())
+                                       + ",\"text\":" + jsonString(page.value(3).toString()));
+            }
+            page.finish();
+        }
+        while (merged.size() > EXPORT_PAGE_ROWS)
+            merged.erase(--merged.end());
+
+        ManifestChunk chunk;
+        chunk.firstEventId = -1;
+        chunk.offset = out.pos();
+        chunk.rows = 0;
+
+        QList<QByteArray> lines;
+        QList<QByteArray> attachmentLists;
+        QHash<qint64, int> lineOfEvent;
+        QMap<qint64, QByteArray>::const_iterator row;
+        for (row = merged.constBegin(); row != merged.constEnd(); ++row) {
+            if (chunk.firstEventId < 0)
+                chunk.firstEventId = row.key();
+            chunk.lastEventId = row.key();
+            ++chunk.rows;
+
+            lineOfEvent.insert(row.key(), lines.size());
+            lines << row.value();
+            attachmentLists << QByteArray();
+        }
+        merged.clear();
+        if (chunk.rows == 0)
+            break;
+
+        // Attachments of the page; 'files' keeps eventID, path and sha1 for the archive.
+        QList<QStringList> files;
+        for (int i = 0; i < attachmentQueries.size(); ++i) {
+            QSqlQuery &attachments = attachmentQueries[i];
+            attachments.addBindValue(chunk.firstEventId);
+            attachments.addBindValue(chunk.lastEventId);
+            if (!attachments.exec()) {
+                emit error(tr("Export failed: %1").arg(attachments.lastError().text()));
+                return false;
+            }
+            while (attachments.next()) {
+                const qint64 eventId = attachments.value(0).toLongLong();
+                if (!lineOfEvent.contains(eventId))
+                    continue;
+
+                QByteArray &list = attachmentLists[lineOfEvent.value(eventId)];
+                if (!list.isEmpty())
+                    list += ",";
+                list += "{\"kind\":" + jsonString(attachments.value(1).toString())
+                      + ",\"path\":" + jsonString(attachments.value(2).toString())
+                      + ",\"sha1\":" + jsonString(attachments.value(3).toString()) + "}";
+                files << (QStringList() << QString::number(eventId)
+                                        << attachments.value(2).toString()
+                                        << attachments.value(3).toString());
+            }
+            attachments.finish();
+        }
+
+        QByteArray json;
+        for (int i = 0; i < lines.size(); ++i) {
+            json += lines.at(i);
+            if (!attachmentLists.at(i).isEmpty())
+                json += ",\"attachments\":[" + attachmentLists.at(i) + "]";
+            json += "}\n";
+        }
+        lines.clear();
+        attachmentLists.clear();
+
+        // 3. Write the chunk.
+        ChunkWriter writer(out);
+        bool ok;
+        if (!archive) {
+            ok = writer.write(json);
+        } else {
+            ok = writer.writeMember(EntriesMember, QString("entries/%1.jsonl").arg(chunk.firstEventId),
+                                    0, true, json);
+
+            // Attachment files are streamed block by block, never read whole.
+            for (int i = 0; ok && i < files.size(); ++i) {
+                QFile file(files.at(i).at(1));
+                if (!file.open(QIODevice::ReadOnly)) {
+                    qWarning() << "Export: attachment missing" << file.fileName();
+                    continue;
+                }
+                const QString name = QString("attachments/%1/%2-%3").arg(files.at(i).at(0))
+                                     .arg(files.at(i).at(2)).arg(QFileInfo(file).fileName());
+                quint32 block = 0;
+                do {
+                    const QByteArray bytes = file.read(EXPORT_BLOCK_BYTES);
+                    ok = writer.writeMember(AttachmentMember, name, block++, file.atEnd(), bytes);
+                } while (ok && !file.atEnd());
+            }
+        }
+
+        // 4. Make the chunk durable before recording it in the manifest.
+        if (!ok || !out.flush() || fsync(out.handle()) != 0) {
+            emit error(tr("Export failed writing %1: %2").arg(m_fileName).arg(out.errorString()));
+            return false;
+        }
+        chunk.length = writer.length();
+        chunk.crc = writer.crc();
+        manifest.write(manifestLine(chunk));
+        manifest.flush();
+
+        lastEventId = chunk.lastEventId;
+        m_rows += chunk.rows;
+        emit progress(m_rows, total);
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+/*
+ * journalexporter.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef JOURNALEXPORTER_HPP_
+#define JOURNALEXPORTER_HPP_
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QString>
+#include <QStringList>
+
+class QThread;
+class ExportWorker;
+
+/*
+ * @brief Writes the journal out without loading it into memory.
+ *
+ * Rows are read in keyset pages (eventID > last ORDER BY eventID), so memory
+ * use does not depend on the size of the journal. Two formats, chosen by the
+ * file extension:
+ *  - .jsonl  one JSON object per entry, attachments listed by path and sha1
+ *  - .dwa    an archive of zlib-compressed members: one member per page of
+ *            entries (as JSON lines) followed by the attachment files of that
+ *            page, split into fixed-size blocks
+ *
+ * Every page is a chunk. Its byte range, eventID range and crc32 are appended
+ * to "<file>.manifest" once the chunk is on disk. verify() re-checks all
+ * chunks; starting an export to an existing file resumes after the last
+ * chunk that still verifies.
+ *
+ * A journal kept in several files, as ShardedStorage keeps it, is exported
+ * as one: every page is read from each file and merged by eventID.
+ *
+ * An export ends with either finished() or error(), never both.
+ */
+class JournalExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    JournalExporter(const QString &databaseName, QObject *parent = 0);
+    JournalExporter(const QStringList &databaseNames, QObject *parent = 0);
+    ~JournalExporter();
+
+    bool isRunning() const;
+
+    void start(const QString &fileName);
+    void stop();
+
+    static bool verify(const QString &fileName, QString *errorText = 0);
+
+Q_SIGNALS:
+    void progress(int rowsDone, int rowsTotal);
+    void finished(const QString &fileName, int rows);
+    void error(const QString &message);
+
+private:
+    QStringList m_databaseNames;
+    QThread *m_thread;
+    ExportWorker *m_worker;
+};
+
+class ExportWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    ExportWorker(const QStringList &databaseNames, const QString &fileName);
+
+    void stop();
+
+public Q_SLOTS:
+    void run();
+
+Q_SIGNALS:
+    void progress(int rowsDone, int rowsTotal);
+    void finished(const QString &fileName, int rows);
+    void error(const QString &message);
+
+private:
+    bool exportPages();
+    static QString connectionName(int file);
+
+    QStringList m_databaseNames;
+    QString m_fileName;
+    QAtomicInt m_stopRequested;
+    int m_rows;
+};
+
+#endif /* JOURNALEXPORTER_HPP_ */
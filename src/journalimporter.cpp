@@ -0,0 +1,980 @@
+/*
+ * journalimporter.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "journalimporter.hpp"
+#include "EventData.hpp"
+#include "facetindex.hpp"
+#include "iovfs.hpp"
+#include "similarityindex.hpp"
+#include "textcounter.hpp"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QPair>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QtAlgorithms>
+#include <QtSql/QtSql>
+
+#include <string.h>
+
+#define IMPORT_CONNECTION "DWriter-import"
+#define IMPORT_CHUNK_BYTES (256 * 1024)
+#define IMPORT_WINDOW_CHUNKS 16
+#define IMPORT_HASH_BLOCK (64 * 1024)
+
+enum ImportFormat
+{
+    JsonLinesFormat,
+    CsvFormat,
+    DayFileFormat
+};
+
+struct ImportedAttachment
+{
+    QString kind;
+    QString path;
+    QString sha1;
+};
+
+struct ImportedEntry
+{
+    QString timeStamp;
+    QString textEvent;
+    qint64 createdAt;
+    QStringList tags;
+    QByteArray signature;
+    TextCounts counts;
+    QList<ImportedAttachment> attachments;
+};
+
+struct ImportChunk
+{
+    qint64 begin;      // byte range of whole records in the source file
+    qint64 end;
+    QList<ImportedEntry> entries;
+    int rejected;
+};
+
+/*
+ * Shared by the parse tasks of one window. Tasks take the next unparsed chunk
+ * from 'next' until none are left, so a slow chunk never holds up idle cores.
+ */
+struct ParseJob
+{
+    const char *data;
+    ImportFormat format;
+    QDir baseDir;
+    QDateTime fileTime;
+    bool csvHeader;
+    int csvTime;
+    int csvText;
+    int csvAttachments;
+
+    ImportChunk *chunks;
+    int count;
+    QAtomicInt next;
+};
+
+// -----------------------------------------------------------------------------------------------
+// Field helpers
+
+static const char *const TIME_KEYS[] = { "timestamp", "date", "time", "created", 0 };
+static const char *const TEXT_KEYS[] = { "text", "entry", "body", "content", 0 };
+static const char *const ATTACHMENT_KEYS[] = { "attachments", "files", 0 };
+
+static int keyIndex(const char *const keys[], const QString &name)
+{
+    const QString lower = name.trimmed().toLower();
+    for (int i = 0; keys[i]; ++i) {
+        if (lower == QLatin1String(keys[i]))
+            return i;
+    }
+    return -1;
+}
+
+static QDateTime normalizeTime(const QVariant &value)
+{
+    // Numbers, and strings made of digits, are Unix time.
+    bool isNumber = false;
+    double seconds = value.toDouble(&isNumber);
+
+    if (isNumber) {
+        if (seconds > 1e11) // milliseconds
+            seconds /= 1000.0;
+        return QDateTime::fromTime_t(uint(seconds));
+    }
+
+    const QString text = value.toString().trimmed();
+    QDateTime time = QDateTime::fromString(text, Qt::ISODate);
+    if (time.isValid())
+        return time;
+
+    static const char *const formats[] = {
+        "yyyy-MM-dd hh:mm:ss", "yyyy-MM-dd hh:mm", "yyyy-MM-dd",
+        "yyyy/MM/dd hh:mm", "yyyy/MM/dd", "dd.MM.yyyy hh:mm", "dd.MM.yyyy", 0
+    };
+    for (int i = 0; formats[i]; ++i) {
+        time = QDateTime::fromString(text, QLatin1String(formats[i]));
+        if (time.isValid())
+            return time;
+    }
+    return QDateTime::fromString(text, Qt::TextDate);
+}
+
+static QString attachmentKind(const QString &path)
+{
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    if (suffix == "jpg" || suffix == "jpeg" || suffix == "png" || suffix == "gif")
+        return "picture";
+    if (suffix == "mp4" || suffix == "3gp" || suffix == "mov")
+        return "video";
+    if (suffix == "m4a" || suffix == "amr" || suffix == "wav" || suffix == "opus" || suffix == "ogg"
+        || suffix == "dwv")
+        return "voice";
+    return "file";
+}
+
+static QString hashFile(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return QString();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QByteArray block;
+    while (!(block = file.read(IMPORT_HASH_BLOCK)).isEmpty())
+        hash.addData(block);
+    return hash.result().toHex();
+}
+
+static bool makeEntry(const ParseJob *job, const QVariant &time, const QString &text,
+                      const QStringList &attachments, ImportedEntry &entry)
+{
+    const QDateTime stamp = time.isValid() ? normalizeTime(time) : job->fileTime;
+    if (!stamp.isValid() || text.trimmed().isEmpty())
+        return false;
+
+    // Stored exactly the way AddEvent stamps new entries.
+    entry.timeStamp = stamp.toString();
+    entry.createdAt = stamp.toTime_t();
+    entry.textEvent = text;
+    entry.tags = FacetIndex::hashtags(text);
+    entry.signature = SimilarityIndex::signature(text);
+    entry.counts = TextCounter::count(text);
+
+    for (int i = 0; i < attachments.size(); ++i) {
+        const QString path = attachments.at(i).trimmed();
+        if (path.isEmpty())
+            continue;
+        ImportedAttachment attachment;
+        attachment.path = job->baseDir.absoluteFilePath(path);
+        attachment.kind = attachmentKind(attachment.path);
+        attachment.sha1 = hashFile(attachment.path);
+        entry.attachments << attachment;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+// JSON lines
+
+/*
+ * Just enough JSON for one journal entry per line: objects, arrays, strings
+ * with escapes, numbers and literals. Nested values are parsed and kept.
+ */
+class JsonReader
+{
+public:
+    JsonReader(const char *begin, const char *end) : p(begin), end(end) {}
+
+    bool readObject(QVariantMap &map)
+    {
+        skipSpace();
+        if (p == end || *p != '{')
+            return false;
+        ++p;
+        skipSpace();
+        if (p != end && *p == '}') {
+            ++p;
+            return true;
+        }
+        for (;;) {
+            QString key;
+            QVariant value;
+            skipSpace();
+            if (!readString(key))
+                return false;
+            skipSpace();
+            if (p == end || *p++ != ':')
+                return false;
+            if (!readValue(value))
+                return false;
+            map.insert(key, value);
+            skipSpace();
+            if (p == end)
+                return false;
+            if (*p == '}') {
+                ++p;
+                return true;
+            }
+            if (*p++ != ',')
+                return false;
+        }
+    }
+
+private:
+    void skipSpace()
+    {
+        while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+            ++p;
+    }
+
+    bool readValue(QVariant &value)
+    {
+        skipSpace();
+        if (p == end)
+            return false;
+
+        switch (*p) {
+        case '"': {
+            QString text;
+            if (!readString(text))
+                return false;
+            value = text;
+            return true;
+        }
+        case '{': {
+            QVariantMap map;
+            if (!readObject(map))
+                return false;
+            value = map;
+            return true;
+        }
+        case '[': {
+            QVariantList list;
+            ++p;
+            skipSpace();
+            if (p != end && *p == ']') {
+                ++p;
+                value = list;
+                return true;
+            }
+            for (;;) {
+                QVariant item;
+                if (!readValue(item))
+                    return false;
+                list << item;
+                skipSpace();
+                if (p == end)
+                    return false;
+                if (*p == ']') {
+                    ++p;
+                    value = list;
+                    return true;
+                }
+                if (*p++ != ',')
+                    return false;
+            }
+        }
+        case 't':
+            return readLiteral("true", QVariant(true), value);
+        case 'f':
+            return readLiteral("false", QVariant(false), value);
+        case 'n':
+            return readLiteral("null", QVariant(), value);
+        default: {
+            const char *start = p;
+            while (p != end && *p && strchr("+-0123456789.eE", *p))
+                ++p;
+            bool ok = false;
+            value = QByteArray(start, p - start).toDouble(&ok);
+            return ok;
+        }
+        }
+    }
+
+    bool readLiteral(const char *literal, const QVariant &result, QVariant &value)
+    {
+        const int length = strlen(literal);
+        if (end - p < length || strncmp(p, literal, length) != 0)
+            return false;
+        p += length;
+        value = result;
+        return true;
+    }
+
+    bool readString(QString &text)
+    {
+        if (p == end || *p != '"')
+            return false;
+        ++p;
+
+        const char *run = p;
+        while (p != end) {
+            const char c = *p;
+            if (c == '"') {
+                text += QString::fromUtf8(run, p - run);
+                ++p;
+                return true;
+            }
+            if (c != '\\') {
+                ++p;
+                continue;
+            }
+
+            text += QString::fromUtf8(run, p - run);
+            if (++p == end)
+                return false;
+            switch (*p++) {
+            case '"':  text += QChar('"');  break;
+            case '\\': text += QChar('\\'); break;
+            case '/':  text += QChar('/');  break;
+            case 'b':  text += QChar('\b'); break;
+            case 'f':  text += QChar('\f'); break;
+            case 'n':  text += QChar('\n'); break;
+            case 'r':  text += QChar('\r'); break;
+            case 't':  text += QChar('\t'); break;
+            case 'u': {
+                // Surrogate pairs arrive as two escapes and end up as two QChars.
+                if (end - p < 4)
+                    return false;
+                bool ok = false;
+                const ushort code = QByteArray(p, 4).toUShort(&ok, 16);
+                if (!ok)
+                    return false;
+                text += QChar(code);
+                p += 4;
+                break;
+            }
+            default:
+                return false;
+            }
+            run = p;
+        }
+        return false;
+    }
+
+    const char *p;
+    const char *end;
+};
+
+static void parseJsonLines(const ParseJob *job, ImportChunk &chunk)
+{
+    const char *p = job->data + chunk.begin;
+    const char *end = job->data + chunk.end;
+
+    while (p < end) {
+        const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+        if (!eol)
+            eol = end;
+
+        QVariantMap object;
+        JsonReader reader(p, eol);
+        bool blank = true;
+        for (const char *c = p; c < eol && blank; ++c)
+            blank = (*c == ' ' || *c == '\t' || *c == '\r');
+
+        if (!blank) {
+            ImportedEntry entry;
+            QVariant time;
+            QString text;
+            QStringList attachments;
+
+            if (reader.readObject(object)) {
+                QVariantMap::const_iterator it;
+                for (it = object.constBegin(); it != object.constEnd(); ++it) {
+                    if (keyIndex(TIME_KEYS, it.key()) >= 0)
+                        time = it.value();
+                    else if (keyIndex(TEXT_KEYS, it.key()) >= 0)
+                        text = it.value().toString();
+                    else if (keyIndex(ATTACHMENT_KEYS, it.key()) >= 0)
+                        attachments = it.value().toStringList();
+                }
+            }
+            if (makeEntry(job, time, text, attachments, entry))
+                chunk.entries << entry;
+            else
+                ++chunk.rejected;
+        }
+        p = eol + 1;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------
+// CSV
+
+// Reads one RFC 4180 record; quoted fields may contain commas, newlines and "" escapes.
+static bool readCsvRecord(const char *&p, const char *end, QStringList &fields)
+{
+    fields.clear();
+    if (p >= end)
+        return false;
+
+    QByteArray field;
+    bool quoted = false;
+    while (p < end) {
+        const char c = *p++;
+        if (quoted) {
+            if (c == '"') {
+                if (p < end && *p == '"') {
+                    field += '"';
+                    ++p;
+                } else {
+                    quoted = false;
+                }
+            } else {
+                field += c;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields << QString::fromUtf8(field);
+            field.clear();
+        } else if (c == '\n') {
+            break;
+        } else if (c != '\r') {
+            field += c;
+        }
+    }
+    fields << QString::fromUtf8(field);
+    return true;
+}
+
+static void parseCsv(const ParseJob *job, ImportChunk &chunk)
+{
+    const char *p = job->data + chunk.begin;
+    const char *end = job->data + chunk.end;
+
+    QStringList fields;
+    bool skipHeader = job->csvHeader && chunk.begin == 0;
+    while (readCsvRecord(p, end, fields)) {
+        if (skipHeader) {
+            skipHeader = false;
+            continue;
+        }
+        if (fields.size() == 1 && fields.first().trimmed().isEmpty())
+            continue;
+
+        const QString text = fields.value(job->csvText);
+        const QStringList attachments = job->csvAttachments >= 0
+                ? fields.value(job->csvAttachments).split(';', QString::SkipEmptyParts)
+                : QStringList();
+
+        ImportedEntry entry;
+        if (makeEntry(job, fields.value(job->csvTime), text, attachments, entry))
+            chunk.entries << entry;
+        else
+            ++chunk.rejected;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------
+// Plain-text day files
+
+static void parseDayFile(const ParseJob *job, ImportChunk &chunk)
+{
+    const QString text = QString::fromUtf8(job->data + chunk.begin, chunk.end - chunk.begin);
+
+    ImportedEntry entry;
+    if (makeEntry(job, QVariant(), text.trimmed(), QStringList(), entry))
+        chunk.entries << entry;
+    else
+        ++chunk.rejected;
+}
+
+class ParseTask : public QRunnable
+{
+public:
+    ParseTask(ParseJob *job) : m_job(job) {}
+
+    void run()
+    {
+        for (;;) {
+            const int i = m_job->next.fetchAndAddOrdered(1);
+            if (i >= m_job->count)
+                return;
+
+            ImportChunk &chunk = m_job->chunks[i];
+            switch (m_job->format) {
+            case JsonLinesFormat: parseJsonLines(m_job, chunk); break;
+            case CsvFormat:       parseCsv(m_job, chunk);       break;
+            case DayFileFormat:   parseDayFile(m_job, chunk);   break;
+            }
+        }
+    }
+
+private:
+    ParseJob *m_job;
+};
+
+// -----------------------------------------------------------------------------------------------
+// Chunking
+
+static QVector<ImportChunk> splitChunks(const char *data, qint64 begin, qint64 size, ImportFormat format)
+{
+    QVector<ImportChunk> chunks;
+    if (format == DayFileFormat) {
+        ImportChunk chunk = { 0, size, QList<ImportedEntry>(), 0 };
+        if (begin < size)
+            chunks << chunk;
+        return chunks;
+    }
+
+    qint64 pos = begin;
+    while (pos < size) {
+        qint64 end = qMin(pos + IMPORT_CHUNK_BYTES, size);
+
+        if (format == CsvFormat) {
+            // Quoted fields can span lines, so only cut at a newline outside quotes.
+            bool quoted = false;
+            for (qint64 i = pos; i < end; ++i) {
+                if (data[i] == '"')
+                    quoted = !quoted;
+            }
+            while (end < size && (quoted || data[end - 1] != '\n')) {
+                if (data[end] == '"')
+                    quoted = !quoted;
+                ++end;
+            }
+        } else if (end < size && data[end - 1] != '\n') {
+            const char *eol = static_cast<const char *>(memchr(data + end, '\n', size - end));
+            end = eol ? (eol - data) + 1 : size;
+        }
+
+        ImportChunk chunk = { pos, end, QList<ImportedEntry>(), 0 };
+        chunks << chunk;
+        pos = end;
+    }
+    return chunks;
+}
+
+// -----------------------------------------------------------------------------------------------
+// JournalImporter
+
+JournalImporter::JournalImporter(const QString &databaseName, QObject *parent)
+    : QObject(parent)
+    , m_databaseName(databaseName)
+    , m_thread(0)
+    , m_worker(0)
+{
+}
+
+JournalImporter::~JournalImporter()
+{
+    stop();
+}
+
+bool JournalImporter::isRunning() const
+{
+    return m_thread && m_thread->isRunning();
+}
+
+void JournalImporter::start(const QStringList &files)
+{
+    if (isRunning())
+        return;
+    stop();
+
+    m_thread = new QThread(this);
+    m_worker = new ImportWorker(m_databaseName, files);
+    m_worker->moveToThread(m_thread);
+
+    connect(m_thread, SIGNAL(started()), m_worker, SLOT(run()));
+    connect(m_worker, SIGNAL(finished(qint64, qint64, int)), m_thread, SLOT(quit()));
+    connect(m_worker, SIGNAL(progress(const QString&, qint64, qint64, int)),
+            this, SIGNAL(progress(const QString&, qint64, qint64, int)));
+    connect(m_worker, SIGNAL(finished(qint64, qint64, int)),
+            this, SIGNAL(finished(qint64, qint64, int)));
+    connect(m_worker, SIGNAL(error(const QString&)), this, SIGNAL(error(const QString&)));
+
+    m_thread->start(QThread::LowPriority);
+}
+
+void JournalImporter::stop()
+{
+    if (!m_thread)
+        return;
+
+    // The window being inserted is committed first, so the next start() resumes after it.
+    m_worker->stop();
+    m_thread->quit();
+    m_thread->wait();
+
+    delete m_worker;
+    m_worker = 0;
+    delete m_thread;
+    m_thread = 0;
+}
+
+// -----------------------------------------------------------------------------------------------
+// ImportWorker
+
+ImportWorker::ImportWorker(const QString &databaseName, const QStringList &files)
+    : m_databaseName(databaseName)
+    , m_files(files)
+    , m_stopRequested(0)
+    , m_firstEventId(-1)
+    , m_lastEventId(-1)
+    , m_entries(0)
+{
+}
+
+void ImportWorker::stop()
+{
+    m_stopRequested.fetchAndStoreOrdered(1);
+}
+
+void ImportWorker::run()
+{
+    IoScope io("import");
+    {
+        QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", IMPORT_CONNECTION);
+        database.setDatabaseName(m_databaseName);
+        database.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+
+        if (!database.open()) {
+            emit error(tr("Import could not open the database: %1").arg(database.lastError().text()));
+        } else {
+            // Large transactions need room for their dirty pages.
+            QSqlQuery(database).exec("PRAGMA cache_size = -8192");
+
+            for (int i = 0; i < m_files.size() && !m_stopRequested; ++i) {
+                if (!importFile(m_files.at(i)))
+                    break;
+            }
+            database.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(IMPORT_CONNECTION);
+
+    emit finished(m_firstEventId, m_lastEventId, m_entries);
+}
+
+// The SHA-1 of bytes [begin, end) of the source, added to 'hash'.
+static void hashRange(QCryptographicHash &hash, const char *data, qint64 begin, qint64 end)
+{
+    for (qint64 pos = begin; pos < end; pos += IMPORT_HASH_BLOCK)
+        hash.addData(data + pos, int(qMin<qint64>(IMPORT_HASH_BLOCK, end - pos)));
+}
+
+/*
+ * What the insert triggers do for one row, done once for the eventIDs of a
+ * window: the change log for sync, and the daily and monthly totals. The
+ * totals are summed per period into a temporary table first, so each
+ * period's row is updated once.
+ */
+static bool logWindow(QSqlDatabase &database, qint64 firstEventId, qint64 lastEventId)
+{
+    // Table, key column and the key of an entry, as in the events_stats_insert trigger.
+    static const char *const PERIODS[][3] = {
+        { "stats_daily", "day",
+          "CAST(julianday(createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER)" },
+        { "stats_monthly", "month",
+          "CAST(strftime('%Y%m', createdAt, 'unixepoch', 'localtime') AS INTEGER)" }
+    };
+
+    QSqlQuery query(database);
+    query.prepare("INSERT INTO changes (eventID, syncId, op, changedAt) "
+                  "SELECT eventID, syncId, 'I', updatedAt FROM events "
+                  "WHERE eventID BETWEEN :first AND :last ORDER BY eventID");
+    query.bindValue(":first", firstEventId);
+    query.bindValue(":last", lastEventId);
+    if (!query.exec())
+        return false;
+
+    if (!query.exec("CREATE TEMP TABLE IF NOT EXISTS import_totals ( "
+                    "                period INTEGER PRIMARY KEY, "
+                    "                entries INTEGER, "
+                    "                words INTEGER, "
+                    "                characters INTEGER"
+                    ")"))
+        return false;
+
+    for (int p = 0; p < 2; ++p) {
+        const QString table = PERIODS[p][0];
+        const QString column = PERIODS[p][1];
+        if (!query.exec("DELETE FROM import_totals"))
+            return false;
+
+        query.prepare(QString("INSERT INTO import_totals (period, entries, words, characters) "
+                              "SELECT %1, COUNT(*), SUM(words), SUM(characters) FROM events "
+                              "WHERE eventID BETWEEN :first AND :last GROUP BY 1").arg(PERIODS[p][2]));
+        query.bindValue(":first", firstEventId);
+        query.bindValue(":last", lastEventId);
+        if (!query.exec()
+            || !query.exec(QString("INSERT OR IGNORE INTO %1 (%2) SELECT period FROM import_totals")
+                           .arg(table, column))
+            || !query.exec(QString("UPDATE %1 SET "
+                                   "entries = entries + (SELECT entries FROM import_totals WHERE period = %2), "
+                                   "words = words + (SELECT words FROM import_totals WHERE period = %2), "
+                                   "characters = characters + (SELECT characters FROM import_totals WHERE period = %2) "
+                                   "WHERE %2 IN (SELECT period FROM import_totals)").arg(table, column)))
+            return false;
+    }
+    return true;
+}
+
+bool ImportWorker::importFile(const QString &fileName)
+{
+    QSqlDatabase database = QSqlDatabase::database(IMPORT_CONNECTION);
+    const QFileInfo info(fileName);
+    const QString source = info.absoluteFilePath();
+    const QString suffix = info.suffix().toLower();
+    const ImportFormat format = (suffix == "jsonl" || suffix == "json") ? JsonLinesFormat
+                              : suffix == "csv" ? CsvFormat
+                              : DayFileFormat;
+
+    QFile file(source);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit error(tr("Cannot open %1: %2").arg(source).arg(file.errorString()));
+        return false;
+    }
+    const qint64 size = file.size();
+    if (size == 0)
+        return true;
+
+    // 1. Map the file; fall back to reading it if mapping is not possible.
+    uchar *map = file.map(0, size);
+    QByteArray contents;
+    if (!map)
+        contents = file.readAll();
+    const char *data = map ? reinterpret_cast<const char *>(map) : contents.constData();
+
+    // 2. Resume state, keyed on what was read: the SHA-1 of the bytes up to
+    //    the offset reached. A source that only grew since resumes there, a
+    //    copy of a finished source is skipped, and a source that changed
+    //    before the offset is read again without adding the entries that
+    //    are already in the journal.
+    qint64 offset = 0;
+    bool skipExisting = false;
+    bool done = false;
+    QCryptographicHash read(QCryptographicHash::Sha1);
+    QSqlQuery state(database);
+    state.prepare("SELECT size, modified, offset, done, sha1 FROM imports WHERE source = :source");
+    state.bindValue(":source", source);
+    if (state.exec() && state.next()) {
+        const qint64 reached = state.value(2).toLongLong();
+        const QString sha1 = state.value(4).toString();
+        bool same = false;
+        if (sha1.isEmpty()) {
+            // Written before the hash was kept.
+            same = state.value(0).toLongLong() == size
+                   && state.value(1).toLongLong() == info.lastModified().toTime_t();
+        } else if (reached <= size) {
+            hashRange(read, data, 0, reached);
+            same = read.result().toHex() == sha1.toLatin1();
+        }
+        // A day file is one entry; one that grew is an edited entry.
+        if (same && format == DayFileFormat && reached != size)
+            same = false;
+
+        if (same) {
+            offset = reached;
+            done = reached == size;
+            if (sha1.isEmpty())
+                hashRange(read, data, 0, reached);
+        } else {
+            skipExisting = true;
+            read.reset();
+        }
+    } else {
+        hashRange(read, data, 0, size);
+        state.prepare("SELECT 1 FROM imports WHERE sha1 = :sha1 AND done = 1 LIMIT 1");
+        state.bindValue(":sha1", QString::fromLatin1(read.result().toHex()));
+        done = state.exec() && state.next();
+        read.reset();
+    }
+    state.finish();
+
+    if (done) {
+        if (map)
+            file.unmap(map);
+        return true;
+    }
+    if (offset == 0) {
+        state.prepare("INSERT OR REPLACE INTO imports (source, size, modified, offset, entries, done, sha1) "
+                      "VALUES(:source, :size, :modified, 0, 0, 0, NULL)");
+        state.bindValue(":source", source);
+        state.bindValue(":size", size);
+        state.bindValue(":modified", info.lastModified().toTime_t());
+        state.exec();
+        state.finish();
+    }
+
+    ParseJob job;
+    job.data = data;
+    job.format = format;
+    job.baseDir = info.absoluteDir();
+    job.fileTime = QDateTime::fromString(info.completeBaseName(), "yyyy-MM-dd");
+    if (!job.fileTime.isValid())
+        job.fileTime = info.lastModified();
+    job.csvHeader = false;
+    job.csvTime = 0;
+    job.csvText = 1;
+    job.csvAttachments = -1;
+
+    if (format == CsvFormat) {
+        const char *p = data;
+        QStringList header;
+        readCsvRecord(p, data + size, header);
+        for (int i = 0; i < header.size(); ++i) {
+            if (keyIndex(TIME_KEYS, header.at(i)) >= 0) {
+                job.csvTime = i;
+                job.csvHeader = true;
+            } else if (keyIndex(TEXT_KEYS, header.at(i)) >= 0) {
+                job.csvText = i;
+                job.csvHeader = true;
+            } else if (keyIndex(ATTACHMENT_KEYS, header.at(i)) >= 0) {
+                job.csvAttachments = i;
+            }
+        }
+        if (!job.csvHeader && header.size() > 2)
+            job.csvAttachments = 2;
+    }
+
+    QVector<ImportChunk> chunks = splitChunks(data, offset, size, format);
+
+    // The sync identity is set here; the insert triggers are quiet during the import.
+    QSqlQuery insertEvent(database);
+    insertEvent.prepare("INSERT INTO events (timeStamp, textEvent, createdAt, words, characters, "
+                        "syncId, updatedAt) "
+                        "VALUES(?, ?, ?, ?, ?, lower(hex(randomblob(16))), strftime('%s', 'now'))");
+    QSqlQuery findEvent(database);
+    findEvent.prepare("SELECT 1 FROM events WHERE createdAt = ? AND textEvent = ? LIMIT 1");
+    QSqlQuery insertAttachment(database);
+    insertAttachment.prepare("INSERT INTO attachments (eventID, kind, path, sha1) VALUES(?, ?, ?, ?)");
+    QSqlQuery insertTag(database);
+    insertTag.prepare("INSERT OR IGNORE INTO event_tags (eventID, tag, inline) VALUES(?, ?, 1)");
+    SimilarityIndex similarity(database);
+    QSqlQuery quiet(database);
+    QSqlQuery saveState(database);
+    saveState.prepare("UPDATE imports SET size = ?, modified = ?, offset = ?, entries = entries + ?, "
+                      "done = ?, sha1 = ? WHERE source = ?");
+
+    QThreadPool pool;
+    bool success = true;
+
+    for (int first = 0; first < chunks.size() && !m_stopRequested; first += IMPORT_WINDOW_CHUNKS) {
+        const int count = qMin(IMPORT_WINDOW_CHUNKS, chunks.size() - first);
+
+        // 3. Parse the window on all cores.
+        job.chunks = chunks.data() + first;
+        job.count = count;
+        job.next = 0;
+        for (int t = 0; t < qMin(pool.maxThreadCount(), count); ++t)
+            pool.start(new ParseTask(&job));
+        pool.waitForDone();
+
+        // 4. Insert it in input order as one transaction, together with the resume offset.
+        //    The rows go in first; their tags, buckets, change log and totals follow in
+        //    batches. Other derived data is left to the finished() handler.
+        database.transaction();
+        success = quiet.exec("INSERT OR REPLACE INTO sync_state (key, value) VALUES ('importing', 1)");
+        qint64 windowFirst = -1;
+        qint64 windowLast = -1;
+        int inserted = 0;
+        int rejected = 0;
+        QList<QPair<QString, qint64> > tags;
+        QList<qint64> signatureIds;
+        QList<QByteArray> signatures;
+        for (int c = first; success && c < first + count; ++c) {
+            const QList<ImportedEntry> &entries = chunks.at(c).entries;
+            rejected += chunks.at(c).rejected;
+            for (int e = 0; success && e < entries.size(); ++e) {
+                const ImportedEntry &entry = entries.at(e);
+                if (skipExisting) {
+                    findEvent.addBindValue(entry.createdAt);
+                    findEvent.addBindValue(entry.textEvent);
+                    success = findEvent.exec();
+                    const bool exists = success && findEvent.next();
+                    findEvent.finish();
+                    if (exists)
+                        continue;
+                }
+
+                insertEvent.addBindValue(entry.timeStamp);
+                insertEvent.addBindValue(entry.textEvent);
+                insertEvent.addBindValue(entry.createdAt);
+                insertEvent.addBindValue(entry.counts.words);
+                insertEvent.addBindValue(entry.counts.characters);
+                success = success && insertEvent.exec();
+                if (!success)
+                    break;
+
+                const qint64 eventId = insertEvent.lastInsertId().toLongLong();
+                if (m_firstEventId < 0)
+                    m_firstEventId = eventId;
+                m_lastEventId = eventId;
+                if (windowFirst < 0)
+                    windowFirst = eventId;
+                windowLast = eventId;
+                ++inserted;
+
+                for (int t = 0; t < entry.tags.size(); ++t)
+                    tags << qMakePair(entry.tags.at(t), eventId);
+                signatureIds << eventId;
+                signatures << entry.signature;
+                for (int a = 0; success && a < entry.attachments.size(); ++a) {
+                    insertAttachment.addBindValue(eventId);
+                    insertAttachment.addBindValue(entry.attachments.at(a).kind);
+                    insertAttachment.addBindValue(entry.attachments.at(a).path);
+                    insertAttachment.addBindValue(entry.attachments.at(a).sha1);
+                    success = insertAttachment.exec();
+                }
+            }
+        }
+
+        // In the order of the event_tags key, like the LSH buckets in addEvents().
+        qSort(tags);
+        for (int t = 0; success && t < tags.size(); ++t) {
+            insertTag.addBindValue(tags.at(t).second);
+            insertTag.addBindValue(tags.at(t).first);
+            success = insertTag.exec();
+        }
+        if (success)
+            success = similarity.addEvents(signatureIds, signatures);
+        if (success && inserted > 0)
+            success = logWindow(database, windowFirst, windowLast);
+        if (success)
+            success = quiet.exec("DELETE FROM sync_state WHERE key = 'importing'");
+
+        const qint64 reached = chunks.at(first + count - 1).end;
+        if (success) {
+            hashRange(read, data, chunks.at(first).begin, reached);
+            saveState.addBindValue(size);
+            saveState.addBindValue(info.lastModified().toTime_t());
+            saveState.addBindValue(reached);
+            saveState.addBindValue(inserted);
+            saveState.addBindValue(reached >= size ? 1 : 0);
+            saveState.addBindValue(QString::fromLatin1(read.result().toHex()));
+            saveState.addBindValue(source);
+            success = saveState.exec();
+        }
+        if (!success || !database.commit()) {
+            database.rollback();
+            emit error(tr("Import of %1 failed: %2").arg(source).arg(database.lastError().text()));
+            success = false;
+            break;
+        }
+
+        if (rejected > 0)
+            qWarning() << "Import:" << rejected << "records without a usable date or text in" << source;
+
+        m_entries += inserted;
+        for (int c = first; c < first + count; ++c)
+            chunks[c].entries.clear();
+
+        emit progress(source, reached, size, m_entries);
+    }
+
+    if (map)
+        file.unmap(map);
+    return success;
+}
@@ -0,0 +1,93 @@
+/*
+ * journalimporter.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef JOURNALIMPORTER_HPP_
+#define JOURNALIMPORTER_HPP_
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QStringList>
+
+class QThread;
+class ImportWorker;
+
+/*
+ * @brief Loads existing diaries into the events table.
+ *
+ * Accepted sources, chosen by file extension:
+ *  - .jsonl / .json  one object per line: {"timestamp": ..., "text": ..., "attachments": [...]}
+ *  - .csv            timestamp,text[,attachments] with an optional header row
+ *  - anything else   a plain-text day file: the whole file is one entry, dated
+ *                    by its name (yyyy-MM-dd.txt) or else by its modification time
+ *
+ * Each file is memory-mapped and cut into chunks on record boundaries. The
+ * chunks of a window are parsed in parallel on the global thread pool
+ * (timestamps normalized, attachment hashes computed), then inserted in input
+ * order in one large transaction. The triggers that would log and count each
+ * row are held off, and the change log, totals, tags and similarity buckets
+ * of the window are written in batches instead.
+ *
+ * The byte offset reached and the SHA-1 of the bytes up to it are committed
+ * with every window. An interrupted import, or one of a source that has only
+ * grown, resumes from there; a source changed before that point is read
+ * again, skipping the entries already in the journal.
+ */
+class JournalImporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    JournalImporter(const QString &databaseName, QObject *parent = 0);
+    ~JournalImporter();
+
+    bool isRunning() const;
+
+    void start(const QStringList &files);
+    void stop();
+
+Q_SIGNALS:
+    void progress(const QString &source, qint64 bytesDone, qint64 bytesTotal, int entries);
+    // The range of eventIDs that were added; derived data can be rebuilt once for it.
+    void finished(qint64 firstEventId, qint64 lastEventId, int entries);
+    void error(const QString &message);
+
+private:
+    QString m_databaseName;
+    QThread *m_thread;
+    ImportWorker *m_worker;
+};
+
+class ImportWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    ImportWorker(const QString &databaseName, const QStringList &files);
+
+    void stop();
+
+public Q_SLOTS:
+    void run();
+
+Q_SIGNALS:
+    void progress(const QString &source, qint64 bytesDone, qint64 bytesTotal, int entries);
+    void finished(qint64 firstEventId, qint64 lastEventId, int entries);
+    void error(const QString &message);
+
+private:
+    bool importFile(const QString &fileName);
+
+    QString m_databaseName;
+    QStringList m_files;
+    QAtomicInt m_stopRequested;
+
+    qint64 m_firstEventId;
+    qint64 m_lastEventId;
+    int m_entries;
+};
+
+#endif /* JOURNALIMPORTER_HPP_ */
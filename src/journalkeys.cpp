@@ -0,0 +1,305 @@
+/*
+ * journalkeys.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "journalkeys.hpp"
+#include "cryptovfs.hpp"
+
+#include <QDataStream>
+#include <QFile>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#define KEYS_MAGIC 0x44574B31        // "DWK1"
+#define KEYS_SALT_BYTES 16
+#define KEYS_PASSPHRASE_ITERATIONS 64000
+#define KEYS_MAX_ID 255
+
+static QByteArray randomBytes(int count)
+{
+    QByteArray bytes(count, '\0');
+    if (RAND_bytes(reinterpret_cast<unsigned char *>(bytes.data()), count) != 1)
+        return QByteArray();
+    return bytes;
+}
+
+static QByteArray keyAad(int id)
+{
+    QByteArray aad("DWK1");
+    aad.append(char(id));
+    return aad;
+}
+
+static bool writeFileAtomically(const QString &fileName, const QByteArray &data)
+{
+    const QString temporary = fileName + ".tmp";
+    QFile file(temporary);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    file.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    const bool ok = file.write(data) == data.size() && file.flush() && fsync(file.handle()) == 0;
+    file.close();
+    if (!ok) {
+        QFile::remove(temporary);
+        return false;
+    }
+    return ::rename(QFile::encodeName(temporary).constData(),
+                    QFile::encodeName(fileName).constData()) == 0;
+}
+
+JournalKeys::JournalKeys(const QString &databaseName)
+    : m_keyFileName(databaseName + ".keys")
+    , m_iterations(KEYS_PASSPHRASE_ITERATIONS)
+    , m_currentId(-1)
+{
+}
+
+bool JournalKeys::exists() const
+{
+    return QFile::exists(m_keyFileName);
+}
+
+bool JournalKeys::create(const QString &passphrase)
+{
+    if (passphrase.isEmpty()) {
+        m_lastError = "A passphrase is required";
+        return false;
+    }
+
+    const QByteArray key = randomBytes(CRYPT_KEY_BYTES);
+    m_salt = randomBytes(KEYS_SALT_BYTES);
+    if (key.isEmpty() || m_salt.isEmpty()) {
+        m_lastError = "No random bytes available";
+        return false;
+    }
+
+    m_iterations = KEYS_PASSPHRASE_ITERATIONS;
+    m_kek = deriveKek(passphrase, m_salt, m_iterations);
+    if (m_kek.isEmpty())
+        return false;
+    m_keys.clear();
+    m_keys.insert(1, key);
+    m_currentId = 1;
+
+    if (!save())
+        return false;
+    publish();
+    return true;
+}
+
+bool JournalKeys::unlock(const QString &passphrase)
+{
+    if (!load(passphrase))
+        return false;
+    publish();
+    return true;
+}
+
+bool JournalKeys::changePassphrase(const QString &oldPassphrase, const QString &newPassphrase)
+{
+    if (newPassphrase.isEmpty()) {
+        m_lastError = "A passphrase is required";
+        return false;
+    }
+    if (!load(oldPassphrase))
+        return false;
+
+    // A new salt, so the old and new key-encryption keys are unrelated.
+    const QByteArray salt = randomBytes(KEYS_SALT_BYTES);
+    if (salt.isEmpty()) {
+        m_lastError = "No random bytes available";
+        return false;
+    }
+    const QByteArray kek = deriveKek(newPassphrase, salt, KEYS_PASSPHRASE_ITERATIONS);
+    if (kek.isEmpty())
+        return false;
+
+    const QByteArray previousKek = m_kek;
+    const QByteArray previousSalt = m_salt;
+    const int previousIterations = m_iterations;
+    m_kek = kek;
+    m_salt = salt;
+    m_iterations = KEYS_PASSPHRASE_ITERATIONS;
+    if (!save()) {
+        m_kek = previousKek;
+        m_salt = previousSalt;
+        m_iterations = previousIterations;
+        return false;
+    }
+    return true;
+}
+
+bool JournalKeys::addKey()
+{
+    if (m_currentId < 0) {
+        m_lastError = "The journal keys are locked";
+        return false;
+    }
+
+    int id = 1;
+    while (id <= KEYS_MAX_ID && m_keys.contains(id))
+        ++id;
+    if (id > KEYS_MAX_ID) {
+        m_lastError = "Too many journal keys; finish the running rekey first";
+        return false;
+    }
+
+    const QByteArray key = randomBytes(CRYPT_KEY_BYTES);
+    if (key.isEmpty()) {
+        m_lastError = "No random bytes available";
+        return false;
+    }
+
+    const int previousId = m_currentId;
+    m_keys.insert(id, key);
+    m_currentId = id;
+    if (!save()) {
+        m_keys.remove(id);
+        m_currentId = previousId;
+        return false;
+    }
+    publish();
+    return true;
+}
+
+bool JournalKeys::retireOldKeys()
+{
+    if (m_currentId < 0) {
+        m_lastError = "The journal keys are locked";
+        return false;
+    }
+
+    const QMap<int, QByteArray> previous = m_keys;
+    QMap<int, QByteArray> current;
+    current.insert(m_currentId, m_keys.value(m_currentId));
+    m_keys = current;
+    if (!save()) {
+        m_keys = previous;
+        return false;
+    }
+    publish();
+    return true;
+}
+
+int JournalKeys::currentKeyId() const
+{
+    return m_currentId;
+}
+
+int JournalKeys::keyCount() const
+{
+    return m_keys.size();
+}
+
+QString JournalKeys::lastError() const
+{
+    return m_lastError;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+QByteArray JournalKeys::deriveKek(const QString &passphrase, const QByteArray &salt,
+                                  int iterations)
+{
+    const QByteArray password = passphrase.toUtf8();
+    QByteArray kek(CRYPT_KEY_BYTES, '\0');
+    if (PKCS5_PBKDF2_HMAC(password.constData(), password.size(),
+                          reinterpret_cast<const unsigned char *>(salt.constData()), salt.size(),
+                          iterations, EVP_sha256(), kek.size(),
+                          reinterpret_cast<unsigned char *>(kek.data())) != 1) {
+        m_lastError = "Key derivation failed";
+        return QByteArray();
+    }
+    return kek;
+}
+
+bool JournalKeys::load(const QString &passphrase)
+{
+    if (passphrase.isEmpty()) {
+        m_lastError = "A passphrase is required";
+        return false;
+    }
+
+    QFile file(m_keyFileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_lastError = file.errorString();
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0, iterations = 0;
+    QByteArray salt;
+    qint32 currentId = -1, count = 0;
+    in >> magic >> iterations >> salt >> currentId >> count;
+    if (in.status() != QDataStream::Ok || magic != KEYS_MAGIC || iterations == 0
+        || count <= 0 || count > KEYS_MAX_ID) {
+        m_lastError = "The key file is damaged";
+        return false;
+    }
+
+    const QByteArray kek = deriveKek(passphrase, salt, int(iterations));
+    if (kek.isEmpty())
+        return false;
+
+    QMap<int, QByteArray> keys;
+    for (int i = 0; i < count; ++i) {
+        qint32 id = 0;
+        QByteArray sealed, key;
+        in >> id >> sealed;
+        if (in.status() != QDataStream::Ok) {
+            m_lastError = "The key file is damaged";
+            return false;
+        }
+        if (!CryptoVfs::open(kek, sealed, keyAad(id), key) || key.size() != CRYPT_KEY_BYTES) {
+            m_lastError = "Wrong passphrase";
+            return false;
+        }
+        keys.insert(id, key);
+    }
+    if (!keys.contains(currentId)) {
+        m_lastError = "The key file is damaged";
+        return false;
+    }
+
+    m_kek = kek;
+    m_salt = salt;
+    m_iterations = int(iterations);
+    m_currentId = currentId;
+    m_keys = keys;
+    return true;
+}
+
+bool JournalKeys::save()
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << quint32(KEYS_MAGIC) << quint32(m_iterations) << m_salt << qint32(m_currentId)
+        << qint32(m_keys.size());
+
+    QMap<int, QByteArray>::const_iterator it;
+    for (it = m_keys.constBegin(); it != m_keys.constEnd(); ++it) {
+        const QByteArray sealed = CryptoVfs::seal(m_kek, it.value(), keyAad(it.key()));
+        if (sealed.isEmpty()) {
+            m_lastError = "Cannot seal the journal keys";
+            return false;
+        }
+        out << qint32(it.key()) << sealed;
+    }
+
+    if (!writeFileAtomically(m_keyFileName, data)) {
+        m_lastError = "Cannot write " + m_keyFileName;
+        return false;
+    }
+    return true;
+}
+
+void JournalKeys::publish()
+{
+    CryptoVfs::setKeys(m_keys, m_currentId);
+}
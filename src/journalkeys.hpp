@@ -0,0 +1,66 @@
+/*
+ * journalkeys.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef JOURNALKEYS_HPP_
+#define JOURNALKEYS_HPP_
+
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+
+/*
+ * @brief The data keys of the encrypted journal, kept wrapped in "<db>.keys".
+ *
+ * Pages are encrypted with random data keys. The key file holds them sealed
+ * with a key-encryption key derived from the passphrase by PBKDF2-HMAC-SHA256
+ * (KEYS_PASSPHRASE_ITERATIONS rounds, random salt). A passphrase is required:
+ * nothing that could stand in for it is stored on the device, so the files
+ * alone are not enough to read the journal. Once unlocked, only the derived
+ * key is kept in memory, not the passphrase.
+ *
+ * Several data keys can be present while a rekey is under way; blocks carry
+ * the id of the key they were written with. The file is replaced atomically
+ * (written beside, synced, renamed) on every change.
+ */
+class JournalKeys
+{
+public:
+    JournalKeys(const QString &databaseName);
+
+    bool exists() const;
+
+    // Creates the key file with a first data key and loads it into CryptoVfs.
+    bool create(const QString &passphrase);
+    // Reads the key file and loads the keys into CryptoVfs.
+    bool unlock(const QString &passphrase);
+    bool changePassphrase(const QString &oldPassphrase, const QString &newPassphrase);
+
+    // Adds a data key and makes it the one new blocks are written with.
+    bool addKey();
+    // Forgets every key but the current one, once nothing uses them any more.
+    bool retireOldKeys();
+
+    int currentKeyId() const;
+    int keyCount() const;
+    QString lastError() const;
+
+private:
+    QByteArray deriveKek(const QString &passphrase, const QByteArray &salt, int iterations);
+    bool load(const QString &passphrase);
+    bool save();
+    void publish();
+
+    QString m_keyFileName;
+    QByteArray m_kek;
+    QByteArray m_salt;
+    int m_iterations;
+    int m_currentId;
+    QMap<int, QByteArray> m_keys;
+    QString m_lastError;
+};
+
+#endif /* JOURNALKEYS_HPP_ */
@@ -0,0 +1,239 @@
+/*
+ * journalqueries.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef JOURNALQUERIES_HPP_
+#define JOURNALQUERIES_HPP_
+
+#include "typedquery.hpp"
+
+/*
+ * The queries DatabaseIo and SqliteStorage run against the events table,
+ * each declared once with the types of its parameters and result columns.
+ * Run them through TypedQuery.
+ */
+
+// The word and character counts feed the stats_daily/stats_monthly triggers (schema v9).
+struct InsertEvent
+{
+    typedef SqlTuple<QString, QString, qint64, int, int> Params;   // timeStamp, textEvent, createdAt,
+                                                                  // words, characters
+    typedef SqlTuple<> Row;
+    static const char *sql()
+    {
+        return "INSERT INTO events (timeStamp, textEvent, createdAt, words, characters) "
+               "VALUES (?, ?, ?, ?, ?)";
+    }
+};
+
+struct UpdateEventText
+{
+    typedef SqlTuple<QString, int, int, qint64> Params;  // textEvent, words, characters, eventID
+    typedef SqlTuple<> Row;
+    static const char *sql()
+    {
+        return "UPDATE events SET textEvent = ?, words = ?, characters = ? WHERE eventID = ?";
+    }
+};
+
+// A negative mood clears it.
+struct UpdateEventMood
+{
+    typedef SqlTuple<int, qint64> Params;                // mood, eventID
+    typedef SqlTuple<> Row;
+    static const char *sql()
+    {
+        return "UPDATE events SET mood = CASE WHEN ?1 >= 0 THEN ?1 END WHERE eventID = ?2";
+    }
+};
+
+struct DropEvents
+{
+    typedef SqlTuple<> Params;
+    typedef SqlTuple<> Row;
+    static const char *sql()
+    {
+        return "DROP TABLE IF EXISTS events";
+    }
+};
+
+// Entries in the trash (deletedAt set, schema v10) are left out of the list,
+// its count and the search.
+struct EventCount
+{
+    typedef SqlTuple<> Params;
+    typedef SqlTuple<int> Row;
+    static const char *sql()
+    {
+        return "SELECT COUNT(*) FROM events WHERE deletedAt IS NULL";
+    }
+};
+
+// The text an edit replaces, and when the entry was written.
+struct EventText
+{
+    typedef SqlTuple<qint64> Params;                     // eventID
+    typedef SqlTuple<QString, qint64> Row;               // textEvent, createdAt
+    static const char *sql()
+    {
+        return "SELECT textEvent, createdAt FROM events WHERE eventID = ?";
+    }
+};
+
+// Rows of the event queries below: eventID, createdAt, timeStamp, textEvent.
+typedef SqlTuple<qint64, qint64, QString, QString> EventRow;
+
+struct EventById
+{
+    typedef SqlTuple<qint64> Params;                     // eventID
+    typedef EventRow Row;
+    static const char *sql()
+    {
+        return "SELECT eventID, createdAt, timeStamp, textEvent FROM events WHERE eventID = ?";
+    }
+};
+
+// Rows are positions among the entries not in the trash, oldest first.
+struct EventsFromRow
+{
+    typedef SqlTuple<int, int> Params;                   // first row, count
+    typedef EventRow Row;
+    static const char *sql()
+    {
+        return "SELECT eventID, createdAt, timeStamp, textEvent FROM events "
+               "WHERE deletedAt IS NULL ORDER BY eventID LIMIT ?2 OFFSET ?1";
+    }
+};
+
+// The same rows from an eventID the RowIndex found, without skipping any.
+struct EventsFromId
+{
+    typedef SqlTuple<qint64, int> Params;                // first eventID, count
+    typedef EventRow Row;
+    static const char *sql()
+    {
+        return "SELECT eventID, createdAt, timeStamp, textEvent FROM events "
+               "WHERE eventID >= ? AND deletedAt IS NULL ORDER BY eventID LIMIT ?";
+    }
+};
+
+// The first entry in list order written at or after a time, -1 if none; the
+// list is in eventID order, so an imported older entry with a high eventID
+// must not pull the scrubber back to it. Scans events_createdAt from the time.
+struct FirstEventAt
+{
+    typedef SqlTuple<qint64> Params;                     // createdAt
+    typedef SqlTuple<qint64> Row;                        // eventID
+    static const char *sql()
+    {
+        return "SELECT coalesce(MIN(eventID), -1) FROM events "
+               "WHERE createdAt >= ? AND deletedAt IS NULL";
+    }
+};
+
+struct EventsMatching
+{
+    typedef SqlTuple<qint64, qint64, QString> Params;    // from, to, LIKE pattern
+    typedef EventRow Row;
+    static const char *sql()
+    {
+        return "SELECT eventID, createdAt, timeStamp, textEvent FROM events "
+               "WHERE createdAt BETWEEN ? AND ? AND textEvent LIKE ? ESCAPE '\\' "
+               "AND deletedAt IS NULL "
+               "ORDER BY createdAt, eventID";
+    }
+};
+
+// What FacetIndex keeps of an entry; a mood of -1 is none.
+struct EventFacets
+{
+    typedef SqlTuple<qint64> Params;                     // eventID
+    typedef SqlTuple<qint64, int> Row;                   // createdAt, mood
+    static const char *sql()
+    {
+        return "SELECT createdAt, COALESCE(mood, -1) FROM events WHERE eventID = ?";
+    }
+};
+
+// Moves an entry to the trash (a time) or back out of it (NULL), see TrashStore.
+struct TrashEvent
+{
+    typedef SqlTuple<qint64, qint64> Params;             // deletedAt, eventID
+    typedef SqlTuple<> Row;
+    static const char *sql()
+    {
+        return "UPDATE events SET deletedAt = ? WHERE eventID = ? AND deletedAt IS NULL";
+    }
+};
+
+struct RestoreEvent
+{
+    typedef SqlTuple<qint64> Params;                     // eventID
+    typedef SqlTuple<> Row;
+    static const char *sql()
+    {
+        return "UPDATE events SET deletedAt = NULL WHERE eventID = ? AND deletedAt IS NOT NULL";
+    }
+};
+
+// The trash, most recently deleted first.
+struct TrashedEvents
+{
+    typedef SqlTuple<> Params;
+    typedef SqlTuple<qint64, qint64, QString, QString, qint64> Row;   // EventRow, deletedAt
+    static const char *sql()
+    {
+        return "SELECT eventID, createdAt, timeStamp, textEvent, deletedAt FROM events "
+               "WHERE deletedAt IS NOT NULL ORDER BY deletedAt DESC, eventID DESC";
+    }
+};
+
+struct InsertAttachment
+{
+    typedef SqlTuple<qint64, QString, QString, QString> Params;   // eventID, kind, path, sha1
+    typedef SqlTuple<> Row;
+    static const char *sql()
+    {
+        return "INSERT INTO attachments (eventID, kind, path, sha1) VALUES (?, ?, ?, ?)";
+    }
+};
+
+// Summaries of the days and months in a range: day or month, entries, words, characters.
+// Days are local Julian day numbers (QDate::toJulianDay()), months are yyyymm.
+struct DailyStats
+{
+    typedef SqlTuple<int, int> Params;                   // first day, last day
+    typedef SqlTuple<int, int, qint64, qint64> Row;
+    static const char *sql()
+    {
+        return "SELECT day, entries, words, characters FROM stats_daily "
+               "WHERE day BETWEEN ? AND ? AND entries > 0 ORDER BY day";
+    }
+};
+
+struct MonthlyStats
+{
+    typedef SqlTuple<int, int> Params;                   // first month, last month
+    typedef SqlTuple<int, int, qint64, qint64> Row;
+    static const char *sql()
+    {
+        return "SELECT month, entries, words, characters FROM stats_monthly "
+               "WHERE month BETWEEN ? AND ? AND entries > 0 ORDER BY month";
+    }
+};
+
+// Every change to the events or their tags is logged under a new seq (schema v8).
+struct LastChangeSeq
+{
+    typedef SqlTuple<> Params;
+    typedef SqlTuple<qint64> Row;
+    static const char *sql()
+    {
+        return "SELECT seq FROM sqlite_sequence WHERE name = 'changes'";
+    }
+};
+
+#endif /* JOURNALQUERIES_HPP_ */
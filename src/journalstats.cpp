@@ -0,0 +1,89 @@
+/*
+ * journalstats.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "journalstats.hpp"
+#include "journalqueries.hpp"
+
+JournalStats::JournalStats(const QSqlDatabase &database)
+    : m_database(database)
+{
+}
+
+QString JournalStats::lastError() const
+{
+    return m_lastError;
+}
+
+WritingStats JournalStats::summarize(const QDate &from, const QDate &to)
+{
+    WritingStats stats;
+    m_lastError.clear();
+    if (!from.isValid() || !to.isValid() || from > to)
+        return stats;
+
+    const int firstDay = from.toJulianDay();
+    const int lastDay = to.toJulianDay();
+    stats.days = lastDay - firstDay + 1;
+
+    TypedQuery<DailyStats> query;
+    if (!query.prepare(sqliteHandle(m_database)) || !query.exec(firstDay, lastDay)) {
+        m_lastError = query.lastError();
+        return stats;
+    }
+
+    // Days come in order and only days with entries are returned, so a gap
+    // between two rows ends a streak.
+    DailyStats::Row row;
+    int previousDay = 0;
+    int streak = 0;
+    while (query.next(row)) {
+        ++stats.activeDays;
+        stats.entries += row.second;
+        stats.words += row.third;
+        stats.characters += row.fourth;
+
+        streak = (streak > 0 && row.first == previousDay + 1) ? streak + 1 : 1;
+        stats.longestStreak = qMax(stats.longestStreak, streak);
+        previousDay = row.first;
+    }
+    if (!query.lastError().isEmpty()) {
+        m_lastError = query.lastError();
+        return WritingStats();
+    }
+
+    // Today does not break the streak before the first entry is written.
+    if (streak > 0 && previousDay >= lastDay - 1)
+        stats.currentStreak = streak;
+    stats.wordsPerDay = double(stats.words) / stats.days;
+    return stats;
+}
+
+QList<MonthStats> JournalStats::months(const QDate &from, const QDate &to)
+{
+    QList<MonthStats> months;
+    m_lastError.clear();
+    if (!from.isValid() || !to.isValid() || from > to)
+        return months;
+
+    TypedQuery<MonthlyStats> query;
+    if (!query.prepare(sqliteHandle(m_database))
+        || !query.exec(from.year() * 100 + from.month(), to.year() * 100 + to.month())) {
+        m_lastError = query.lastError();
+        return months;
+    }
+
+    MonthlyStats::Row row;
+    while (query.next(row)) {
+        MonthStats month;
+        month.month = QDate(row.first / 100, row.first % 100, 1);
+        month.entries = row.second;
+        month.words = row.third;
+        month.characters = row.fourth;
+        months << month;
+    }
+    m_lastError = query.lastError();
+    return months;
+}
@@ -0,0 +1,64 @@
+/*
+ * journalstats.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef JOURNALSTATS_HPP_
+#define JOURNALSTATS_HPP_
+
+#include <QDate>
+#include <QList>
+#include <QString>
+#include <QtSql/QSqlDatabase>
+
+struct WritingStats
+{
+    WritingStats()
+        : days(0), activeDays(0), entries(0), words(0), characters(0),
+          wordsPerDay(0), longestStreak(0), currentStreak(0) {}
+
+    int days;             // days in the range
+    int activeDays;       // days with at least one entry
+    int entries;
+    qint64 words;
+    qint64 characters;
+    double wordsPerDay;   // over all days of the range
+    int longestStreak;    // consecutive active days
+    int currentStreak;    // active days up to the end of the range (or the day before)
+};
+
+struct MonthStats
+{
+    MonthStats() : entries(0), words(0), characters(0) {}
+
+    QDate month;          // the first of the month
+    int entries;
+    qint64 words;
+    qint64 characters;
+};
+
+/*
+ * @brief Writing statistics of the journal.
+ *
+ * Answers from the stats_daily and stats_monthly tables, which triggers on
+ * the events table keep up to date (schema v9), so the cost depends on the
+ * number of days asked for, not on the number of entries.
+ */
+class JournalStats
+{
+public:
+    JournalStats(const QSqlDatabase &database);
+
+    WritingStats summarize(const QDate &from, const QDate &to);
+    QList<MonthStats> months(const QDate &from, const QDate &to);
+
+    QString lastError() const;
+
+private:
+    QSqlDatabase m_database;
+    QString m_lastError;
+};
+
+#endif /* JOURNALSTATS_HPP_ */
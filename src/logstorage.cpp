@@ -0,0 +1,692 @@
+/*
+ * logstorage.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "logstorage.hpp"
+#include "EventData.hpp"
+
+#include <QDir>
+#include <QMutexLocker>
+#include <QtConcurrentRun>
+#include <QtEndian>
+#include <QtDebug>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define LOG_INDEX_STRIDE 32
+#define LOG_INDEX_GROWTH 1024
+#define LOG_INDEX_HEADER 32
+#define LOG_INDEX_ENTRY 8
+#define LOG_RECORD_HEADER 8
+#define LOG_RECORD_MIN_PAYLOAD 24
+#define LOG_SEGMENT_MAX_BYTES (4 * 1024 * 1024)
+#define LOG_SEGMENT_SMALL_BYTES (256 * 1024)
+
+static const quint32 LOG_INDEX_MAGIC = 0x494c5744; // "DWLI"
+static const quint32 LOG_INDEX_VERSION = 1;
+
+// Index header layout (little endian u32 fields)
+enum { HeaderMagic = 0, HeaderVersion = 4, HeaderStride = 8, HeaderEntries = 12, HeaderDirty = 16 };
+
+// -----------------------------------------------------------------------------------------------
+// Record encoding
+
+static QByteArray encodeRecord(qint64 eventId, qint64 createdAt,
+                               const QString &timeStamp, const QString &textEvent)
+{
+    const QByteArray stamp = timeStamp.toUtf8();
+    const QByteArray text = textEvent.toUtf8();
+    const quint32 payloadLength = LOG_RECORD_MIN_PAYLOAD + stamp.size() + text.size();
+
+    QByteArray bytes;
+    bytes.resize(LOG_RECORD_HEADER + payloadLength);
+    uchar *data = reinterpret_cast<uchar *>(bytes.data());
+    uchar *p = data + LOG_RECORD_HEADER;
+
+    qToLittleEndian<qint64>(eventId, p);                 p += 8;
+    qToLittleEndian<qint64>(createdAt, p);               p += 8;
+    qToLittleEndian<quint32>(stamp.size(), p);           p += 4;
+    memcpy(p, stamp.constData(), stamp.size());          p += stamp.size();
+    qToLittleEndian<quint32>(text.size(), p);            p += 4;
+    memcpy(p, text.constData(), text.size());
+
+    qToLittleEndian<quint32>(payloadLength, data);
+    qToLittleEndian<quint32>(crc32(0, data + LOG_RECORD_HEADER, payloadLength), data + 4);
+    return bytes;
+}
+
+static bool decodeRecord(const uchar *p, quint32 length, EventRecord *record)
+{
+    const uchar *end = p + length;
+
+    record->eventId = qFromLittleEndian<qint64>(p);      p += 8;
+    record->createdAt = qFromLittleEndian<qint64>(p);    p += 8;
+
+    const quint32 stampLength = qFromLittleEndian<quint32>(p); p += 4;
+    if (stampLength > quint32(end - p) - 4)
+        return false;
+    record->timeStamp = QString::fromUtf8(reinterpret_cast<const char *>(p), stampLength);
+    p += stampLength;
+
+    const quint32 textLength = qFromLittleEndian<quint32>(p); p += 4;
+    if (textLength != quint32(end - p))
+        return false;
+    record->textEvent = QString::fromUtf8(reinterpret_cast<const char *>(p), textLength);
+    return true;
+}
+
+static bool syncFile(QFile *file)
+{
+    return file->flush() && fsync(file->handle()) == 0;
+}
+
+// -----------------------------------------------------------------------------------------------
+// LogStorage
+
+LogStorage::LogStorage(const QString &directory)
+    : m_directory(directory)
+    , m_activeId(0)
+    , m_indexMap(0)
+    , m_indexCapacity(0)
+    , m_count(0)
+    , m_lastEventId(0)
+{
+}
+
+LogStorage::~LogStorage()
+{
+    close();
+}
+
+QString LogStorage::segmentPath(quint32 id) const
+{
+    return QString("%1/segment-%2.log").arg(m_directory).arg(id, 8, 10, QChar('0'));
+}
+
+bool LogStorage::open()
+{
+    QMutexLocker locker(&m_lock);
+
+    if (!QDir().mkpath(m_directory)) {
+        m_lastError = QString("Cannot create %1").arg(m_directory);
+        return false;
+    }
+    if (!openIndex() || !finishInterruptedCompaction())
+        return false;
+
+    QDir dir(m_directory);
+    const QStringList names = dir.entryList(QStringList() << "segment-*.log", QDir::Files, QDir::Name);
+    for (int i = 0; i < names.size(); ++i) {
+        const quint32 id = names.at(i).mid(8, 8).toUInt();
+        Segment segment;
+        segment.id = id;
+        segment.file = new QFile(dir.filePath(names.at(i)));
+        segment.map = 0;
+        if (!segment.file->open(QIODevice::ReadWrite)) {
+            m_lastError = segment.file->errorString();
+            delete segment.file;
+            return false;
+        }
+        segment.size = segment.file->size();
+        m_segments.insert(id, segment);
+    }
+
+    // A dirty index means a compaction was interrupted while rows were being moved
+    // between segments; it is rebuilt from the segments, which are authoritative.
+    const bool rebuild = qFromLittleEndian<quint32>(m_indexMap + HeaderDirty) != 0;
+    if (!recover(rebuild))
+        return false;
+    setIndexDirty(false);
+
+    // All existing segments are sealed from here on; this session appends to a new one.
+    QMap<quint32, Segment>::iterator it = m_segments.begin();
+    while (it != m_segments.end()) {
+        Segment &segment = it.value();
+        segment.file->close();
+        if (segment.size == 0) {
+            segment.file->remove();
+            delete segment.file;
+            it = m_segments.erase(it);
+            continue;
+        }
+        segment.file->open(QIODevice::ReadOnly);
+        segment.map = segment.file->map(0, segment.size);
+        ++it;
+    }
+    m_activeId = 0;
+
+    // Short sessions leave small segments behind; fold them together off the UI thread.
+    compactInBackground();
+    return true;
+}
+
+void LogStorage::close()
+{
+    waitForCompaction();
+
+    QMutexLocker locker(&m_lock);
+
+    if (m_activeId)
+        syncFile(m_segments[m_activeId].file);
+    m_activeId = 0;
+
+    QMap<quint32, Segment>::iterator it;
+    for (it = m_segments.begin(); it != m_segments.end(); ++it) {
+        if (it.value().map)
+            it.value().file->unmap(it.value().map);
+        it.value().file->close();
+        delete it.value().file;
+    }
+    m_segments.clear();
+
+    if (m_indexMap) {
+        m_indexFile.unmap(m_indexMap);
+        m_indexMap = 0;
+    }
+    m_indexFile.close();
+    m_indexCapacity = 0;
+    m_count = 0;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Sparse index
+
+bool LogStorage::openIndex()
+{
+    m_indexFile.setFileName(m_directory + "/index.idx");
+    if (!m_indexFile.open(QIODevice::ReadWrite)) {
+        m_lastError = m_indexFile.errorString();
+        return false;
+    }
+
+    bool initialize = m_indexFile.size() < LOG_INDEX_HEADER;
+    if (initialize && !m_indexFile.resize(LOG_INDEX_HEADER + LOG_INDEX_GROWTH * LOG_INDEX_ENTRY)) {
+        m_lastError = m_indexFile.errorString();
+        return false;
+    }
+
+    m_indexMap = m_indexFile.map(0, m_indexFile.size());
+    if (!m_indexMap) {
+        m_lastError = m_indexFile.errorString();
+        return false;
+    }
+    m_indexCapacity = (m_indexFile.size() - LOG_INDEX_HEADER) / LOG_INDEX_ENTRY;
+
+    if (!initialize) {
+        initialize = qFromLittleEndian<quint32>(m_indexMap + HeaderMagic) != LOG_INDEX_MAGIC
+                  || qFromLittleEndian<quint32>(m_indexMap + HeaderVersion) != LOG_INDEX_VERSION
+                  || qFromLittleEndian<quint32>(m_indexMap + HeaderStride) != LOG_INDEX_STRIDE;
+    }
+    if (initialize) {
+        memset(m_indexMap, 0, LOG_INDEX_HEADER);
+        qToLittleEndian<quint32>(LOG_INDEX_MAGIC, m_indexMap + HeaderMagic);
+        qToLittleEndian<quint32>(LOG_INDEX_VERSION, m_indexMap + HeaderVersion);
+        qToLittleEndian<quint32>(LOG_INDEX_STRIDE, m_indexMap + HeaderStride);
+        // Whatever segments exist were written without this index.
+        qToLittleEndian<quint32>(1, m_indexMap + HeaderDirty);
+    }
+    return true;
+}
+
+bool LogStorage::growIndex(int entries)
+{
+    if (entries <= m_indexCapacity)
+        return true;
+
+    m_indexFile.unmap(m_indexMap);
+    const qint64 size = LOG_INDEX_HEADER + qint64(entries + LOG_INDEX_GROWTH) * LOG_INDEX_ENTRY;
+    const bool resized = m_indexFile.resize(size);
+    m_indexMap = m_indexFile.map(0, m_indexFile.size());
+    if (!resized || !m_indexMap) {
+        m_lastError = m_indexFile.errorString();
+        return false;
+    }
+    m_indexCapacity = (m_indexFile.size() - LOG_INDEX_HEADER) / LOG_INDEX_ENTRY;
+    return true;
+}
+
+int LogStorage::indexEntries() const
+{
+    return qFromLittleEndian<quint32>(m_indexMap + HeaderEntries);
+}
+
+LogStorage::Position LogStorage::indexEntry(int entry) const
+{
+    const uchar *p = m_indexMap + LOG_INDEX_HEADER + entry * LOG_INDEX_ENTRY;
+    Position position = { qFromLittleEndian<quint32>(p), qFromLittleEndian<quint32>(p + 4) };
+    return position;
+}
+
+void LogStorage::appendIndexEntry(const Position &position)
+{
+    const int entries = indexEntries();
+    if (!growIndex(entries + 1))
+        return;
+
+    // Entry first, count second: a torn update only loses the new entry,
+    // which recover() re-creates from the segment data.
+    uchar *p = m_indexMap + LOG_INDEX_HEADER + entries * LOG_INDEX_ENTRY;
+    qToLittleEndian<quint32>(position.segment, p);
+    qToLittleEndian<quint32>(position.offset, p + 4);
+    qToLittleEndian<quint32>(entries + 1, m_indexMap + HeaderEntries);
+}
+
+void LogStorage::setIndexDirty(bool dirty)
+{
+    qToLittleEndian<quint32>(dirty ? 1 : 0, m_indexMap + HeaderDirty);
+    msync(m_indexMap, LOG_INDEX_HEADER, MS_SYNC);
+}
+
+// -----------------------------------------------------------------------------------------------
+// Reading
+
+QByteArray LogStorage::readBytes(const Segment &segment, qint64 offset, qint64 length) const
+{
+    if (segment.map)
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(segment.map + offset), length);
+
+    segment.file->seek(offset);
+    return segment.file->read(length);
+}
+
+bool LogStorage::readRecord(const Position &position, EventRecord *record, quint32 *length)
+{
+    QMap<quint32, Segment>::const_iterator it = m_segments.constFind(position.segment);
+    if (it == m_segments.constEnd())
+        return false;
+
+    const Segment &segment = it.value();
+    if (position.offset + LOG_RECORD_HEADER > segment.size)
+        return false;
+
+    const QByteArray header = readBytes(segment, position.offset, LOG_RECORD_HEADER);
+    const uchar *h = reinterpret_cast<const uchar *>(header.constData());
+    const quint32 payloadLength = qFromLittleEndian<quint32>(h);
+    const quint32 checksum = qFromLittleEndian<quint32>(h + 4);
+
+    if (payloadLength < LOG_RECORD_MIN_PAYLOAD
+        || position.offset + LOG_RECORD_HEADER + qint64(payloadLength) > segment.size)
+        return false;
+
+    const QByteArray payload = readBytes(segment, position.offset + LOG_RECORD_HEADER, payloadLength);
+    const uchar *p = reinterpret_cast<const uchar *>(payload.constData());
+    if (quint32(payload.size()) != payloadLength || crc32(0, p, payloadLength) != checksum)
+        return false;
+
+    if (record && !decodeRecord(p, payloadLength, record))
+        return false;
+
+    *length = payloadLength;
+    return true;
+}
+
+bool LogStorage::advance(Position &position, quint32 length) const
+{
+    position.offset += LOG_RECORD_HEADER + length;
+
+    QMap<quint32, Segment>::const_iterator it = m_segments.constFind(position.segment);
+    while (it != m_segments.constEnd() && position.offset >= it.value().size) {
+        ++it;
+        if (it == m_segments.constEnd())
+            return false;
+        position.segment = it.key();
+        position.offset = 0;
+    }
+    return it != m_segments.constEnd();
+}
+
+bool LogStorage::seek(int row, Position &position)
+{
+    if (row < 0 || row >= m_count)
+        return false;
+
+    position = indexEntry(row / LOG_INDEX_STRIDE);
+    for (int skip = row % LOG_INDEX_STRIDE; skip > 0; --skip) {
+        quint32 length = 0;
+        if (!readRecord(position, 0, &length) || !advance(position, length))
+            return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Recovery
+
+bool LogStorage::finishInterruptedCompaction()
+{
+    QDir dir(m_directory);
+
+    // A .tmp file is an incomplete merge; the source segments are still intact.
+    const QStringList partial = dir.entryList(QStringList() << "*.tmp", QDir::Files);
+    for (int i = 0; i < partial.size(); ++i)
+        dir.remove(partial.at(i));
+
+    // A .merge file is complete. Finish replacing its source segments with it.
+    const QStringList merged = dir.entryList(QStringList() << "segment-*-*.merge", QDir::Files);
+    for (int i = 0; i < merged.size(); ++i) {
+        const QStringList ids = merged.at(i).mid(8).section('.', 0, 0).split('-');
+        const quint32 first = ids.value(0).toUInt();
+        const quint32 last = ids.value(1).toUInt();
+
+        for (quint32 id = first + 1; id <= last; ++id)
+            QFile::remove(segmentPath(id));
+        if (::rename(QFile::encodeName(dir.filePath(merged.at(i))).constData(),
+                     QFile::encodeName(segmentPath(first)).constData()) != 0) {
+            m_lastError = QString("Cannot finish compaction of %1").arg(merged.at(i));
+            return false;
+        }
+        setIndexDirty(true);
+    }
+    return true;
+}
+
+bool LogStorage::recover(bool rebuild)
+{
+    int entries = rebuild ? 0 : indexEntries();
+
+    // Drop index entries that point past what actually reached the segments.
+    quint32 length = 0;
+    while (entries > 0 && !readRecord(indexEntry(entries - 1), 0, &length))
+        --entries;
+    qToLittleEndian<quint32>(entries, m_indexMap + HeaderEntries);
+
+    m_count = 0;
+    m_lastEventId = 0;
+    if (m_segments.isEmpty())
+        return true;
+
+    Position position;
+    int row = 0;
+    if (entries > 0) {
+        position = indexEntry(entries - 1);
+        row = (entries - 1) * LOG_INDEX_STRIDE;
+    } else {
+        position.segment = m_segments.constBegin().key();
+        position.offset = 0;
+    }
+
+    // Walk the records after the last indexed one, re-creating missing index
+    // entries and cutting off a torn tail left by a crash during an append.
+    for (;;) {
+        EventRecord record;
+        if (!readRecord(position, &record, &length)) {
+            Segment &segment = m_segments[position.segment];
+            if (position.offset < segment.size) {
+                qWarning() << "LogStorage: truncating" << segment.file->fileName()
+                           << "at" << position.offset << "of" << segment.size;
+                segment.file->resize(position.offset);
+                segment.size = position.offset;
+            }
+            QMap<quint32, Segment>::const_iterator next = m_segments.constFind(position.segment) + 1;
+            if (next == m_segments.constEnd())
+                break;
+            position.segment = next.key();
+            position.offset = 0;
+            continue;
+        }
+
+        if (row % LOG_INDEX_STRIDE == 0 && row / LOG_INDEX_STRIDE >= indexEntries())
+            appendIndexEntry(position);
+
+        m_lastEventId = record.eventId;
+        ++row;
+        if (!advance(position, length))
+            break;
+    }
+
+    m_count = row;
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Writing
+
+bool LogStorage::startActiveSegment()
+{
+    const quint32 id = m_segments.isEmpty() ? 1 : (m_segments.constEnd() - 1).key() + 1;
+
+    Segment segment;
+    segment.id = id;
+    segment.file = new QFile(segmentPath(id));
+    segment.map = 0;
+    segment.size = 0;
+    if (!segment.file->open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        m_lastError = segment.file->errorString();
+        delete segment.file;
+        return false;
+    }
+
+    m_segments.insert(id, segment);
+    m_activeId = id;
+    return true;
+}
+
+void LogStorage::sealActiveSegment()
+{
+    Segment &segment = m_segments[m_activeId];
+    syncFile(segment.file);
+    segment.file->close();
+    segment.file->open(QIODevice::ReadOnly);
+    segment.map = segment.file->map(0, segment.size);
+    m_activeId = 0;
+}
+
+qint64 LogStorage::addRecord(const QString &timeStamp, const QString &textEvent,
+                             Durability durability)
+{
+    QMutexLocker locker(&m_lock);
+
+    if (!m_indexMap) {
+        m_lastError = "Log storage is not open";
+        return -1;
+    }
+    if (!m_activeId && !startActiveSegment())
+        return -1;
+
+    Segment &segment = m_segments[m_activeId];
+    const qint64 eventId = m_lastEventId + 1;
+    const QByteArray bytes = encodeRecord(eventId, eventTimeFromString(timeStamp), timeStamp, textEvent);
+
+    // Buffered records stay in the file's write buffer.
+    segment.file->seek(segment.size);
+    if (segment.file->write(bytes) != bytes.size()
+        || (durability == Flushed && !segment.file->flush())
+        || (durability == Synced && !syncFile(segment.file))) {
+        m_lastError = segment.file->errorString();
+        segment.file->resize(segment.size);
+        return -1;
+    }
+
+    const Position position = { m_activeId, quint32(segment.size) };
+    if (m_count % LOG_INDEX_STRIDE == 0)
+        appendIndexEntry(position);
+
+    segment.size += bytes.size();
+    ++m_count;
+    m_lastEventId = eventId;
+
+    if (segment.size >= LOG_SEGMENT_MAX_BYTES)
+        sealActiveSegment();
+    return eventId;
+}
+
+bool LogStorage::updateRecord(qint64 eventId, const QString &textEvent, Durability durability)
+{
+    Q_UNUSED(textEvent);
+    Q_UNUSED(durability);
+
+    // Records are immutable once written.
+    m_lastError = QString("Log storage is append-only, event %1 cannot be edited").arg(eventId);
+    return false;
+}
+
+bool LogStorage::flush()
+{
+    QMutexLocker locker(&m_lock);
+
+    if (!m_activeId || syncFile(m_segments[m_activeId].file))
+        return true;
+    m_lastError = m_segments[m_activeId].file->errorString();
+    return false;
+}
+
+int LogStorage::count()
+{
+    QMutexLocker locker(&m_lock);
+    return m_count;
+}
+
+bool LogStorage::event(int row, EventRecord &record)
+{
+    QMutexLocker locker(&m_lock);
+
+    Position position;
+    quint32 length = 0;
+    return seek(row, position) && readRecord(position, &record, &length);
+}
+
+QList<EventRecord> LogStorage::range(int firstRow, int count)
+{
+    QMutexLocker locker(&m_lock);
+
+    QList<EventRecord> records;
+    Position position;
+    if (!seek(firstRow, position))
+        return records;
+
+    const int last = qMin(firstRow + count, m_count);
+    for (int row = firstRow; row < last; ++row) {
+        EventRecord record;
+        quint32 length = 0;
+        if (!readRecord(position, &record, &length))
+            break;
+        records << record;
+        if (!advance(position, length))
+            break;
+    }
+    return records;
+}
+
+QString LogStorage::lastError() const
+{
+    return m_lastError;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Compaction
+
+void LogStorage::compactInBackground()
+{
+    if (m_compaction.isRunning())
+        return;
+    m_compaction = QtConcurrent::run(this, &LogStorage::compact);
+}
+
+void LogStorage::waitForCompaction()
+{
+    m_compaction.waitForFinished();
+}
+
+void LogStorage::compact()
+{
+    // 1. Pick the first run of adjacent small sealed segments that fits in one segment.
+    QList<Segment> run;
+    qint64 runBytes = 0;
+    {
+        QMutexLocker locker(&m_lock);
+        QMap<quint32, Segment>::const_iterator it;
+        for (it = m_segments.constBegin(); it != m_segments.constEnd(); ++it) {
+            const Segment &segment = it.value();
+            const bool small = segment.id != m_activeId && segment.size < LOG_SEGMENT_SMALL_BYTES;
+            if (small && runBytes + segment.size <= LOG_SEGMENT_MAX_BYTES) {
+                run << segment;
+                runBytes += segment.size;
+                continue;
+            }
+            if (run.size() >= 2)
+                break;
+            run.clear();
+            runBytes = 0;
+            if (small) {
+                run << segment;
+                runBytes = segment.size;
+            }
+        }
+    }
+    if (run.size() < 2)
+        return;
+
+    // 2. Concatenate them into a new file. Records are self-describing, so a merged
+    //    segment is just the source segments back to back. Sealed segments are
+    //    immutable and only compaction unmaps them, so no lock is needed here.
+    const quint32 first = run.first().id;
+    const quint32 last = run.last().id;
+    const QString base = QString("%1/segment-%2-%3").arg(m_directory)
+                         .arg(first, 8, 10, QChar('0')).arg(last, 8, 10, QChar('0'));
+    QFile merged(base + ".tmp");
+    if (!merged.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+
+    QMap<quint32, quint32> shift;
+    for (int i = 0; i < run.size(); ++i) {
+        shift.insert(run.at(i).id, quint32(merged.pos()));
+        if (merged.write(reinterpret_cast<const char *>(run.at(i).map), run.at(i).size) != run.at(i).size) {
+            merged.remove();
+            return;
+        }
+    }
+    if (!syncFile(&merged)) {
+        merged.remove();
+        return;
+    }
+    merged.close();
+    if (!merged.rename(base + ".merge")) {
+        merged.remove();
+        return;
+    }
+
+    // 3. Swap the merged segment in and re-point the index. From here on an
+    //    interrupted swap is finished by finishInterruptedCompaction() on open.
+    QMutexLocker locker(&m_lock);
+    setIndexDirty(true);
+
+    for (int i = 0; i < run.size(); ++i) {
+        Segment &segment = m_segments[run.at(i).id];
+        segment.file->unmap(segment.map);
+        segment.file->close();
+        if (segment.id != first)
+            segment.file->remove();
+        delete segment.file;
+        m_segments.remove(run.at(i).id);
+    }
+    ::rename(QFile::encodeName(base + ".merge").constData(),
+             QFile::encodeName(segmentPath(first)).constData());
+
+    Segment segment;
+    segment.id = first;
+    segment.file = new QFile(segmentPath(first));
+    segment.file->open(QIODevice::ReadOnly);
+    segment.size = segment.file->size();
+    segment.map = segment.file->map(0, segment.size);
+    m_segments.insert(first, segment);
+
+    const int entries = indexEntries();
+    for (int i = 0; i < entries; ++i) {
+        uchar *p = m_indexMap + LOG_INDEX_HEADER + i * LOG_INDEX_ENTRY;
+        const quint32 id = qFromLittleEndian<quint32>(p);
+        if (shift.contains(id)) {
+            qToLittleEndian<quint32>(first, p);
+            qToLittleEndian<quint32>(qFromLittleEndian<quint32>(p + 4) + shift.value(id), p + 4);
+        }
+    }
+    msync(m_indexMap, LOG_INDEX_HEADER + entries * LOG_INDEX_ENTRY, MS_SYNC);
+    setIndexDirty(false);
+
+    qDebug() << "LogStorage: merged segments" << first << "to" << last << "," << runBytes << "bytes";
+}
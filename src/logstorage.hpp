@@ -0,0 +1,107 @@
+/*
+ * logstorage.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef LOGSTORAGE_HPP_
+#define LOGSTORAGE_HPP_
+
+#include "storagebackend.hpp"
+
+#include <QFile>
+#include <QFuture>
+#include <QMap>
+#include <QMutex>
+
+/*
+ * @brief Append-only, log-structured entry store.
+ *
+ * A journal is appended to and read, almost never updated, so entries are
+ * written one after the other into segment files:
+ *
+ *   [u32 payload length][u32 crc32 of payload][payload]
+ *
+ * Every session appends to a fresh segment, so older segments are immutable
+ * and are memory-mapped for reading. A sparse index (one entry per
+ * LOG_INDEX_STRIDE rows) is kept in a memory-mapped file and gives positional
+ * access with at most LOG_INDEX_STRIDE - 1 records skipped. Small segments
+ * left behind by short sessions are merged by a background compaction.
+ */
+class LogStorage : public StorageBackend
+{
+public:
+    LogStorage(const QString &directory);
+    virtual ~LogStorage();
+
+    virtual bool open();
+    virtual void close();
+
+    virtual qint64 addRecord(const QString &timeStamp, const QString &textEvent,
+                             Durability durability = Synced);
+    virtual bool updateRecord(qint64 eventId, const QString &textEvent,
+                              Durability durability = Synced);
+    virtual bool flush();
+
+    virtual int count();
+    virtual bool event(int row, EventRecord &record);
+    virtual QList<EventRecord> range(int firstRow, int count);
+
+    virtual QString lastError() const;
+
+    // Merges runs of small sealed segments on a worker thread.
+    void compactInBackground();
+    void waitForCompaction();
+
+private:
+    struct Segment
+    {
+        quint32 id;
+        QFile *file;
+        uchar *map;      // 0 for the active segment, which is still growing
+        qint64 size;
+    };
+
+    struct Position
+    {
+        quint32 segment;
+        quint32 offset;
+    };
+
+    QString segmentPath(quint32 id) const;
+    bool openIndex();
+    bool growIndex(int entries);
+    int indexEntries() const;
+    Position indexEntry(int entry) const;
+    void appendIndexEntry(const Position &position);
+    void setIndexDirty(bool dirty);
+
+    bool finishInterruptedCompaction();
+    bool recover(bool rebuild);
+    bool readRecord(const Position &position, EventRecord *record, quint32 *length);
+    bool advance(Position &position, quint32 length) const;
+    QByteArray readBytes(const Segment &segment, qint64 offset, qint64 length) const;
+    bool seek(int row, Position &position);
+
+    bool startActiveSegment();
+    void sealActiveSegment();
+    void compact();
+
+    QString m_directory;
+    QMap<quint32, Segment> m_segments;
+    quint32 m_activeId;            // 0 when no segment was written this session
+
+    QFile m_indexFile;
+    uchar *m_indexMap;
+    int m_indexCapacity;
+
+    int m_count;
+    qint64 m_lastEventId;
+
+    QMutex m_lock;
+    QFuture<void> m_compaction;
+    QString m_lastError;
+};
+
+#endif /* LOGSTORAGE_HPP_ */
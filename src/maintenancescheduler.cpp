@@ -0,0 +1,378 @@
+/*
+ * maintenancescheduler.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "maintenancescheduler.hpp"
+#include "iovfs.hpp"
+#include "trashstore.hpp"
+
+#include <QDateTime>
+#include <QThread>
+#include <QtSql/QtSql>
+
+#include <sqlite3.h>
+#include <unistd.h>
+
+#define MAINTENANCE_CONNECTION "DWriter-maintenance"
+#define MAINTENANCE_SLICE_MS 50
+#define MAINTENANCE_SLICE_PAUSE_MS 10
+#define MAINTENANCE_POLL_MS 1000
+#define MAINTENANCE_IDLE_SECONDS 30
+#define MAINTENANCE_RECHECK_SECONDS 300
+
+// Thresholds for choosing the next task
+#define MAINTENANCE_FREELIST_RATIO 0.10      // incremental vacuum
+#define MAINTENANCE_CONVERT_RATIO 0.20       // one-off full VACUUM, background only
+#define MAINTENANCE_ANALYZE_GROWTH 0.10
+#define MAINTENANCE_ANALYZE_AGE (7 * 24 * 3600)
+#define MAINTENANCE_OPTIMIZE_AGE (24 * 3600)
+
+#define MAINTENANCE_VACUUM_MIN_PAGES 8
+#define MAINTENANCE_VACUUM_MAX_PAGES 4096
+#define MAINTENANCE_PURGE_MIN_ROWS 16
+#define MAINTENANCE_PURGE_MAX_ROWS 1024
+
+static qint64 pragmaValue(QSqlDatabase &database, const QString &pragma)
+{
+    QSqlQuery query(database);
+    if (query.exec("PRAGMA " + pragma) && query.next())
+        return query.value(0).toLongLong();
+    return 0;
+}
+
+static qint64 eventCount(QSqlDatabase &database)
+{
+    QSqlQuery query(database);
+    if (query.exec("SELECT COUNT(*) FROM events") && query.next())
+        return query.value(0).toLongLong();
+    return 0;
+}
+
+// -----------------------------------------------------------------------------------------------
+// MaintenanceScheduler
+
+MaintenanceScheduler::MaintenanceScheduler(const QString &databaseName, QObject *parent)
+    : QObject(parent)
+    , m_databaseName(databaseName)
+    , m_thread(0)
+    , m_worker(0)
+{
+}
+
+MaintenanceScheduler::~MaintenanceScheduler()
+{
+    stop();
+}
+
+void MaintenanceScheduler::start()
+{
+    if (m_thread && m_thread->isRunning())
+        return;
+    stop();
+
+    m_thread = new QThread(this);
+    m_worker = new MaintenanceWorker(m_databaseName);
+    m_worker->moveToThread(m_thread);
+
+    connect(m_thread, SIGNAL(started()), m_worker, SLOT(run()));
+    connect(m_worker, SIGNAL(finished()), m_thread, SLOT(quit()));
+    connect(m_worker, SIGNAL(taskFinished(const QString&, int)),
+            this, SIGNAL(taskFinished(const QString&, int)));
+
+    m_thread->start(QThread::IdlePriority);
+}
+
+void MaintenanceScheduler::stop()
+{
+    if (!m_thread)
+        return;
+
+    m_worker->stop();
+    m_thread->quit();
+    m_thread->wait();
+
+    delete m_worker;
+    m_worker = 0;
+    delete m_thread;
+    m_thread = 0;
+}
+
+void MaintenanceScheduler::notifyActivity()
+{
+    if (m_worker)
+        m_worker->notifyActivity();
+}
+
+void MaintenanceScheduler::setBackground(bool background)
+{
+    if (m_worker)
+        m_worker->setBackground(background);
+}
+
+QList<MaintenanceStats> MaintenanceScheduler::stats(QSqlDatabase database)
+{
+    QList<MaintenanceStats> list;
+    QSqlQuery query(database);
+    if (!query.exec("SELECT task, lastRun, runs, lastMs, totalMs FROM maintenance ORDER BY task"))
+        return list;
+    while (query.next()) {
+        MaintenanceStats stats;
+        stats.task = query.value(0).toString();
+        stats.lastRun = query.value(1).toLongLong();
+        stats.runs = query.value(2).toInt();
+        stats.lastMs = query.value(3).toInt();
+        stats.totalMs = query.value(4).toLongLong();
+        list << stats;
+    }
+    return list;
+}
+
+// -----------------------------------------------------------------------------------------------
+// MaintenanceWorker
+
+MaintenanceWorker::MaintenanceWorker(const QString &databaseName)
+    : m_databaseName(databaseName)
+    , m_stopRequested(0)
+    , m_background(0)
+    , m_lastActivity(0)
+    , m_interrupted(0)
+    , m_handle(0)
+    , m_vacuumPages(64)
+    , m_purgeRows(64)
+    , m_taskMs(0)
+{
+    m_clock.start();
+}
+
+void MaintenanceWorker::stop()
+{
+    m_stopRequested.fetchAndStoreOrdered(1);
+}
+
+void MaintenanceWorker::notifyActivity()
+{
+    m_lastActivity.fetchAndStoreOrdered(int(m_clock.elapsed() / 1000));
+
+    // Only while a slice runs; the handle stays valid until run() returns.
+    sqlite3 *handle = m_handle;
+    if (handle) {
+        m_interrupted.fetchAndStoreOrdered(1);
+        sqlite3_interrupt(handle);
+    }
+}
+
+void MaintenanceWorker::setBackground(bool background)
+{
+    m_background.fetchAndStoreOrdered(background ? 1 : 0);
+}
+
+bool MaintenanceWorker::isIdle() const
+{
+    return m_background
+        || m_clock.elapsed() / 1000 - m_lastActivity >= MAINTENANCE_IDLE_SECONDS;
+}
+
+void MaintenanceWorker::run()
+{
+    IoScope io("maintenance");
+    {
+        QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", MAINTENANCE_CONNECTION);
+        database.setDatabaseName(m_databaseName);
+        database.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+
+        if (!database.open()) {
+            qWarning() << "Maintenance could not open the database:" << database.lastError().text();
+        } else {
+            qint64 nextCheck = 0;
+            while (!m_stopRequested) {
+                if (!isIdle() || (m_task.isEmpty() && m_clock.elapsed() < nextCheck)) {
+                    usleep(MAINTENANCE_POLL_MS * 1000);
+                    continue;
+                }
+
+                if (m_task.isEmpty()) {
+                    m_task = nextTask(database);
+                    m_taskMs = 0;
+                    if (m_task.isEmpty()) {
+                        nextCheck = m_clock.elapsed() + MAINTENANCE_RECHECK_SECONDS * 1000;
+                        continue;
+                    }
+                }
+
+                bool done = false;
+                if (!runSlice(database, m_task, &done)) {
+                    qWarning() << "Maintenance task" << m_task << "failed:" << database.lastError().text();
+                    m_task.clear();
+                    m_pendingTables.clear();
+                    nextCheck = m_clock.elapsed() + MAINTENANCE_RECHECK_SECONDS * 1000;
+                } else if (done) {
+                    record(database, m_task, m_taskMs);
+                    emit taskFinished(m_task, m_taskMs);
+                    m_task.clear();
+                }
+                usleep(MAINTENANCE_SLICE_PAUSE_MS * 1000);
+            }
+            database.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(MAINTENANCE_CONNECTION);
+
+    emit finished();
+}
+
+QString MaintenanceWorker::nextTask(QSqlDatabase &database)
+{
+    const qint64 now = QDateTime::currentDateTime().toTime_t();
+
+    // 1. Entries whose time in the trash is up; purging frees pages as it goes.
+    if (TrashStore(database).hasExpired(TrashStore::expiryCutoff(now)))
+        return "purge";
+
+    // 2. Fragmentation next: free pages make every scan longer.
+    const qint64 pages = pragmaValue(database, "page_count");
+    const qint64 freePages = pragmaValue(database, "freelist_count");
+    const double ratio = pages > 0 ? double(freePages) / pages : 0.0;
+    if (ratio >= MAINTENANCE_FREELIST_RATIO) {
+        const bool incremental = pragmaValue(database, "auto_vacuum") == 2;
+        if (incremental || (m_background && ratio >= MAINTENANCE_CONVERT_RATIO))
+            return "vacuum";
+    }
+
+    qint64 analyzedAt = 0;
+    qint64 analyzedRows = 0;
+    qint64 optimizedAt = 0;
+    QSqlQuery query(database);
+    if (query.exec("SELECT task, lastRun, rowsAtRun FROM maintenance")) {
+        while (query.next()) {
+            if (query.value(0).toString() == "analyze") {
+                analyzedAt = query.value(1).toLongLong();
+                analyzedRows = query.value(2).toLongLong();
+            } else if (query.value(0).toString() == "optimize") {
+                optimizedAt = query.value(1).toLongLong();
+            }
+        }
+    }
+
+    // 3. Planner statistics, once the journal has grown or changed since the last run.
+    const qint64 rows = eventCount(database);
+    if (!analyzedAt || rows > analyzedRows * (1.0 + MAINTENANCE_ANALYZE_GROWTH) + 100
+        || (now - analyzedAt > MAINTENANCE_ANALYZE_AGE && rows != analyzedRows))
+        return "analyze";
+
+    if (now - optimizedAt > MAINTENANCE_OPTIMIZE_AGE)
+        return "optimize";
+
+    return QString();
+}
+
+bool MaintenanceWorker::runSlice(QSqlDatabase &database, const QString &task, bool *done)
+{
+    sqlite3 *handle = 0;
+    const QVariant driverHandle = database.driver()->handle();
+    if (driverHandle.isValid() && qstrcmp(driverHandle.typeName(), "sqlite3*") == 0)
+        handle = *static_cast<sqlite3 * const *>(driverHandle.constData());
+
+    m_interrupted.fetchAndStoreOrdered(0);
+    m_handle.fetchAndStoreOrdered(handle);
+
+    QElapsedTimer timer;
+    timer.start();
+    QSqlQuery query(database);
+    bool ok = true;
+    *done = false;
+
+    if (task == "vacuum") {
+        if (pragmaValue(database, "auto_vacuum") != 2) {
+            // Switching modes takes a full rewrite; nextTask() only asks for
+            // it in the background, and foreground activity still interrupts it.
+            ok = query.exec("PRAGMA auto_vacuum = INCREMENTAL") && query.exec("VACUUM");
+            *done = ok;
+        } else {
+            // Every step of the pragma frees a page, so the result set is drained.
+            ok = query.exec(QString("PRAGMA incremental_vacuum(%1)").arg(m_vacuumPages));
+            while (ok && query.next()) {}
+            query.finish();
+
+            // Size the next slice to fit the time box.
+            const qint64 elapsed = timer.elapsed();
+            if (elapsed < MAINTENANCE_SLICE_MS / 2)
+                m_vacuumPages = qMin(m_vacuumPages * 2, MAINTENANCE_VACUUM_MAX_PAGES);
+            else if (elapsed > MAINTENANCE_SLICE_MS)
+                m_vacuumPages = qMax(m_vacuumPages / 2, MAINTENANCE_VACUUM_MIN_PAGES);
+            *done = ok && pragmaValue(database, "freelist_count") == 0;
+        }
+    } else if (task == "purge") {
+        TrashStore trash(database);
+        const qint64 now = QDateTime::currentDateTime().toTime_t();
+        const int batch = m_purgeRows;
+        const int purged = trash.purge(TrashStore::expiryCutoff(now), batch);
+        ok = purged >= 0;
+
+        // What the batch freed goes back to the file system while the slice has time left.
+        if (ok && timer.elapsed() < MAINTENANCE_SLICE_MS && pragmaValue(database, "auto_vacuum") == 2) {
+            ok = query.exec(QString("PRAGMA incremental_vacuum(%1)").arg(m_vacuumPages));
+            while (ok && query.next()) {}
+            query.finish();
+        }
+
+        const qint64 elapsed = timer.elapsed();
+        if (elapsed < MAINTENANCE_SLICE_MS / 2)
+            m_purgeRows = qMin(m_purgeRows * 2, MAINTENANCE_PURGE_MAX_ROWS);
+        else if (elapsed > MAINTENANCE_SLICE_MS)
+            m_purgeRows = qMax(m_purgeRows / 2, MAINTENANCE_PURGE_MIN_ROWS);
+        *done = ok && purged < batch;
+        if (!ok && !trash.lastError().isEmpty())
+            qWarning() << "Maintenance purge:" << trash.lastError();
+    } else if (task == "analyze") {
+        if (m_pendingTables.isEmpty()) {
+            ok = query.exec("SELECT name FROM sqlite_master "
+                            "WHERE type = 'table' AND name NOT LIKE 'sqlite_%'");
+            while (ok && query.next())
+                m_pendingTables << query.value(0).toString();
+            query.finish();
+        }
+        // One table per slice.
+        if (ok && !m_pendingTables.isEmpty()) {
+            ok = query.exec(QString("ANALYZE \"%1\"").arg(m_pendingTables.first()));
+            if (ok)
+                m_pendingTables.removeFirst();
+        }
+        *done = ok && m_pendingTables.isEmpty();
+    } else if (task == "optimize") {
+        // A no-op on SQLite versions that predate the pragma.
+        ok = query.exec("PRAGMA optimize");
+        *done = ok;
+    } else {
+        *done = true;
+    }
+
+    m_handle.fetchAndStoreOrdered(0);
+    m_taskMs += int(timer.elapsed());
+
+    // Interrupted by a foreground query: not an error, the slice runs again later.
+    if (!ok && m_interrupted)
+        return true;
+    return ok;
+}
+
+void MaintenanceWorker::record(QSqlDatabase &database, const QString &task, int milliseconds)
+{
+    QSqlQuery query(database);
+    query.prepare("INSERT OR IGNORE INTO maintenance (task) VALUES(:task)");
+    query.bindValue(":task", task);
+    query.exec();
+
+    query.prepare("UPDATE maintenance SET lastRun = :lastRun, runs = runs + 1, lastMs = :lastMs, "
+                  "totalMs = totalMs + :addMs, rowsAtRun = :rows WHERE task = :task");
+    query.bindValue(":lastRun", QDateTime::currentDateTime().toTime_t());
+    query.bindValue(":lastMs", milliseconds);
+    query.bindValue(":addMs", milliseconds);
+    query.bindValue(":rows", eventCount(database));
+    query.bindValue(":task", task);
+    if (!query.exec())
+        qWarning() << "Maintenance stats:" << query.lastError().text();
+
+    qDebug() << "Maintenance task" << task << "took" << milliseconds << "ms";
+}
@@ -0,0 +1,125 @@
+/*
+ * maintenancescheduler.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef MAINTENANCESCHEDULER_HPP_
+#define MAINTENANCESCHEDULER_HPP_
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+#include <QList>
+#include <QStringList>
+#include <QtSql/QSqlDatabase>
+
+class QThread;
+class MaintenanceWorker;
+struct sqlite3;
+
+struct MaintenanceStats
+{
+    QString task;
+    qint64 lastRun;      // seconds since the epoch, 0 if never
+    int runs;
+    int lastMs;          // wall time of the last completed run, all slices
+    qint64 totalMs;
+};
+
+/*
+ * @brief Keeps the journal database in shape while nobody is using it.
+ *
+ * Tasks:
+ *  - purge     deletes the entries that have been in the trash for longer than
+ *              the retention, one batch per slice (see TrashStore), and hands
+ *              the pages they leave back with incremental_vacuum
+ *  - vacuum    returns free pages to the file system with PRAGMA
+ *              incremental_vacuum, a few pages per slice. A journal created
+ *              before incremental auto_vacuum is converted by one full VACUUM
+ *              the first time the app is in the background.
+ *  - analyze   refreshes the query planner statistics, one table per slice
+ *  - optimize  PRAGMA optimize
+ *
+ * What runs next is decided from the freelist ratio, the growth of the
+ * events table since the last ANALYZE and the time since each task last ran.
+ * Work is done in slices of about MAINTENANCE_SLICE_MS, only once the app has
+ * been idle for MAINTENANCE_IDLE_SECONDS or is in the background. Every
+ * foreground query calls notifyActivity(), which interrupts a running slice
+ * through sqlite3_interrupt(); an interrupted slice is simply retried later.
+ *
+ * Timings and "last run" are kept in the maintenance table.
+ */
+class MaintenanceScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    MaintenanceScheduler(const QString &databaseName, QObject *parent = 0);
+    ~MaintenanceScheduler();
+
+    void start();
+    void stop();
+
+    // Thread-safe and cheap; called for every foreground query.
+    void notifyActivity();
+    void setBackground(bool background);
+
+    static QList<MaintenanceStats> stats(QSqlDatabase database);
+
+Q_SIGNALS:
+    void taskFinished(const QString &task, int milliseconds);
+
+private:
+    QString m_databaseName;
+    QThread *m_thread;
+    MaintenanceWorker *m_worker;
+};
+
+/*
+ * Lives on the maintenance thread. The flags and the connection handle are
+ * shared with the UI thread through atomics.
+ */
+class MaintenanceWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    MaintenanceWorker(const QString &databaseName);
+
+    void stop();
+    void notifyActivity();
+    void setBackground(bool background);
+
+public Q_SLOTS:
+    void run();
+
+Q_SIGNALS:
+    void taskFinished(const QString &task, int milliseconds);
+    void finished();
+
+private:
+    bool isIdle() const;
+    QString nextTask(QSqlDatabase &database);
+    bool runSlice(QSqlDatabase &database, const QString &task, bool *done);
+    void record(QSqlDatabase &database, const QString &task, int milliseconds);
+
+    QString m_databaseName;
+    QAtomicInt m_stopRequested;
+    QAtomicInt m_background;
+    QAtomicInt m_lastActivity;         // seconds on m_clock
+    QAtomicInt m_interrupted;
+    QAtomicPointer<sqlite3> m_handle;  // set while a slice runs
+    QElapsedTimer m_clock;
+
+    // Progress of the task in hand, carried across slices
+    QString m_task;
+    QStringList m_pendingTables;
+    int m_vacuumPages;
+    int m_purgeRows;
+    int m_taskMs;
+};
+
+#endif /* MAINTENANCESCHEDULER_HPP_ */
@@ -0,0 +1,275 @@
+/*
+ * memorybudget.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "memorybudget.hpp"
+#include "typedquery.hpp"
+
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QtSql/QtSql>
+
+#define SQLITE_CACHE_MIN_PAGES 16
+
+// Each priority step doubles what a consumer's bytes count for.
+static double weightedValue(const MemoryConsumer *consumer)
+{
+    const int priority = qBound(-8, consumer->priority(), 8);
+    return consumer->valuePerByte() * (priority >= 0 ? double(1 << priority) : 1.0 / (1 << -priority));
+}
+
+// -----------------------------------------------------------------------------------------------
+// MemoryBudget
+
+MemoryBudget::MemoryBudget(qint64 limit, QObject *parent)
+    : QObject(parent)
+    , m_limit(limit)
+    , m_target(limit)
+    , m_shrinkPending(false)
+{
+}
+
+void MemoryBudget::addConsumer(MemoryConsumer *consumer)
+{
+    if (!m_consumers.contains(consumer))
+        m_consumers << consumer;
+}
+
+void MemoryBudget::removeConsumer(MemoryConsumer *consumer)
+{
+    m_consumers.removeAll(consumer);
+}
+
+qint64 MemoryBudget::limit() const
+{
+    return m_limit;
+}
+
+void MemoryBudget::setLimit(qint64 bytes)
+{
+    m_limit = bytes;
+    m_target = bytes;
+    enforce();
+}
+
+qint64 MemoryBudget::bytesUsed() const
+{
+    qint64 total = 0;
+    for (int i = 0; i < m_consumers.size(); ++i)
+        total += m_consumers.at(i)->bytesUsed();
+    return total;
+}
+
+qint64 MemoryBudget::headroom() const
+{
+    return qMax<qint64>(0, m_target - bytesUsed());
+}
+
+QList<MemoryUsage> MemoryBudget::usage() const
+{
+    QList<MemoryUsage> list;
+    for (int i = 0; i < m_consumers.size(); ++i) {
+        const MemoryConsumer *consumer = m_consumers.at(i);
+        MemoryUsage usage;
+        usage.name = consumer->consumerName();
+        usage.bytes = consumer->bytesUsed();
+        usage.priority = consumer->priority();
+        usage.valuePerByte = consumer->valuePerByte();
+        list << usage;
+    }
+    return list;
+}
+
+void MemoryBudget::enforce()
+{
+    // Once a low-memory episode has been dealt with, the full cap applies again.
+    if (!m_shrinkPending)
+        m_target = m_limit;
+    while (bytesUsed() > m_target && shrinkOnce(m_target)) {
+    }
+    if (!m_shrinkPending)
+        restoreConsumers();
+}
+
+// The headroom goes to the consumers in order of weighted value, so what
+// is worth most grows back first.
+void MemoryBudget::restoreConsumers()
+{
+    qint64 headroom = this->headroom();
+    QList<MemoryConsumer *> candidates = m_consumers;
+    while (headroom > 0 && !candidates.isEmpty()) {
+        int dearest = 0;
+        for (int i = 1; i < candidates.size(); ++i) {
+            if (weightedValue(candidates.at(i)) > weightedValue(candidates.at(dearest)))
+                dearest = i;
+        }
+        headroom -= qBound<qint64>(0, candidates.at(dearest)->restore(headroom), headroom);
+        candidates.removeAt(dearest);
+    }
+}
+
+void MemoryBudget::onLowMemory()
+{
+    m_target = qint64(m_limit * MEMORY_LOW_FRACTION);
+
+    QElapsedTimer frame;
+    frame.start();
+    while (bytesUsed() > m_target && frame.elapsed() < MEMORY_FRAME_MS) {
+        if (!shrinkOnce(m_target))
+            return;
+    }
+    if (bytesUsed() > m_target && !m_shrinkPending) {
+        m_shrinkPending = true;
+        QTimer::singleShot(0, this, SLOT(continueShrinking()));
+    }
+}
+
+void MemoryBudget::continueShrinking()
+{
+    QElapsedTimer frame;
+    frame.start();
+    while (bytesUsed() > m_target && frame.elapsed() < MEMORY_FRAME_MS) {
+        if (!shrinkOnce(m_target)) {
+            m_shrinkPending = false;
+            return;
+        }
+    }
+    if (bytesUsed() > m_target) {
+        QTimer::singleShot(0, this, SLOT(continueShrinking()));
+    } else {
+        m_shrinkPending = false;
+    }
+}
+
+// Takes one step from the consumer whose bytes are worth least. Returns
+// false if no consumer could give anything back.
+bool MemoryBudget::shrinkOnce(qint64 target)
+{
+    QList<MemoryConsumer *> candidates;
+    for (int i = 0; i < m_consumers.size(); ++i) {
+        if (m_consumers.at(i)->bytesUsed() > 0)
+            candidates << m_consumers.at(i);
+    }
+
+    const qint64 excess = bytesUsed() - target;
+    while (!candidates.isEmpty()) {
+        int cheapest = 0;
+        for (int i = 1; i < candidates.size(); ++i) {
+            if (weightedValue(candidates.at(i)) < weightedValue(candidates.at(cheapest)))
+                cheapest = i;
+        }
+        if (candidates.at(cheapest)->shrink(qMin<qint64>(excess, MEMORY_SHRINK_STEP)) > 0)
+            return true;
+        candidates.removeAt(cheapest);
+    }
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------
+// SqliteCacheConsumer
+
+static int dbStatus(sqlite3 *handle, int op)
+{
+    int current = 0, highwater = 0;
+    if (!handle || sqlite3_db_status(handle, op, &current, &highwater, 0) != SQLITE_OK)
+        return 0;
+    return current;
+}
+
+SqliteCacheConsumer::SqliteCacheConsumer(const QSqlDatabase &database, const QString &name)
+    : m_database(database)
+    , m_name(name)
+    , m_shrunk(false)
+    , m_configuredCacheSize(0)
+    , m_cachePages(0)
+{
+}
+
+qint64 SqliteCacheConsumer::pageSize() const
+{
+    QSqlQuery query(m_database);
+    if (query.exec("PRAGMA page_size") && query.next())
+        return qMax<qint64>(512, query.value(0).toLongLong());
+    return 4096;
+}
+
+// cache_size counts pages, or KiB when negative.
+qint64 SqliteCacheConsumer::cacheBytes(qint64 cacheSize) const
+{
+    return cacheSize < 0 ? -cacheSize * 1024 : cacheSize * pageSize();
+}
+
+QString SqliteCacheConsumer::consumerName() const
+{
+    return m_name;
+}
+
+qint64 SqliteCacheConsumer::bytesUsed() const
+{
+    return dbStatus(sqliteHandle(m_database), SQLITE_DBSTATUS_CACHE_USED);
+}
+
+int SqliteCacheConsumer::priority() const
+{
+    // Every query goes through the page cache; it is the last thing to give up.
+    return 2;
+}
+
+double SqliteCacheConsumer::valuePerByte() const
+{
+    sqlite3 *handle = sqliteHandle(m_database);
+    const qint64 bytes = bytesUsed();
+    if (bytes <= 0)
+        return 0;
+
+    // Hit ratio per KiB: a cache that keeps missing is not worth its pages.
+    const double hits = dbStatus(handle, SQLITE_DBSTATUS_CACHE_HIT);
+    const double misses = dbStatus(handle, SQLITE_DBSTATUS_CACHE_MISS);
+    return hits / (hits + misses + 1) / bytes * 1024;
+}
+
+qint64 SqliteCacheConsumer::shrink(qint64 bytes)
+{
+    sqlite3 *handle = sqliteHandle(m_database);
+    if (!handle)
+        return 0;
+
+    QSqlQuery query(m_database);
+    if (!m_shrunk && query.exec("PRAGMA cache_size") && query.next()) {
+        m_configuredCacheSize = query.value(0).toLongLong();
+        m_shrunk = true;
+    }
+    query.finish();
+
+    const qint64 before = bytesUsed();
+    m_cachePages = qMax<qint64>(SQLITE_CACHE_MIN_PAGES, (before - bytes) / pageSize());
+    query.exec(QString("PRAGMA cache_size = %1").arg(m_cachePages));
+    sqlite3_db_release_memory(handle);
+    return qMax<qint64>(0, before - bytesUsed());
+}
+
+qint64 SqliteCacheConsumer::restore(qint64 bytes)
+{
+    if (!m_shrunk || bytes <= 0 || !sqliteHandle(m_database))
+        return 0;
+
+    // The configured size once it fits; until then as many more pages as the
+    // headroom pays for.
+    const qint64 page = pageSize();
+    const qint64 current = m_cachePages * page;
+    const qint64 configured = cacheBytes(m_configuredCacheSize);
+    QSqlQuery query(m_database);
+    if (configured - current <= bytes) {
+        if (!query.exec(QString("PRAGMA cache_size = %1").arg(m_configuredCacheSize)))
+            return 0;
+        m_shrunk = false;
+        return qMax<qint64>(0, configured - current);
+    }
+    const qint64 added = bytes / page;
+    if (added <= 0 || !query.exec(QString("PRAGMA cache_size = %1").arg(m_cachePages + added)))
+        return 0;
+    m_cachePages += added;
+    return added * page;
+}
@@ -0,0 +1,132 @@
+/*
+ * memorybudget.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef MEMORYBUDGET_HPP_
+#define MEMORYBUDGET_HPP_
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include <QtSql/QSqlDatabase>
+
+#define MEMORY_DEFAULT_LIMIT (24 * 1024 * 1024)
+#define MEMORY_FRAME_MS 12              // time a low-memory response may take on the UI thread
+#define MEMORY_LOW_FRACTION 0.5         // target after a low-memory warning, as part of the limit
+#define MEMORY_SHRINK_STEP (64 * 1024)
+
+/*
+ * @brief A cache whose memory is managed by a MemoryBudget.
+ */
+class MemoryConsumer
+{
+public:
+    virtual ~MemoryConsumer() {}
+
+    virtual QString consumerName() const = 0;
+    virtual qint64 bytesUsed() const = 0;
+    // Consumers with a higher priority keep their memory longer.
+    virtual int priority() const = 0;
+    // What keeping one more byte is worth, e.g. hits per byte. Only compared
+    // between consumers, so any consistent measure works.
+    virtual double valuePerByte() const = 0;
+    // Frees about 'bytes' (least valuable entries first). Returns what was freed.
+    virtual qint64 shrink(qint64 bytes) = 0;
+    // Called when the total is under the cap again: takes back up to 'bytes'
+    // of a limit that shrink() lowered. Returns what the consumer may now grow
+    // by. Caches that simply refill need not do anything.
+    virtual qint64 restore(qint64 bytes) { Q_UNUSED(bytes); return 0; }
+};
+
+struct MemoryUsage
+{
+    QString name;
+    qint64 bytes;
+    int priority;
+    double valuePerByte;
+};
+
+/*
+ * @brief One memory cap shared by all the app's caches.
+ *
+ * Caches register as MemoryConsumers and call enforce() after they grow.
+ * Over the cap, memory is taken back from the consumer whose bytes are
+ * worth least (value per byte, weighted by priority), MEMORY_SHRINK_STEP at
+ * a time, until the total fits. A low-memory warning from the OS lowers
+ * the target to MEMORY_LOW_FRACTION of the cap; as much as fits into
+ * MEMORY_FRAME_MS is freed right away and the rest on the next turns of
+ * the event loop. Once the total fits again, enforce() hands the headroom
+ * back to consumers whose limits were lowered.
+ */
+class MemoryBudget : public QObject
+{
+    Q_OBJECT
+
+public:
+    MemoryBudget(qint64 limit = MEMORY_DEFAULT_LIMIT, QObject *parent = 0);
+
+    void addConsumer(MemoryConsumer *consumer);
+    void removeConsumer(MemoryConsumer *consumer);
+
+    qint64 limit() const;
+    void setLimit(qint64 bytes);
+    qint64 bytesUsed() const;
+
+    // Bytes a consumer may still take before the cap is reached.
+    qint64 headroom() const;
+
+    QList<MemoryUsage> usage() const;
+
+public Q_SLOTS:
+    // Brings the total under the cap. Cheap when it already is.
+    void enforce();
+    // Connected to the OS low-memory notification.
+    void onLowMemory();
+
+private Q_SLOTS:
+    void continueShrinking();
+
+private:
+    bool shrinkOnce(qint64 target);
+    void restoreConsumers();
+
+    QList<MemoryConsumer *> m_consumers;
+    qint64 m_limit;
+    qint64 m_target;           // m_limit, or lower after a low-memory warning
+    bool m_shrinkPending;
+};
+
+/*
+ * @brief The SQLite page cache of one connection as a MemoryConsumer.
+ *
+ * Shrinking lowers PRAGMA cache_size and releases the unused pages. The
+ * configured cache_size is kept and set again, as far as the headroom
+ * allows, when the budget restores.
+ */
+class SqliteCacheConsumer : public MemoryConsumer
+{
+public:
+    SqliteCacheConsumer(const QSqlDatabase &database, const QString &name);
+
+    virtual QString consumerName() const;
+    virtual qint64 bytesUsed() const;
+    virtual int priority() const;
+    virtual double valuePerByte() const;
+    virtual qint64 shrink(qint64 bytes);
+    virtual qint64 restore(qint64 bytes);
+
+private:
+    qint64 pageSize() const;
+    qint64 cacheBytes(qint64 cacheSize) const;
+
+    QSqlDatabase m_database;
+    QString m_name;
+    bool m_shrunk;
+    qint64 m_configuredCacheSize;  // PRAGMA cache_size before the first shrink; negative is KiB
+    qint64 m_cachePages;           // what shrink() or restore() set last
+};
+
+#endif /* MEMORYBUDGET_HPP_ */
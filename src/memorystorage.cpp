@@ -0,0 +1,35 @@
+/*
+ * memorystorage.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "memorystorage.hpp"
+
+#include <QAtomicInt>
+#include <QtSql/QtSql>
+
+MemoryStorage::MemoryStorage()
+    : SqliteStorage(":memory:", nextConnectionName())
+{
+}
+
+QString MemoryStorage::nextConnectionName()
+{
+    // Each connection to ":memory:" is its own database, so instances stay isolated.
+    static QAtomicInt counter(0);
+    return QString("DWriter-memory-%1").arg(counter.fetchAndAddOrdered(1));
+}
+
+bool MemoryStorage::open()
+{
+    if (!SqliteStorage::open())
+        return false;
+
+    // Nothing to make durable; keep the journal out of the timings.
+    QSqlQuery query(database());
+    query.exec("PRAGMA journal_mode = MEMORY");
+    query.exec("PRAGMA synchronous = OFF");
+    query.exec("PRAGMA temp_store = MEMORY");
+    return true;
+}
@@ -0,0 +1,32 @@
+/*
+ * memorystorage.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef MEMORYSTORAGE_HPP_
+#define MEMORYSTORAGE_HPP_
+
+#include "sqlitestorage.hpp"
+
+/*
+ * @brief A journal that lives in a private SQLite ":memory:" database.
+ *
+ * Runs the same schema and SQL as the on-device journal without touching the
+ * filesystem, so the model and the write path can be exercised on a desktop
+ * build and timed without flash storage in the way. Hand one to the
+ * DatabaseIo constructor. Every instance is a separate, empty journal.
+ */
+class MemoryStorage : public SqliteStorage
+{
+public:
+    MemoryStorage();
+
+    virtual bool open();
+
+private:
+    static QString nextConnectionName();
+};
+
+#endif /* MEMORYSTORAGE_HPP_ */
@@ -0,0 +1,200 @@
+/*
+ * modelsnapshot.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "modelsnapshot.hpp"
+
+#include <QtEndian>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SNAPSHOT_FORMAT 2
+#define SNAPSHOT_HEADER_BYTES 32
+#define SNAPSHOT_ENTRY_BYTES 32
+
+static const char SNAPSHOT_MAGIC[4] = { 'D', 'W', 'S', '1' };
+
+// Header fields
+enum { HeaderFormat = 4, HeaderVersion = 8, HeaderRowCount = 16, HeaderScrollRow = 20,
+       HeaderEntries = 24 };
+// Index entry fields
+enum { EntryRow = 0, EntryFlags = 4, EntryEventId = 8, EntryCreatedAt = 16, EntryTextOffset = 24,
+       EntryTextLength = 28 };
+// Entry flags
+enum { FlagTruncated = 1 };
+
+ModelSnapshot::ModelSnapshot()
+    : m_map(0)
+    , m_size(0)
+    , m_entries(0)
+{
+}
+
+ModelSnapshot::~ModelSnapshot()
+{
+    close();
+}
+
+bool ModelSnapshot::write(const QString &fileName, qint64 journalVersion, int rowCount,
+                          int scrollRow, const QList<SnapshotRow> &rows)
+{
+    QByteArray data(SNAPSHOT_HEADER_BYTES + rows.size() * SNAPSHOT_ENTRY_BYTES, '\0');
+    uchar *header = reinterpret_cast<uchar *>(data.data());
+    memcpy(header, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    qToLittleEndian<quint32>(SNAPSHOT_FORMAT, header + HeaderFormat);
+    qToLittleEndian<qint64>(journalVersion, header + HeaderVersion);
+    qToLittleEndian<quint32>(quint32(rowCount), header + HeaderRowCount);
+    qToLittleEndian<quint32>(quint32(scrollRow), header + HeaderScrollRow);
+    qToLittleEndian<quint32>(quint32(rows.size()), header + HeaderEntries);
+
+    QByteArray text;
+    for (int i = 0; i < rows.size(); ++i) {
+        const SnapshotRow &row = rows.at(i);
+        uchar *entry = reinterpret_cast<uchar *>(data.data()) + SNAPSHOT_HEADER_BYTES
+                     + i * SNAPSHOT_ENTRY_BYTES;
+        qToLittleEndian<quint32>(quint32(row.row), entry + EntryRow);
+        qToLittleEndian<quint32>(row.truncated ? FlagTruncated : 0, entry + EntryFlags);
+        qToLittleEndian<qint64>(row.eventId, entry + EntryEventId);
+        qToLittleEndian<qint64>(row.createdAt, entry + EntryCreatedAt);
+        qToLittleEndian<quint32>(quint32(text.size()), entry + EntryTextOffset);
+        qToLittleEndian<quint32>(quint32(row.preview.size()), entry + EntryTextLength);
+        for (int c = 0; c < row.preview.size(); ++c) {
+            uchar unit[2];
+            qToLittleEndian<quint16>(row.preview.at(c).unicode(), unit);
+            text.append(reinterpret_cast<const char *>(unit), 2);
+        }
+    }
+    data += text;
+
+    // Written beside the old snapshot and renamed, so a crash leaves one or the other.
+    const QString temporary = fileName + ".tmp";
+    QFile file(temporary);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    const bool ok = file.write(data) == data.size() && file.flush() && fsync(file.handle()) == 0;
+    file.close();
+    if (!ok) {
+        QFile::remove(temporary);
+        return false;
+    }
+    return ::rename(QFile::encodeName(temporary).constData(),
+                    QFile::encodeName(fileName).constData()) == 0;
+}
+
+bool ModelSnapshot::open(const QString &fileName)
+{
+    close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    m_size = m_file.size();
+    if (m_size >= SNAPSHOT_HEADER_BYTES)
+        m_map = m_file.map(0, m_size);
+    if (!m_map || memcmp(m_map, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0
+        || qFromLittleEndian<quint32>(m_map + HeaderFormat) != SNAPSHOT_FORMAT) {
+        close();
+        return false;
+    }
+
+    // Every entry and its text must lie inside the file.
+    m_entries = int(qFromLittleEndian<quint32>(m_map + HeaderEntries));
+    const qint64 textStart = SNAPSHOT_HEADER_BYTES + qint64(m_entries) * SNAPSHOT_ENTRY_BYTES;
+    bool ok = m_entries >= 0 && textStart <= m_size;
+    for (int i = 0; ok && i < m_entries; ++i) {
+        const qint64 offset = qFromLittleEndian<quint32>(entry(i) + EntryTextOffset);
+        const qint64 length = qFromLittleEndian<quint32>(entry(i) + EntryTextLength);
+        ok = textStart + offset + 2 * length <= m_size;
+    }
+    if (!ok) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ModelSnapshot::close()
+{
+    if (m_map)
+        m_file.unmap(const_cast<uchar *>(m_map));
+    m_map = 0;
+    m_size = 0;
+    m_entries = 0;
+    m_file.close();
+}
+
+bool ModelSnapshot::isOpen() const
+{
+    return m_map != 0;
+}
+
+qint64 ModelSnapshot::journalVersion() const
+{
+    return m_map ? qFromLittleEndian<qint64>(m_map + HeaderVersion) : -1;
+}
+
+int ModelSnapshot::rowCount() const
+{
+    return m_map ? int(qFromLittleEndian<quint32>(m_map + HeaderRowCount)) : 0;
+}
+
+int ModelSnapshot::scrollRow() const
+{
+    return m_map ? int(qFromLittleEndian<quint32>(m_map + HeaderScrollRow)) : 0;
+}
+
+int ModelSnapshot::firstRow() const
+{
+    return m_entries ? int(qFromLittleEndian<quint32>(entry(0) + EntryRow)) : 0;
+}
+
+int ModelSnapshot::lastRow() const
+{
+    return m_entries ? int(qFromLittleEndian<quint32>(entry(m_entries - 1) + EntryRow)) : -1;
+}
+
+bool ModelSnapshot::preview(int row, QString &text, bool *truncated) const
+{
+    // Binary search over the row-sorted index.
+    int low = 0;
+    int high = m_entries - 1;
+    while (low <= high) {
+        const int middle = (low + high) / 2;
+        const int found = int(qFromLittleEndian<quint32>(entry(middle) + EntryRow));
+        if (found < row) {
+            low = middle + 1;
+        } else if (found > row) {
+            high = middle - 1;
+        } else {
+            const uchar *units = m_map + SNAPSHOT_HEADER_BYTES + m_entries * SNAPSHOT_ENTRY_BYTES
+                               + qFromLittleEndian<quint32>(entry(middle) + EntryTextOffset);
+            const int length = int(qFromLittleEndian<quint32>(entry(middle) + EntryTextLength));
+            text.resize(length);
+            for (int i = 0; i < length; ++i)
+                text[i] = QChar(qFromLittleEndian<quint16>(units + 2 * i));
+            if (truncated)
+                *truncated = qFromLittleEndian<quint32>(entry(middle) + EntryFlags) & FlagTruncated;
+            return true;
+        }
+    }
+    return false;
+}
+
+QList<int> ModelSnapshot::truncatedRows() const
+{
+    QList<int> rows;
+    for (int i = 0; i < m_entries; ++i) {
+        if (qFromLittleEndian<quint32>(entry(i) + EntryFlags) & FlagTruncated)
+            rows << int(qFromLittleEndian<quint32>(entry(i) + EntryRow));
+    }
+    return rows;
+}
+
+const uchar *ModelSnapshot::entry(int index) const
+{
+    return m_map + SNAPSHOT_HEADER_BYTES + index * SNAPSHOT_ENTRY_BYTES;
+}
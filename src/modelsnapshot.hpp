@@ -0,0 +1,76 @@
+/*
+ * modelsnapshot.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef MODELSNAPSHOT_HPP_
+#define MODELSNAPSHOT_HPP_
+
+#include <QFile>
+#include <QList>
+#include <QString>
+
+struct SnapshotRow
+{
+    int row;
+    qint64 eventId;
+    qint64 createdAt;
+    QString preview;      // the list text, cut to SNAPSHOT_PREVIEW_CHARS
+    bool truncated;       // the list text was longer than the preview
+};
+
+/*
+ * @brief What the entry list showed when the app last went away, memory-mapped.
+ *
+ * Written when the app is backgrounded or closed, read at the next start so
+ * Tab 2 can show rows before the journal has been queried. Layout (little
+ * endian):
+ *
+ *   header  [magic][u32 format][u64 journal version][u32 row count]
+ *           [u32 scroll row][u32 entries]
+ *   index   entries x [u32 row][u32 flags][i64 eventID][i64 createdAt]
+ *                     [u32 text offset][u32 text length in UTF-16 units]
+ *   text    UTF-16 previews
+ *
+ * The index is sorted by row. Flag 1 marks a preview that is shorter than
+ * the row's text, which has to be read from the journal once it can be.
+ * The journal version is what
+ * DatabaseIo::journalVersion() returned when the snapshot was written; a
+ * different value at startup means the rows may be stale.
+ */
+class ModelSnapshot
+{
+public:
+    ModelSnapshot();
+    ~ModelSnapshot();
+
+    static bool write(const QString &fileName, qint64 journalVersion, int rowCount, int scrollRow,
+                      const QList<SnapshotRow> &rows);
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+
+    qint64 journalVersion() const;
+    int rowCount() const;
+    int scrollRow() const;
+    int firstRow() const;
+    int lastRow() const;
+
+    // False if 'row' is not in the snapshot.
+    bool preview(int row, QString &text, bool *truncated = 0) const;
+    // Rows whose preview is cut short, ascending.
+    QList<int> truncatedRows() const;
+
+private:
+    const uchar *entry(int index) const;
+
+    QFile m_file;
+    const uchar *m_map;
+    qint64 m_size;
+    int m_entries;
+};
+
+#endif /* MODELSNAPSHOT_HPP_ */
@@ -0,0 +1,238 @@
+/*
+ * querytrace.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "querytrace.hpp"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QThreadStorage>
+#include <QtEndian>
+
+#include <string.h>
+
+static const char TRACE_MAGIC[4] = { 'D', 'W', 'T', 'R' };
+#define TRACE_HEADER_BYTES 16
+
+// -----------------------------------------------------------------------------------------------
+// Varints
+
+static void putVarint(QByteArray &out, qint64 value)
+{
+    // Zigzag, so small negative deltas stay small.
+    quint64 bits = (quint64(value) << 1) ^ quint64(value >> 63);
+    while (bits >= 0x80) {
+        out += char(bits | 0x80);
+        bits >>= 7;
+    }
+    out += char(bits);
+}
+
+static bool getVarint(const uchar *&p, const uchar *end, qint64 &value)
+{
+    quint64 bits = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const uchar byte = *p++;
+        bits |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            value = qint64(bits >> 1) ^ -qint64(bits & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Threads
+
+struct TraceThread
+{
+    int number;
+};
+
+static QThreadStorage<TraceThread *> g_threads;
+static QAtomicInt g_threadCount(0);
+
+static int threadNumber()
+{
+    if (!g_threads.hasLocalData()) {
+        TraceThread *thread = new TraceThread;
+        thread->number = g_threadCount.fetchAndAddOrdered(1);
+        g_threads.setLocalData(thread);
+    }
+    return g_threads.localData()->number;
+}
+
+// -----------------------------------------------------------------------------------------------
+// QueryTrace
+
+QueryTrace::QueryTrace()
+    : m_active(0)
+    , m_lastStartUs(0)
+{
+}
+
+QueryTrace::~QueryTrace()
+{
+    stop();
+}
+
+bool QueryTrace::start(const QString &fileName)
+{
+    stop();
+
+    QMutexLocker locker(&m_mutex);
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_lastError = m_file.errorString();
+        return false;
+    }
+
+    uchar header[TRACE_HEADER_BYTES];
+    memcpy(header, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    qToLittleEndian<quint32>(TRACE_FORMAT, header + 4);
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), header + 8);
+    m_buffer = QByteArray(reinterpret_cast<const char *>(header), TRACE_HEADER_BYTES);
+    m_buffer.reserve(TRACE_BUFFER_BYTES + 64);
+    m_lastStartUs = 0;
+    m_lastError.clear();
+    m_clock.start();
+
+    m_active.fetchAndStoreOrdered(1);
+    return true;
+}
+
+void QueryTrace::stop()
+{
+    if (!m_active.fetchAndStoreOrdered(0))
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    writeBuffer();
+    m_file.close();
+    qDebug() << "QueryTrace: written to" << m_file.fileName();
+}
+
+bool QueryTrace::isActive() const
+{
+    return m_active;
+}
+
+QString QueryTrace::lastError() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_lastError;
+}
+
+qint64 QueryTrace::now() const
+{
+    return m_clock.nsecsElapsed() / 1000;
+}
+
+void QueryTrace::append(TraceKind kind, qint64 startUs, qint64 durationUs, const qint64 *args, int argCount)
+{
+    const int thread = threadNumber();
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_active)
+        return;
+
+    m_buffer += char(kind);
+    m_buffer += char(qMin(thread, 255));
+    putVarint(m_buffer, startUs - m_lastStartUs);
+    putVarint(m_buffer, durationUs);
+    m_buffer += char(argCount);
+    for (int i = 0; i < argCount; ++i)
+        putVarint(m_buffer, args[i]);
+    m_lastStartUs = startUs;
+
+    if (m_buffer.size() >= TRACE_BUFFER_BYTES && !writeBuffer()) {
+        // A full disk ends the trace rather than the operations being traced.
+        qWarning() << "QueryTrace: stopped:" << m_lastError;
+        m_active.fetchAndStoreOrdered(0);
+        m_file.close();
+    }
+}
+
+bool QueryTrace::writeBuffer()
+{
+    const bool ok = m_file.write(m_buffer) == m_buffer.size();
+    if (!ok)
+        m_lastError = m_file.errorString();
+    m_buffer.clear();
+    return ok;
+}
+
+bool QueryTrace::load(const QString &fileName, QVector<TraceRecord> &records, QString *error)
+{
+    records.clear();
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (error)
+            *error = file.errorString();
+        return false;
+    }
+    const QByteArray data = file.readAll();
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+    const uchar *end = p + data.size();
+    if (data.size() < TRACE_HEADER_BYTES || memcmp(p, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0
+        || qFromLittleEndian<quint32>(p + 4) != TRACE_FORMAT) {
+        if (error)
+            *error = QString("%1 is not a trace").arg(fileName);
+        return false;
+    }
+    p += TRACE_HEADER_BYTES;
+
+    qint64 startUs = 0;
+    while (p < end) {
+        TraceRecord record;
+        qint64 delta;
+        bool ok = end - p >= 2 && *p < TraceKindCount;
+        if (ok) {
+            record.kind = TraceKind(*p++);
+            record.thread = *p++;
+            ok = getVarint(p, end, delta) && getVarint(p, end, record.durationUs) && p < end
+                 && *p <= TRACE_MAX_ARGS;
+        }
+        if (ok) {
+            record.argCount = *p++;
+            for (int i = 0; ok && i < record.argCount; ++i)
+                ok = getVarint(p, end, record.args[i]);
+        }
+        if (!ok) {
+            // The tail of a trace whose app died before stop() is cut off; keep what came before.
+            qWarning() << "QueryTrace: damaged record after" << records.size() << "in" << fileName;
+            break;
+        }
+        startUs += delta;
+        record.startUs = startUs;
+        records << record;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+// TraceScope
+
+TraceScope::TraceScope(QueryTrace *trace, TraceKind kind)
+    : m_trace(trace && trace->isActive() ? trace : 0)
+    , m_kind(kind)
+    , m_startUs(m_trace ? m_trace->now() : 0)
+    , m_argCount(0)
+{
+}
+
+TraceScope::~TraceScope()
+{
+    if (m_trace)
+        m_trace->append(m_kind, m_startUs, m_trace->now() - m_startUs, m_args, m_argCount);
+}
+
+void TraceScope::arg(qint64 value)
+{
+    if (m_trace && m_argCount < TRACE_MAX_ARGS)
+        m_args[m_argCount++] = value;
+}
@@ -0,0 +1,129 @@
+/*
+ * querytrace.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef QUERYTRACE_HPP_
+#define QUERYTRACE_HPP_
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#define TRACE_FORMAT 1
+#define TRACE_MAX_ARGS 4
+#define TRACE_BUFFER_BYTES 65536    // records are written out in chunks of this size
+
+// What a record is; the arguments of each kind follow.
+enum TraceKind {
+    TraceCount,         // -
+    TraceEvent,         // row
+    TraceEventById,     // eventID
+    TraceRange,         // first row, count
+    TraceSearch,        // from, to, text length
+    TraceAdd,           // text length, durability, eventID (-1 on error)
+    TraceEdit,          // eventID, text length, durability
+    TraceDelete,        // eventID
+    TraceRestore,       // eventID
+    TraceFlush,         // -
+    TraceTags,          // eventID, number of tags
+    TraceMood,          // eventID, mood
+    TraceRowForTime,    // createdAt
+    TraceTimeAtRow,     // row
+    TraceFilter,        // number of tags, matches
+    TraceModelRow,      // row, 1 if it was cached; the list asking for a row
+    TraceKindCount
+};
+
+struct TraceRecord
+{
+    TraceRecord() : kind(TraceCount), thread(0), startUs(0), durationUs(0), argCount(0) {}
+
+    TraceKind kind;
+    int thread;             // numbered in the order the threads first recorded
+    qint64 startUs;         // since the trace started
+    qint64 durationUs;
+    int argCount;
+    qint64 args[TRACE_MAX_ARGS];
+};
+
+/*
+ * @brief Records the journal operations of a session into a compact binary file.
+ *
+ * Tracing is off until start(). Each operation is a record of its kind, its
+ * integer arguments, the thread, when it started and how long it took; text
+ * is never recorded, only its length, so a trace can be shared without the
+ * entries in it. Layout (little endian):
+ *
+ *   header  [magic][u32 format][i64 start, ms since the epoch]
+ *   record  [u8 kind][u8 thread][start delta][duration][u8 args][args]
+ *
+ * The start delta is from the start of the previous record. It, the duration
+ * and the arguments are zigzag LEB128 varints, so most records take under
+ * ten bytes. Records are buffered and written TRACE_BUFFER_BYTES at a time.
+ *
+ * Thread-safe. While tracing is off, a TraceScope costs one atomic load.
+ */
+class QueryTrace
+{
+public:
+    QueryTrace();
+    ~QueryTrace();
+
+    bool start(const QString &fileName);
+    void stop();
+    bool isActive() const;
+    QString lastError() const;
+
+    // Microseconds since start().
+    qint64 now() const;
+    void append(TraceKind kind, qint64 startUs, qint64 durationUs, const qint64 *args, int argCount);
+
+    // Reads a whole trace, as TraceReplay does.
+    static bool load(const QString &fileName, QVector<TraceRecord> &records, QString *error = 0);
+
+private:
+    Q_DISABLE_COPY(QueryTrace)
+
+    bool writeBuffer();
+
+    QAtomicInt m_active;
+    mutable QMutex m_mutex;
+    QFile m_file;
+    QElapsedTimer m_clock;
+    QByteArray m_buffer;
+    qint64 m_lastStartUs;
+    QString m_lastError;
+};
+
+/*
+ * @brief Records one operation when it goes out of scope.
+ *
+ * Arguments may be added up to then, results included. Does nothing if
+ * 'trace' is null or not tracing.
+ */
+class TraceScope
+{
+public:
+    TraceScope(QueryTrace *trace, TraceKind kind);
+    ~TraceScope();
+
+    void arg(qint64 value);
+
+private:
+    Q_DISABLE_COPY(TraceScope)
+
+    QueryTrace *m_trace;
+    TraceKind m_kind;
+    qint64 m_startUs;
+    int m_argCount;
+    qint64 m_args[TRACE_MAX_ARGS];
+};
+
+#endif /* QUERYTRACE_HPP_ */
@@ -0,0 +1,138 @@
+/*
+ * revisionstore.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "revisionstore.hpp"
+#include "textdelta.hpp"
+
+#include <QtSql/QtSql>
+
+#define REVISION_SNAPSHOT_INTERVAL 8
+
+RevisionStore::RevisionStore(const QSqlDatabase &database)
+    : m_database(database)
+{
+}
+
+QString RevisionStore::lastError() const
+{
+    return m_lastError;
+}
+
+bool RevisionStore::insert(qint64 eventId, int revision, qint64 savedAt, bool snapshot,
+                           const QByteArray &data)
+{
+    QSqlQuery query(m_database);
+    query.prepare("INSERT INTO revisions (eventID, revision, savedAt, snapshot, data) "
+                  "VALUES(:eventID, :revision, :savedAt, :snapshot, :data)");
+    query.bindValue(":eventID", eventId);
+    query.bindValue(":revision", revision);
+    query.bindValue(":savedAt", savedAt);
+    query.bindValue(":snapshot", snapshot ? 1 : 0);
+    query.bindValue(":data", data);
+
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool RevisionStore::addRevision(qint64 eventId, const QString &currentText, const QString &newText,
+                                qint64 createdAt, qint64 savedAt)
+{
+    QSqlQuery query(m_database);
+    query.prepare("SELECT MAX(revision) FROM revisions WHERE eventID = :eventID");
+    query.bindValue(":eventID", eventId);
+    if (!query.exec() || !query.next()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+
+    int revision;
+    if (query.value(0).isNull()) {
+        // First edit: keep the original text as the base of the chain.
+        if (!insert(eventId, 0, createdAt, true, qCompress(currentText.toUtf8())))
+            return false;
+        revision = 1;
+    } else {
+        revision = query.value(0).toInt() + 1;
+    }
+
+    const QByteArray target = newText.toUtf8();
+    if (revision % REVISION_SNAPSHOT_INTERVAL == 0)
+        return insert(eventId, revision, savedAt, true, qCompress(target));
+    return insert(eventId, revision, savedAt, false, TextDelta::encode(currentText.toUtf8(), target));
+}
+
+QList<RevisionInfo> RevisionStore::revisions(qint64 eventId)
+{
+    QList<RevisionInfo> list;
+
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    query.prepare("SELECT revision, savedAt, snapshot, LENGTH(data) FROM revisions "
+                  "WHERE eventID = :eventID ORDER BY revision");
+    query.bindValue(":eventID", eventId);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return list;
+    }
+
+    while (query.next()) {
+        RevisionInfo info;
+        info.revision = query.value(0).toInt();
+        info.savedAt = query.value(1).toLongLong();
+        info.snapshot = query.value(2).toInt() != 0;
+        info.storedBytes = query.value(3).toInt();
+        list << info;
+    }
+    return list;
+}
+
+bool RevisionStore::materialize(qint64 eventId, int revision, QString &text)
+{
+    // The nearest snapshot at or before 'revision', then the deltas after it.
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    query.prepare("SELECT revision, snapshot, data FROM revisions "
+                  "WHERE eventID = :eventID AND revision <= :revision AND revision >= "
+                  "    (SELECT MAX(revision) FROM revisions "
+                  "     WHERE eventID = :eventID2 AND revision <= :revision2 AND snapshot = 1) "
+                  "ORDER BY revision");
+    query.bindValue(":eventID", eventId);
+    query.bindValue(":revision", revision);
+    query.bindValue(":eventID2", eventId);
+    query.bindValue(":revision2", revision);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+
+    QByteArray current;
+    int reached = -1;
+    while (query.next()) {
+        const QByteArray data = query.value(2).toByteArray();
+        if (query.value(1).toInt()) {
+            current = qUncompress(data);
+        } else {
+            QByteArray next;
+            if (!TextDelta::apply(current, data, next)) {
+                m_lastError = QString("Revision %1 of event %2 is damaged")
+                              .arg(query.value(0).toInt()).arg(eventId);
+                return false;
+            }
+            current = next;
+        }
+        reached = query.value(0).toInt();
+    }
+
+    if (reached != revision) {
+        m_lastError = QString("Event %1 has no revision %2").arg(eventId).arg(revision);
+        return false;
+    }
+    text = QString::fromUtf8(current);
+    return true;
+}
@@ -0,0 +1,53 @@
+/*
+ * revisionstore.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef REVISIONSTORE_HPP_
+#define REVISIONSTORE_HPP_
+
+#include <QList>
+#include <QString>
+#include <QtSql/QSqlDatabase>
+
+struct RevisionInfo
+{
+    int revision;        // 0 is the text as it was first saved
+    qint64 savedAt;      // seconds since the epoch
+    bool snapshot;
+    int storedBytes;
+};
+
+/*
+ * @brief Edit history of entries, kept in the revisions table.
+ *
+ * Each revision is stored as a TextDelta against the revision before it,
+ * and every REVISION_SNAPSHOT_INTERVAL-th revision as a full (compressed)
+ * snapshot, so rebuilding any revision applies at most that many deltas.
+ * Revision 0 is written lazily on the first edit of an entry.
+ */
+class RevisionStore
+{
+public:
+    RevisionStore(const QSqlDatabase &database);
+
+    // Records 'newText' as the next revision. 'currentText' is the text it
+    // replaces. Runs inside the caller's transaction.
+    bool addRevision(qint64 eventId, const QString &currentText, const QString &newText,
+                     qint64 createdAt, qint64 savedAt);
+
+    QList<RevisionInfo> revisions(qint64 eventId);
+    bool materialize(qint64 eventId, int revision, QString &text);
+
+    QString lastError() const;
+
+private:
+    bool insert(qint64 eventId, int revision, qint64 savedAt, bool snapshot, const QByteArray &data);
+
+    QSqlDatabase m_database;
+    QString m_lastError;
+};
+
+#endif /* REVISIONSTORE_HPP_ */
@@ -0,0 +1,324 @@
+/*
+ * roaringbitmap.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "roaringbitmap.hpp"
+
+#include <QtAlgorithms>
+
+#define ROARING_ARRAY_MAX 4096
+#define ROARING_WORDS 1024
+
+static inline int popcount(quint64 word)
+{
+    return __builtin_popcountll(word);
+}
+
+// -----------------------------------------------------------------------------------------------
+// Container
+
+bool RoaringBitmap::Container::contains(quint16 low) const
+{
+    if (isBitmap())
+        return (bits.at(low >> 6) >> (low & 63)) & 1;
+    return qBinaryFind(array.constBegin(), array.constEnd(), low) != array.constEnd();
+}
+
+void RoaringBitmap::Container::add(quint16 low)
+{
+    if (isBitmap()) {
+        quint64 &word = bits[low >> 6];
+        const quint64 mask = quint64(1) << (low & 63);
+        if (!(word & mask)) {
+            word |= mask;
+            ++cardinality;
+        }
+        return;
+    }
+
+    QVector<quint16>::iterator it = qLowerBound(array.begin(), array.end(), low);
+    if (it != array.end() && *it == low)
+        return;
+    array.insert(it, low);
+    ++cardinality;
+    if (cardinality > ROARING_ARRAY_MAX)
+        toBitmap();
+}
+
+void RoaringBitmap::Container::remove(quint16 low)
+{
+    if (isBitmap()) {
+        quint64 &word = bits[low >> 6];
+        const quint64 mask = quint64(1) << (low & 63);
+        if (word & mask) {
+            word &= ~mask;
+            --cardinality;
+            optimize();
+        }
+        return;
+    }
+
+    QVector<quint16>::iterator it = qLowerBound(array.begin(), array.end(), low);
+    if (it != array.end() && *it == low) {
+        array.erase(it);
+        --cardinality;
+    }
+}
+
+void RoaringBitmap::Container::toBitmap()
+{
+    if (isBitmap())
+        return;
+    bits.fill(0, ROARING_WORDS);
+    for (int i = 0; i < array.size(); ++i)
+        bits[array.at(i) >> 6] |= quint64(1) << (array.at(i) & 63);
+    array.clear();
+}
+
+void RoaringBitmap::Container::optimize()
+{
+    if (!isBitmap() || cardinality > ROARING_ARRAY_MAX)
+        return;
+
+    QVector<quint16> values;
+    values.reserve(cardinality);
+    for (int w = 0; w < ROARING_WORDS; ++w) {
+        quint64 word = bits.at(w);
+        while (word) {
+            values << quint16((w << 6) + __builtin_ctzll(word));
+            word &= word - 1;
+        }
+    }
+    array = values;
+    bits.clear();
+}
+
+RoaringBitmap::Container RoaringBitmap::intersect(const Container &a, const Container &b)
+{
+    Container result;
+
+    if (a.isBitmap() && b.isBitmap()) {
+        result.bits.resize(ROARING_WORDS);
+        for (int w = 0; w < ROARING_WORDS; ++w) {
+            result.bits[w] = a.bits.at(w) & b.bits.at(w);
+            result.cardinality += popcount(result.bits.at(w));
+        }
+        result.optimize();
+        return result;
+    }
+
+    if (a.isBitmap() || b.isBitmap()) {
+        const Container &small = a.isBitmap() ? b : a;
+        const Container &large = a.isBitmap() ? a : b;
+        for (int i = 0; i < small.array.size(); ++i) {
+            if (large.contains(small.array.at(i)))
+                result.array << small.array.at(i);
+        }
+        result.cardinality = result.array.size();
+        return result;
+    }
+
+    int i = 0;
+    int j = 0;
+    while (i < a.array.size() && j < b.array.size()) {
+        if (a.array.at(i) < b.array.at(j)) {
+            ++i;
+        } else if (b.array.at(j) < a.array.at(i)) {
+            ++j;
+        } else {
+            result.array << a.array.at(i);
+            ++i;
+            ++j;
+        }
+    }
+    result.cardinality = result.array.size();
+    return result;
+}
+
+RoaringBitmap::Container RoaringBitmap::unite(const Container &a, const Container &b)
+{
+    if (a.isBitmap() || b.isBitmap()) {
+        Container result = a.isBitmap() ? a : b;
+        const Container &other = a.isBitmap() ? b : a;
+        if (other.isBitmap()) {
+            for (int w = 0; w < ROARING_WORDS; ++w)
+                result.bits[w] |= other.bits.at(w);
+        } else {
+            for (int i = 0; i < other.array.size(); ++i)
+                result.bits[other.array.at(i) >> 6] |= quint64(1) << (other.array.at(i) & 63);
+        }
+        result.cardinality = 0;
+        for (int w = 0; w < ROARING_WORDS; ++w)
+            result.cardinality += popcount(result.bits.at(w));
+        return result;
+    }
+
+    Container result;
+    result.array.reserve(a.array.size() + b.array.size());
+    int i = 0;
+    int j = 0;
+    while (i < a.array.size() || j < b.array.size()) {
+        if (j == b.array.size() || (i < a.array.size() && a.array.at(i) < b.array.at(j))) {
+            result.array << a.array.at(i++);
+        } else if (i == a.array.size() || b.array.at(j) < a.array.at(i)) {
+            result.array << b.array.at(j++);
+        } else {
+            result.array << a.array.at(i);
+            ++i;
+            ++j;
+        }
+    }
+    result.cardinality = result.array.size();
+    if (result.cardinality > ROARING_ARRAY_MAX)
+        result.toBitmap();
+    return result;
+}
+
+RoaringBitmap::Container RoaringBitmap::subtract(const Container &a, const Container &b)
+{
+    Container result;
+
+    if (!a.isBitmap()) {
+        for (int i = 0; i < a.array.size(); ++i) {
+            if (!b.contains(a.array.at(i)))
+                result.array << a.array.at(i);
+        }
+        result.cardinality = result.array.size();
+        return result;
+    }
+
+    result = a;
+    if (b.isBitmap()) {
+        for (int w = 0; w < ROARING_WORDS; ++w)
+            result.bits[w] &= ~b.bits.at(w);
+    } else {
+        for (int i = 0; i < b.array.size(); ++i)
+            result.bits[b.array.at(i) >> 6] &= ~(quint64(1) << (b.array.at(i) & 63));
+    }
+    result.cardinality = 0;
+    for (int w = 0; w < ROARING_WORDS; ++w)
+        result.cardinality += popcount(result.bits.at(w));
+    result.optimize();
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------
+// RoaringBitmap
+
+RoaringBitmap::RoaringBitmap()
+{
+}
+
+void RoaringBitmap::add(quint32 value)
+{
+    m_containers[quint16(value >> 16)].add(quint16(value));
+}
+
+void RoaringBitmap::remove(quint32 value)
+{
+    QMap<quint16, Container>::iterator it = m_containers.find(quint16(value >> 16));
+    if (it == m_containers.end())
+        return;
+    it.value().remove(quint16(value));
+    if (it.value().cardinality == 0)
+        m_containers.erase(it);
+}
+
+bool RoaringBitmap::contains(quint32 value) const
+{
+    QMap<quint16, Container>::const_iterator it = m_containers.constFind(quint16(value >> 16));
+    return it != m_containers.constEnd() && it.value().contains(quint16(value));
+}
+
+int RoaringBitmap::cardinality() const
+{
+    int total = 0;
+    QMap<quint16, Container>::const_iterator it;
+    for (it = m_containers.constBegin(); it != m_containers.constEnd(); ++it)
+        total += it.value().cardinality;
+    return total;
+}
+
+bool RoaringBitmap::isEmpty() const
+{
+    return m_containers.isEmpty();
+}
+
+RoaringBitmap RoaringBitmap::operator&(const RoaringBitmap &other) const
+{
+    RoaringBitmap result;
+    QMap<quint16, Container>::const_iterator it;
+    for (it = m_containers.constBegin(); it != m_containers.constEnd(); ++it) {
+        QMap<quint16, Container>::const_iterator match = other.m_containers.constFind(it.key());
+        if (match == other.m_containers.constEnd())
+            continue;
+        const Container container = intersect(it.value(), match.value());
+        if (container.cardinality > 0)
+            result.m_containers.insert(it.key(), container);
+    }
+    return result;
+}
+
+RoaringBitmap RoaringBitmap::operator|(const RoaringBitmap &other) const
+{
+    RoaringBitmap result = *this;
+    result |= other;
+    return result;
+}
+
+RoaringBitmap &RoaringBitmap::operator|=(const RoaringBitmap &other)
+{
+    QMap<quint16, Container>::const_iterator it;
+    for (it = other.m_containers.constBegin(); it != other.m_containers.constEnd(); ++it) {
+        QMap<quint16, Container>::iterator mine = m_containers.find(it.key());
+        if (mine == m_containers.end())
+            m_containers.insert(it.key(), it.value());
+        else
+            mine.value() = unite(mine.value(), it.value());
+    }
+    return *this;
+}
+
+RoaringBitmap RoaringBitmap::andNot(const RoaringBitmap &other) const
+{
+    RoaringBitmap result;
+    QMap<quint16, Container>::const_iterator it;
+    for (it = m_containers.constBegin(); it != m_containers.constEnd(); ++it) {
+        QMap<quint16, Container>::const_iterator match = other.m_containers.constFind(it.key());
+        if (match == other.m_containers.constEnd()) {
+            result.m_containers.insert(it.key(), it.value());
+            continue;
+        }
+        const Container container = subtract(it.value(), match.value());
+        if (container.cardinality > 0)
+            result.m_containers.insert(it.key(), container);
+    }
+    return result;
+}
+
+QVector<quint32> RoaringBitmap::toVector() const
+{
+    QVector<quint32> values;
+    values.reserve(cardinality());
+
+    QMap<quint16, Container>::const_iterator it;
+    for (it = m_containers.constBegin(); it != m_containers.constEnd(); ++it) {
+        const quint32 high = quint32(it.key()) << 16;
+        const Container &container = it.value();
+        if (!container.isBitmap()) {
+            for (int i = 0; i < container.array.size(); ++i)
+                values << (high | container.array.at(i));
+            continue;
+        }
+        for (int w = 0; w < ROARING_WORDS; ++w) {
+            quint64 word = container.bits.at(w);
+            while (word) {
+                values << (high | quint32((w << 6) + __builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+    }
+    return values;
+}
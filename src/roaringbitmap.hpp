@@ -0,0 +1,67 @@
+/*
+ * roaringbitmap.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef ROARINGBITMAP_HPP_
+#define ROARINGBITMAP_HPP_
+
+#include <QList>
+#include <QMap>
+#include <QVector>
+
+/*
+ * @brief Compressed set of 32-bit ids (eventIDs), in the style of Roaring bitmaps.
+ *
+ * Ids are split by their high 16 bits into containers. A container holds a
+ * sorted array of the low 16 bits while it has at most ROARING_ARRAY_MAX
+ * members and a 65536-bit bitmap once it grows past that, so sparse and
+ * dense sets are both small and intersections stay cheap.
+ */
+class RoaringBitmap
+{
+public:
+    RoaringBitmap();
+
+    void add(quint32 value);
+    void remove(quint32 value);
+    bool contains(quint32 value) const;
+
+    int cardinality() const;
+    bool isEmpty() const;
+
+    RoaringBitmap operator&(const RoaringBitmap &other) const;
+    RoaringBitmap operator|(const RoaringBitmap &other) const;
+    RoaringBitmap &operator|=(const RoaringBitmap &other);
+    RoaringBitmap andNot(const RoaringBitmap &other) const;
+
+    // Ascending.
+    QVector<quint32> toVector() const;
+
+private:
+    struct Container
+    {
+        Container() : cardinality(0) {}
+
+        bool isBitmap() const { return !bits.isEmpty(); }
+        bool contains(quint16 low) const;
+        void add(quint16 low);
+        void remove(quint16 low);
+        void toBitmap();
+        void optimize();
+
+        QVector<quint16> array;   // sorted, used while small
+        QVector<quint64> bits;    // 1024 words, used once large
+        int cardinality;
+    };
+
+    static Container intersect(const Container &a, const Container &b);
+    static Container unite(const Container &a, const Container &b);
+    static Container subtract(const Container &a, const Container &b);
+
+    QMap<quint16, Container> m_containers;
+};
+
+#endif /* ROARINGBITMAP_HPP_ */
@@ -0,0 +1,154 @@
+/*
+ * rowindex.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "rowindex.hpp"
+
+#include <QDebug>
+#include <QtSql/QtSql>
+
+RowIndex::RowIndex()
+    : m_capacity(0)
+    , m_count(0)
+    , m_loaded(false)
+{
+}
+
+bool RowIndex::load(QSqlDatabase database)
+{
+    clear();
+
+    QSqlQuery query(database);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT eventID FROM events WHERE deletedAt IS NULL"))
+        return false;
+
+    QVector<qint64> ids;
+    qint64 maxId = 0;
+    while (query.next()) {
+        const qint64 id = query.value(0).toLongLong();
+        ids << id;
+        maxId = qMax(maxId, id);
+    }
+    if (!reserve(maxId))
+        return false;
+    for (int i = 0; i < ids.size(); ++i) {
+        if (ids.at(i) > 0)
+            m_live.setBit(int(ids.at(i)));
+    }
+    build();
+
+    m_loaded = true;
+    qDebug() << "Row index:" << m_count << "entries, eventIDs up to" << maxId;
+    return true;
+}
+
+void RowIndex::clear()
+{
+    m_tree.clear();
+    m_live.clear();
+    m_capacity = 0;
+    m_count = 0;
+    m_loaded = false;
+}
+
+bool RowIndex::isLoaded() const
+{
+    return m_loaded;
+}
+
+void RowIndex::addEvent(qint64 eventId)
+{
+    if (!m_loaded || eventId <= 0)
+        return;
+    if (!reserve(eventId)) {
+        clear();
+        return;
+    }
+    if (!m_live.testBit(int(eventId))) {
+        m_live.setBit(int(eventId));
+        update(eventId, 1);
+    }
+}
+
+void RowIndex::removeEvent(qint64 eventId)
+{
+    if (!m_loaded || eventId <= 0 || eventId > m_capacity || !m_live.testBit(int(eventId)))
+        return;
+    m_live.clearBit(int(eventId));
+    update(eventId, -1);
+}
+
+int RowIndex::count() const
+{
+    return m_count;
+}
+
+int RowIndex::rowOf(qint64 eventId) const
+{
+    // The entries before it.
+    int row = 0;
+    for (int i = int(qBound<qint64>(0, eventId - 1, m_capacity)); i > 0; i &= i - 1)
+        row += m_tree.at(i);
+    return row;
+}
+
+qint64 RowIndex::eventAt(int row) const
+{
+    if (row < 0 || row >= m_count)
+        return -1;
+
+    // The largest eventID with at most 'row' entries up to it; the entry is the next one.
+    int position = 0;
+    int remaining = row + 1;
+    for (int step = m_capacity; step; step >>= 1) {
+        if (position + step <= m_capacity && m_tree.at(position + step) < remaining) {
+            position += step;
+            remaining -= m_tree.at(position);
+        }
+    }
+    return position + 1;
+}
+
+bool RowIndex::reserve(qint64 eventId)
+{
+    if (eventId <= m_capacity)
+        return true;
+    if (eventId > ROW_INDEX_MAX_EVENT_ID) {
+        qWarning() << "Row index: eventID" << eventId << "is too large, rows are looked up with OFFSET";
+        return false;
+    }
+
+    // Doubling keeps the rebuilds to O(n) in all.
+    int capacity = qMax(m_capacity, 1024);
+    while (capacity < eventId)
+        capacity *= 2;
+    m_capacity = capacity;
+    m_live.resize(capacity + 1);
+    build();
+    return true;
+}
+
+void RowIndex::build()
+{
+    m_tree.fill(0, m_capacity + 1);
+    m_count = 0;
+    for (int i = 1; i <= m_capacity; ++i) {
+        if (m_live.testBit(i)) {
+            ++m_tree[i];
+            ++m_count;
+        }
+        const int parent = i + (i & -i);
+        if (parent <= m_capacity)
+            m_tree[parent] += m_tree.at(i);
+    }
+}
+
+void RowIndex::update(qint64 eventId, int delta)
+{
+    for (int i = int(eventId); i <= m_capacity; i += i & -i)
+        m_tree[i] += delta;
+    m_count += delta;
+}
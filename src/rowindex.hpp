@@ -0,0 +1,62 @@
+/*
+ * rowindex.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef ROWINDEX_HPP_
+#define ROWINDEX_HPP_
+
+#include <QBitArray>
+#include <QVector>
+#include <QtSql/QSqlDatabase>
+
+// Beyond this eventID the tree would take more memory than it saves; the
+// list then falls back to OFFSET queries.
+#define ROW_INDEX_MAX_EVENT_ID (1 << 22)
+
+/*
+ * @brief Maps rows of the entry list to eventIDs and back in O(log n).
+ *
+ * Rows are positions among the entries not in the trash, in eventID order.
+ * A Fenwick tree over the eventIDs counts the entries in the list up to any
+ * eventID, which is the row of the next one; walking down the tree finds
+ * the eventID at a row. The list then reads a page from a known eventID
+ * instead of skipping rows with OFFSET, which gets slower the further down
+ * the row is.
+ *
+ * The index is loaded once and then kept current entry by entry, like the
+ * FacetIndex. Both take about 4 bytes per eventID.
+ */
+class RowIndex
+{
+public:
+    RowIndex();
+
+    bool load(QSqlDatabase database);
+    void clear();
+    bool isLoaded() const;
+
+    void addEvent(qint64 eventId);
+    void removeEvent(qint64 eventId);
+
+    int count() const;
+    // The row of the entry, or the row it would have if it were in the list.
+    int rowOf(qint64 eventId) const;
+    // -1 past the end of the list.
+    qint64 eventAt(int row) const;
+
+private:
+    bool reserve(qint64 eventId);
+    void build();
+    void update(qint64 eventId, int delta);
+
+    QVector<int> m_tree;       // 1-based; m_tree[i] counts the eventIDs (i - (i & -i), i]
+    QBitArray m_live;          // by eventID
+    int m_capacity;            // a power of two, or 0
+    int m_count;
+    bool m_loaded;
+};
+
+#endif /* ROWINDEX_HPP_ */
@@ -0,0 +1,751 @@
+/*
+ * schemamigrator.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "schemamigrator.hpp"
+#include "EventData.hpp"
+#include "facetindex.hpp"
+#include "iovfs.hpp"
+#include "similarityindex.hpp"
+#include "textcounter.hpp"
+
+#include <QThread>
+#include <QtSql/QtSql>
+
+#include <unistd.h>
+
+#define MIGRATION_BATCH_SIZE 200
+#define MIGRATION_BATCH_PAUSE_MS 20
+#define MIGRATION_CONNECTION "DWriter-migration"
+
+// -----------------------------------------------------------------------------------------------
+// Data steps
+
+// Version 2: derive the sortable createdAt column from the textual timeStamp.
+static int fillCreatedAt(QSqlDatabase &database, qint64 &cursor, int batchSize)
+{
+    QSqlQuery select(database);
+    select.prepare("SELECT eventID, timeStamp FROM events "
+                   "WHERE eventID > :cursor ORDER BY eventID LIMIT :limit");
+    select.bindValue(":cursor", cursor);
+    select.bindValue(":limit", batchSize);
+    if (!select.exec())
+        return -1;
+
+    QSqlQuery update(database);
+    update.prepare("UPDATE events SET createdAt = :createdAt WHERE eventID = :eventID");
+
+    int rows = 0;
+    while (select.next()) {
+        const qint64 eventId = select.value(0).toLongLong();
+        update.bindValue(":createdAt", eventTimeFromString(select.value(1).toString()));
+        update.bindValue(":eventID", eventId);
+        if (!update.exec())
+            return -1;
+        cursor = eventId;
+        ++rows;
+    }
+    return rows;
+}
+
+// Version 5: tag existing entries with the #hashtags in their text.
+static int extractHashtags(QSqlDatabase &database, qint64 &cursor, int batchSize)
+{
+    QSqlQuery select(database);
+    select.prepare("SELECT eventID, textEvent FROM events "
+                   "WHERE eventID > :cursor ORDER BY eventID LIMIT :limit");
+    select.bindValue(":cursor", cursor);
+    select.bindValue(":limit", batchSize);
+    if (!select.exec())
+        return -1;
+
+    int rows = 0;
+    while (select.next()) {
+        const qint64 eventId = select.value(0).toLongLong();
+        const QStringList tags = FacetIndex::hashtags(select.value(1).toString());
+        if (!tags.isEmpty() && !FacetIndex::writeTags(database, eventId, tags, true))
+            return -1;
+        cursor = eventId;
+        ++rows;
+    }
+    return rows;
+}
+
+// Version 6: MinHash signatures and LSH buckets of existing entries.
+static int fillSignatures(QSqlDatabase &database, qint64 &cursor, int batchSize)
+{
+    QSqlQuery select(database);
+    select.prepare("SELECT eventID, textEvent FROM events "
+                   "WHERE eventID > :cursor ORDER BY eventID LIMIT :limit");
+    select.bindValue(":cursor", cursor);
+    select.bindValue(":limit", batchSize);
+    if (!select.exec())
+        return -1;
+
+    SimilarityIndex index(database);
+    int rows = 0;
+    while (select.next()) {
+        const qint64 eventId = select.value(0).toLongLong();
+        if (!index.addEvent(eventId, SimilarityIndex::signature(select.value(1).toString())))
+            return -1;
+        cursor = eventId;
+        ++rows;
+    }
+    return rows;
+}
+
+// Version 8: give existing entries a sync identity and log them as inserts,
+// so the first sync sends the whole journal once.
+static int fillSyncIds(QSqlDatabase &database, qint64 &cursor, int batchSize)
+{
+    QSqlQuery select(database);
+    select.prepare("SELECT eventID FROM events "
+                   "WHERE eventID > :cursor AND syncId IS NULL ORDER BY eventID LIMIT :limit");
+    select.bindValue(":cursor", cursor);
+    select.bindValue(":limit", batchSize);
+    if (!select.exec())
+        return -1;
+
+    QSqlQuery update(database);
+    update.prepare("UPDATE events SET syncId = lower(hex(randomblob(16))), "
+                   "updatedAt = COALESCE(createdAt, strftime('%s', 'now')) WHERE eventID = :eventID");
+    QSqlQuery log(database);
+    log.prepare("INSERT INTO changes (eventID, syncId, op, changedAt) "
+                "SELECT eventID, syncId, 'I', updatedAt FROM events WHERE eventID = :eventID");
+
+    int rows = 0;
+    while (select.next()) {
+        const qint64 eventId = select.value(0).toLongLong();
+        update.bindValue(":eventID", eventId);
+        log.bindValue(":eventID", eventId);
+        if (!update.exec() || !log.exec())
+            return -1;
+        cursor = eventId;
+        ++rows;
+    }
+    return rows;
+}
+
+// Version 9: word and character counts of existing entries.
+static int fillTextCounts(QSqlDatabase &database, qint64 &cursor, int batchSize)
+{
+    QSqlQuery select(database);
+    select.prepare("SELECT eventID, textEvent FROM events "
+                   "WHERE eventID > :cursor ORDER BY eventID LIMIT :limit");
+    select.bindValue(":cursor", cursor);
+    select.bindValue(":limit", batchSize);
+    if (!select.exec())
+        return -1;
+
+    QSqlQuery update(database);
+    update.prepare("UPDATE events SET words = :words, characters = :characters WHERE eventID = :eventID");
+
+    int rows = 0;
+    while (select.next()) {
+        const qint64 eventId = select.value(0).toLongLong();
+        const TextCounts counts = TextCounter::count(select.value(1).toString());
+        update.bindValue(":words", counts.words);
+        update.bindValue(":characters", counts.characters);
+        update.bindValue(":eventID", eventId);
+        if (!update.exec())
+            return -1;
+        cursor = eventId;
+        ++rows;
+    }
+    return rows;
+}
+
+// -----------------------------------------------------------------------------------------------
+// SchemaMigrator
+
+SchemaMigrator::SchemaMigrator(const QString &databaseName, QObject *parent)
+    : QObject(parent)
+    , m_databaseName(databaseName)
+    , m_thread(0)
+    , m_worker(0)
+{
+}
+
+SchemaMigrator::~SchemaMigrator()
+{
+    stopBackgroundMigration();
+}
+
+QString SchemaMigrator::eventsTableSql()
+{
+    return "CREATE TABLE IF NOT EXISTS events ( "
+           "                eventID INTEGER PRIMARY KEY AUTOINCREMENT, "
+           "                timeStamp VARCHAR, "
+           "                textEvent VARCHAR"
+           ");";
+}
+
+/*
+ * The list of schema versions. Append new versions at the end; never edit
+ * a version that has shipped.
+ */
+const QList<Migration> &SchemaMigrator::migrations()
+{
+    static QList<Migration> list;
+    if (list.isEmpty()) {
+        Migration v1;
+        v1.version = 1;
+        v1.schemaSql << eventsTableSql();
+        v1.dataStep = 0;
+        list << v1;
+
+        Migration v2;
+        v2.version = 2;
+        v2.schemaSql << "ALTER TABLE events ADD COLUMN createdAt INTEGER"
+                     << "CREATE INDEX IF NOT EXISTS events_createdAt ON events(createdAt)";
+        v2.dataStep = fillCreatedAt;
+        list << v2;
+
+        // Version 3: files linked to entries, and the resume state of bulk imports.
+        Migration v3;
+        v3.version = 3;
+        v3.schemaSql << "CREATE TABLE IF NOT EXISTS attachments ( "
+                        "                attachmentID INTEGER PRIMARY KEY AUTOINCREMENT, "
+                        "                eventID INTEGER NOT NULL, "
+                        "                kind VARCHAR, "
+                        "                path VARCHAR, "
+                        "                sha1 VARCHAR"
+                        ");"
+                     << "CREATE INDEX IF NOT EXISTS attachments_eventID ON attachments(eventID)"
+                     << "CREATE TABLE IF NOT EXISTS imports ( "
+                        "                source VARCHAR PRIMARY KEY, "
+                        "                size INTEGER, "
+                        "                modified INTEGER, "
+                        "                offset INTEGER NOT NULL DEFAULT 0, "
+                        "                entries INTEGER NOT NULL DEFAULT 0, "
+                        "                done INTEGER NOT NULL DEFAULT 0"
+                        ");";
+        v3.dataStep = 0;
+        list << v3;
+
+        // Version 4: edit history, see RevisionStore.
+        Migration v4;
+        v4.version = 4;
+        v4.schemaSql << "CREATE TABLE IF NOT EXISTS revisions ( "
+                        "                eventID INTEGER NOT NULL, "
+                        "                revision INTEGER NOT NULL, "
+                        "                savedAt INTEGER, "
+                        "                snapshot INTEGER NOT NULL, "
+                        "                data BLOB, "
+                        "                PRIMARY KEY (eventID, revision)"
+                        ");";
+        v4.dataStep = 0;
+        list << v4;
+
+        // Version 5: facets, see FacetIndex.
+        Migration v5;
+        v5.version = 5;
+        v5.schemaSql << "ALTER TABLE events ADD COLUMN mood INTEGER"
+                     << "CREATE TABLE IF NOT EXISTS event_tags ( "
+                        "                eventID INTEGER NOT NULL, "
+                        "                tag VARCHAR NOT NULL, "
+                        "                inline INTEGER NOT NULL DEFAULT 0, "
+                        "                PRIMARY KEY (tag, eventID)"
+                        ");"
+                     << "CREATE INDEX IF NOT EXISTS event_tags_eventID ON event_tags(eventID)";
+        v5.dataStep = extractHashtags;
+        list << v5;
+
+        // Version 6: similar entries, see SimilarityIndex.
+        Migration v6;
+        v6.version = 6;
+        v6.schemaSql << "CREATE TABLE IF NOT EXISTS event_signatures ( "
+                        "                eventID INTEGER PRIMARY KEY, "
+                        "                signature BLOB"
+                        ");"
+                     << "CREATE TABLE IF NOT EXISTS event_lsh ( "
+                        "                band INTEGER NOT NULL, "
+                        "                bucket INTEGER NOT NULL, "
+                        "                eventID INTEGER NOT NULL, "
+                        "                PRIMARY KEY (band, bucket, eventID)"
+                        ");"
+                     << "CREATE INDEX IF NOT EXISTS event_lsh_eventID ON event_lsh(eventID)";
+        v6.dataStep = fillSignatures;
+        list << v6;
+
+        // Version 7: timings of the idle-time maintenance, see MaintenanceScheduler.
+        Migration v7;
+        v7.version = 7;
+        v7.schemaSql << "CREATE TABLE IF NOT EXISTS maintenance ( "
+                        "                task VARCHAR PRIMARY KEY, "
+                        "                lastRun INTEGER, "
+                        "                runs INTEGER NOT NULL DEFAULT 0, "
+                        "                lastMs INTEGER, "
+                        "                totalMs INTEGER NOT NULL DEFAULT 0, "
+                        "                rowsAtRun INTEGER"
+                        ");";
+        v7.dataStep = 0;
+        list << v7;
+
+        // Version 8: change log for sync, see SyncClient. The triggers write
+        // the log in the same transaction as the change; they stay quiet while
+        // SyncClient applies remote changes (sync_state key 'applying').
+        Migration v8;
+        v8.version = 8;
+        v8.schemaSql << "ALTER TABLE events ADD COLUMN syncId VARCHAR"
+                     << "ALTER TABLE events ADD COLUMN updatedAt INTEGER"
+                     << "CREATE UNIQUE INDEX IF NOT EXISTS events_syncId ON events(syncId)"
+                     << "CREATE TABLE IF NOT EXISTS changes ( "
+                        "                seq INTEGER PRIMARY KEY AUTOINCREMENT, "
+                        "                eventID INTEGER NOT NULL, "
+                        "                syncId VARCHAR, "
+                        "                op CHAR(1) NOT NULL, "
+                        "                changedAt INTEGER"
+                        ");"
+                     << "CREATE TABLE IF NOT EXISTS sync_state ( "
+                        "                key VARCHAR PRIMARY KEY, "
+                        "                value"
+                        ");"
+                     << "CREATE TRIGGER IF NOT EXISTS events_log_insert AFTER INSERT ON events "
+                        "BEGIN "
+                        "    UPDATE events SET syncId = lower(hex(randomblob(16))), "
+                        "                      updatedAt = strftime('%s', 'now') "
+                        "    WHERE eventID = NEW.eventID AND NEW.syncId IS NULL; "
+                        "    INSERT INTO changes (eventID, syncId, op, changedAt) "
+                        "    SELECT eventID, syncId, 'I', strftime('%s', 'now') FROM events "
+                        "    WHERE eventID = NEW.eventID "
+                        "      AND NOT EXISTS (SELECT 1 FROM sync_state WHERE key = 'applying'); "
+                        "END"
+                     << "CREATE TRIGGER IF NOT EXISTS events_log_update AFTER UPDATE OF textEvent, mood ON events "
+                        "WHEN NOT EXISTS (SELECT 1 FROM sync_state WHERE key = 'applying') "
+                        "BEGIN "
+                        "    UPDATE events SET updatedAt = strftime('%s', 'now') WHERE eventID = NEW.eventID; "
+                        "    INSERT INTO changes (eventID, syncId, op, changedAt) "
+                        "    VALUES (NEW.eventID, NEW.syncId, 'U', strftime('%s', 'now')); "
+                        "END"
+                     << "CREATE TRIGGER IF NOT EXISTS events_log_delete AFTER DELETE ON events "
+                        "WHEN NOT EXISTS (SELECT 1 FROM sync_state WHERE key = 'applying') "
+                        "BEGIN "
+                        "    INSERT INTO changes (eventID, syncId, op, changedAt) "
+                        "    VALUES (OLD.eventID, OLD.syncId, 'D', strftime('%s', 'now')); "
+                        "END"
+                     << "CREATE TRIGGER IF NOT EXISTS event_tags_log_insert AFTER INSERT ON event_tags "
+                        "WHEN NOT EXISTS (SELECT 1 FROM sync_state WHERE key = 'applying') "
+                        "BEGIN "
+                        "    UPDATE events SET updatedAt = strftime('%s', 'now') WHERE eventID = NEW.eventID; "
+                        "    INSERT INTO changes (eventID, syncId, op, changedAt) "
+                        "    SELECT eventID, syncId, 'U', strftime('%s', 'now') FROM events "
+                        "    WHERE eventID = NEW.eventID; "
+                        "END"
+                     << "CREATE TRIGGER IF NOT EXISTS event_tags_log_delete AFTER DELETE ON event_tags "
+                        "WHEN NOT EXISTS (SELECT 1 FROM sync_state WHERE key = 'applying') "
+                        "BEGIN "
+                        "    UPDATE events SET updatedAt = strftime('%s', 'now') WHERE eventID = OLD.eventID; "
+                        "    INSERT INTO changes (eventID, syncId, op, changedAt) "
+                        "    SELECT eventID, syncId, 'U', strftime('%s', 'now') FROM events "
+                        "    WHERE eventID = OLD.eventID; "
+                        "END";
+        v8.dataStep = fillSyncIds;
+        list << v8;
+
+        // Version 9: word and character counts, and daily and monthly totals
+        // that triggers keep up to date in the writer's transaction, see
+        // JournalStats. Existing rows are counted as entries here and get
+        // their words and characters from the data step, through the trigger.
+        Migration v9;
+        v9.version = 9;
+        v9.schemaSql << "ALTER TABLE events ADD COLUMN words INTEGER NOT NULL DEFAULT 0"
+                     << "ALTER TABLE events ADD COLUMN characters INTEGER NOT NULL DEFAULT 0"
+                     << "CREATE TABLE IF NOT EXISTS stats_daily ( "
+                        "                day INTEGER PRIMARY KEY, "
+                        "                entries INTEGER NOT NULL DEFAULT 0, "
+                        "                words INTEGER NOT NULL DEFAULT 0, "
+                        "                characters INTEGER NOT NULL DEFAULT 0"
+                        ");"
+                     << "CREATE TABLE IF NOT EXISTS stats_monthly ( "
+                        "                month INTEGER PRIMARY KEY, "
+                        "                entries INTEGER NOT NULL DEFAULT 0, "
+                        "                words INTEGER NOT NULL DEFAULT 0, "
+                        "                characters INTEGER NOT NULL DEFAULT 0"
+                        ");"
+                     << "INSERT OR IGNORE INTO stats_daily (day, entries) "
+                        "SELECT CAST(julianday(events.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER), COUNT(*) FROM events "
+                        "WHERE events.createdAt IS NOT NULL GROUP BY 1"
+                     << "INSERT OR IGNORE INTO stats_monthly (month, entries) "
+                        "SELECT CAST(strftime('%Y%m', events.createdAt, 'unixepoch', 'localtime') AS INTEGER), COUNT(*) FROM events "
+                        "WHERE events.createdAt IS NOT NULL GROUP BY 1"
+                     << "CREATE TRIGGER IF NOT EXISTS events_stats_insert AFTER INSERT ON events "
+                        "BEGIN "
+                        "    INSERT OR IGNORE INTO stats_daily (day) VALUES (CAST(julianday(NEW.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER)); "
+                        "    UPDATE stats_daily SET entries = entries + 1, words = words + NEW.words, "
+                        "                           characters = characters + NEW.characters "
+                        "    WHERE day = CAST(julianday(NEW.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER); "
+                        "    INSERT OR IGNORE INTO stats_monthly (month) VALUES (CAST(strftime('%Y%m', NEW.createdAt, 'unixepoch', 'localtime') AS INTEGER)); "
+                        "    UPDATE stats_monthly SET entries = entries + 1, words = words + NEW.words, "
+                        "                             characters = characters + NEW.characters "
+                        "    WHERE month = CAST(strftime('%Y%m', NEW.createdAt, 'unixepoch', 'localtime') AS INTEGER); "
+                        "END"
+                     << "CREATE TRIGGER IF NOT EXISTS events_stats_update "
+                        "AFTER UPDATE OF words, characters, createdAt ON events "
+                        "BEGIN "
+                        "    UPDATE stats_daily SET entries = entries - 1, words = words - OLD.words, "
+                        "                           characters = characters - OLD.characters "
+                        "    WHERE day = CAST(julianday(OLD.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER); "
+                        "    UPDATE stats_monthly SET entries = entries - 1, words = words - OLD.words, "
+                        "                             characters = characters - OLD.characters "
+                        "    WHERE month = CAST(strftime('%Y%m', OLD.createdAt, 'unixepoch', 'localtime') AS INTEGER); "
+                        "    INSERT OR IGNORE INTO stats_daily (day) VALUES (CAST(julianday(NEW.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER)); "
+                        "    UPDATE stats_daily SET entries = entries + 1, words = words + NEW.words, "
+                        "                           characters = characters + NEW.characters "
+                        "    WHERE day = CAST(julianday(NEW.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER); "
+                        "    INSERT OR IGNORE INTO stats_monthly (month) VALUES (CAST(strftime('%Y%m', NEW.createdAt, 'unixepoch', 'localtime') AS INTEGER)); "
+                        "    UPDATE stats_monthly SET entries = entries + 1, words = words + NEW.words, "
+                        "                             characters = characters + NEW.characters "
+                        "    WHERE month = CAST(strftime('%Y%m', NEW.createdAt, 'unixepoch', 'localtime') AS INTEGER); "
+                        "END"
+                     << "CREATE TRIGGER IF NOT EXISTS events_stats_delete AFTER DELETE ON events "
+                        "BEGIN "
+                        "    UPDATE stats_daily SET entries = entries - 1, words = words - OLD.words, "
+                        "                           characters = characters - OLD.characters "
+                        "    WHERE day = CAST(julianday(OLD.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER); "
+                        "    UPDATE stats_monthly SET entries = entries - 1, words = words - OLD.words, "
+                        "                             characters = characters - OLD.characters "
+                        "    WHERE month = CAST(strftime('%Y%m', OLD.createdAt, 'unixepoch', 'localtime') AS INTEGER); "
+                        "END";
+        v9.dataStep = fillTextCounts;
+        list << v9;
+
+        // Version 10: soft delete, see TrashStore. The totals count the entries
+        // outside the trash, and for sync moving an entry to the trash is a
+        // delete and taking it back out an edit.
+        Migration v10;
+        v10.version = 10;
+        v10.schemaSql << "ALTER TABLE events ADD COLUMN deletedAt INTEGER"
+                      << "CREATE INDEX IF NOT EXISTS events_deletedAt ON events(deletedAt)"
+                      << "DROP TRIGGER IF EXISTS events_stats_update"
+                      << "DROP TRIGGER IF EXISTS events_stats_delete"
+                      << "CREATE TRIGGER IF NOT EXISTS events_stats_update "
+                         "AFTER UPDATE OF words, characters, createdAt, deletedAt ON events "
+                         "BEGIN "
+                         "    UPDATE stats_daily SET entries = entries - 1, words = words - OLD.words, "
+                         "                           characters = characters - OLD.characters "
+                         "    WHERE day = CAST(julianday(OLD.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER) AND OLD.deletedAt IS NULL; "
+                         "    UPDATE stats_monthly SET entries = entries - 1, words = words - OLD.words, "
+                         "                             characters = characters - OLD.characters "
+                         "    WHERE month = CAST(strftime('%Y%m', OLD.createdAt, 'unixepoch', 'localtime') AS INTEGER) AND OLD.deletedAt IS NULL; "
+                         "    INSERT OR IGNORE INTO stats_daily (day) VALUES (CAST(julianday(NEW.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER)); "
+                         "    UPDATE stats_daily SET entries = entries + 1, words = words + NEW.words, "
+                         "                           characters = characters + NEW.characters "
+                         "    WHERE day = CAST(julianday(NEW.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER) AND NEW.deletedAt IS NULL; "
+                         "    INSERT OR IGNORE INTO stats_monthly (month) VALUES (CAST(strftime('%Y%m', NEW.createdAt, 'unixepoch', 'localtime') AS INTEGER)); "
+                         "    UPDATE stats_monthly SET entries = entries + 1, words = words + NEW.words, "
+                         "                             characters = characters + NEW.characters "
+                         "    WHERE month = CAST(strftime('%Y%m', NEW.createdAt, 'unixepoch', 'localtime') AS INTEGER) AND NEW.deletedAt IS NULL; "
+                         "END"
+                      << "CREATE TRIGGER IF NOT EXISTS events_stats_delete AFTER DELETE ON events "
+                         "BEGIN "
+                         "    UPDATE stats_daily SET entries = entries - 1, words = words - OLD.words, "
+                         "                           characters = characters - OLD.characters "
+                         "    WHERE day = CAST(julianday(OLD.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER) AND OLD.deletedAt IS NULL; "
+                         "    UPDATE stats_monthly SET entries = entries - 1, words = words - OLD.words, "
+                         "                             characters = characters - OLD.characters "
+                         "    WHERE month = CAST(strftime('%Y%m', OLD.createdAt, 'unixepoch', 'localtime') AS INTEGER) AND OLD.deletedAt IS NULL; "
+                         "END"
+                      << "CREATE TRIGGER IF NOT EXISTS events_log_trash AFTER UPDATE OF deletedAt ON events "
+                         "WHEN (OLD.deletedAt IS NULL) <> (NEW.deletedAt IS NULL) "
+                         " AND NOT EXISTS (SELECT 1 FROM sync_state WHERE key = 'applying') "
+                         "BEGIN "
+                         "    UPDATE events SET updatedAt = strftime('%s', 'now') WHERE eventID = NEW.eventID; "
+                         "    INSERT INTO changes (eventID, syncId, op, changedAt) "
+                         "    VALUES (NEW.eventID, NEW.syncId, CASE WHEN NEW.deletedAt IS NULL THEN 'U' ELSE 'D' END, "
+                         "            strftime('%s', 'now')); "
+                         "END";
+        v10.dataStep = 0;
+        list << v10;
+
+        // Version 11: bulk imports. While an import holds sync_state key
+        // 'importing' in its transaction, the insert triggers stay quiet and
+        // JournalImporter logs the changes and adds the totals once per window.
+        // The resume state of a source keeps the SHA-1 of the bytes read.
+        Migration v11;
+        v11.version = 11;
+        v11.schemaSql << "ALTER TABLE imports ADD COLUMN sha1 VARCHAR"
+                      << "CREATE INDEX IF NOT EXISTS imports_sha1 ON imports(sha1)"
+                      << "DROP TRIGGER IF EXISTS events_log_insert"
+                      << "DROP TRIGGER IF EXISTS event_tags_log_insert"
+                      << "DROP TRIGGER IF EXISTS events_stats_insert"
+                      << "CREATE TRIGGER IF NOT EXISTS events_log_insert AFTER INSERT ON events "
+                         "WHEN NOT EXISTS (SELECT 1 FROM sync_state WHERE key = 'importing') "
+                         "BEGIN "
+                         "    UPDATE events SET syncId = lower(hex(randomblob(16))), "
+                         "                      updatedAt = strftime('%s', 'now') "
+                         "    WHERE eventID = NEW.eventID AND NEW.syncId IS NULL; "
+                         "    INSERT INTO changes (eventID, syncId, op, changedAt) "
+                         "    SELECT eventID, syncId, 'I', strftime('%s', 'now') FROM events "
+                         "    WHERE eventID = NEW.eventID "
+                         "      AND NOT EXISTS (SELECT 1 FROM sync_state WHERE key = 'applying'); "
+                         "END"
+                      << "CREATE TRIGGER IF NOT EXISTS event_tags_log_insert AFTER INSERT ON event_tags "
+                         "WHEN NOT EXISTS (SELECT 1 FROM sync_state WHERE key IN ('applying', 'importing')) "
+                         "BEGIN "
+                         "    UPDATE events SET updatedAt = strftime('%s', 'now') WHERE eventID = NEW.eventID; "
+                         "    INSERT INTO changes (eventID, syncId, op, changedAt) "
+                         "    SELECT eventID, syncId, 'U', strftime('%s', 'now') FROM events "
+                         "    WHERE eventID = NEW.eventID; "
+                         "END"
+                      << "CREATE TRIGGER IF NOT EXISTS events_stats_insert AFTER INSERT ON events "
+                         "WHEN NOT EXISTS (SELECT 1 FROM sync_state WHERE key = 'importing') "
+                         "BEGIN "
+                         "    INSERT OR IGNORE INTO stats_daily (day) VALUES (CAST(julianday(NEW.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER)); "
+                         "    UPDATE stats_daily SET entries = entries + 1, words = words + NEW.words, "
+                         "                           characters = characters + NEW.characters "
+                         "    WHERE day = CAST(julianday(NEW.createdAt, 'unixepoch', 'localtime') + 0.5 AS INTEGER); "
+                         "    INSERT OR IGNORE INTO stats_monthly (month) VALUES (CAST(strftime('%Y%m', NEW.createdAt, 'unixepoch', 'localtime') AS INTEGER)); "
+                         "    UPDATE stats_monthly SET entries = entries + 1, words = words + NEW.words, "
+                         "                             characters = characters + NEW.characters "
+                         "    WHERE month = CAST(strftime('%Y%m', NEW.createdAt, 'unixepoch', 'localtime') AS INTEGER); "
+                         "END";
+        v11.dataStep = 0;
+        list << v11;
+    }
+    return list;
+}
+
+int SchemaMigrator::latestVersion()
+{
+    return migrations().last().version;
+}
+
+bool SchemaMigrator::migrateSchema(QSqlDatabase &database, QString *errorText)
+{
+    QSqlQuery query(database);
+
+    // A new journal returns the pages of purged entries to the file system a
+    // few at a time (see MaintenanceScheduler). The mode can only be chosen
+    // before the first table is created.
+    if (query.exec("PRAGMA page_count") && query.next() && query.value(0).toInt() == 0) {
+        query.finish();
+        query.exec("PRAGMA auto_vacuum = INCREMENTAL");
+    }
+
+    if (!query.exec("CREATE TABLE IF NOT EXISTS schema_migrations ( "
+                    "                version INTEGER PRIMARY KEY, "
+                    "                cursor INTEGER NOT NULL DEFAULT 0, "
+                    "                done INTEGER NOT NULL DEFAULT 0"
+                    ");")) {
+        if (errorText)
+            *errorText = query.lastError().text();
+        return false;
+    }
+
+    int current = 0;
+    if (query.exec("PRAGMA user_version") && query.next())
+        current = query.value(0).toInt();
+
+    // dropTable() leaves user_version behind, and the tables keyed by eventID.
+    // The new events table hands out IDs from 1 again, so those rows would
+    // attach to the wrong entries: they are dropped too, and every version is
+    // applied again from scratch.
+    if (current > 0 && query.exec("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'events'")
+        && !query.next()) {
+        qDebug() << "The events table is missing; rebuilding the schema from version 1";
+        static const char *const dependents[] = {
+            "attachments", "imports", "revisions", "event_tags", "event_signatures",
+            "event_lsh", "changes", "sync_state", "stats_daily", "stats_monthly"
+        };
+        database.transaction();
+        bool ok = true;
+        for (size_t t = 0; ok && t < sizeof(dependents) / sizeof(dependents[0]); ++t)
+            ok = query.exec(QString("DROP TABLE IF EXISTS %1").arg(dependents[t]));
+        ok = ok && query.exec("DELETE FROM schema_migrations");
+        if (!ok) {
+            if (errorText)
+                *errorText = query.lastError().text();
+            database.rollback();
+            return false;
+        }
+        database.commit();
+        current = 0;
+    }
+
+    const QList<Migration> &list = migrations();
+    for (int i = 0; i < list.size(); ++i) {
+        const Migration &migration = list.at(i);
+        if (migration.version <= current)
+            continue;
+
+        // Each version is applied atomically together with its user_version bump,
+        // so a crash in the middle leaves the database at the previous version.
+        database.transaction();
+        bool ok = true;
+        for (int s = 0; ok && s < migration.schemaSql.size(); ++s)
+            ok = query.exec(migration.schemaSql.at(s));
+
+        if (ok && migration.dataStep) {
+            query.prepare("INSERT OR REPLACE INTO schema_migrations (version, cursor, done) "
+                          "VALUES(:version, 0, 0)");
+            query.bindValue(":version", migration.version);
+            ok = query.exec();
+        }
+        if (ok)
+            ok = query.exec(QString("PRAGMA user_version = %1").arg(migration.version));
+
+        if (!ok) {
+            if (errorText)
+                *errorText = tr("Schema version %1: %2").arg(migration.version)
+                                                         .arg(query.lastError().text());
+            database.rollback();
+            return false;
+        }
+        database.commit();
+        qDebug() << "Schema migrated to version" << migration.version;
+    }
+    return true;
+}
+
+void SchemaMigrator::startBackgroundMigration(bool applySchema)
+{
+    // A running worker is stopped between batches and picks up where it was.
+    if (m_thread && m_thread->isRunning() && !applySchema)
+        return;
+    stopBackgroundMigration();
+
+    m_thread = new QThread(this);
+    m_worker = new MigrationWorker(m_databaseName, migrations(), applySchema);
+    m_worker->moveToThread(m_thread);
+
+    connect(m_thread, SIGNAL(started()), m_worker, SLOT(run()));
+    connect(m_worker, SIGNAL(finished()), m_thread, SLOT(quit()));
+    connect(m_worker, SIGNAL(progress(int, qint64, qint64)),
+            this, SIGNAL(progress(int, qint64, qint64)));
+    connect(m_worker, SIGNAL(finished()), this, SIGNAL(finished()));
+    connect(m_worker, SIGNAL(error(const QString&)), this, SIGNAL(error(const QString&)));
+
+    m_thread->start(QThread::LowPriority);
+}
+
+void SchemaMigrator::stopBackgroundMigration()
+{
+    if (!m_thread)
+        return;
+
+    // The worker checks the flag between batches; the current batch is
+    // committed (or rolled back) before the thread exits.
+    m_worker->stop();
+    m_thread->quit();
+    m_thread->wait();
+
+    delete m_worker;
+    m_worker = 0;
+    delete m_thread;
+    m_thread = 0;
+}
+
+// -----------------------------------------------------------------------------------------------
+// MigrationWorker
+
+MigrationWorker::MigrationWorker(const QString &databaseName, const QList<Migration> &migrations,
+                                 bool applySchema)
+    : m_databaseName(databaseName)
+    , m_migrations(migrations)
+    , m_applySchema(applySchema)
+    , m_stopRequested(0)
+{
+}
+
+void MigrationWorker::stop()
+{
+    m_stopRequested.fetchAndStoreOrdered(1);
+}
+
+void MigrationWorker::run()
+{
+    IoScope io("migration");
+    {
+        QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", MIGRATION_CONNECTION);
+        database.setDatabaseName(m_databaseName);
+        database.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+
+        QString errorText;
+        if (!database.open()) {
+            emit error(tr("Migration could not open the database: %1")
+                       .arg(database.lastError().text()));
+        } else if (m_applySchema && !SchemaMigrator::migrateSchema(database, &errorText)) {
+            emit error(errorText);
+            database.close();
+        } else {
+            QSqlQuery pending(database);
+            pending.exec("SELECT version, cursor FROM schema_migrations "
+                         "WHERE done = 0 ORDER BY version");
+
+            // Collect first; the steps below write to schema_migrations.
+            QList<QPair<int, qint64> > steps;
+            while (pending.next())
+                steps << qMakePair(pending.value(0).toInt(), pending.value(1).toLongLong());
+            pending.finish();
+
+            // Later steps expect the data of the earlier ones, so a failed step
+            // ends the run; it is retried from its cursor at the next start.
+            bool failed = false;
+            for (int i = 0; i < steps.size() && !failed && !m_stopRequested; ++i) {
+                for (int m = 0; m < m_migrations.size(); ++m) {
+                    if (m_migrations.at(m).version == steps.at(i).first
+                        && !runStep(database, m_migrations.at(m), steps.at(i).second)) {
+                        qWarning() << "Data migration stopped at version" << steps.at(i).first;
+                        failed = true;
+                        break;
+                    }
+                }
+            }
+            database.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(MIGRATION_CONNECTION);
+
+    emit finished();
+}
+
+bool MigrationWorker::runStep(QSqlDatabase &database, const Migration &migration, qint64 cursor)
+{
+    if (!migration.dataStep)
+        return true;
+
+    QSqlQuery query(database);
+    qint64 total = 0;
+    qint64 done = 0;
+    if (query.exec("SELECT COUNT(*) FROM events") && query.next())
+        total = query.value(0).toLongLong();
+    query.prepare("SELECT COUNT(*) FROM events WHERE eventID <= :cursor");
+    query.bindValue(":cursor", cursor);
+    if (query.exec() && query.next())
+        done = query.value(0).toLongLong();
+
+    emit progress(migration.version, done, total);
+
+    QSqlQuery save(database);
+    save.prepare("UPDATE schema_migrations SET cursor = :cursor, done = :done "
+                 "WHERE version = :version");
+
+    while (!m_stopRequested) {
+        // One short transaction per batch keeps the write lock brief for the UI thread.
+        database.transaction();
+        const int rows = migration.dataStep(database, cursor, MIGRATION_BATCH_SIZE);
+        if (rows < 0) {
+            database.rollback();
+            emit error(tr("Migration to version %1 failed: %2")
+                       .arg(migration.version).arg(database.lastError().text()));
+            return false;
+        }
+
+        save.bindValue(":cursor", cursor);
+        save.bindValue(":done", rows == 0 ? 1 : 0);
+        save.bindValue(":version", migration.version);
+        save.exec();
+        database.commit();
+
+        if (rows == 0)
+            break;
+
+        done += rows;
+        emit progress(migration.version, qMin(done, total), total);
+        usleep(MIGRATION_BATCH_PAUSE_MS * 1000);
+    }
+    return true;
+}
@@ -0,0 +1,111 @@
+/*
+ * schemamigrator.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef SCHEMAMIGRATOR_HPP_
+#define SCHEMAMIGRATOR_HPP_
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QList>
+#include <QStringList>
+#include <QtSql/QSqlDatabase>
+
+class QThread;
+class MigrationWorker;
+
+/*
+ * A data step moves existing rows over to a new schema version. It is run
+ * repeatedly on a background connection, one small transaction per call.
+ * 'cursor' is the last eventID that was processed (persisted between calls
+ * so an interrupted upgrade resumes where it stopped). The function returns
+ * the number of rows it touched; 0 means the step is complete.
+ */
+typedef int (*MigrationDataStep)(QSqlDatabase &database, qint64 &cursor, int batchSize);
+
+struct Migration
+{
+    int version;
+    QStringList schemaSql;       // DDL, run synchronously inside one transaction
+    MigrationDataStep dataStep;  // optional, run in batches on a worker thread
+};
+
+/*
+ * @brief Upgrades the events database to the latest schema version.
+ *
+ * The schema version is tracked with PRAGMA user_version. Schema changes are
+ * cheap and are applied on the caller's connection when the database is
+ * opened. Data migrations are recorded in the schema_migrations table and
+ * run afterwards on a worker thread in small batches, so the app stays usable
+ * while a large journal is being upgraded.
+ */
+class SchemaMigrator : public QObject
+{
+    Q_OBJECT
+
+public:
+    SchemaMigrator(const QString &databaseName, QObject *parent = 0);
+    ~SchemaMigrator();
+
+    static int latestVersion();
+    static QString eventsTableSql();
+
+    // Applies all pending schema steps. Returns false if a step failed,
+    // in which case the database stays at the last good version. A database
+    // whose events table was dropped is built up again from version 1.
+    static bool migrateSchema(QSqlDatabase &database, QString *errorText = 0);
+
+    // Runs the pending data steps on a worker thread. With 'applySchema', the
+    // worker first applies the pending schema steps on its own connection, so
+    // creating the tables does not block the caller either.
+    void startBackgroundMigration(bool applySchema = false);
+    void stopBackgroundMigration();
+
+Q_SIGNALS:
+    void progress(int version, qint64 done, qint64 total);
+    void finished();
+    void error(const QString &message);
+
+private:
+    static const QList<Migration> &migrations();
+
+    QString m_databaseName;
+    QThread *m_thread;
+    MigrationWorker *m_worker;
+};
+
+/*
+ * Runs the pending data steps on its own database connection. Lives on the
+ * migration thread; stop() may be called from any thread.
+ */
+class MigrationWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    MigrationWorker(const QString &databaseName, const QList<Migration> &migrations,
+                    bool applySchema = false);
+
+    void stop();
+
+public Q_SLOTS:
+    void run();
+
+Q_SIGNALS:
+    void progress(int version, qint64 done, qint64 total);
+    void finished();
+    void error(const QString &message);
+
+private:
+    bool runStep(QSqlDatabase &database, const Migration &migration, qint64 cursor);
+
+    QString m_databaseName;
+    QList<Migration> m_migrations;
+    bool m_applySchema;
+    QAtomicInt m_stopRequested;
+};
+
+#endif /* SCHEMAMIGRATOR_HPP_ */
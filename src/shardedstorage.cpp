@@ -0,0 +1,655 @@
+/*
+ * shardedstorage.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "shardedstorage.hpp"
+#include "EventData.hpp"
+#include "schemamigrator.hpp"
+
+#include <QAtomicInt>
+#include <QDir>
+#include <QFileInfo>
+#include <QVector>
+#include <QtConcurrentMap>
+#include <QtSql/QtSql>
+
+#define SHARD_INDEX_FILE "shards.db"
+#define SHARD_MAX_ATTACHED 8
+#define SHARD_MIGRATION_CONNECTION "DWriter-shard-migration"
+#define SHARD_LEGACY_SCHEMA "legacy"
+
+// Numbers the scan connections; searches may run at the same time.
+static QAtomicInt nextScanId;
+
+// -----------------------------------------------------------------------------------------------
+// Parallel scans
+
+struct ShardRef
+{
+    int year;
+    QString path;
+};
+
+/*
+ * Scans one shard over a connection of its own, so that the shards of a
+ * search can be read on the thread pool at the same time.
+ */
+struct ShardScan
+{
+    typedef QList<EventRecord> result_type;
+
+    ShardScan(qint64 from, qint64 to, const QString &text)
+        : from(from), to(to), pattern(QString(text).replace("\\", "\\\\")
+                                                   .replace("%", "\\%")
+                                                   .replace("_", "\\_"))
+    {
+    }
+
+    QList<EventRecord> operator()(const ShardRef &shard) const
+    {
+        QList<EventRecord> records;
+        const QString connectionName = QString("DWriter-scan-%1-%2").arg(shard.year)
+                                       .arg(nextScanId.fetchAndAddRelaxed(1));
+        {
+            QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+            database.setDatabaseName(shard.path);
+            database.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000;QSQLITE_OPEN_READONLY");
+
+            if (database.open()) {
+                QSqlQuery query(database);
+                query.setForwardOnly(true);
+                query.prepare("SELECT eventID, createdAt, timeStamp, textEvent FROM events "
+                              "WHERE createdAt BETWEEN ? AND ? AND textEvent LIKE ? ESCAPE '\\' "
+                              "AND deletedAt IS NULL ORDER BY createdAt, eventID");
+                query.addBindValue(from);
+                query.addBindValue(to);
+                query.addBindValue("%" + pattern + "%");
+                if (query.exec()) {
+                    while (query.next()) {
+                        EventRecord record;
+                        record.eventId = query.value(0).toLongLong();
+                        record.createdAt = query.value(1).toLongLong();
+                        record.timeStamp = query.value(2).toString();
+                        record.textEvent = query.value(3).toString();
+                        records << record;
+                    }
+                } else {
+                    qWarning() << "Shard scan" << shard.year << query.lastError().text();
+                }
+                database.close();
+            }
+        }
+        QSqlDatabase::removeDatabase(connectionName);
+        return records;
+    }
+
+    qint64 from;
+    qint64 to;
+    QString pattern;
+};
+
+// -----------------------------------------------------------------------------------------------
+// ShardedStorage
+
+ShardedStorage::ShardedStorage(const QString &directory, const QString &connectionName)
+    : m_directory(directory)
+    , m_connectionName(connectionName)
+    , m_lastEventId(0)
+{
+}
+
+ShardedStorage::~ShardedStorage()
+{
+    close();
+}
+
+QSqlDatabase ShardedStorage::connection() const
+{
+    return QSqlDatabase::database(m_connectionName);
+}
+
+QString ShardedStorage::shardPath(int year) const
+{
+    return QString("%1/journal-%2.db").arg(m_directory).arg(year);
+}
+
+QString ShardedStorage::schemaName(int year)
+{
+    return QString("y%1").arg(year);
+}
+
+int ShardedStorage::yearOf(qint64 createdAt)
+{
+    // Entries without a usable time stamp go to the current year.
+    if (createdAt <= 0)
+        return QDate::currentDate().year();
+    return QDateTime::fromTime_t(uint(createdAt)).date().year();
+}
+
+bool ShardedStorage::open()
+{
+    if (!QDir().mkpath(m_directory)) {
+        m_lastError = QString("Cannot create %1").arg(m_directory);
+        return false;
+    }
+
+    QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    database.setDatabaseName(m_directory + "/" SHARD_INDEX_FILE);
+    database.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+    if (!database.open()) {
+        m_lastError = database.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query(database);
+    if (!query.exec("CREATE TABLE IF NOT EXISTS shards ( "
+                    "                year INTEGER PRIMARY KEY, "
+                    "                path VARCHAR NOT NULL, "
+                    "                firstEventId INTEGER NOT NULL DEFAULT 0, "
+                    "                lastEventId INTEGER NOT NULL DEFAULT 0, "
+                    "                minCreatedAt INTEGER NOT NULL DEFAULT 0, "
+                    "                maxCreatedAt INTEGER NOT NULL DEFAULT 0, "
+                    "                rows INTEGER NOT NULL DEFAULT 0"
+                    ");")) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+
+    // Only this year's shard is opened up front; older years are attached on demand.
+    return loadIndex() && attach(QDate::currentDate().year());
+}
+
+void ShardedStorage::close()
+{
+    if (!QSqlDatabase::contains(m_connectionName))
+        return;
+
+    {
+        QSqlDatabase database = QSqlDatabase::database(m_connectionName, false);
+        database.close();
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+    m_attached.clear();
+    m_shards.clear();
+}
+
+bool ShardedStorage::loadIndex()
+{
+    QSqlQuery query(connection());
+    if (!query.exec("SELECT year, path, firstEventId, lastEventId, minCreatedAt, maxCreatedAt, rows "
+                    "FROM shards")) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+
+    m_shards.clear();
+    m_lastEventId = 0;
+    while (query.next()) {
+        Shard shard;
+        shard.year = query.value(0).toInt();
+        shard.path = m_directory + "/" + query.value(1).toString();
+        shard.firstEventId = query.value(2).toLongLong();
+        shard.lastEventId = query.value(3).toLongLong();
+        shard.minCreatedAt = query.value(4).toLongLong();
+        shard.maxCreatedAt = query.value(5).toLongLong();
+        shard.rows = query.value(6).toInt();
+        m_shards.insert(shard.year, shard);
+        m_lastEventId = qMax(m_lastEventId, shard.lastEventId);
+    }
+    return true;
+}
+
+bool ShardedStorage::ensureShard(int year)
+{
+    if (!m_shards.contains(year)) {
+        Shard shard;
+        shard.year = year;
+        shard.path = shardPath(year);
+
+        QSqlQuery query(connection());
+        query.prepare("INSERT OR IGNORE INTO shards (year, path) VALUES(:year, :path)");
+        query.bindValue(":year", year);
+        query.bindValue(":path", QFileInfo(shard.path).fileName());
+        if (!query.exec()) {
+            m_lastError = query.lastError().text();
+            return false;
+        }
+        m_shards.insert(year, shard);
+    }
+
+    Shard &shard = m_shards[year];
+    if (shard.migrated)
+        return true;
+
+    // Every shard has the full journal schema, applied before it is attached.
+    shard.migrated = migrateFile(shard.path);
+    return shard.migrated;
+}
+
+bool ShardedStorage::migrateFile(const QString &path)
+{
+    // Over a short-lived connection of its own, as the file is not attached yet.
+    bool success;
+    {
+        QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", SHARD_MIGRATION_CONNECTION);
+        database.setDatabaseName(path);
+        success = database.open();
+        if (!success) {
+            m_lastError = database.lastError().text();
+        } else {
+            SchemaMigrator migrator(path);
+            success = migrator.migrateSchema(database, &m_lastError);
+            database.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(SHARD_MIGRATION_CONNECTION);
+    return success;
+}
+
+bool ShardedStorage::attach(int year)
+{
+    const int position = m_attached.indexOf(year);
+    if (position >= 0) {
+        m_attached.move(position, m_attached.size() - 1);
+        return true;
+    }
+
+    if (!ensureShard(year))
+        return false;
+
+    QSqlQuery query(connection());
+
+    // Make room by detaching the least recently used shard, except this year's.
+    const int currentYear = QDate::currentDate().year();
+    for (int i = 0; m_attached.size() >= SHARD_MAX_ATTACHED && i < m_attached.size(); ++i) {
+        if (m_attached.at(i) == currentYear)
+            continue;
+        // Attaching anyway could go past the limit of attached files.
+        if (!query.exec(QString("DETACH DATABASE %1").arg(schemaName(m_attached.at(i))))) {
+            m_lastError = query.lastError().text();
+            return false;
+        }
+        m_attached.removeAt(i);
+        break;
+    }
+
+    query.prepare(QString("ATTACH DATABASE :path AS %1").arg(schemaName(year)));
+    query.bindValue(":path", m_shards.value(year).path);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+    m_attached << year;
+    return true;
+}
+
+QList<int> ShardedStorage::shardsHolding(qint64 eventId) const
+{
+    // Usually one shard; ranges only overlap when old entries were added late.
+    QList<int> years;
+    QMap<int, Shard>::const_iterator it = m_shards.constEnd();
+    while (it != m_shards.constBegin()) {
+        --it;
+        if (it.value().lastEventId > 0 && it.value().firstEventId <= eventId
+            && eventId <= it.value().lastEventId)
+            years << it.key();
+    }
+    return years;
+}
+
+bool ShardedStorage::findEvent(qint64 eventId, int *year, EventRecord *record)
+{
+    const QList<int> years = shardsHolding(eventId);
+    for (int i = 0; i < years.size(); ++i) {
+        if (!attach(years.at(i)))
+            return false;
+
+        QSqlQuery query(connection());
+        query.prepare(QString("SELECT eventID, createdAt, timeStamp, textEvent FROM %1.events "
+                              "WHERE eventID = :eventID").arg(schemaName(years.at(i))));
+        query.bindValue(":eventID", eventId);
+        if (!query.exec()) {
+            m_lastError = query.lastError().text();
+            return false;
+        }
+        if (!query.next())
+            continue;
+
+        if (year)
+            *year = years.at(i);
+        if (record) {
+            record->eventId = query.value(0).toLongLong();
+            record->createdAt = query.value(1).toLongLong();
+            record->timeStamp = query.value(2).toString();
+            record->textEvent = query.value(3).toString();
+        }
+        return true;
+    }
+    return false;
+}
+
+qint64 ShardedStorage::addRecord(const QString &timeStamp, const QString &textEvent,
+                                 Durability durability)
+{
+    // Commits span the shard and the index, so they are always synced.
+    Q_UNUSED(durability);
+
+    const qint64 createdAt = eventTimeFromString(timeStamp);
+    const int year = yearOf(createdAt);
+    if (!attach(year))
+        return -1;
+
+    const qint64 eventId = m_lastEventId + 1;
+    Shard shard = m_shards.value(year);
+    shard.firstEventId = shard.lastEventId ? qMin(shard.firstEventId, eventId) : eventId;
+    shard.lastEventId = qMax(shard.lastEventId, eventId);
+    if (createdAt > 0) {
+        shard.minCreatedAt = shard.minCreatedAt ? qMin(shard.minCreatedAt, createdAt) : createdAt;
+        shard.maxCreatedAt = qMax(shard.maxCreatedAt, createdAt);
+    }
+    ++shard.rows;
+
+    // The entry and the shard index are committed together, across both files.
+    QSqlDatabase database = connection();
+    database.transaction();
+
+    QSqlQuery query(database);
+    query.prepare(QString("INSERT INTO %1.events (eventID, timeStamp, textEvent, createdAt) "
+                          "VALUES(:eventID, :timeStamp, :textEvent, :createdAt)").arg(schemaName(year)));
+    query.bindValue(":eventID", eventId);
+    query.bindValue(":timeStamp", timeStamp);
+    query.bindValue(":textEvent", textEvent);
+    query.bindValue(":createdAt", createdAt);
+    bool ok = query.exec();
+
+    if (ok) {
+        query.prepare("UPDATE shards SET firstEventId = :first, lastEventId = :last, "
+                      "minCreatedAt = :min, maxCreatedAt = :max, rows = :rows WHERE year = :year");
+        query.bindValue(":first", shard.firstEventId);
+        query.bindValue(":last", shard.lastEventId);
+        query.bindValue(":min", shard.minCreatedAt);
+        query.bindValue(":max", shard.maxCreatedAt);
+        query.bindValue(":rows", shard.rows);
+        query.bindValue(":year", year);
+        ok = query.exec();
+    }
+
+    if (!ok || !database.commit()) {
+        m_lastError = ok ? database.lastError().text() : query.lastError().text();
+        database.rollback();
+        return -1;
+    }
+
+    m_shards.insert(year, shard);
+    m_lastEventId = eventId;
+    return eventId;
+}
+
+bool ShardedStorage::updateRecord(qint64 eventId, const QString &textEvent, Durability durability)
+{
+    Q_UNUSED(durability);
+
+    int year = 0;
+    if (!findEvent(eventId, &year, 0)) {
+        if (m_lastError.isEmpty())
+            m_lastError = QString("No event %1").arg(eventId);
+        return false;
+    }
+
+    QSqlQuery query(connection());
+    query.prepare(QString("UPDATE %1.events SET textEvent = :textEvent WHERE eventID = :eventID")
+                  .arg(schemaName(year)));
+    query.bindValue(":textEvent", textEvent);
+    query.bindValue(":eventID", eventId);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+int ShardedStorage::count()
+{
+    int rows = 0;
+    QMap<int, Shard>::const_iterator it;
+    for (it = m_shards.constBegin(); it != m_shards.constEnd(); ++it)
+        rows += it.value().rows;
+    return rows;
+}
+
+bool ShardedStorage::event(int row, EventRecord &record)
+{
+    m_lastError.clear();
+    const QList<EventRecord> records = range(row, 1);
+    if (records.isEmpty()) {
+        if (m_lastError.isEmpty())
+            m_lastError = QString("No row %1").arg(row);
+        return false;
+    }
+    record = records.first();
+    return true;
+}
+
+bool ShardedStorage::liveEvents(int year, int offset, int limit, QList<EventRecord> &records)
+{
+    if (!attach(year))
+        return false;
+
+    QSqlQuery query(connection());
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT eventID, createdAt, timeStamp, textEvent FROM %1.events "
+                          "WHERE deletedAt IS NULL ORDER BY eventID LIMIT :limit OFFSET :offset")
+                  .arg(schemaName(year)));
+    query.bindValue(":limit", limit);
+    query.bindValue(":offset", offset);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+    while (query.next()) {
+        EventRecord record;
+        record.eventId = query.value(0).toLongLong();
+        record.createdAt = query.value(1).toLongLong();
+        record.timeStamp = query.value(2).toString();
+        record.textEvent = query.value(3).toString();
+        records << record;
+    }
+    return true;
+}
+
+QList<EventRecord> ShardedStorage::range(int firstRow, int count)
+{
+    // The shards in the order of their first eventID. A shard whose eventID
+    // range lies apart from the others is skipped whole by its row count, or
+    // read with an offset of its own. Shards whose ranges overlap (old entries
+    // added late) form a run: each gives its rows up to the end of the page,
+    // and they are merged by eventID.
+    QMultiMap<qint64, int> byFirstEventId;
+    QMap<int, Shard>::const_iterator it;
+    for (it = m_shards.constBegin(); it != m_shards.constEnd(); ++it) {
+        if (it.value().lastEventId > 0)
+            byFirstEventId.insert(it.value().firstEventId, it.key());
+    }
+    const QList<int> years = byFirstEventId.values();
+
+    QList<EventRecord> records;
+    int skip = firstRow;
+    int next = 0;
+    while (next < years.size() && records.size() < count) {
+        QList<int> run;
+        qint64 runLastEventId = 0;
+        int live = 0;
+        do {
+            const Shard &shard = m_shards[years.at(next++)];
+            run << shard.year;
+            runLastEventId = qMax(runLastEventId, shard.lastEventId);
+            live += shard.rows;
+        } while (next < years.size() && m_shards[years.at(next)].firstEventId <= runLastEventId);
+
+        if (skip >= live) {
+            skip -= live;
+            continue;
+        }
+
+        const int wanted = count - records.size();
+        QList<QList<EventRecord> > pages;
+        for (int i = 0; i < run.size(); ++i) {
+            QList<EventRecord> page;
+            const bool ok = run.size() == 1 ? liveEvents(run.at(i), skip, wanted, page)
+                                            : liveEvents(run.at(i), 0, skip + wanted, page);
+            if (!ok)
+                return QList<EventRecord>();
+            pages << page;
+        }
+        if (run.size() == 1)
+            skip = 0;
+
+        QVector<int> heads(pages.size(), 0);
+        while (records.size() < count) {
+            int best = -1;
+            for (int p = 0; p < pages.size(); ++p) {
+                if (heads.at(p) < pages.at(p).size()
+                    && (best < 0 || pages.at(p).at(heads.at(p)).eventId
+                                    < pages.at(best).at(heads.at(best)).eventId))
+                    best = p;
+            }
+            if (best < 0)
+                break;
+            if (skip > 0) {
+                --skip;
+                ++heads[best];
+                continue;
+            }
+            records << pages.at(best).at(heads[best]++);
+        }
+        skip = 0;
+    }
+    return records;
+}
+
+QList<EventRecord> ShardedStorage::search(qint64 from, qint64 to, const QString &text)
+{
+    QList<ShardRef> shards;
+    QMap<int, Shard>::const_iterator it;
+    for (it = m_shards.constBegin(); it != m_shards.constEnd(); ++it) {
+        const Shard &shard = it.value();
+        if (shard.rows == 0 || shard.maxCreatedAt < from || shard.minCreatedAt > to)
+            continue;
+        ShardRef ref;
+        ref.year = shard.year;
+        ref.path = shard.path;
+        shards << ref;
+    }
+
+    const QList<QList<EventRecord> > results =
+        QtConcurrent::blockingMapped<QList<QList<EventRecord> > >(shards, ShardScan(from, to, text));
+
+    // Years do not overlap in time, so the per-shard results, each in
+    // createdAt order, are merged by concatenating them in year order.
+    QList<EventRecord> records;
+    for (int i = 0; i < results.size(); ++i)
+        records += results.at(i);
+    return records;
+}
+
+QStringList ShardedStorage::shardFiles() const
+{
+    QStringList files;
+    QMap<int, Shard>::const_iterator it;
+    for (it = m_shards.constBegin(); it != m_shards.constEnd(); ++it) {
+        if (it.value().lastEventId > 0)
+            files << it.value().path;
+    }
+    return files;
+}
+
+bool ShardedStorage::importJournal(const QString &databaseName)
+{
+    // The old file gets the current schema too, so every column below exists.
+    if (!QFileInfo(databaseName).exists()) {
+        m_lastError = QString("No journal at %1").arg(databaseName);
+        return false;
+    }
+    if (!migrateFile(databaseName))
+        return false;
+
+    QSqlDatabase database = connection();
+    QSqlQuery query(database);
+    query.prepare("ATTACH DATABASE :path AS " SHARD_LEGACY_SCHEMA);
+    query.bindValue(":path", databaseName);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+
+    // Entries without a usable time stamp go to the current year, as in yearOf().
+    const QString yearSql = QString("CASE WHEN coalesce(createdAt, 0) <= 0 THEN %1 "
+                                    "ELSE CAST(strftime('%Y', createdAt, 'unixepoch', 'localtime') AS INTEGER) END")
+                            .arg(QDate::currentDate().year());
+
+    QList<int> years;
+    bool ok = query.exec("SELECT DISTINCT " + yearSql + " FROM " SHARD_LEGACY_SCHEMA ".events");
+    while (ok && query.next())
+        years << query.value(0).toInt();
+    if (!ok)
+        m_lastError = query.lastError().text();
+    query.finish();
+
+    // One transaction per year: the rows of the year, its attachments and
+    // tags, and its line in the shard index. Rows a previous run copied are
+    // ignored, so an import that was cut short resumes with the year it was
+    // in. Copied entries keep their syncId and are not logged as changes.
+    for (int i = 0; ok && i < years.size(); ++i) {
+        const int year = years.at(i);
+        const QString schema = schemaName(year);
+        ok = attach(year) && database.transaction();
+        if (!ok) {
+            if (m_lastError.isEmpty())
+                m_lastError = database.lastError().text();
+            break;
+        }
+
+        QStringList statements;
+        statements << QString("INSERT OR REPLACE INTO %1.sync_state (key, value) VALUES ('applying', 1)").arg(schema)
+                   << QString("INSERT OR IGNORE INTO %1.events (eventID, timeStamp, textEvent, createdAt, mood, "
+                              "syncId, updatedAt, words, characters, deletedAt) "
+                              "SELECT eventID, timeStamp, textEvent, createdAt, mood, syncId, updatedAt, "
+                              "words, characters, deletedAt FROM " SHARD_LEGACY_SCHEMA ".events "
+                              "WHERE %2 = %3 ORDER BY eventID").arg(schema).arg(yearSql).arg(year)
+                   << QString("INSERT OR IGNORE INTO %1.attachments (attachmentID, eventID, kind, path, sha1) "
+                              "SELECT attachmentID, eventID, kind, path, sha1 FROM " SHARD_LEGACY_SCHEMA ".attachments "
+                              "WHERE eventID IN (SELECT eventID FROM %1.events)").arg(schema)
+                   << QString("INSERT OR IGNORE INTO %1.event_tags (eventID, tag, inline) "
+                              "SELECT eventID, tag, inline FROM " SHARD_LEGACY_SCHEMA ".event_tags "
+                              "WHERE eventID IN (SELECT eventID FROM %1.events)").arg(schema)
+                   << QString("DELETE FROM %1.sync_state WHERE key = 'applying'").arg(schema)
+                   << QString("UPDATE shards SET "
+                              "firstEventId = (SELECT coalesce(MIN(eventID), 0) FROM %1.events), "
+                              "lastEventId = (SELECT coalesce(MAX(eventID), 0) FROM %1.events), "
+                              "minCreatedAt = (SELECT coalesce(MIN(createdAt), 0) FROM %1.events WHERE createdAt > 0), "
+                              "maxCreatedAt = (SELECT coalesce(MAX(createdAt), 0) FROM %1.events), "
+                              "rows = (SELECT COUNT(*) FROM %1.events WHERE deletedAt IS NULL) "
+                              "WHERE year = %2").arg(schema).arg(year);
+        for (int s = 0; ok && s < statements.size(); ++s) {
+            ok = query.exec(statements.at(s));
+            if (!ok)
+                m_lastError = query.lastError().text();
+        }
+        if (!ok || !database.commit()) {
+            if (ok)
+                m_lastError = database.lastError().text();
+            database.rollback();
+            ok = false;
+        }
+    }
+
+    query.exec("DETACH DATABASE " SHARD_LEGACY_SCHEMA);
+    return loadIndex() && ok;
+}
+
+QString ShardedStorage::lastError() const
+{
+    return m_lastError;
+}
@@ -0,0 +1,105 @@
+/*
+ * shardedstorage.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef SHARDEDSTORAGE_HPP_
+#define SHARDEDSTORAGE_HPP_
+
+#include "storagebackend.hpp"
+
+#include <QList>
+#include <QMap>
+#include <QStringList>
+
+/*
+ * @brief Keeps the journal in one SQLite file per year.
+ *
+ * The recent entries that are read and written every day sit in a small
+ * file of their own, apart from years of history. "shards.db" in the
+ * directory is the shard index: for every year it records the file, the
+ * eventID and createdAt ranges and the number of entries outside the trash,
+ * so a lookup only opens the shards that can hold the answer. Rows are
+ * positions among the entries outside the trash, as in SqliteStorage.
+ *
+ * Shards are ATTACHed to the index connection when a query first needs
+ * them, and at most SHARD_MAX_ATTACHED at a time (the shard of the current
+ * year stays attached). An insert and the update of the shard index are
+ * one transaction across both files. search() scans the shards of a time
+ * range in parallel, each over its own connection.
+ *
+ * eventIDs are unique across shards and are handed out by the index.
+ * importJournal() moves a single-file journal (DWriteData.db) into shards;
+ * JournalExporter exports the shards listed by shardFiles().
+ */
+class ShardedStorage : public StorageBackend
+{
+public:
+    ShardedStorage(const QString &directory, const QString &connectionName = "DWriter-shards");
+    virtual ~ShardedStorage();
+
+    virtual bool open();
+    virtual void close();
+
+    virtual qint64 addRecord(const QString &timeStamp, const QString &textEvent,
+                             Durability durability = Synced);
+    virtual bool updateRecord(qint64 eventId, const QString &textEvent,
+                              Durability durability = Synced);
+
+    virtual int count();
+    virtual bool event(int row, EventRecord &record);
+    virtual QList<EventRecord> range(int firstRow, int count);
+    virtual QList<EventRecord> search(qint64 from, qint64 to, const QString &text);
+
+    virtual QString lastError() const;
+
+    // Copies the entries of a single-file journal, with their attachments and
+    // tags, into the shards of their years. Entries already copied are
+    // skipped, so an import that failed can be run again.
+    bool importJournal(const QString &databaseName);
+
+    // The files of the shards that hold entries, oldest year first.
+    QStringList shardFiles() const;
+
+private:
+    struct Shard
+    {
+        Shard() : year(0), firstEventId(0), lastEventId(0), minCreatedAt(0), maxCreatedAt(0),
+                  rows(0), migrated(false) {}
+
+        int year;
+        QString path;
+        qint64 firstEventId;
+        qint64 lastEventId;
+        qint64 minCreatedAt;
+        qint64 maxCreatedAt;
+        int rows;           // entries outside the trash
+        bool migrated;      // schema checked this session
+    };
+
+    QSqlDatabase connection() const;
+    QString shardPath(int year) const;
+    static QString schemaName(int year);
+    static int yearOf(qint64 createdAt);
+
+    bool loadIndex();
+    bool ensureShard(int year);
+    bool migrateFile(const QString &path);
+    bool attach(int year);
+    // Shards whose eventID range contains 'eventId', newest first.
+    QList<int> shardsHolding(qint64 eventId) const;
+    bool findEvent(qint64 eventId, int *year, EventRecord *record);
+    // The entries of one shard outside the trash, in eventID order.
+    bool liveEvents(int year, int offset, int limit, QList<EventRecord> &records);
+
+    QString m_directory;
+    QString m_connectionName;
+    QMap<int, Shard> m_shards;
+    QList<int> m_attached;       // least recently used first
+    qint64 m_lastEventId;
+    QString m_lastError;
+};
+
+#endif /* SHARDEDSTORAGE_HPP_ */
@@ -0,0 +1,352 @@
+/*
+ * similarityindex.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "similarityindex.hpp"
+
+#include <QHash>
+#include <QVector>
+#include <QtAlgorithms>
+#include <QtSql/QtSql>
+
+#define SIMILARITY_HASHES 64
+#define SIMILARITY_BANDS 16
+#define SIMILARITY_ROWS (SIMILARITY_HASHES / SIMILARITY_BANDS)
+#define SIMILARITY_SHINGLE_WORDS 2
+#define SIMILARITY_MAX_CANDIDATES 200
+
+// -----------------------------------------------------------------------------------------------
+// Hashing
+
+static inline quint64 mix64(quint64 x)
+{
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= Q_UINT64_C(0xbf58476d1ce4e5b9);
+    x ^= x >> 27;
+    x *= Q_UINT64_C(0x94d049bb133111eb);
+    x ^= x >> 31;
+    return x;
+}
+
+static quint64 wordHash(const QChar *word, int length)
+{
+    quint64 hash = Q_UINT64_C(0xcbf29ce484222325);
+    for (int i = 0; i < length; ++i) {
+        hash ^= word[i].toLower().unicode();
+        hash *= Q_UINT64_C(0x100000001b3);
+    }
+    return hash;
+}
+
+// Word hashes of 'text'; words shorter than two characters are skipped.
+static QVector<quint64> words(const QString &text)
+{
+    QVector<quint64> hashes;
+    const QChar *data = text.constData();
+    const int size = text.size();
+
+    int start = -1;
+    for (int i = 0; i <= size; ++i) {
+        const bool letter = i < size && data[i].isLetterOrNumber();
+        if (letter && start < 0) {
+            start = i;
+        } else if (!letter && start >= 0) {
+            if (i - start >= 2)
+                hashes << wordHash(data + start, i - start);
+            start = -1;
+        }
+    }
+    return hashes;
+}
+
+// -----------------------------------------------------------------------------------------------
+// SimilarityIndex
+
+SimilarityIndex::SimilarityIndex(const QSqlDatabase &database)
+    : m_database(database)
+    , m_insertSignature(database)
+    , m_insertBucket(database)
+    , m_prepared(false)
+{
+}
+
+QString SimilarityIndex::lastError() const
+{
+    return m_lastError;
+}
+
+QVector<quint64> SimilarityIndex::shingles(const QString &text)
+{
+    const QVector<quint64> hashes = words(text);
+    QVector<quint64> result;
+    if (hashes.isEmpty())
+        return result;
+
+    // Entries shorter than a shingle are a single shingle.
+    const int count = qMax(1, hashes.size() - SIMILARITY_SHINGLE_WORDS + 1);
+    result.reserve(count);
+    for (int s = 0; s < count; ++s) {
+        quint64 shingle = 0;
+        for (int w = s; w < qMin(s + SIMILARITY_SHINGLE_WORDS, hashes.size()); ++w)
+            shingle = mix64(shingle ^ hashes.at(w));
+        result << shingle;
+    }
+    qSort(result);
+
+    int unique = 1;
+    for (int s = 1; s < result.size(); ++s) {
+        if (result.at(s) != result.at(unique - 1))
+            result[unique++] = result.at(s);
+    }
+    result.resize(unique);
+    return result;
+}
+
+double SimilarityIndex::jaccard(const QVector<quint64> &a, const QVector<quint64> &b)
+{
+    if (a.isEmpty() && b.isEmpty())
+        return 0.0;
+
+    int i = 0;
+    int j = 0;
+    int common = 0;
+    while (i < a.size() && j < b.size()) {
+        if (a.at(i) < b.at(j)) {
+            ++i;
+        } else if (b.at(j) < a.at(i)) {
+            ++j;
+        } else {
+            ++common;
+            ++i;
+            ++j;
+        }
+    }
+    return double(common) / (a.size() + b.size() - common);
+}
+
+QByteArray SimilarityIndex::signature(const QString &text)
+{
+    const QVector<quint64> set = shingles(text);
+    if (set.isEmpty())
+        return QByteArray();
+
+    quint32 minimum[SIMILARITY_HASHES];
+    for (int h = 0; h < SIMILARITY_HASHES; ++h)
+        minimum[h] = 0xffffffff;
+
+    for (int s = 0; s < set.size(); ++s) {
+        // One independent hash function per slot, derived from the shingle hash.
+        for (int h = 0; h < SIMILARITY_HASHES; ++h) {
+            const quint32 value = quint32(mix64(set.at(s) + Q_UINT64_C(0x9e3779b97f4a7c15) * (h + 1)));
+            if (value < minimum[h])
+                minimum[h] = value;
+        }
+    }
+    return QByteArray(reinterpret_cast<const char *>(minimum), sizeof(minimum));
+}
+
+double SimilarityIndex::similarity(const QByteArray &a, const QByteArray &b)
+{
+    if (a.size() != SIMILARITY_HASHES * 4 || b.size() != a.size())
+        return 0.0;
+
+    const quint32 *x = reinterpret_cast<const quint32 *>(a.constData());
+    const quint32 *y = reinterpret_cast<const quint32 *>(b.constData());
+    int equal = 0;
+    for (int h = 0; h < SIMILARITY_HASHES; ++h)
+        equal += x[h] == y[h];
+    return double(equal) / SIMILARITY_HASHES;
+}
+
+qint64 SimilarityIndex::bucket(const QByteArray &signature, int band)
+{
+    const quint32 *values = reinterpret_cast<const quint32 *>(signature.constData())
+                          + band * SIMILARITY_ROWS;
+    quint64 hash = band;
+    for (int r = 0; r < SIMILARITY_ROWS; ++r)
+        hash = mix64(hash ^ values[r]);
+    return qint64(hash >> 1);   // SQLite integers are signed
+}
+
+// An event_lsh row; sorted the way its primary key is.
+struct BucketRow
+{
+    int band;
+    qint64 bucket;
+    qint64 eventId;
+
+    bool operator<(const BucketRow &other) const
+    {
+        if (band != other.band)
+            return band < other.band;
+        if (bucket != other.bucket)
+            return bucket < other.bucket;
+        return eventId < other.eventId;
+    }
+};
+
+void SimilarityIndex::prepareInserts()
+{
+    // Prepared once and reused for every entry of a batch.
+    if (!m_prepared) {
+        m_insertSignature.prepare("INSERT OR REPLACE INTO event_signatures (eventID, signature) "
+                                  "VALUES(?, ?)");
+        m_insertBucket.prepare("INSERT OR IGNORE INTO event_lsh (band, bucket, eventID) "
+                               "VALUES(?, ?, ?)");
+        m_prepared = true;
+    }
+}
+
+bool SimilarityIndex::insertSignature(qint64 eventId, const QByteArray &signature)
+{
+    m_insertSignature.addBindValue(eventId);
+    m_insertSignature.addBindValue(signature);
+    if (!m_insertSignature.exec()) {
+        m_lastError = m_insertSignature.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool SimilarityIndex::insertBucket(int band, qint64 bucket, qint64 eventId)
+{
+    m_insertBucket.addBindValue(band);
+    m_insertBucket.addBindValue(bucket);
+    m_insertBucket.addBindValue(eventId);
+    if (!m_insertBucket.exec()) {
+        m_lastError = m_insertBucket.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool SimilarityIndex::addEvent(qint64 eventId, const QByteArray &signature)
+{
+    if (signature.isEmpty())
+        return true;
+
+    prepareInserts();
+    if (!insertSignature(eventId, signature))
+        return false;
+    for (int band = 0; band < SIMILARITY_BANDS; ++band) {
+        if (!insertBucket(band, bucket(signature, band), eventId))
+            return false;
+    }
+    return true;
+}
+
+bool SimilarityIndex::addEvents(const QList<qint64> &eventIds, const QList<QByteArray> &signatures)
+{
+    prepareInserts();
+
+    // The buckets of different entries are scattered over event_lsh; sorted,
+    // a batch fills its pages in order instead of touching one per row.
+    QVector<BucketRow> rows;
+    rows.reserve(eventIds.size() * SIMILARITY_BANDS);
+    for (int i = 0; i < eventIds.size(); ++i) {
+        const QByteArray &signature = signatures.at(i);
+        if (signature.isEmpty())
+            continue;
+        if (!insertSignature(eventIds.at(i), signature))
+            return false;
+        for (int band = 0; band < SIMILARITY_BANDS; ++band) {
+            BucketRow row = { band, bucket(signature, band), eventIds.at(i) };
+            rows << row;
+        }
+    }
+    qSort(rows);
+
+    for (int i = 0; i < rows.size(); ++i) {
+        if (!insertBucket(rows.at(i).band, rows.at(i).bucket, rows.at(i).eventId))
+            return false;
+    }
+    return true;
+}
+
+bool SimilarityIndex::updateEvent(qint64 eventId, const QByteArray &signature)
+{
+    QSqlQuery query(m_database);
+    query.prepare("DELETE FROM event_lsh WHERE eventID = :eventID");
+    query.bindValue(":eventID", eventId);
+    bool ok = query.exec();
+    if (ok) {
+        query.prepare("DELETE FROM event_signatures WHERE eventID = :eventID");
+        query.bindValue(":eventID", eventId);
+        ok = query.exec();
+    }
+    if (!ok) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+    return addEvent(eventId, signature);
+}
+
+QByteArray SimilarityIndex::storedSignature(qint64 eventId)
+{
+    QSqlQuery query(m_database);
+    query.prepare("SELECT signature FROM event_signatures WHERE eventID = :eventID");
+    query.bindValue(":eventID", eventId);
+    if (query.exec() && query.next())
+        return query.value(0).toByteArray();
+    return QByteArray();
+}
+
+static bool moreHits(const QPair<int, qint64> &a, const QPair<int, qint64> &b)
+{
+    return a.first > b.first;
+}
+
+static bool moreSimilar(const SimilarEntry &a, const SimilarEntry &b)
+{
+    return a.similarity > b.similarity;
+}
+
+QList<SimilarEntry> SimilarityIndex::similarTo(qint64 eventId, int count)
+{
+    QList<SimilarEntry> result;
+
+    const QByteArray own = storedSignature(eventId);
+    if (own.isEmpty())
+        return result;
+
+    // 1. Candidates: every entry sharing a bucket, with the number of bands it shares.
+    QHash<qint64, int> hits;
+    QSqlQuery query(m_database);
+    query.setForwardOnly(true);
+    query.prepare("SELECT l.eventID FROM event_lsh l JOIN events e ON e.eventID = l.eventID "
+                  "WHERE l.band = ? AND l.bucket = ? AND e.deletedAt IS NULL");
+    for (int band = 0; band < SIMILARITY_BANDS; ++band) {
+        query.addBindValue(band);
+        query.addBindValue(bucket(own, band));
+        if (!query.exec()) {
+            m_lastError = query.lastError().text();
+            return result;
+        }
+        while (query.next())
+            ++hits[query.value(0).toLongLong()];
+    }
+    hits.remove(eventId);
+
+    // 2. Entries sharing more bands are likelier to be similar; compare the best ones.
+    QList<QPair<int, qint64> > candidates;
+    QHash<qint64, int>::const_iterator it;
+    for (it = hits.constBegin(); it != hits.constEnd(); ++it)
+        candidates << qMakePair(it.value(), it.key());
+    qStableSort(candidates.begin(), candidates.end(), moreHits);
+
+    for (int i = 0; i < candidates.size() && i < SIMILARITY_MAX_CANDIDATES; ++i) {
+        SimilarEntry entry;
+        entry.eventId = candidates.at(i).second;
+        entry.similarity = similarity(own, storedSignature(entry.eventId));
+        if (entry.similarity > 0.0)
+            result << entry;
+    }
+
+    qStableSort(result.begin(), result.end(), moreSimilar);
+    while (result.size() > count)
+        result.removeLast();
+    return result;
+}
@@ -0,0 +1,77 @@
+/*
+ * similarityindex.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef SIMILARITYINDEX_HPP_
+#define SIMILARITYINDEX_HPP_
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QVector>
+#include <QtSql/QSqlDatabase>
+#include <QtSql/QSqlQuery>
+
+struct SimilarEntry
+{
+    qint64 eventId;
+    double similarity;   // estimated Jaccard similarity of the word shingles, 0..1
+};
+
+/*
+ * @brief Finds entries with similar text through MinHash and locality-sensitive hashing.
+ *
+ * The text of an entry is reduced to its set of word pairs (shingles) and
+ * summarized by a MinHash signature of SIMILARITY_HASHES values. Two
+ * signatures agree in a fraction of their values that estimates the Jaccard
+ * similarity of the two sets.
+ *
+ * The signature is split into SIMILARITY_BANDS bands. Each band is hashed to
+ * a bucket in the event_lsh table, and entries sharing any bucket are the
+ * candidates for a lookup. Only those candidates are compared, so a lookup
+ * costs a few indexed reads instead of a pass over the journal.
+ */
+class SimilarityIndex
+{
+public:
+    SimilarityIndex(const QSqlDatabase &database);
+
+    // Thread-safe; empty for text without words.
+    static QByteArray signature(const QString &text);
+    static double similarity(const QByteArray &a, const QByteArray &b);
+
+    // The shingle hashes a signature summarizes, sorted and unique, and their
+    // exact Jaccard similarity; what the benchmark measures the index against.
+    static QVector<quint64> shingles(const QString &text);
+    static double jaccard(const QVector<quint64> &a, const QVector<quint64> &b);
+
+    // Run inside the caller's transaction. updateEvent() replaces the
+    // buckets of an entry whose text has changed; addEvents() adds many
+    // entries at once, as an import does.
+    bool addEvent(qint64 eventId, const QByteArray &signature);
+    bool addEvents(const QList<qint64> &eventIds, const QList<QByteArray> &signatures);
+    bool updateEvent(qint64 eventId, const QByteArray &signature);
+
+    // The 'count' most similar entries, best first.
+    QList<SimilarEntry> similarTo(qint64 eventId, int count);
+
+    QString lastError() const;
+
+private:
+    static qint64 bucket(const QByteArray &signature, int band);
+    void prepareInserts();
+    bool insertSignature(qint64 eventId, const QByteArray &signature);
+    bool insertBucket(int band, qint64 bucket, qint64 eventId);
+    QByteArray storedSignature(qint64 eventId);
+
+    QSqlDatabase m_database;
+    QSqlQuery m_insertSignature;
+    QSqlQuery m_insertBucket;
+    bool m_prepared;
+    QString m_lastError;
+};
+
+#endif /* SIMILARITYINDEX_HPP_ */
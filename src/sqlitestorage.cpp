@@ -0,0 +1,368 @@
+/*
+ * sqlitestorage.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "sqlitestorage.hpp"
+#include "EventData.hpp"
+#include "cryptovfs.hpp"
+#include "facetindex.hpp"
+#include "revisionstore.hpp"
+#include "schemamigrator.hpp"
+#include "similarityindex.hpp"
+#include "textcounter.hpp"
+
+#include <QtSql/QtSql>
+
+template <class Query>
+static void appendRows(TypedQuery<Query> &query, QList<EventRecord> &records)
+{
+    EventRow row;
+    while (query.next(row)) {
+        EventRecord record;
+        record.eventId = row.first;
+        record.createdAt = row.second;
+        record.timeStamp = row.third;
+        record.textEvent = row.fourth;
+        records << record;
+    }
+}
+
+SqliteStorage::SqliteStorage(const QString &databaseName, const QString &connectionName)
+    : m_databaseName(databaseName)
+    , m_connectionName(connectionName)
+    , m_handle(0)
+    , m_durable(false)
+    , m_wal(false)
+    , m_transaction(false)
+{
+}
+
+SqliteStorage::~SqliteStorage()
+{
+    close();
+}
+
+bool SqliteStorage::open()
+{
+    QSqlDatabase database = QSqlDatabase::contains(m_connectionName)
+                          ? QSqlDatabase::database(m_connectionName, false)
+                          : QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    database.setDatabaseName(m_databaseName);
+    database.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+
+    if (!database.open()) {
+        m_lastError = database.lastError().text();
+        return false;
+    }
+
+    // A no-op for the journal file, which DatabaseIo has already upgraded;
+    // a fresh in-memory database gets its schema here.
+    SchemaMigrator migrator(m_databaseName);
+    if (!migrator.migrateSchema(database, &m_lastError))
+        return false;
+
+    m_handle = sqliteHandle(database);
+    m_synchronous.clear();
+
+    // The encrypting VFS seals whole files and cannot host a write-ahead log.
+    // The journal mode is kept in the file, so it also has to be switched back.
+    m_durable = m_databaseName != ":memory:";
+    m_wal = false;
+    if (m_durable) {
+        const bool encrypted = CryptoVfs::hasKeys() || CryptoVfs::isEncrypted(m_databaseName);
+        QSqlQuery query(database);
+        if (query.exec(encrypted ? "PRAGMA journal_mode = DELETE" : "PRAGMA journal_mode = WAL")
+            && query.next())
+            m_wal = query.value(0).toString().compare("wal", Qt::CaseInsensitive) == 0;
+        if (encrypted && m_wal)
+            qWarning() << "SqliteStorage: the encrypted journal is still in WAL mode";
+    }
+    return true;
+}
+
+void SqliteStorage::close()
+{
+    if (!QSqlDatabase::contains(m_connectionName))
+        return;
+
+    if (!flush())
+        qWarning() << "SqliteStorage: buffered writes lost:" << m_lastError;
+
+    // Prepared statements keep the connection from closing.
+    m_insertEvent.finalize();
+    m_eventText.finalize();
+    m_updateEventText.finalize();
+    m_eventCount.finalize();
+    m_eventById.finalize();
+    m_eventsFromRow.finalize();
+    m_eventsFromId.finalize();
+    m_eventsMatching.finalize();
+    m_handle = 0;
+
+    {
+        QSqlDatabase database = QSqlDatabase::database(m_connectionName, false);
+        database.close();
+    }
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
+
+QSqlDatabase SqliteStorage::database() const
+{
+    return QSqlDatabase::database(m_connectionName);
+}
+
+bool SqliteStorage::isWriteAheadLog() const
+{
+    return m_wal;
+}
+
+bool SqliteStorage::execute(const char *sql)
+{
+    if (sqlite3_exec(m_handle, sql, 0, 0, 0) == SQLITE_OK)
+        return true;
+    m_lastError = QString::fromUtf8(sqlite3_errmsg(m_handle));
+    return false;
+}
+
+bool SqliteStorage::setSynchronous(const QString &level)
+{
+    // Only takes effect outside a transaction.
+    if (!m_durable || m_synchronous == level)
+        return true;
+    if (!execute(QString("PRAGMA synchronous = %1").arg(level).toUtf8().constData()))
+        return false;
+    m_synchronous = level;
+    return true;
+}
+
+bool SqliteStorage::beginWrite(Durability durability)
+{
+    if (!m_handle) {
+        m_lastError = "The journal is not open";
+        return false;
+    }
+
+    // Buffered writes leave the transaction open for the next write, and it is
+    // committed with whatever level that one asks for, so it has to be the
+    // strongest. IMMEDIATE takes the write lock up front: a write that read
+    // first would fail on a stale snapshot once another connection committed,
+    // without waiting in the busy handler.
+    if (!m_transaction) {
+        if (!setSynchronous(durability == Flushed && m_wal ? "NORMAL" : "FULL")
+            || !execute("BEGIN IMMEDIATE"))
+            return false;
+        m_transaction = true;
+    }
+    return execute("SAVEPOINT write");
+}
+
+bool SqliteStorage::endWrite(bool ok, Durability durability)
+{
+    if (ok)
+        ok = execute("RELEASE write");
+    if (!ok) {
+        const QString error = m_lastError;
+        sqlite3_exec(m_handle, "ROLLBACK TO write; RELEASE write", 0, 0, 0);
+        m_lastError = error;
+        // Some errors roll back the whole transaction.
+        if (sqlite3_get_autocommit(m_handle))
+            m_transaction = false;
+    }
+
+    // A stronger write takes the buffered ones along. The other users of the
+    // connection (tags, trash, sync, ...) keep committing with FULL.
+    if (durability != Buffered && (!flush() || !setSynchronous("FULL")))
+        ok = false;
+    return ok;
+}
+
+bool SqliteStorage::flush()
+{
+    if (!m_transaction)
+        return true;
+
+    m_transaction = false;
+    if (execute("COMMIT"))
+        return true;
+    const QString error = m_lastError;
+    sqlite3_exec(m_handle, "ROLLBACK", 0, 0, 0);
+    m_lastError = error;
+    return false;
+}
+
+qint64 SqliteStorage::addRecord(const QString &timeStamp, const QString &textEvent,
+                                Durability durability)
+{
+    if (!beginWrite(durability))
+        return -1;
+    QSqlDatabase db = database();
+
+    const TextCounts counts = TextCounter::count(textEvent);
+    if (!m_insertEvent.prepare(m_handle)
+        || !m_insertEvent.exec(timeStamp, textEvent, eventTimeFromString(timeStamp),
+                               counts.words, counts.characters)) {
+        m_lastError = m_insertEvent.lastError();
+        endWrite(false, durability);
+        return -1;
+    }
+    const qint64 eventId = m_insertEvent.lastInsertId();
+
+    // The entry, its #hashtags and its similarity signature are committed together.
+    if (!FacetIndex::writeTags(db, eventId, FacetIndex::hashtags(textEvent), true, &m_lastError)) {
+        endWrite(false, durability);
+        return -1;
+    }
+    SimilarityIndex similarity(db);
+    if (!similarity.addEvent(eventId, SimilarityIndex::signature(textEvent))) {
+        m_lastError = similarity.lastError();
+        endWrite(false, durability);
+        return -1;
+    }
+    if (!endWrite(true, durability))
+        return -1;
+    return eventId;
+}
+
+bool SqliteStorage::updateRecord(qint64 eventId, const QString &textEvent, Durability durability)
+{
+    if (!beginWrite(durability))
+        return false;
+    QSqlDatabase db = database();
+
+    EventText::Row row;
+    if (!m_eventText.prepare(m_handle) || !m_eventText.exec(eventId)) {
+        m_lastError = m_eventText.lastError();
+        endWrite(false, durability);
+        return false;
+    }
+    if (!m_eventText.next(row)) {
+        m_lastError = QString("No event %1").arg(eventId);
+        endWrite(false, durability);
+        return false;
+    }
+    m_eventText.finish();
+    const QString current = row.first;
+    const qint64 createdAt = row.second;
+
+    if (current == textEvent)
+        return endWrite(true, durability);
+
+    // The revision and the new text are committed together.
+    RevisionStore revisions(db);
+    if (!revisions.addRevision(eventId, current, textEvent, createdAt,
+                               QDateTime::currentDateTime().toTime_t())) {
+        m_lastError = revisions.lastError();
+        endWrite(false, durability);
+        return false;
+    }
+
+    const TextCounts counts = TextCounter::count(textEvent);
+    if (!m_updateEventText.prepare(m_handle)
+        || !m_updateEventText.exec(textEvent, counts.words, counts.characters, eventId)) {
+        m_lastError = m_updateEventText.lastError();
+        endWrite(false, durability);
+        return false;
+    }
+    if (!FacetIndex::writeTags(db, eventId, FacetIndex::hashtags(textEvent), true, &m_lastError)) {
+        endWrite(false, durability);
+        return false;
+    }
+    SimilarityIndex similarity(db);
+    if (!similarity.updateEvent(eventId, SimilarityIndex::signature(textEvent))) {
+        m_lastError = similarity.lastError();
+        endWrite(false, durability);
+        return false;
+    }
+    return endWrite(true, durability);
+}
+
+int SqliteStorage::count()
+{
+    EventCount::Row row;
+    if (!m_eventCount.prepare(m_handle) || !m_eventCount.exec() || !m_eventCount.next(row)) {
+        m_lastError = m_eventCount.lastError();
+        return 0;
+    }
+    return row.first;
+}
+
+bool SqliteStorage::event(int row, EventRecord &record)
+{
+    if (!m_eventsFromRow.prepare(m_handle) || !m_eventsFromRow.exec(row, 1)) {
+        m_lastError = m_eventsFromRow.lastError();
+        return false;
+    }
+    EventRow found;
+    if (!m_eventsFromRow.next(found))
+        return false;
+
+    record.eventId = found.first;
+    record.createdAt = found.second;
+    record.timeStamp = found.third;
+    record.textEvent = found.fourth;
+    return true;
+}
+
+bool SqliteStorage::eventById(qint64 eventId, EventRecord &record)
+{
+    if (!m_eventById.prepare(m_handle) || !m_eventById.exec(eventId)) {
+        m_lastError = m_eventById.lastError();
+        return false;
+    }
+    EventRow found;
+    if (!m_eventById.next(found))
+        return false;
+
+    record.eventId = found.first;
+    record.createdAt = found.second;
+    record.timeStamp = found.third;
+    record.textEvent = found.fourth;
+    return true;
+}
+
+QList<EventRecord> SqliteStorage::range(int firstRow, int count)
+{
+    QList<EventRecord> records;
+
+    if (!m_eventsFromRow.prepare(m_handle) || !m_eventsFromRow.exec(firstRow, count)) {
+        m_lastError = m_eventsFromRow.lastError();
+        return records;
+    }
+    appendRows(m_eventsFromRow, records);
+    return records;
+}
+
+QList<EventRecord> SqliteStorage::rangeFrom(qint64 firstEventId, int count)
+{
+    QList<EventRecord> records;
+
+    if (!m_eventsFromId.prepare(m_handle) || !m_eventsFromId.exec(firstEventId, count)) {
+        m_lastError = m_eventsFromId.lastError();
+        return records;
+    }
+    appendRows(m_eventsFromId, records);
+    return records;
+}
+
+QList<EventRecord> SqliteStorage::search(qint64 from, qint64 to, const QString &text)
+{
+    QList<EventRecord> records;
+
+    QString pattern = text;
+    pattern.replace("\\", "\\\\").replace("%", "\\%").replace("_", "\\_");
+
+    if (!m_eventsMatching.prepare(m_handle)
+        || !m_eventsMatching.exec(from, to, "%" + pattern + "%")) {
+        m_lastError = m_eventsMatching.lastError();
+        return records;
+    }
+    appendRows(m_eventsMatching, records);
+    return records;
+}
+
+QString SqliteStorage::lastError() const
+{
+    return m_lastError;
+}
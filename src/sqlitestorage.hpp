@@ -0,0 +1,87 @@
+/*
+ * sqlitestorage.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef SQLITESTORAGE_HPP_
+#define SQLITESTORAGE_HPP_
+
+#include "journalqueries.hpp"
+#include "storagebackend.hpp"
+
+#include <QtSql/QSqlDatabase>
+
+/*
+ * @brief Keeps entries in the events table of a SQLite database.
+ *
+ * Uses its own named QSqlDatabase connection, so it can sit beside the
+ * default connection that createDatabase() and the migrations use. The
+ * queries behind the list stay prepared while the storage is open. Rows
+ * are positions among the entries that are not in the trash.
+ *
+ * The journal is kept in write-ahead log mode, where a Flushed write is
+ * committed with synchronous = NORMAL (no fsync) and a Synced one with FULL.
+ * Buffered writes share one open transaction, committed as a group by
+ * flush() or the next stronger write. SQLite fixes the sync level when a
+ * transaction starts, so that group commit is always synced. An encrypted
+ * journal keeps the rollback journal, where Flushed writes are synced too.
+ */
+class SqliteStorage : public StorageBackend
+{
+public:
+    SqliteStorage(const QString &databaseName, const QString &connectionName = "DWriter-storage");
+    virtual ~SqliteStorage();
+
+    virtual bool open();
+    virtual void close();
+
+    virtual qint64 addRecord(const QString &timeStamp, const QString &textEvent,
+                             Durability durability = Synced);
+    // Keeps the replaced text in the entry's revision history.
+    virtual bool updateRecord(qint64 eventId, const QString &textEvent,
+                              Durability durability = Synced);
+    virtual bool flush();
+
+    virtual int count();
+    virtual bool event(int row, EventRecord &record);
+    virtual QList<EventRecord> range(int firstRow, int count);
+    virtual bool eventById(qint64 eventId, EventRecord &record);
+    virtual QList<EventRecord> rangeFrom(qint64 firstEventId, int count);
+    virtual QList<EventRecord> search(qint64 from, qint64 to, const QString &text);
+
+    virtual QString lastError() const;
+
+    virtual QSqlDatabase database() const;
+
+    bool isWriteAheadLog() const;
+
+private:
+    // Every write is a savepoint, inside the buffered transaction if one is open.
+    // Writers on other connections are waited for in the busy handler.
+    bool beginWrite(Durability durability);
+    bool endWrite(bool ok, Durability durability);
+    bool setSynchronous(const QString &level);
+    bool execute(const char *sql);
+
+    QString m_databaseName;
+    QString m_connectionName;
+    QString m_lastError;
+
+    sqlite3 *m_handle;
+    bool m_durable;                // false for an in-memory database
+    bool m_wal;
+    bool m_transaction;            // open; holds Buffered writes between calls
+    QString m_synchronous;
+    TypedQuery<InsertEvent> m_insertEvent;
+    TypedQuery<EventText> m_eventText;
+    TypedQuery<UpdateEventText> m_updateEventText;
+    TypedQuery<EventCount> m_eventCount;
+    TypedQuery<EventById> m_eventById;
+    TypedQuery<EventsFromRow> m_eventsFromRow;
+    TypedQuery<EventsFromId> m_eventsFromId;
+    TypedQuery<EventsMatching> m_eventsMatching;
+};
+
+#endif /* SQLITESTORAGE_HPP_ */
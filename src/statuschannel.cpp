@@ -0,0 +1,173 @@
+/*
+ * statuschannel.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "statuschannel.hpp"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QThread>
+#include <QTimer>
+
+// -----------------------------------------------------------------------------------------------
+// StatusChannel
+
+StatusChannel::StatusChannel(QObject *parent)
+    : QObject(parent)
+    , m_timer(0)
+    , m_dueMs(0)
+    , m_scheduled(false)
+{
+    for (int s = 0; s < SeverityCount; ++s) {
+        for (int c = 0; c < CodeCount; ++c)
+            m_posted[s][c] = 0;
+    }
+    m_clock.start();
+
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(deliver()));
+}
+
+void StatusChannel::post(Severity severity, Code code, const QString &text, const QString &detail)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        ++m_posted[severity][code];
+        if (severity == Info) {
+            qDebug() << "StatusChannel:" << text;
+            return;
+        }
+
+        const QString key = QString("%1\n%2").arg(int(code)).arg(detail.isEmpty() ? text : detail);
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        Pending &pending = m_pending[key];
+        if (!pending.repeats) {
+            pending.severity = severity;
+            pending.code = code;
+            pending.text = text;
+            pending.detail = detail;
+            pending.firstMs = now;
+        }
+        pending.severity = qMax(pending.severity, severity);
+        pending.lastMs = now;
+        ++pending.repeats;
+
+        if (m_scheduled)
+            return;
+        m_scheduled = true;
+    }
+
+    if (QThread::currentThread() == thread()) {
+        schedule();
+    } else {
+        QMetaObject::invokeMethod(this, "schedule", Qt::QueuedConnection);
+    }
+}
+
+QList<StatusMessage> StatusChannel::takeMessages()
+{
+    QMutexLocker locker(&m_mutex);
+    QList<StatusMessage> messages = m_messages;
+    m_messages.clear();
+    return messages;
+}
+
+int StatusChannel::posted(Severity severity, Code code) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_posted[severity][code];
+}
+
+void StatusChannel::schedule()
+{
+    // A timer still waiting out a repeat interval is brought forward.
+    const qint64 due = m_clock.elapsed() + STATUS_FRAME_MS;
+    if (!m_timer->isActive() || m_dueMs > due) {
+        m_timer->start(STATUS_FRAME_MS);
+        m_dueMs = due;
+    }
+}
+
+void StatusChannel::deliver()
+{
+    bool posted = false;
+    qint64 nextMs = -1;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_scheduled = false;
+        const qint64 now = m_clock.elapsed();
+
+        QMap<QString, Pending>::iterator it = m_pending.begin();
+        while (it != m_pending.end()) {
+            Pending &pending = it.value();
+            qint64 due = pending.shownMs < 0 ? now : pending.shownMs + STATUS_REPEAT_MS;
+            if (due <= now && pending.repeats) {
+                StatusMessage message;
+                message.severity = pending.severity;
+                message.code = pending.code;
+                message.text = summary(pending);
+                message.detail = pending.detail;
+                message.repeats = pending.repeats;
+                message.firstMs = pending.firstMs;
+                message.lastMs = pending.lastMs;
+                m_messages << message;
+                if (m_messages.size() > STATUS_MAX_MESSAGES)
+                    m_messages.removeFirst();
+                posted = true;
+
+                pending.repeats = 0;
+                pending.shownMs = now;
+                due = now + STATUS_REPEAT_MS;
+            }
+
+            // Once the interval is over without repeats, the message may be shown right away again.
+            if (!pending.repeats && due <= now) {
+                it = m_pending.erase(it);
+                continue;
+            }
+            nextMs = nextMs < 0 ? due : qMin(nextMs, due);
+            ++it;
+        }
+        if (nextMs >= 0)
+            nextMs = qMax<qint64>(nextMs - now, STATUS_FRAME_MS);
+    }
+
+    if (nextMs >= 0) {
+        m_timer->start(int(nextMs));
+        m_dueMs = m_clock.elapsed() + nextMs;
+    }
+    if (posted)
+        emit messagesPosted();
+}
+
+QString StatusChannel::summary(const Pending &pending) const
+{
+    const int n = pending.repeats;
+    if (n == 1)
+        return pending.text;
+
+    // Errors of one kind read as a count; anything else is repeated as it was posted.
+    if (pending.severity >= Warning && !pending.detail.isEmpty()) {
+        switch (pending.code) {
+        case Insert:     return tr("%n inserts failed: %1", 0, n).arg(pending.detail);
+        case Edit:       return tr("%n edits failed: %1", 0, n).arg(pending.detail);
+        case Delete:     return tr("%n deletions failed: %1", 0, n).arg(pending.detail);
+        case Restore:    return tr("%n restores failed: %1", 0, n).arg(pending.detail);
+        case EmptyTrash: return tr("Emptying the trash failed %n times: %1", 0, n).arg(pending.detail);
+        case Save:       return tr("Saving the journal failed %n times: %1", 0, n).arg(pending.detail);
+        case Tags:       return tr("%n tag changes failed: %1", 0, n).arg(pending.detail);
+        case Mood:       return tr("%n mood changes failed: %1", 0, n).arg(pending.detail);
+        case Import:     return tr("%n import errors: %1", 0, n).arg(pending.detail);
+        case Export:     return tr("%n export errors: %1", 0, n).arg(pending.detail);
+        case Sync:       return tr("%n syncs failed: %1", 0, n).arg(pending.detail);
+        case VoiceNote:  return tr("%n voice notes failed: %1", 0, n).arg(pending.detail);
+        default:         break;
+        }
+    }
+    return tr("%1 (%n times)", 0, n).arg(pending.text);
+}
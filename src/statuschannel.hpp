@@ -0,0 +1,115 @@
+/*
+ * statuschannel.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef STATUSCHANNEL_HPP_
+#define STATUSCHANNEL_HPP_
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+
+class QTimer;
+struct StatusMessage;
+
+#define STATUS_FRAME_MS 16          // messages are handed to the UI once per frame
+#define STATUS_REPEAT_MS 5000       // a message is shown again at most this often
+#define STATUS_MAX_MESSAGES 20      // queued for the UI; the oldest are dropped
+
+/*
+ * @brief Errors and notices on their way to the UI.
+ *
+ * Anything may post(); the UI takes the queued messages when
+ * messagesPosted() is emitted, at most once per STATUS_FRAME_MS. Posts with
+ * the same code and detail are merged: one that comes within
+ * STATUS_REPEAT_MS of the last time it was shown waits for the interval
+ * to end and is then shown once with the number of repeats, as in
+ * "37 inserts failed: disk full". Info posts (successes) are only counted.
+ */
+class StatusChannel : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Severity { Info, Notice, Warning, Error, SeverityCount };
+
+    // What a message is about.
+    enum Code {
+        Journal,        // opening or unlocking the journal
+        Schema,         // creating, upgrading or dropping tables
+        Insert, Edit, Delete, Restore, EmptyTrash, Save, Tags, Mood,
+        Import, Export, Sync, Encryption, VoiceNote,
+        CodeCount
+    };
+
+    StatusChannel(QObject *parent = 0);
+
+    // Thread-safe. 'text' is what is shown for a single post; 'detail',
+    // usually the error text, tells the posts of one code apart. Without it,
+    // posts of one code are merged when their text is the same.
+    void post(Severity severity, Code code, const QString &text, const QString &detail = QString());
+
+    // The messages queued since the last call, oldest first.
+    QList<StatusMessage> takeMessages();
+
+    // Posts since the channel was created, shown or not.
+    int posted(Severity severity, Code code) const;
+
+Q_SIGNALS:
+    void messagesPosted();
+
+private Q_SLOTS:
+    void schedule();
+    void deliver();
+
+private:
+    struct Pending
+    {
+        Pending() : severity(Info), code(Journal), repeats(0), firstMs(0), lastMs(0), shownMs(-1) {}
+
+        Severity severity;     // the worst of the repeats
+        Code code;
+        QString text;
+        QString detail;
+        int repeats;           // posts since the message was last shown
+        qint64 firstMs;
+        qint64 lastMs;
+        qint64 shownMs;        // m_clock time; -1 before it was first shown
+    };
+
+    QString summary(const Pending &pending) const;
+
+    mutable QMutex m_mutex;
+    QElapsedTimer m_clock;
+    QTimer *m_timer;
+    qint64 m_dueMs;
+    bool m_scheduled;
+    QMap<QString, Pending> m_pending;     // by code and detail
+    QList<StatusMessage> m_messages;
+    int m_posted[SeverityCount][CodeCount];
+};
+
+/*
+ * One message as the UI shows it.
+ */
+struct StatusMessage
+{
+    StatusMessage()
+        : severity(StatusChannel::Info), code(StatusChannel::Journal), repeats(0), firstMs(0), lastMs(0) {}
+
+    StatusChannel::Severity severity;
+    StatusChannel::Code code;
+    QString text;          // with the repeats summed up
+    QString detail;
+    int repeats;           // posts merged into this message
+    qint64 firstMs;        // of the first and last of them, since the epoch
+    qint64 lastMs;
+};
+
+#endif /* STATUSCHANNEL_HPP_ */
@@ -0,0 +1,113 @@
+/*
+ * storagebackend.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef STORAGEBACKEND_HPP_
+#define STORAGEBACKEND_HPP_
+
+#include <QList>
+#include <QtAlgorithms>
+#include <QString>
+#include <QtSql/QSqlDatabase>
+
+/*
+ * One journal entry as it is handed between DatabaseIo and a storage backend.
+ */
+struct EventRecord
+{
+    EventRecord() : eventId(-1), createdAt(0) {}
+
+    qint64 eventId;
+    qint64 createdAt;     // seconds since the epoch, see eventTimeFromString()
+    QString timeStamp;
+    QString textEvent;
+};
+
+inline bool createdBefore(const EventRecord &a, const EventRecord &b)
+{
+    return a.createdAt < b.createdAt;
+}
+
+/*
+ * @brief Interface to the place where journal entries are kept.
+ *
+ * DatabaseIo talks to one backend. Rows are addressed by their position in
+ * insertion order (row 0 is the oldest entry), which is how the list in
+ * Tab 2 addresses them.
+ */
+class StorageBackend
+{
+public:
+    // How far a write has got when it returns:
+    //   Buffered  held in memory or an open transaction until the next Flushed or
+    //             Synced write or flush(); lost if the app dies before that.
+    //   Flushed   handed to the OS (the write-ahead log, for SQLite); survives
+    //             the app crashing but not necessarily a power loss.
+    //   Synced    on stable storage; survives a power loss.
+    // Backends may keep a promise stronger than the one asked for.
+    enum Durability { Buffered, Flushed, Synced };
+
+    virtual ~StorageBackend() {}
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+
+    // Appends an entry and returns its eventID, or -1 on error.
+    virtual qint64 addRecord(const QString &timeStamp, const QString &textEvent,
+                             Durability durability = Synced) = 0;
+    virtual bool updateRecord(qint64 eventId, const QString &textEvent,
+                              Durability durability = Synced) = 0;
+
+    // Makes Buffered writes Synced. Must be called before anything else writes
+    // to database(), and is called by close().
+    virtual bool flush() { return true; }
+
+    virtual int count() = 0;
+    virtual bool event(int row, EventRecord &record) = 0;
+    virtual QList<EventRecord> range(int firstRow, int count) = 0;
+
+    // Backends that never delete keep eventIDs in row order.
+    virtual bool eventById(qint64 eventId, EventRecord &record)
+    {
+        return event(int(eventId - 1), record);
+    }
+
+    // Up to 'count' entries from 'firstEventId' on, in row order. Backends that
+    // delete look the rows up by eventID instead of counting them off.
+    virtual QList<EventRecord> rangeFrom(qint64 firstEventId, int count)
+    {
+        return range(int(firstEventId - 1), count);
+    }
+
+    // Entries created between 'from' and 'to' (seconds since the epoch) whose
+    // text contains 'text', oldest first. Backends with an index override this
+    // plain walk over all entries.
+    virtual QList<EventRecord> search(qint64 from, qint64 to, const QString &text)
+    {
+        QList<EventRecord> found;
+        QList<EventRecord> page;
+        int row = 0;
+        while (!(page = range(row, 500)).isEmpty()) {
+            for (int i = 0; i < page.size(); ++i) {
+                const EventRecord &record = page.at(i);
+                if (record.createdAt >= from && record.createdAt <= to
+                    && record.textEvent.contains(text, Qt::CaseInsensitive))
+                    found << record;
+            }
+            row += page.size();
+        }
+        qStableSort(found.begin(), found.end(), createdBefore);
+        return found;
+    }
+
+    virtual QString lastError() const = 0;
+
+    // Backends kept in SQLite hand out their connection to the features that
+    // live beside the events table (revisions, ...). Others return an invalid one.
+    virtual QSqlDatabase database() const { return QSqlDatabase(); }
+};
+
+#endif /* STORAGEBACKEND_HPP_ */
@@ -0,0 +1,546 @@
+/*
+ * stressharness.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "stressharness.hpp"
+#include "EventData.hpp"
+#include "sqlitestorage.hpp"
+#include "typedquery.hpp"
+
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QVector>
+#include <QtAlgorithms>
+#include <QtSql/QtSql>
+
+#include <sqlite3.h>
+#include <unistd.h>
+
+#define STRESS_EPOCH 1700000000                 // entries are dated in the years after this
+#define STRESS_SPAN_SECONDS (3 * 365 * 86400)
+#define STRESS_SEARCH_SECONDS (90 * 86400)
+#define STRESS_SCROLL_PAGES 5
+#define STRESS_SEED_FLUSH 500
+#define STRESS_MAX_ERRORS 20
+#define STRESS_MAX_MISMATCHES 10
+
+static const char *const VOCABULARY[] = {
+    "morning", "coffee", "walk", "rain", "work", "meeting", "friend", "dinner",
+    "book", "train", "garden", "music", "tired", "happy", "call", "letter",
+    "river", "market", "project", "weekend", "quiet", "family", "run", "sleep",
+    "storm", "bread", "window", "travel", "plan", "idea", "night", "summer"
+};
+#define VOCABULARY_SIZE int(sizeof(VOCABULARY) / sizeof(VOCABULARY[0]))
+
+static quint32 nextRandom(quint32 &state)
+{
+    // xorshift32; the seed only has to reproduce a run.
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static QString entryText(quint32 &random, int writer, int serial)
+{
+    QString text = QString("writer %1 entry %2:").arg(writer).arg(serial);
+    const int words = 5 + int(nextRandom(random) % 60);
+    for (int i = 0; i < words; ++i)
+        text += QString(" ") + VOCABULARY[nextRandom(random) % VOCABULARY_SIZE];
+    if (nextRandom(random) % 4 == 0)
+        text += QString(" #") + VOCABULARY[nextRandom(random) % VOCABULARY_SIZE];
+    return text;
+}
+
+static QString entryTimeStamp(quint32 &random)
+{
+    return QDateTime::fromTime_t(STRESS_EPOCH + nextRandom(random) % STRESS_SPAN_SECONDS).toString();
+}
+
+static qint64 residentBytes()
+{
+    // Linux and the simulator; elsewhere the SQLite heap has to do.
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+        return 0;
+    const QList<QByteArray> fields = statm.readLine().split(' ');
+    return fields.size() > 1 ? fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE) : 0;
+}
+
+static qint64 percentile(const QVector<qint64> &sorted, int percent)
+{
+    if (sorted.isEmpty())
+        return 0;
+    return sorted.at(qMin(sorted.size() - 1, sorted.size() * percent / 100));
+}
+
+// QMap::unite() would keep both texts of an edited entry.
+static void insertAll(QMap<qint64, QString> &to, const QMap<qint64, QString> &from)
+{
+    for (QMap<qint64, QString>::const_iterator it = from.constBegin(); it != from.constEnd(); ++it)
+        to.insert(it.key(), it.value());
+}
+
+static void addStats(StressStats &total, const StressStats &part)
+{
+    total.operations += part.operations;
+    total.errors += part.errors;
+    total.busyWaits += part.busyWaits;
+    total.busyWaitUs += part.busyWaitUs;
+    total.maxBusyWaitUs = qMax(total.maxBusyWaitUs, part.maxBusyWaitUs);
+}
+
+// -----------------------------------------------------------------------------------------------
+// Busy handler
+
+struct BusyState
+{
+    BusyState() : waited(false), waitedUs(0) {}
+
+    QElapsedTimer since;
+    bool waited;
+    qint64 waitedUs;
+};
+
+static int busyHandler(void *context, int count)
+{
+    BusyState *state = static_cast<BusyState *>(context);
+    if (count == 0) {
+        state->since.start();
+        state->waited = true;
+    } else if (state->since.elapsed() >= STRESS_BUSY_TIMEOUT_MS) {
+        return 0;
+    }
+
+    // Backs off like SQLite's own handler: 1, 2, 4, ... up to 50 ms a try.
+    QElapsedTimer slept;
+    slept.start();
+    sqlite3_sleep(qMin(1 << qMin(count, 6), 50));
+    state->waitedUs += slept.nsecsElapsed() / 1000;
+    return 1;
+}
+
+// -----------------------------------------------------------------------------------------------
+// StressWorker
+
+class StressWorker : public QRunnable
+{
+public:
+    enum Role { Writer, Scroller, Searcher };
+
+    StressWorker(Role role, int index, const StressConfig &config, const QString &databaseName,
+                 const QElapsedTimer &clock, int windows, QAtomicInt *stopRequested)
+        : m_role(role)
+        , m_index(index)
+        , m_config(config)
+        , m_databaseName(databaseName)
+        , m_clock(clock)
+        , m_windows(windows)
+        , m_stopRequested(stopRequested)
+        , edits(0)
+    {
+        setAutoDelete(false);
+        for (int op = 0; op < StressOperationCount; ++op) {
+            stats[op].resize(windows);
+            latencies[op].resize(windows);
+        }
+    }
+
+    void run();
+
+    // Per window; the percentiles are filled in by StressHarness.
+    QVector<StressStats> stats[StressOperationCount];
+    QVector<QVector<qint64> > latencies[StressOperationCount];
+
+    // Writers: the entries they added or edited, with their last text.
+    QMap<qint64, QString> written;
+    int edits;
+    QStringList errors;
+
+private:
+    void write(SqliteStorage &storage, quint32 &random);
+    void scroll(SqliteStorage &storage, quint32 &random);
+    void search(SqliteStorage &storage, quint32 &random);
+    void settlePending(bool committed);
+
+    void begin();
+    void end(StressOperation op, bool ok, const QString &error = QString());
+
+    Role m_role;
+    int m_index;
+    StressConfig m_config;
+    QString m_databaseName;
+    QElapsedTimer m_clock;
+    int m_windows;
+    QAtomicInt *m_stopRequested;
+
+    BusyState m_busy;
+    QElapsedTimer m_timer;
+
+    // Buffered writes, until a flush makes them count
+    QList<qint64> m_ids;
+    QMap<qint64, QString> m_pending;
+    int m_pendingEdits;
+    int m_serial;
+};
+
+void StressWorker::run()
+{
+    SqliteStorage storage(m_databaseName, QString("DWriter-stress-%1-%2").arg(int(m_role)).arg(m_index));
+    if (!storage.open()) {
+        errors << storage.lastError();
+        return;
+    }
+    sqlite3_busy_handler(sqliteHandle(storage.database()), busyHandler, &m_busy);
+
+    quint32 random = (m_config.seed ? m_config.seed : 1) * 2654435761u + quint32(m_role) * 7919u + quint32(m_index) + 1;
+    m_pendingEdits = 0;
+    m_serial = 0;
+
+    while (!*m_stopRequested) {
+        switch (m_role) {
+        case Writer:   write(storage, random);  break;
+        case Scroller: scroll(storage, random); break;
+        case Searcher: search(storage, random); break;
+        }
+    }
+
+    if (m_role == Writer) {
+        IoScope io("stress insert");
+        begin();
+        const bool ok = storage.flush();
+        end(StressInsert, ok, storage.lastError());
+        settlePending(ok);
+    }
+    storage.close();
+}
+
+void StressWorker::begin()
+{
+    m_busy.waited = false;
+    m_busy.waitedUs = 0;
+    m_timer.start();
+}
+
+void StressWorker::end(StressOperation op, bool ok, const QString &error)
+{
+    const qint64 us = m_timer.nsecsElapsed() / 1000;
+    const int window = qMin(int(m_clock.elapsed() / m_config.windowMs), m_windows - 1);
+
+    StressStats &stat = stats[op][window];
+    ++stat.operations;
+    latencies[op][window] << us;
+    if (!ok) {
+        ++stat.errors;
+        if (errors.size() < STRESS_MAX_ERRORS)
+            errors << error;
+    }
+    if (m_busy.waited) {
+        ++stat.busyWaits;
+        stat.busyWaitUs += m_busy.waitedUs;
+        stat.maxBusyWaitUs = qMax(stat.maxBusyWaitUs, m_busy.waitedUs);
+    }
+}
+
+void StressWorker::write(SqliteStorage &storage, quint32 &random)
+{
+    const bool buffered = m_config.durability == StorageBackend::Buffered;
+    const bool edit = !m_ids.isEmpty() && int(nextRandom(random) % 100) < m_config.editPercent;
+    const QString text = entryText(random, m_index, ++m_serial);
+    qint64 eventId;
+    IoScope io(edit ? "stress edit" : "stress insert");
+
+    begin();
+    bool ok;
+    if (edit) {
+        eventId = m_ids.at(nextRandom(random) % m_ids.size());
+        ok = storage.updateRecord(eventId, text, m_config.durability);
+    } else {
+        eventId = storage.addRecord(entryTimeStamp(random), text, m_config.durability);
+        ok = eventId >= 0;
+    }
+    if (ok) {
+        if (!edit)
+            m_ids << eventId;
+        m_pending.insert(eventId, text);
+        m_pendingEdits += edit ? 1 : 0;
+    }
+    const bool flushing = ok && buffered && m_serial % m_config.flushEvery == 0;
+    if (flushing)
+        ok = storage.flush();
+    end(edit ? StressEdit : StressInsert, ok,
+        QString("%1: %2").arg(edit ? "edit" : "insert", storage.lastError()));
+
+    // Acknowledged writes count once they are committed. A failed flush, or a
+    // failure that ended the transaction, loses the Buffered ones since the last flush.
+    if (!buffered || flushing || (!ok && sqlite3_get_autocommit(sqliteHandle(storage.database()))))
+        settlePending(ok);
+}
+
+void StressWorker::settlePending(bool committed)
+{
+    if (committed) {
+        insertAll(written, m_pending);
+        edits += m_pendingEdits;
+    } else {
+        for (QMap<qint64, QString>::const_iterator it = m_pending.constBegin();
+             it != m_pending.constEnd(); ++it) {
+            if (!written.contains(it.key()))
+                m_ids.removeAll(it.key());
+        }
+    }
+    m_pending.clear();
+    m_pendingEdits = 0;
+}
+
+void StressWorker::scroll(SqliteStorage &storage, quint32 &random)
+{
+    // Rows only ever get appended here, so every row below the count stays put.
+    IoScope io("stress scroll");
+    begin();
+    const int count = storage.count();
+    int row = count ? int(nextRandom(random) % count) : 0;
+
+    for (int page = 0; page < STRESS_SCROLL_PAGES && row < count; ++page) {
+        const QList<EventRecord> records = storage.range(row, m_config.pageSize);
+        bool ok = !records.isEmpty();
+        for (int i = 1; ok && i < records.size(); ++i)
+            ok = records.at(i - 1).eventId < records.at(i).eventId;
+        end(StressScroll, ok, QString("page at row %1 of %2: %3")
+                              .arg(row).arg(count).arg(records.isEmpty() ? storage.lastError()
+                                                                         : QString("out of order")));
+        row += m_config.pageSize;
+        begin();
+    }
+}
+
+void StressWorker::search(SqliteStorage &storage, quint32 &random)
+{
+    const qint64 from = STRESS_EPOCH + nextRandom(random) % STRESS_SPAN_SECONDS;
+    const qint64 to = from + STRESS_SEARCH_SECONDS;
+    const QString word = VOCABULARY[nextRandom(random) % VOCABULARY_SIZE];
+
+    IoScope io("stress search");
+    begin();
+    const QList<EventRecord> found = storage.search(from, to, word);
+    bool ok = true;
+    for (int i = 0; ok && i < found.size(); ++i) {
+        const EventRecord &record = found.at(i);
+        ok = record.createdAt >= from && record.createdAt <= to
+             && record.textEvent.contains(word, Qt::CaseInsensitive);
+    }
+    end(StressSearch, ok, QString("search for \"%1\" returned an entry that does not match").arg(word));
+}
+
+// -----------------------------------------------------------------------------------------------
+// StressHarness
+
+StressHarness::StressHarness(const QString &databaseName)
+    : m_databaseName(databaseName)
+{
+}
+
+QString StressHarness::lastError() const
+{
+    return m_lastError;
+}
+
+StressReport StressHarness::run(const StressConfig &config)
+{
+    StressReport report;
+    m_lastError.clear();
+
+    const char *const suffixes[] = { "", "-wal", "-shm", "-journal" };
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); ++i)
+        QFile::remove(m_databaseName + suffixes[i]);
+    IoVfs::install();
+    if (!seedJournal(config))
+        return report;
+
+    const int windowMs = qMax(1, config.windowMs);
+    const int windows = qMax(1, (config.seconds * 1000 + windowMs - 1) / windowMs);
+    StressConfig workerConfig = config;
+    workerConfig.windowMs = windowMs;
+    workerConfig.flushEvery = qMax(1, config.flushEvery);
+    workerConfig.pageSize = qMax(1, config.pageSize);
+
+    MaintenanceScheduler *maintenance = 0;
+    if (config.maintenance) {
+        maintenance = new MaintenanceScheduler(m_databaseName);
+        maintenance->start();
+        maintenance->setBackground(true);
+    }
+
+    sqlite3_memory_highwater(1);
+    IoVfs::reset();
+    QAtomicInt stopRequested(0);
+    QElapsedTimer clock;
+    clock.start();
+
+    QList<StressWorker *> workers;
+    for (int i = 0; i < config.writers; ++i)
+        workers << new StressWorker(StressWorker::Writer, i, workerConfig, m_databaseName, clock, windows, &stopRequested);
+    for (int i = 0; i < config.scrollers; ++i)
+        workers << new StressWorker(StressWorker::Scroller, i, workerConfig, m_databaseName, clock, windows, &stopRequested);
+    for (int i = 0; i < config.searchers; ++i)
+        workers << new StressWorker(StressWorker::Searcher, i, workerConfig, m_databaseName, clock, windows, &stopRequested);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, workers.size()));
+    for (int i = 0; i < workers.size(); ++i)
+        pool.start(workers.at(i));
+
+    // Memory is sampled at the end of every window.
+    for (int w = 0; w < windows; ++w) {
+        const qint64 windowEnd = qint64(w + 1) * windowMs;
+        qint64 left;
+        while ((left = windowEnd - clock.elapsed()) > 0)
+            sqlite3_sleep(int(qMin<qint64>(left, 50)));
+
+        StressWindow window;
+        window.startMs = qint64(w) * windowMs;
+        window.sqliteBytes = sqlite3_memory_used();
+        window.residentBytes = residentBytes();
+        report.windows << window;
+    }
+    stopRequested.fetchAndStoreOrdered(1);
+    pool.waitForDone();
+
+    if (maintenance) {
+        maintenance->stop();
+        delete maintenance;
+    }
+    report.sqliteHighwater = sqlite3_memory_highwater(0);
+    report.io = IoVfs::totals();
+
+    // Throughput and percentiles per window, then over the whole run.
+    QMap<qint64, QString> written;
+    int edits = 0;
+    for (int op = 0; op < StressOperationCount; ++op) {
+        QVector<qint64> all;
+        for (int w = 0; w < windows; ++w) {
+            StressStats &stat = report.windows[w].stats[op];
+            QVector<qint64> samples;
+            for (int i = 0; i < workers.size(); ++i) {
+                addStats(stat, workers.at(i)->stats[op].at(w));
+                samples += workers.at(i)->latencies[op].at(w);
+            }
+            qSort(samples);
+            stat.p50Us = percentile(samples, 50);
+            stat.p99Us = percentile(samples, 99);
+            stat.maxUs = samples.isEmpty() ? 0 : samples.last();
+            addStats(report.totals[op], stat);
+            all += samples;
+        }
+        qSort(all);
+        report.totals[op].p50Us = percentile(all, 50);
+        report.totals[op].p99Us = percentile(all, 99);
+        report.totals[op].maxUs = all.isEmpty() ? 0 : all.last();
+    }
+    for (int i = 0; i < workers.size(); ++i) {
+        insertAll(written, workers.at(i)->written);
+        edits += workers.at(i)->edits;
+        for (int e = 0; e < workers.at(i)->errors.size() && report.errors.size() < STRESS_MAX_ERRORS; ++e)
+            report.errors << workers.at(i)->errors.at(e);
+    }
+    qDeleteAll(workers);
+
+    // The seed entries are checked along with the rest; writers only edit their own.
+    insertAll(written, m_seeded);
+    m_seeded.clear();
+
+    checkInvariants(report, written, edits);
+    return report;
+}
+
+bool StressHarness::seedJournal(const StressConfig &config)
+{
+    SqliteStorage storage(m_databaseName, "DWriter-stress-seed");
+    if (!storage.open()) {
+        m_lastError = storage.lastError();
+        return false;
+    }
+
+    quint32 random = config.seed ? config.seed : 1;
+    m_seeded.clear();
+    for (int i = 0; i < config.seedEntries; ++i) {
+        const QString text = entryText(random, -1, i);
+        const qint64 eventId = storage.addRecord(entryTimeStamp(random), text, StorageBackend::Buffered);
+        if (eventId < 0 || ((i + 1) % STRESS_SEED_FLUSH == 0 && !storage.flush())) {
+            m_lastError = storage.lastError();
+            storage.close();
+            return false;
+        }
+        m_seeded.insert(eventId, text);
+    }
+    const bool ok = storage.flush();
+    if (!ok)
+        m_lastError = storage.lastError();
+    storage.close();
+    return ok;
+}
+
+void StressHarness::checkInvariants(StressReport &report, const QMap<qint64, QString> &written, int edits)
+{
+    SqliteStorage storage(m_databaseName, "DWriter-stress-check");
+    if (!storage.open()) {
+        report.violations << QString("Cannot open the journal: %1").arg(storage.lastError());
+        return;
+    }
+
+    {
+        QSqlQuery query(storage.database());
+        if (!query.exec("PRAGMA integrity_check") || !query.next()
+            || query.value(0).toString() != "ok") {
+            report.violations << QString("integrity_check: %1")
+                                 .arg(query.isActive() ? query.value(0).toString() : query.lastError().text());
+        }
+
+        report.entries = storage.count();
+        report.edits = edits;
+        if (report.entries != written.size()) {
+            report.violations << QString("%1 entries in the journal, %2 acknowledged")
+                                 .arg(report.entries).arg(written.size());
+        }
+
+        if (query.exec("SELECT COUNT(*) FROM revisions") && query.next()
+            && query.value(0).toInt() != edits) {
+            report.violations << QString("%1 revisions for %2 acknowledged edits")
+                                 .arg(query.value(0).toInt()).arg(edits);
+        }
+
+        // The triggers keep the statistics in step with the entries.
+        const char *const totals[] = { "stats_daily", "stats_monthly" };
+        for (int t = 0; t < 2; ++t) {
+            if (query.exec(QString("SELECT (SELECT SUM(entries) FROM %1) IS COUNT(*), "
+                                   "(SELECT SUM(words) FROM %1) IS SUM(words), "
+                                   "(SELECT SUM(characters) FROM %1) IS SUM(characters) "
+                                   "FROM events WHERE deletedAt IS NULL").arg(totals[t]))
+                && query.next()
+                && !(query.value(0).toBool() && query.value(1).toBool() && query.value(2).toBool())) {
+                report.violations << QString("%1 does not add up to the entries").arg(totals[t]);
+            }
+        }
+    }
+
+    int mismatches = 0;
+    for (QMap<qint64, QString>::const_iterator it = written.constBegin(); it != written.constEnd(); ++it) {
+        EventRecord record;
+        if (storage.eventById(it.key(), record) && record.textEvent == it.value())
+            continue;
+        if (++mismatches <= STRESS_MAX_MISMATCHES)
+            report.violations << QString("Entry %1 is missing or has other text").arg(it.key());
+    }
+    if (mismatches > STRESS_MAX_MISMATCHES)
+        report.violations << QString("%1 more entries are missing or have other text")
+                             .arg(mismatches - STRESS_MAX_MISMATCHES);
+
+    report.maintenance = MaintenanceScheduler::stats(storage.database());
+    storage.close();
+}
@@ -0,0 +1,126 @@
+/*
+ * stressharness.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef STRESSHARNESS_HPP_
+#define STRESSHARNESS_HPP_
+
+#include "iovfs.hpp"
+#include "maintenancescheduler.hpp"
+#include "storagebackend.hpp"
+
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+// How long an operation waits for a lock before it fails with SQLITE_BUSY.
+#define STRESS_BUSY_TIMEOUT_MS 5000
+
+enum StressOperation { StressInsert, StressEdit, StressScroll, StressSearch, StressOperationCount };
+
+struct StressConfig
+{
+    StressConfig()
+        : writers(2), scrollers(2), searchers(1), maintenance(true), seconds(60), windowMs(1000)
+        , seedEntries(2000), pageSize(20), editPercent(20), flushEvery(8)
+        , durability(StorageBackend::Synced), seed(1) {}
+
+    int writers;          // threads appending entries and editing their own
+    int scrollers;        // threads reading pages of the list from random rows on
+    int searchers;        // threads running text searches over date ranges
+    bool maintenance;     // runs the MaintenanceScheduler as if the app were in the background
+    int seconds;
+    int windowMs;         // the report has one StressWindow per window
+    int seedEntries;      // written before the clock starts
+    int pageSize;
+    int editPercent;      // of the writers' operations
+    int flushEvery;       // Buffered writers call flush() after this many writes
+    StorageBackend::Durability durability;
+    quint32 seed;
+};
+
+struct StressStats
+{
+    StressStats()
+        : operations(0), errors(0), busyWaits(0), busyWaitUs(0), maxBusyWaitUs(0)
+        , p50Us(0), p99Us(0), maxUs(0) {}
+
+    int operations;
+    int errors;
+    int busyWaits;        // operations that had to wait for another connection's lock
+    qint64 busyWaitUs;
+    qint64 maxBusyWaitUs;
+    qint64 p50Us;
+    qint64 p99Us;
+    qint64 maxUs;
+};
+
+struct StressWindow
+{
+    StressWindow() : startMs(0), sqliteBytes(0), residentBytes(0) {}
+
+    qint64 startMs;
+    StressStats stats[StressOperationCount];
+    qint64 sqliteBytes;      // sqlite3_memory_used() at the end of the window
+    qint64 residentBytes;    // of the process; 0 where the platform does not tell
+};
+
+struct StressReport
+{
+    StressReport() : entries(0), edits(0), sqliteHighwater(0) {}
+
+    bool passed() const { return violations.isEmpty(); }
+
+    QList<StressWindow> windows;
+    StressStats totals[StressOperationCount];
+    int entries;
+    int edits;
+    qint64 sqliteHighwater;
+    QList<MaintenanceStats> maintenance;
+    QMap<QString, IoCounters> io;   // by operation: "stress insert", "maintenance", ...
+    QStringList errors;       // the first few failed operations
+    QStringList violations;   // invariants that did not hold at the end
+};
+
+/*
+ * @brief Soaks the storage layer with concurrent writers, readers and maintenance.
+ *
+ * Every thread has its own SqliteStorage connection to one scratch journal,
+ * as DatabaseIo, the importer, the exporter and the maintenance each have
+ * theirs in the app. Writers append entries and edit their own, scrollers
+ * page through the list from random rows, searchers run text searches, and
+ * the MaintenanceScheduler runs its tasks alongside. Each connection gets a
+ * busy handler that records how often and how long it waited for a lock.
+ *
+ * Throughput, latency percentiles, lock waits and memory are reported per
+ * window of the run, and the file I/O of each kind of operation over the
+ * whole run, through IoVfs. At the end the journal is checked: integrity_check,
+ * every acknowledged entry with its last text, the entry count, the revision
+ * count and the daily statistics kept by the triggers.
+ *
+ * What each thread does is reproducible from the seed; how the threads
+ * interleave is up to the scheduler.
+ */
+class StressHarness
+{
+public:
+    StressHarness(const QString &databaseName);
+
+    StressReport run(const StressConfig &config);
+
+    QString lastError() const;
+
+private:
+    bool seedJournal(const StressConfig &config);
+    void checkInvariants(StressReport &report, const QMap<qint64, QString> &written, int edits);
+
+    QString m_databaseName;
+    QString m_lastError;
+    QMap<qint64, QString> m_seeded;   // eventID to text
+};
+
+#endif /* STRESSHARNESS_HPP_ */
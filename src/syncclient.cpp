@@ -0,0 +1,413 @@
+/*
+ * syncclient.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "syncclient.hpp"
+#include "facetindex.hpp"
+#include "revisionstore.hpp"
+#include "similarityindex.hpp"
+#include "textcounter.hpp"
+
+#include <QDataStream>
+#include <QHash>
+#include <QtSql/QtSql>
+
+// -----------------------------------------------------------------------------------------------
+// SyncMessage
+
+QByteArray SyncMessage::encode() const
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_8);
+
+    out << quint32(SYNC_PROTOCOL_VERSION) << quint8(type) << clientId << cursor << qint32(limit)
+        << more << error << qint32(changes.size());
+    for (int i = 0; i < changes.size(); ++i) {
+        const SyncChange &change = changes.at(i);
+        out << quint8(change.op) << change.syncId << change.updatedAt;
+        if (change.op != 'D') {
+            out << change.timeStamp << change.createdAt << change.textEvent << qint32(change.mood)
+                << change.tags << change.inlineTags;
+        }
+    }
+    return qCompress(data);
+}
+
+bool SyncMessage::decode(const QByteArray &bytes, SyncMessage &message)
+{
+    const QByteArray data = qUncompress(bytes);
+    if (data.isEmpty())
+        return false;
+
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_4_8);
+
+    quint32 version = 0;
+    quint8 type = 0;
+    qint32 limit = 0, count = 0;
+    in >> version;
+    if (version != SYNC_PROTOCOL_VERSION)
+        return false;
+    in >> type >> message.clientId >> message.cursor >> limit >> message.more >> message.error
+       >> count;
+    if (in.status() != QDataStream::Ok || count < 0)
+        return false;
+    message.type = char(type);
+    message.limit = limit;
+
+    message.changes.clear();
+    for (int i = 0; i < count; ++i) {
+        SyncChange change;
+        quint8 op = 0;
+        in >> op >> change.syncId >> change.updatedAt;
+        change.op = char(op);
+        if (change.op != 'D') {
+            qint32 mood = -1;
+            in >> change.timeStamp >> change.createdAt >> change.textEvent >> mood
+               >> change.tags >> change.inlineTags;
+            change.mood = mood;
+        }
+        if (in.status() != QDataStream::Ok)
+            return false;
+        message.changes << change;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------
+// SyncClient
+
+SyncClient::SyncClient(const QSqlDatabase &database)
+    : m_database(database)
+{
+}
+
+bool SyncClient::sync(SyncTransport *transport, SyncStats *stats)
+{
+    SyncStats ignored;
+    if (!stats)
+        stats = &ignored;
+    return push(transport, stats) && pull(transport, stats);
+}
+
+int SyncClient::pendingChanges()
+{
+    QSqlQuery query(m_database);
+    query.prepare("SELECT COUNT(*) FROM changes WHERE seq > :seq");
+    query.bindValue(":seq", state("pushedSeq", 0));
+    if (!query.exec() || !query.next())
+        return 0;
+    return query.value(0).toInt();
+}
+
+QString SyncClient::lastError() const
+{
+    return m_lastError;
+}
+
+QString SyncClient::clientId()
+{
+    QString id = state("clientId").toString();
+    if (id.isEmpty()) {
+        QSqlQuery query(m_database);
+        if (query.exec("SELECT lower(hex(randomblob(16)))") && query.next())
+            id = query.value(0).toString();
+        if (!setState("clientId", id))
+            return QString();
+    }
+    return id;
+}
+
+QVariant SyncClient::state(const QString &key, const QVariant &defaultValue)
+{
+    QSqlQuery query(m_database);
+    query.prepare("SELECT value FROM sync_state WHERE key = :key");
+    query.bindValue(":key", key);
+    if (query.exec() && query.next())
+        return query.value(0);
+    return defaultValue;
+}
+
+bool SyncClient::setState(const QString &key, const QVariant &value)
+{
+    QSqlQuery query(m_database);
+    query.prepare("INSERT OR REPLACE INTO sync_state (key, value) VALUES(:key, :value)");
+    query.bindValue(":key", key);
+    query.bindValue(":value", value);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool SyncClient::exchange(SyncTransport *transport, const SyncMessage &request, SyncMessage &reply,
+                          SyncStats *stats)
+{
+    const QByteArray bytes = request.encode();
+    QByteArray response;
+    ++stats->roundTrips;
+    stats->bytesSent += bytes.size();
+    if (!transport->roundTrip(bytes, response)) {
+        m_lastError = "The sync server did not answer";
+        return false;
+    }
+    stats->bytesReceived += response.size();
+
+    if (!SyncMessage::decode(response, reply)) {
+        m_lastError = "Unreadable reply from the sync server";
+        return false;
+    }
+    if (reply.type == SyncMessage::Failure) {
+        m_lastError = reply.error;
+        return false;
+    }
+    return true;
+}
+
+bool SyncClient::push(SyncTransport *transport, SyncStats *stats)
+{
+    const QString id = clientId();
+    if (id.isEmpty())
+        return false;
+
+    QSqlQuery select(m_database);
+    select.setForwardOnly(true);
+    select.prepare("SELECT seq, op, syncId, changedAt FROM changes "
+                   "WHERE seq > :seq ORDER BY seq LIMIT :limit");
+
+    for (;;) {
+        select.bindValue(":seq", state("pushedSeq", 0));
+        select.bindValue(":limit", SYNC_BATCH_CHANGES);
+        if (!select.exec()) {
+            m_lastError = select.lastError().text();
+            return false;
+        }
+
+        // The latest operation per entry, in the order the entries first changed.
+        QStringList order;
+        QHash<QString, SyncChange> latest;
+        qint64 lastSeq = -1;
+        while (select.next()) {
+            lastSeq = select.value(0).toLongLong();
+            const QString syncId = select.value(2).toString();
+            if (syncId.isEmpty())
+                continue;
+            if (!latest.contains(syncId))
+                order << syncId;
+            SyncChange &change = latest[syncId];
+            change.syncId = syncId;
+            change.op = select.value(1).toString().at(0).toLatin1();
+            change.updatedAt = select.value(3).toLongLong();
+        }
+        select.finish();
+        if (lastSeq < 0)
+            return true;
+
+        SyncMessage request;
+        request.type = SyncMessage::Push;
+        request.clientId = id;
+        for (int i = 0; i < order.size(); ++i) {
+            SyncChange change = latest.value(order.at(i));
+            // An entry deleted since it was logged goes out as a delete.
+            if (change.op != 'D' && !readEntry(change.syncId, change))
+                change.op = 'D';
+            request.changes << change;
+        }
+
+        SyncMessage reply;
+        if (!request.changes.isEmpty() && !exchange(transport, request, reply, stats))
+            return false;
+
+        m_database.transaction();
+        QSqlQuery prune(m_database);
+        prune.prepare("DELETE FROM changes WHERE seq <= :seq");
+        prune.bindValue(":seq", lastSeq);
+        if (!setState("pushedSeq", lastSeq) || !prune.exec() || !m_database.commit()) {
+            if (m_lastError.isEmpty())
+                m_lastError = m_database.lastError().text();
+            m_database.rollback();
+            return false;
+        }
+        stats->pushed += request.changes.size();
+    }
+}
+
+bool SyncClient::pull(SyncTransport *transport, SyncStats *stats)
+{
+    const QString id = clientId();
+    if (id.isEmpty())
+        return false;
+
+    SyncMessage reply;
+    do {
+        SyncMessage request;
+        request.type = SyncMessage::Pull;
+        request.clientId = id;
+        request.cursor = state("pullCursor", 0).toLongLong();
+        request.limit = SYNC_BATCH_CHANGES;
+        if (!exchange(transport, request, reply, stats))
+            return false;
+
+        // Applied with the change log triggers quiet, so nothing is echoed back.
+        m_database.transaction();
+        bool ok = setState("applying", 1);
+        for (int i = 0; ok && i < reply.changes.size(); ++i) {
+            bool applied = false;
+            ok = apply(reply.changes.at(i), &applied);
+            if (applied)
+                ++stats->applied;
+        }
+        QSqlQuery quiet(m_database);
+        ok = ok && quiet.exec("DELETE FROM sync_state WHERE key = 'applying'")
+                && setState("pullCursor", reply.cursor);
+        if (!ok || !m_database.commit()) {
+            if (m_lastError.isEmpty())
+                m_lastError = m_database.lastError().text();
+            m_database.rollback();
+            return false;
+        }
+        stats->pulled += reply.changes.size();
+    } while (reply.more);
+    return true;
+}
+
+bool SyncClient::readEntry(const QString &syncId, SyncChange &change)
+{
+    QSqlQuery query(m_database);
+    query.prepare("SELECT eventID, timeStamp, createdAt, textEvent, mood, updatedAt "
+                  "FROM events WHERE syncId = :syncId");
+    query.bindValue(":syncId", syncId);
+    if (!query.exec() || !query.next())
+        return false;
+
+    const qint64 eventId = query.value(0).toLongLong();
+    change.timeStamp = query.value(1).toString();
+    change.createdAt = query.value(2).toLongLong();
+    change.textEvent = query.value(3).toString();
+    change.mood = query.value(4).isNull() ? -1 : query.value(4).toInt();
+    change.updatedAt = query.value(5).toLongLong();
+
+    query.prepare("SELECT tag, inline FROM event_tags WHERE eventID = :eventID ORDER BY tag");
+    query.bindValue(":eventID", eventId);
+    if (!query.exec())
+        return false;
+    change.tags.clear();
+    change.inlineTags.clear();
+    while (query.next()) {
+        if (query.value(1).toInt())
+            change.inlineTags << query.value(0).toString();
+        else
+            change.tags << query.value(0).toString();
+    }
+    return true;
+}
+
+bool SyncClient::apply(const SyncChange &change, bool *applied)
+{
+    *applied = false;
+
+    QSqlQuery query(m_database);
+    query.prepare("SELECT eventID, updatedAt, textEvent, createdAt FROM events WHERE syncId = :syncId");
+    query.bindValue(":syncId", change.syncId);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+
+    qint64 eventId = -1;
+    QString localText;
+    qint64 localCreatedAt = 0;
+    if (query.next()) {
+        eventId = query.value(0).toLongLong();
+        const qint64 localUpdatedAt = query.value(1).toLongLong();
+        localText = query.value(2).toString();
+        localCreatedAt = query.value(3).toLongLong();
+
+        // Last write wins; a tie goes to the larger text, so every device
+        // settles on the same version whatever order changes arrive in.
+        const bool wins = change.updatedAt > localUpdatedAt
+                       || (change.updatedAt == localUpdatedAt
+                           && (change.op == 'D' || change.textEvent >= localText));
+        if (!wins)
+            return true;
+    } else if (change.op == 'D') {
+        return true;
+    }
+    query.finish();
+
+    bool ok = true;
+    if (change.op == 'D') {
+        // Into the trash, as a local delete; TrashStore::purge() removes it and
+        // its tags, signatures, revisions and attachments once it has expired.
+        query.prepare("UPDATE events SET deletedAt = coalesce(deletedAt, :deletedAt), "
+                      "                  updatedAt = :updatedAt "
+                      "WHERE eventID = :eventID");
+        query.bindValue(":deletedAt", change.updatedAt);
+        query.bindValue(":updatedAt", change.updatedAt);
+        query.bindValue(":eventID", eventId);
+        ok = query.exec();
+    } else if (eventId < 0) {
+        const TextCounts counts = TextCounter::count(change.textEvent);
+        query.prepare("INSERT INTO events (timeStamp, textEvent, createdAt, mood, syncId, updatedAt, "
+                      "                    words, characters) "
+                      "VALUES(:timeStamp, :textEvent, :createdAt, :mood, :syncId, :updatedAt, "
+                      "       :words, :characters)");
+        query.bindValue(":timeStamp", change.timeStamp);
+        query.bindValue(":textEvent", change.textEvent);
+        query.bindValue(":words", counts.words);
+        query.bindValue(":characters", counts.characters);
+        query.bindValue(":createdAt", change.createdAt);
+        query.bindValue(":mood", change.mood < 0 ? QVariant(QVariant::Int) : QVariant(change.mood));
+        query.bindValue(":syncId", change.syncId);
+        query.bindValue(":updatedAt", change.updatedAt);
+        ok = query.exec();
+        if (ok) {
+            eventId = query.lastInsertId().toLongLong();
+            ok = SimilarityIndex(m_database).addEvent(eventId, SimilarityIndex::signature(change.textEvent));
+        }
+    } else {
+        // The local text stays in the history, as for an edit made here
+        // (see SqliteStorage::updateRecord).
+        if (change.textEvent != localText) {
+            RevisionStore revisions(m_database);
+            if (!revisions.addRevision(eventId, localText, change.textEvent, localCreatedAt,
+                                       change.updatedAt)) {
+                m_lastError = revisions.lastError();
+                return false;
+            }
+        }
+
+        const TextCounts counts = TextCounter::count(change.textEvent);
+        // A newer version of an entry in the trash was restored on the other device.
+        query.prepare("UPDATE events SET textEvent = :textEvent, mood = :mood, updatedAt = :updatedAt, "
+                      "                  words = :words, characters = :characters, deletedAt = NULL "
+                      "WHERE eventID = :eventID");
+        query.bindValue(":textEvent", change.textEvent);
+        query.bindValue(":words", counts.words);
+        query.bindValue(":characters", counts.characters);
+        query.bindValue(":mood", change.mood < 0 ? QVariant(QVariant::Int) : QVariant(change.mood));
+        query.bindValue(":updatedAt", change.updatedAt);
+        query.bindValue(":eventID", eventId);
+        ok = query.exec();
+        if (ok && change.textEvent != localText) {
+            ok = SimilarityIndex(m_database).updateEvent(eventId,
+                                                         SimilarityIndex::signature(change.textEvent));
+        }
+    }
+
+    if (ok && change.op != 'D') {
+        ok = FacetIndex::writeTags(m_database, eventId, change.inlineTags, true, &m_lastError)
+          && FacetIndex::writeTags(m_database, eventId, change.tags, false, &m_lastError);
+    }
+    if (!ok) {
+        if (m_lastError.isEmpty())
+            m_lastError = query.lastError().text();
+        return false;
+    }
+    *applied = true;
+    return true;
+}
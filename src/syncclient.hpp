@@ -0,0 +1,135 @@
+/*
+ * syncclient.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef SYNCCLIENT_HPP_
+#define SYNCCLIENT_HPP_
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QtSql/QSqlDatabase>
+
+#define SYNC_PROTOCOL_VERSION 1
+#define SYNC_BATCH_CHANGES 200
+
+/*
+ * One change as it travels between devices. Entries are identified by their
+ * syncId, since eventIDs are local to a database.
+ */
+struct SyncChange
+{
+    SyncChange() : op('U'), updatedAt(0), createdAt(0), mood(-1) {}
+
+    char op;              // 'I', 'U' or 'D'
+    QString syncId;
+    qint64 updatedAt;     // seconds since the epoch; the last write wins
+    QString timeStamp;
+    qint64 createdAt;
+    QString textEvent;
+    int mood;             // -1 for none
+    QStringList tags;
+    QStringList inlineTags;
+};
+
+/*
+ * A request or a response. Sent as a qCompress()ed QDataStream.
+ *
+ *  push   client -> server: 'changes'; the reply's 'cursor' is the server's
+ *         position after them
+ *  pull   client -> server: 'cursor' and 'limit'; the reply holds the changes
+ *         made by other clients after 'cursor', the cursor to continue from
+ *         and whether there are more
+ */
+struct SyncMessage
+{
+    enum Type { Push = 'P', Pull = 'F', Reply = 'R', Failure = 'X' };
+
+    SyncMessage() : type(Reply), cursor(0), limit(0), more(false) {}
+
+    QByteArray encode() const;
+    static bool decode(const QByteArray &bytes, SyncMessage &message);
+
+    char type;
+    QString clientId;
+    qint64 cursor;
+    int limit;
+    bool more;
+    QList<SyncChange> changes;
+    QString error;
+};
+
+/*
+ * @brief Carries encoded SyncMessages to a sync server and back.
+ */
+class SyncTransport
+{
+public:
+    virtual ~SyncTransport() {}
+
+    virtual bool roundTrip(const QByteArray &request, QByteArray &response) = 0;
+};
+
+struct SyncStats
+{
+    SyncStats() : pushed(0), pulled(0), applied(0), roundTrips(0), bytesSent(0), bytesReceived(0) {}
+
+    int pushed;           // local changes sent
+    int pulled;           // remote changes received
+    int applied;          // remote changes that won over the local entry
+    int roundTrips;
+    qint64 bytesSent;
+    qint64 bytesReceived;
+};
+
+/*
+ * @brief Sends the local change log to a sync server and applies remote changes.
+ *
+ * Every insert, update or delete of an entry (or of its tags) is appended to
+ * the changes table by triggers, in the same transaction, under a monotonic
+ * sequence number. sync() pushes the log after the last acknowledged
+ * sequence number in batches of SYNC_BATCH_CHANGES (an entry changed several
+ * times in a batch is sent once, as it is now), then pulls the changes of
+ * other devices after its server cursor. Both cursors live in sync_state, so
+ * what a sync costs depends on what changed since the last one, not on the
+ * size of the journal. Acknowledged log entries are deleted.
+ *
+ * Remote changes are applied idempotently: the newer updatedAt wins, ties
+ * are broken on the text, and applying a change twice leaves the same entry.
+ * A remote delete moves the entry to the trash, and a newer remote version
+ * of an entry in the trash restores it.
+ */
+class SyncClient
+{
+public:
+    SyncClient(const QSqlDatabase &database);
+
+    bool sync(SyncTransport *transport, SyncStats *stats = 0);
+
+    // Local changes not yet acknowledged by the server.
+    int pendingChanges();
+
+    QString lastError() const;
+
+private:
+    QString clientId();
+    QVariant state(const QString &key, const QVariant &defaultValue = QVariant());
+    bool setState(const QString &key, const QVariant &value);
+
+    bool exchange(SyncTransport *transport, const SyncMessage &request, SyncMessage &reply,
+                  SyncStats *stats);
+    bool push(SyncTransport *transport, SyncStats *stats);
+    bool pull(SyncTransport *transport, SyncStats *stats);
+    bool readEntry(const QString &syncId, SyncChange &change);
+    bool apply(const SyncChange &change, bool *applied);
+
+    QSqlDatabase m_database;
+    QString m_lastError;
+};
+
+#endif /* SYNCCLIENT_HPP_ */
@@ -0,0 +1,110 @@
+/*
+ * syncserver.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "syncserver.hpp"
+
+#include <QMutexLocker>
+
+// -----------------------------------------------------------------------------------------------
+// SyncServer
+
+SyncServer::SyncServer()
+{
+}
+
+QByteArray SyncServer::handle(const QByteArray &request)
+{
+    SyncMessage message;
+    SyncMessage reply;
+    if (!SyncMessage::decode(request, message) || message.clientId.isEmpty()) {
+        reply.type = SyncMessage::Failure;
+        reply.error = "Malformed sync request";
+    } else if (message.type == SyncMessage::Push) {
+        reply = push(message);
+    } else if (message.type == SyncMessage::Pull) {
+        reply = pull(message);
+    } else {
+        reply.type = SyncMessage::Failure;
+        reply.error = "Unknown sync request";
+    }
+    return reply.encode();
+}
+
+int SyncServer::logSize() const
+{
+    QMutexLocker locker(&m_lock);
+    return m_log.size();
+}
+
+SyncMessage SyncServer::push(const SyncMessage &request)
+{
+    QMutexLocker locker(&m_lock);
+    for (int i = 0; i < request.changes.size(); ++i) {
+        LoggedChange logged;
+        logged.clientId = request.clientId;
+        logged.change = request.changes.at(i);
+        m_latest.insert(logged.change.syncId, m_log.size());
+        m_log << logged;
+    }
+
+    SyncMessage reply;
+    reply.cursor = m_log.size();
+    return reply;
+}
+
+SyncMessage SyncServer::pull(const SyncMessage &request)
+{
+    QMutexLocker locker(&m_lock);
+    SyncMessage reply;
+
+    int position = int(qBound<qint64>(0, request.cursor, m_log.size()));
+    const int limit = request.limit > 0 ? request.limit : SYNC_BATCH_CHANGES;
+    for (; position < m_log.size() && reply.changes.size() < limit; ++position) {
+        const LoggedChange &logged = m_log.at(position);
+        if (logged.clientId == request.clientId
+            || m_latest.value(logged.change.syncId) != position)
+            continue;
+        reply.changes << logged.change;
+    }
+    reply.cursor = position;
+    reply.more = position < m_log.size();
+    return reply;
+}
+
+// -----------------------------------------------------------------------------------------------
+// LoopbackTransport
+
+LoopbackTransport::LoopbackTransport(SyncServer *server)
+    : m_server(server)
+    , m_roundTrips(0)
+    , m_bytesSent(0)
+    , m_bytesReceived(0)
+{
+}
+
+bool LoopbackTransport::roundTrip(const QByteArray &request, QByteArray &response)
+{
+    response = m_server->handle(request);
+    ++m_roundTrips;
+    m_bytesSent += request.size();
+    m_bytesReceived += response.size();
+    return !response.isEmpty();
+}
+
+int LoopbackTransport::roundTrips() const
+{
+    return m_roundTrips;
+}
+
+qint64 LoopbackTransport::bytesSent() const
+{
+    return m_bytesSent;
+}
+
+qint64 LoopbackTransport::bytesReceived() const
+{
+    return m_bytesReceived;
+}
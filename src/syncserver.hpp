@@ -0,0 +1,75 @@
+/*
+ * syncserver.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef SYNCSERVER_HPP_
+#define SYNCSERVER_HPP_
+
+#include "syncclient.hpp"
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+
+/*
+ * @brief In-process stand-in for the sync server.
+ *
+ * Speaks the same encoded SyncMessages a remote server would, so SyncClient
+ * can be exercised end to end without a network. Changes are kept in one
+ * log in arrival order; the cursor handed to clients is a position in it.
+ * A change that a later change to the same entry supersedes is skipped when
+ * pulling, and clients never get their own changes back.
+ */
+class SyncServer
+{
+public:
+    SyncServer();
+
+    // Thread-safe.
+    QByteArray handle(const QByteArray &request);
+
+    int logSize() const;
+
+private:
+    struct LoggedChange
+    {
+        QString clientId;
+        SyncChange change;
+    };
+
+    SyncMessage push(const SyncMessage &request);
+    SyncMessage pull(const SyncMessage &request);
+
+    mutable QMutex m_lock;
+    QList<LoggedChange> m_log;
+    QHash<QString, int> m_latest;     // syncId -> position of its latest change
+};
+
+/*
+ * @brief SyncTransport that hands requests straight to a SyncServer.
+ *
+ * Counts what went over the "wire", so tests and diagnostics can check that a
+ * sync costs what changed and not what is stored.
+ */
+class LoopbackTransport : public SyncTransport
+{
+public:
+    LoopbackTransport(SyncServer *server);
+
+    virtual bool roundTrip(const QByteArray &request, QByteArray &response);
+
+    int roundTrips() const;
+    qint64 bytesSent() const;
+    qint64 bytesReceived() const;
+
+private:
+    SyncServer *m_server;
+    int m_roundTrips;
+    qint64 m_bytesSent;
+    qint64 m_bytesReceived;
+};
+
+#endif /* SYNCSERVER_HPP_ */
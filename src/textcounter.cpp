@@ -0,0 +1,166 @@
+/*
+ * textcounter.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "textcounter.hpp"
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TEXTCOUNTER_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define TEXTCOUNTER_SSE2
+#endif
+
+static inline bool inRange(ushort c, ushort first, ushort last)
+{
+    return ushort(c - first) <= ushort(last - first);
+}
+
+static inline bool isSpace(ushort c)
+{
+    return c == 0x20 || inRange(c, 0x09, 0x0d) || c == 0x85 || c == 0xa0 || c == 0x1680
+        || inRange(c, 0x2000, 0x200a) || c == 0x2028 || c == 0x2029 || c == 0x202f
+        || c == 0x205f || c == 0x3000;
+}
+
+// Units that do not start a character of their own.
+static inline bool isExtend(ushort c)
+{
+    return inRange(c, 0xdc00, 0xdfff) || inRange(c, 0x0300, 0x036f) || inRange(c, 0x1ab0, 0x1aff)
+        || inRange(c, 0x1dc0, 0x1dff) || inRange(c, 0x20d0, 0x20ff) || inRange(c, 0xfe00, 0xfe2f)
+        || c == 0x200d;
+}
+
+// 'afterSpace' carries whether the unit before 'units' was whitespace.
+static void countUnits(const ushort *units, int length, bool &afterSpace, TextCounts &counts)
+{
+    for (int i = 0; i < length; ++i) {
+        const bool space = isSpace(units[i]);
+        if (!space && afterSpace)
+            ++counts.words;
+        if (!isExtend(units[i]))
+            ++counts.characters;
+        afterSpace = space;
+    }
+}
+
+TextCounts TextCounter::countScalar(const QString &text)
+{
+    TextCounts counts;
+    bool afterSpace = true;
+    countUnits(text.utf16(), text.size(), afterSpace, counts);
+    return counts;
+}
+
+#if defined(TEXTCOUNTER_SSE2)
+
+// No unsigned 16-bit compare in SSE2: c - first <= span  <=>  saturated (c - first) - span == 0.
+static inline __m128i rangeMask(__m128i v, ushort first, ushort last)
+{
+    const __m128i offset = _mm_sub_epi16(v, _mm_set1_epi16(short(first)));
+    return _mm_cmpeq_epi16(_mm_subs_epu16(offset, _mm_set1_epi16(short(last - first))),
+                           _mm_setzero_si128());
+}
+
+static inline __m128i equalMask(__m128i v, ushort c)
+{
+    return _mm_cmpeq_epi16(v, _mm_set1_epi16(short(c)));
+}
+
+// One bit per unit.
+static inline unsigned bitMask(__m128i lanes)
+{
+    return unsigned(_mm_movemask_epi8(_mm_packs_epi16(lanes, _mm_setzero_si128()))) & 0xff;
+}
+
+static inline void classify(const ushort *p, unsigned &space, unsigned &extend)
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i s = _mm_or_si128(equalMask(v, 0x20), rangeMask(v, 0x09, 0x0d));
+    s = _mm_or_si128(s, _mm_or_si128(equalMask(v, 0x85), equalMask(v, 0xa0)));
+    s = _mm_or_si128(s, _mm_or_si128(equalMask(v, 0x1680), rangeMask(v, 0x2000, 0x200a)));
+    s = _mm_or_si128(s, _mm_or_si128(rangeMask(v, 0x2028, 0x2029), equalMask(v, 0x202f)));
+    s = _mm_or_si128(s, _mm_or_si128(equalMask(v, 0x205f), equalMask(v, 0x3000)));
+
+    __m128i e = _mm_or_si128(rangeMask(v, 0xdc00, 0xdfff), rangeMask(v, 0x0300, 0x036f));
+    e = _mm_or_si128(e, _mm_or_si128(rangeMask(v, 0x1ab0, 0x1aff), rangeMask(v, 0x1dc0, 0x1dff)));
+    e = _mm_or_si128(e, _mm_or_si128(rangeMask(v, 0x20d0, 0x20ff), rangeMask(v, 0xfe00, 0xfe2f)));
+    e = _mm_or_si128(e, equalMask(v, 0x200d));
+
+    space = bitMask(s);
+    extend = bitMask(e);
+}
+
+#elif defined(TEXTCOUNTER_NEON)
+
+static inline uint16x8_t rangeMask(uint16x8_t v, ushort first, ushort last)
+{
+    return vcleq_u16(vsubq_u16(v, vdupq_n_u16(first)), vdupq_n_u16(ushort(last - first)));
+}
+
+static inline uint16x8_t equalMask(uint16x8_t v, ushort c)
+{
+    return vceqq_u16(v, vdupq_n_u16(c));
+}
+
+// One bit per unit: keep bit i in lane i, then add the lanes up.
+static inline unsigned bitMask(uint16x8_t lanes)
+{
+    static const ushort bits[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint16x8_t masked = vandq_u16(lanes, vld1q_u16(bits));
+    uint16x4_t sum = vadd_u16(vget_low_u16(masked), vget_high_u16(masked));
+    sum = vpadd_u16(sum, sum);
+    sum = vpadd_u16(sum, sum);
+    return vget_lane_u16(sum, 0);
+}
+
+static inline void classify(const ushort *p, unsigned &space, unsigned &extend)
+{
+    const uint16x8_t v = vld1q_u16(p);
+    uint16x8_t s = vorrq_u16(equalMask(v, 0x20), rangeMask(v, 0x09, 0x0d));
+    s = vorrq_u16(s, vorrq_u16(equalMask(v, 0x85), equalMask(v, 0xa0)));
+    s = vorrq_u16(s, vorrq_u16(equalMask(v, 0x1680), rangeMask(v, 0x2000, 0x200a)));
+    s = vorrq_u16(s, vorrq_u16(rangeMask(v, 0x2028, 0x2029), equalMask(v, 0x202f)));
+    s = vorrq_u16(s, vorrq_u16(equalMask(v, 0x205f), equalMask(v, 0x3000)));
+
+    uint16x8_t e = vorrq_u16(rangeMask(v, 0xdc00, 0xdfff), rangeMask(v, 0x0300, 0x036f));
+    e = vorrq_u16(e, vorrq_u16(rangeMask(v, 0x1ab0, 0x1aff), rangeMask(v, 0x1dc0, 0x1dff)));
+    e = vorrq_u16(e, vorrq_u16(rangeMask(v, 0x20d0, 0x20ff), rangeMask(v, 0xfe00, 0xfe2f)));
+    e = vorrq_u16(e, equalMask(v, 0x200d));
+
+    space = bitMask(s);
+    extend = bitMask(e);
+}
+
+#endif
+
+TextCounts TextCounter::count(const QString &text)
+{
+#if defined(TEXTCOUNTER_SSE2) || defined(TEXTCOUNTER_NEON)
+    TextCounts counts;
+    const ushort *units = text.utf16();
+    const int length = text.size();
+
+    // Bit i of 'space' is unit i of the block; a word starts at every
+    // non-space unit whose predecessor is a space.
+    unsigned previous = 1;
+    int i = 0;
+    for (; i + 8 <= length; i += 8) {
+        unsigned space, extend;
+        classify(units + i, space, extend);
+        const unsigned starts = ~space & ((space << 1) | previous) & 0xff;
+        counts.words += __builtin_popcount(starts);
+        counts.characters += 8 - __builtin_popcount(extend);
+        previous = space >> 7;
+    }
+
+    bool afterSpace = previous != 0;
+    countUnits(units + i, length - i, afterSpace, counts);
+    return counts;
+#else
+    return countScalar(text);
+#endif
+}
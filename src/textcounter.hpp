@@ -0,0 +1,40 @@
+/*
+ * textcounter.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef TEXTCOUNTER_HPP_
+#define TEXTCOUNTER_HPP_
+
+#include <QString>
+
+struct TextCounts
+{
+    TextCounts() : words(0), characters(0) {}
+
+    int words;
+    int characters;
+};
+
+/*
+ * @brief Counts the words and characters of an entry.
+ *
+ * A word is a run of anything but whitespace (the Unicode White_Space
+ * characters of the BMP). Characters approximate what the user sees: UTF-16
+ * units minus the second half of surrogate pairs, combining marks, variation
+ * selectors and zero-width joiners.
+ *
+ * count() works on 8 units at a time with NEON or SSE2 when the build
+ * targets them and falls back to countScalar() otherwise; both give the
+ * same result.
+ */
+class TextCounter
+{
+public:
+    static TextCounts count(const QString &text);
+    static TextCounts countScalar(const QString &text);
+};
+
+#endif /* TEXTCOUNTER_HPP_ */
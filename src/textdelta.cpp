@@ -0,0 +1,160 @@
+/*
+ * textdelta.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "textdelta.hpp"
+
+#include <QHash>
+
+#include <string.h>
+
+#define DELTA_BLOCK 8
+#define DELTA_PRIME 16777619u
+
+static void putVarint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80) {
+        out += char((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+static bool getVarint(const uchar *&p, const uchar *end, quint64 &value)
+{
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        const uchar byte = *p++;
+        value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static void emitCopy(QByteArray &out, int offset, int length)
+{
+    if (length <= 0)
+        return;
+    putVarint(out, quint64(length) << 1);
+    putVarint(out, offset);
+}
+
+static void emitInsert(QByteArray &out, const char *data, int length)
+{
+    if (length <= 0)
+        return;
+    putVarint(out, (quint64(length) << 1) | 1);
+    out.append(data, length);
+}
+
+static quint32 blockHash(const char *p)
+{
+    quint32 h = 0;
+    for (int i = 0; i < DELTA_BLOCK; ++i)
+        h = h * DELTA_PRIME + uchar(p[i]);
+    return h;
+}
+
+QByteArray TextDelta::encode(const QByteArray &base, const QByteArray &target)
+{
+    const char *b = base.constData();
+    const char *t = target.constData();
+    const int baseSize = base.size();
+    const int targetSize = target.size();
+
+    QByteArray out;
+    putVarint(out, targetSize);
+
+    // Most edits touch one place; strip the common head and tail first.
+    const int shorter = qMin(baseSize, targetSize);
+    int prefix = 0;
+    while (prefix < shorter && b[prefix] == t[prefix])
+        ++prefix;
+    int suffix = 0;
+    while (suffix < shorter - prefix && b[baseSize - 1 - suffix] == t[targetSize - 1 - suffix])
+        ++suffix;
+
+    emitCopy(out, 0, prefix);
+
+    const int baseEnd = baseSize - suffix;
+    const int targetEnd = targetSize - suffix;
+
+    QHash<quint32, int> index;
+    for (int i = prefix; i + DELTA_BLOCK <= baseEnd; i += DELTA_BLOCK)
+        index.insert(blockHash(b + i), i);
+
+    quint32 power = 1;
+    for (int i = 1; i < DELTA_BLOCK; ++i)
+        power *= DELTA_PRIME;
+
+    int pending = prefix;
+    int pos = prefix;
+    if (!index.isEmpty() && targetEnd - pos >= DELTA_BLOCK) {
+        quint32 h = blockHash(t + pos);
+        while (pos + DELTA_BLOCK <= targetEnd) {
+            QHash<quint32, int>::const_iterator it = index.constFind(h);
+            if (it != index.constEnd() && memcmp(b + it.value(), t + pos, DELTA_BLOCK) == 0) {
+                int from = it.value();
+                int to = pos;
+                while (to > pending && from > 0 && b[from - 1] == t[to - 1]) {
+                    --from;
+                    --to;
+                }
+                int length = pos + DELTA_BLOCK - to;
+                while (to + length < targetEnd && from + length < baseSize
+                       && b[from + length] == t[to + length])
+                    ++length;
+
+                emitInsert(out, t + pending, to - pending);
+                emitCopy(out, from, length);
+                pos = pending = to + length;
+                if (pos + DELTA_BLOCK <= targetEnd)
+                    h = blockHash(t + pos);
+                continue;
+            }
+
+            if (pos + DELTA_BLOCK < targetEnd)
+                h = (h - uchar(t[pos]) * power) * DELTA_PRIME + uchar(t[pos + DELTA_BLOCK]);
+            ++pos;
+        }
+    }
+
+    emitInsert(out, t + pending, targetEnd - pending);
+    emitCopy(out, baseEnd, suffix);
+    return out;
+}
+
+bool TextDelta::apply(const QByteArray &base, const QByteArray &delta, QByteArray &target)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(delta.constData());
+    const uchar *end = p + delta.size();
+
+    quint64 size = 0;
+    if (!getVarint(p, end, size))
+        return false;
+
+    target.clear();
+    target.reserve(size);
+    while (p < end) {
+        quint64 op = 0;
+        if (!getVarint(p, end, op))
+            return false;
+        const quint64 length = op >> 1;
+
+        if (op & 1) {
+            if (length > quint64(end - p))
+                return false;
+            target.append(reinterpret_cast<const char *>(p), length);
+            p += length;
+        } else {
+            quint64 offset = 0;
+            if (!getVarint(p, end, offset) || offset + length > quint64(base.size()))
+                return false;
+            target.append(base.constData() + offset, length);
+        }
+    }
+    return quint64(target.size()) == size;
+}
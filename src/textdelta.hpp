@@ -0,0 +1,31 @@
+/*
+ * textdelta.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef TEXTDELTA_HPP_
+#define TEXTDELTA_HPP_
+
+#include <QByteArray>
+
+/*
+ * @brief Compact binary diff between two versions of a text.
+ *
+ * A delta is the target length followed by a list of operations, all
+ * integers as unsigned LEB128 varints:
+ *
+ *   (length << 1) | 0, offset   copy 'length' bytes of the base from 'offset'
+ *   (length << 1) | 1, bytes    insert the next 'length' bytes of the delta
+ *
+ * Matching uses a rolling hash over DELTA_BLOCK-byte windows of the base, so
+ * the size of a delta grows with the size of the edit, not of the text.
+ */
+namespace TextDelta
+{
+    QByteArray encode(const QByteArray &base, const QByteArray &target);
+    bool apply(const QByteArray &base, const QByteArray &delta, QByteArray &target);
+}
+
+#endif /* TEXTDELTA_HPP_ */
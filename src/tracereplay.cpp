@@ -0,0 +1,178 @@
+/*
+ * tracereplay.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "tracereplay.hpp"
+#include "EventData.hpp"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QtAlgorithms>
+
+#include <unistd.h>
+
+static qint64 percentile(const QVector<qint64> &sorted, int percent)
+{
+    if (sorted.isEmpty())
+        return 0;
+    return sorted.at(qMin(sorted.size() - 1, sorted.size() * percent / 100));
+}
+
+static bool traceStartedBefore(const TraceRecord &a, const TraceRecord &b)
+{
+    return a.startUs < b.startUs;
+}
+
+// The arguments a replayed record needs, see TraceKind; -1 where it is not replayed.
+static const int REPLAY_ARGS[TraceKindCount] = {
+    0, 1, 1, 2, 3, 3, 3, -1, -1, 0, -1, -1, -1, -1, -1, -1
+};
+
+static StorageBackend::Durability durability(qint64 value)
+{
+    return StorageBackend::Durability(qBound<qint64>(StorageBackend::Buffered, value, StorageBackend::Synced));
+}
+
+static quint32 nextRandom(quint32 &state)
+{
+    // xorshift32; the text only has to look like text to the storage.
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+TraceReplay::TraceReplay(StorageBackend *backend)
+    : m_backend(backend)
+    , m_random(1)
+{
+}
+
+ReplayReport TraceReplay::run(const QString &fileName, Speed speed)
+{
+    ReplayReport report;
+    QVector<TraceRecord> records;
+    if (!QueryTrace::load(fileName, records, &report.error))
+        return report;
+
+    // Records are appended when operations end; replay them in the order they started.
+    qStableSort(records.begin(), records.end(), traceStartedBefore);
+
+    m_ids.clear();
+    m_random = 1;
+    QVector<qint64> latencies[TraceKindCount];
+    QVector<qint64> recorded[TraceKindCount];
+
+    QElapsedTimer clock;
+    clock.start();
+    const qint64 firstUs = records.isEmpty() ? 0 : records.first().startUs;
+    for (int i = 0; i < records.size(); ++i) {
+        const TraceRecord &record = records.at(i);
+        if (speed == Recorded) {
+            const qint64 lateUs = clock.nsecsElapsed() / 1000 - (record.startUs - firstUs);
+            if (lateUs < 0) {
+                usleep(useconds_t(-lateUs));
+            } else {
+                report.lagMs = qMax(report.lagMs, lateUs / 1000);
+            }
+        }
+
+        ReplayStats &stats = report.kinds[record.kind];
+        recorded[record.kind] << record.durationUs;
+        ++report.records;
+
+        QElapsedTimer timer;
+        timer.start();
+        bool ok = true;
+        if (!replay(record, ok)) {
+            ++report.skipped;
+            continue;
+        }
+        latencies[record.kind] << timer.nsecsElapsed() / 1000;
+        ++stats.operations;
+        if (!ok)
+            ++stats.errors;
+    }
+    m_backend->flush();
+    report.elapsedMs = clock.elapsed();
+
+    for (int kind = 0; kind < TraceKindCount; ++kind) {
+        ReplayStats &stats = report.kinds[kind];
+        qSort(latencies[kind]);
+        qSort(recorded[kind]);
+        stats.p50Us = percentile(latencies[kind], 50);
+        stats.p90Us = percentile(latencies[kind], 90);
+        stats.p99Us = percentile(latencies[kind], 99);
+        stats.maxUs = latencies[kind].isEmpty() ? 0 : latencies[kind].last();
+        stats.recordedP50Us = percentile(recorded[kind], 50);
+        stats.recordedP99Us = percentile(recorded[kind], 99);
+    }
+    return report;
+}
+
+bool TraceReplay::replay(const TraceRecord &record, bool &ok)
+{
+    const int needed = REPLAY_ARGS[record.kind];
+    if (needed < 0 || record.argCount < needed)
+        return false;
+
+    const qint64 *args = record.args;
+    EventRecord event;
+    switch (record.kind) {
+    case TraceCount:
+        ok = m_backend->count() >= 0;
+        break;
+    case TraceEvent:
+        ok = m_backend->event(int(args[0]), event);
+        break;
+    case TraceEventById:
+        ok = m_backend->eventById(mappedId(args[0]), event);
+        break;
+    case TraceRange:
+        m_backend->range(int(args[0]), int(args[1]));
+        break;
+    case TraceSearch:
+        m_backend->search(args[0], args[1], filler(int(qBound<qint64>(1, args[2], 32))).trimmed());
+        break;
+    case TraceAdd: {
+        const qint64 eventId = m_backend->addRecord(QDateTime::currentDateTime().toString(),
+                                                    filler(int(args[0])), durability(args[1]));
+        ok = eventId >= 0;
+        if (ok && args[2] >= 0)
+            m_ids.insert(args[2], eventId);
+        break;
+    }
+    case TraceEdit:
+        ok = m_backend->updateRecord(mappedId(args[0]), filler(int(args[1])), durability(args[2]));
+        break;
+    case TraceFlush:
+        ok = m_backend->flush();
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+qint64 TraceReplay::mappedId(qint64 eventId) const
+{
+    return m_ids.value(eventId, eventId);
+}
+
+QString TraceReplay::filler(int length)
+{
+    // Words of 2 to 9 letters, so the text compresses and indexes about like an entry.
+    QString text;
+    text.reserve(qMax(0, length));
+    while (text.size() < length) {
+        const int word = 2 + int(nextRandom(m_random) % 8);
+        for (int i = 0; i < word && text.size() < length; ++i)
+            text += QChar('a' + nextRandom(m_random) % 26);
+        if (text.size() < length)
+            text += ' ';
+    }
+    return text;
+}
@@ -0,0 +1,86 @@
+/*
+ * tracereplay.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef TRACEREPLAY_HPP_
+#define TRACEREPLAY_HPP_
+
+#include "querytrace.hpp"
+#include "storagebackend.hpp"
+
+#include <QHash>
+#include <QString>
+
+struct ReplayStats
+{
+    ReplayStats()
+        : operations(0), errors(0), p50Us(0), p90Us(0), p99Us(0), maxUs(0)
+        , recordedP50Us(0), recordedP99Us(0) {}
+
+    int operations;
+    int errors;
+    qint64 p50Us;
+    qint64 p90Us;
+    qint64 p99Us;
+    qint64 maxUs;
+    qint64 recordedP50Us;   // as the operations took in the traced session
+    qint64 recordedP99Us;
+};
+
+struct ReplayReport
+{
+    ReplayReport() : records(0), skipped(0), elapsedMs(0), lagMs(0) {}
+
+    ReplayStats kinds[TraceKindCount];
+    int records;
+    int skipped;            // records of operations a StorageBackend has no counterpart for
+    qint64 elapsedMs;
+    qint64 lagMs;           // at recorded speed, how far the replay fell behind the trace at most
+    QString error;
+};
+
+/*
+ * @brief Replays a QueryTrace against a StorageBackend and measures it.
+ *
+ * The operations are run in the order they started, on the calling thread,
+ * either as fast as they can go or at the pace they were recorded. Entries
+ * get filler text of the recorded length. Searches look for a word of the
+ * recorded length. Entries added by the trace are mapped to the eventIDs
+ * they get in the backend, so later edits of them hit the right rows.
+ *
+ * Operations that only exist above the backend are skipped but still appear
+ * under their own kind with their recorded latencies:
+ *   - deletes
+ *   - tags
+ *   - the row index
+ *   - the list model's cache
+ *
+ * Point the backend at a copy of the journal the trace was taken on, or a
+ * seeded one of similar size. Compare the latency of each kind with the
+ * recorded one, or with other backends and configurations.
+ */
+class TraceReplay
+{
+public:
+    enum Speed { Recorded, Maximum };
+
+    // Does not take ownership of 'backend', which must be open.
+    TraceReplay(StorageBackend *backend);
+
+    ReplayReport run(const QString &fileName, Speed speed);
+
+private:
+    // False if the backend has no counterpart for the record.
+    bool replay(const TraceRecord &record, bool &ok);
+    qint64 mappedId(qint64 eventId) const;
+    QString filler(int length);
+
+    StorageBackend *m_backend;
+    QHash<qint64, qint64> m_ids;    // eventIDs of the trace to those in the backend
+    quint32 m_random;
+};
+
+#endif /* TRACEREPLAY_HPP_ */
@@ -0,0 +1,166 @@
+/*
+ * trashstore.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "trashstore.hpp"
+#include "journalqueries.hpp"
+
+#include <QFile>
+#include <QStringList>
+#include <QtSql/QtSql>
+
+#define TRASH_RETENTION_DAYS 30
+
+TrashStore::TrashStore(const QSqlDatabase &database)
+    : m_database(database)
+{
+}
+
+QString TrashStore::lastError() const
+{
+    return m_lastError;
+}
+
+qint64 TrashStore::expiryCutoff(qint64 now)
+{
+    return now - qint64(TRASH_RETENTION_DAYS) * 24 * 3600;
+}
+
+bool TrashStore::trash(qint64 eventId, qint64 deletedAt)
+{
+    TypedQuery<TrashEvent> query;
+    if (!query.prepare(sqliteHandle(m_database)) || !query.exec(deletedAt, eventId)) {
+        m_lastError = query.lastError();
+        return false;
+    }
+    if (query.changes() == 0) {
+        m_lastError = QString("No entry %1 outside the trash").arg(eventId);
+        return false;
+    }
+    return true;
+}
+
+bool TrashStore::restore(qint64 eventId)
+{
+    TypedQuery<RestoreEvent> query;
+    if (!query.prepare(sqliteHandle(m_database)) || !query.exec(eventId)) {
+        m_lastError = query.lastError();
+        return false;
+    }
+    if (query.changes() == 0) {
+        m_lastError = QString("No entry %1 in the trash").arg(eventId);
+        return false;
+    }
+    return true;
+}
+
+QList<TrashedEntry> TrashStore::entries()
+{
+    QList<TrashedEntry> list;
+
+    TypedQuery<TrashedEvents> query;
+    if (!query.prepare(sqliteHandle(m_database)) || !query.exec()) {
+        m_lastError = query.lastError();
+        return list;
+    }
+
+    TrashedEvents::Row row;
+    while (query.next(row)) {
+        TrashedEntry entry;
+        entry.record.eventId = row.first;
+        entry.record.createdAt = row.second;
+        entry.record.timeStamp = row.third;
+        entry.record.textEvent = row.fourth;
+        entry.deletedAt = row.fifth;
+        list << entry;
+    }
+    return list;
+}
+
+bool TrashStore::hasExpired(qint64 cutoff)
+{
+    QSqlQuery query(m_database);
+    query.prepare("SELECT 1 FROM events WHERE deletedAt <= :cutoff LIMIT 1");
+    query.bindValue(":cutoff", cutoff);
+    if (!query.exec()) {
+        m_lastError = query.lastError().text();
+        return false;
+    }
+    return query.next();
+}
+
+int TrashStore::purge(qint64 cutoff, int batchSize)
+{
+    // 1. The batch is the eventID range of the next 'batchSize' expired entries.
+    QSqlQuery query(m_database);
+    query.prepare("SELECT MIN(eventID), MAX(eventID), COUNT(*) FROM "
+                  "    (SELECT eventID FROM events WHERE deletedAt <= :cutoff "
+                  "     ORDER BY eventID LIMIT :limit)");
+    query.bindValue(":cutoff", cutoff);
+    query.bindValue(":limit", batchSize);
+    if (!query.exec() || !query.next()) {
+        m_lastError = query.lastError().text();
+        return -1;
+    }
+    const qint64 first = query.value(0).toLongLong();
+    const qint64 last = query.value(1).toLongLong();
+    const int count = query.value(2).toInt();
+    query.finish();
+    if (count == 0)
+        return 0;
+
+    // 2. The entries go first: the change log triggers on event_tags then find
+    //    no entry to log an edit for. The rows that referred to them are whatever
+    //    in the range no longer has an entry.
+    m_database.transaction();
+    query.prepare("DELETE FROM events WHERE eventID BETWEEN :first AND :last AND deletedAt <= :cutoff");
+    query.bindValue(":first", first);
+    query.bindValue(":last", last);
+    query.bindValue(":cutoff", cutoff);
+    bool ok = query.exec();
+
+    // 3. The voice notes of the batch are the app's own files; they go once the
+    //    rows are gone for good. Imported attachments point at the user's
+    //    files and stay.
+    QStringList voiceNotes;
+    if (ok) {
+        query.prepare("SELECT path FROM attachments WHERE kind = 'voice' "
+                      "AND eventID BETWEEN :first AND :last "
+                      "AND eventID NOT IN (SELECT eventID FROM events "
+                      "                    WHERE eventID BETWEEN :first2 AND :last2)");
+        query.bindValue(":first", first);
+        query.bindValue(":last", last);
+        query.bindValue(":first2", first);
+        query.bindValue(":last2", last);
+        ok = query.exec();
+        while (ok && query.next())
+            voiceNotes << query.value(0).toString();
+        query.finish();
+    }
+
+    const char *tables[] = { "event_tags", "event_signatures", "event_lsh", "revisions", "attachments" };
+    for (int i = 0; ok && i < int(sizeof(tables) / sizeof(tables[0])); ++i) {
+        query.prepare(QString("DELETE FROM %1 WHERE eventID BETWEEN :first AND :last "
+                              "AND eventID NOT IN (SELECT eventID FROM events "
+                              "                    WHERE eventID BETWEEN :first2 AND :last2)")
+                      .arg(tables[i]));
+        query.bindValue(":first", first);
+        query.bindValue(":last", last);
+        query.bindValue(":first2", first);
+        query.bindValue(":last2", last);
+        ok = query.exec();
+    }
+
+    if (!ok || !m_database.commit()) {
+        m_lastError = ok ? m_database.lastError().text() : query.lastError().text();
+        m_database.rollback();
+        return -1;
+    }
+    for (int i = 0; i < voiceNotes.size(); ++i) {
+        if (!voiceNotes.at(i).isEmpty() && !QFile::remove(voiceNotes.at(i)) && QFile::exists(voiceNotes.at(i)))
+            qWarning() << "TrashStore: could not remove" << voiceNotes.at(i);
+    }
+    return count;
+}
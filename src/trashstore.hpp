@@ -0,0 +1,60 @@
+/*
+ * trashstore.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef TRASHSTORE_HPP_
+#define TRASHSTORE_HPP_
+
+#include "storagebackend.hpp"
+
+#include <QList>
+#include <QString>
+#include <QtSql/QSqlDatabase>
+
+struct TrashedEntry
+{
+    TrashedEntry() : deletedAt(0) {}
+
+    EventRecord record;
+    qint64 deletedAt;     // seconds since the epoch
+};
+
+/*
+ * @brief Deleted entries, kept for TRASH_RETENTION_DAYS so a delete can be undone.
+ *
+ * Deleting an entry only sets its deletedAt column (schema v10); the list,
+ * search, facets and statistics leave it out from then on. Expired entries
+ * are purged in batches, each a range delete of the entries and of their
+ * tags, signatures, LSH buckets, revisions and attachments in one short
+ * transaction, so other connections wait for one batch at most. Their voice
+ * note files are removed after the commit. The maintenance task hands the
+ * freed pages back with incremental_vacuum.
+ */
+class TrashStore
+{
+public:
+    TrashStore(const QSqlDatabase &database);
+
+    bool trash(qint64 eventId, qint64 deletedAt);
+    bool restore(qint64 eventId);
+    QList<TrashedEntry> entries();
+
+    // Purges up to 'batchSize' entries deleted at or before 'cutoff'. Returns
+    // the number purged, so fewer than 'batchSize' means none are left, or -1.
+    int purge(qint64 cutoff, int batchSize);
+    bool hasExpired(qint64 cutoff);
+
+    // Entries deleted before this time have been in the trash long enough.
+    static qint64 expiryCutoff(qint64 now);
+
+    QString lastError() const;
+
+private:
+    QSqlDatabase m_database;
+    QString m_lastError;
+};
+
+#endif /* TRASHSTORE_HPP_ */
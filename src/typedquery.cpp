@@ -0,0 +1,19 @@
+/*
+ * typedquery.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "typedquery.hpp"
+
+#include <QtSql/QSqlDriver>
+
+sqlite3 *sqliteHandle(const QSqlDatabase &database)
+{
+    if (!database.isValid() || !database.isOpen())
+        return 0;
+    const QVariant driverHandle = database.driver()->handle();
+    if (driverHandle.isValid() && qstrcmp(driverHandle.typeName(), "sqlite3*") == 0)
+        return *static_cast<sqlite3 * const *>(driverHandle.constData());
+    return 0;
+}
@@ -0,0 +1,417 @@
+/*
+ * typedquery.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef TYPEDQUERY_HPP_
+#define TYPEDQUERY_HPP_
+
+#include <QByteArray>
+#include <QString>
+#include <QtSql/QSqlDatabase>
+
+#include <sqlite3.h>
+
+// The sqlite3 handle behind a QSQLITE connection, or 0.
+sqlite3 *sqliteHandle(const QSqlDatabase &database);
+
+/*
+ * How a C++ type is bound to a parameter and read from a column. Only the
+ * types specialised here can appear in a query; anything else fails to compile.
+ */
+template <class T> struct SqlType;
+
+template <> struct SqlType<int>
+{
+    static int bind(sqlite3_stmt *statement, int index, int value)
+    {
+        return sqlite3_bind_int(statement, index, value);
+    }
+    static int column(sqlite3_stmt *statement, int index)
+    {
+        return sqlite3_column_int(statement, index);
+    }
+};
+
+template <> struct SqlType<qint64>
+{
+    static int bind(sqlite3_stmt *statement, int index, qint64 value)
+    {
+        return sqlite3_bind_int64(statement, index, value);
+    }
+    static qint64 column(sqlite3_stmt *statement, int index)
+    {
+        return sqlite3_column_int64(statement, index);
+    }
+};
+
+template <> struct SqlType<double>
+{
+    static int bind(sqlite3_stmt *statement, int index, double value)
+    {
+        return sqlite3_bind_double(statement, index, value);
+    }
+    static double column(sqlite3_stmt *statement, int index)
+    {
+        return sqlite3_column_double(statement, index);
+    }
+};
+
+template <> struct SqlType<QString>
+{
+    static int bind(sqlite3_stmt *statement, int index, const QString &value)
+    {
+        return sqlite3_bind_text16(statement, index, value.utf16(), value.size() * int(sizeof(QChar)),
+                                   SQLITE_TRANSIENT);
+    }
+    static QString column(sqlite3_stmt *statement, int index)
+    {
+        const void *text = sqlite3_column_text16(statement, index);
+        const int bytes = sqlite3_column_bytes16(statement, index);
+        return QString(static_cast<const QChar *>(text), bytes / int(sizeof(QChar)));
+    }
+};
+
+template <> struct SqlType<QByteArray>
+{
+    static int bind(sqlite3_stmt *statement, int index, const QByteArray &value)
+    {
+        return sqlite3_bind_blob(statement, index, value.constData(), value.size(), SQLITE_TRANSIENT);
+    }
+    static QByteArray column(sqlite3_stmt *statement, int index)
+    {
+        const char *data = static_cast<const char *>(sqlite3_column_blob(statement, index));
+        return QByteArray(data, sqlite3_column_bytes(statement, index));
+    }
+};
+
+/*
+ * The parameters or the columns of a query: SqlTuple<qint64, QString> holds
+ * 'first' and 'second'. Up to five values.
+ */
+struct SqlNone {};
+
+template <class T1 = SqlNone, class T2 = SqlNone, class T3 = SqlNone, class T4 = SqlNone,
+          class T5 = SqlNone>
+struct SqlTuple
+{
+    enum { Arity = 5 };
+    typedef T1 Type1; typedef T2 Type2; typedef T3 Type3; typedef T4 Type4; typedef T5 Type5;
+
+    SqlTuple() : first(), second(), third(), fourth(), fifth() {}
+    SqlTuple(const T1 &a, const T2 &b, const T3 &c, const T4 &d, const T5 &e)
+        : first(a), second(b), third(c), fourth(d), fifth(e) {}
+
+    int bind(sqlite3_stmt *s) const
+    {
+        int rc = SqlType<T1>::bind(s, 1, first);
+        if (rc == SQLITE_OK) rc = SqlType<T2>::bind(s, 2, second);
+        if (rc == SQLITE_OK) rc = SqlType<T3>::bind(s, 3, third);
+        if (rc == SQLITE_OK) rc = SqlType<T4>::bind(s, 4, fourth);
+        if (rc == SQLITE_OK) rc = SqlType<T5>::bind(s, 5, fifth);
+        return rc;
+    }
+    void read(sqlite3_stmt *s)
+    {
+        first = SqlType<T1>::column(s, 0);
+        second = SqlType<T2>::column(s, 1);
+        third = SqlType<T3>::column(s, 2);
+        fourth = SqlType<T4>::column(s, 3);
+        fifth = SqlType<T5>::column(s, 4);
+    }
+
+    T1 first; T2 second; T3 third; T4 fourth; T5 fifth;
+};
+
+template <class T1, class T2, class T3, class T4>
+struct SqlTuple<T1, T2, T3, T4, SqlNone>
+{
+    enum { Arity = 4 };
+    typedef T1 Type1; typedef T2 Type2; typedef T3 Type3; typedef T4 Type4; typedef SqlNone Type5;
+
+    SqlTuple() : first(), second(), third(), fourth() {}
+    SqlTuple(const T1 &a, const T2 &b, const T3 &c, const T4 &d)
+        : first(a), second(b), third(c), fourth(d) {}
+
+    int bind(sqlite3_stmt *s) const
+    {
+        int rc = SqlType<T1>::bind(s, 1, first);
+        if (rc == SQLITE_OK) rc = SqlType<T2>::bind(s, 2, second);
+        if (rc == SQLITE_OK) rc = SqlType<T3>::bind(s, 3, third);
+        if (rc == SQLITE_OK) rc = SqlType<T4>::bind(s, 4, fourth);
+        return rc;
+    }
+    void read(sqlite3_stmt *s)
+    {
+        first = SqlType<T1>::column(s, 0);
+        second = SqlType<T2>::column(s, 1);
+        third = SqlType<T3>::column(s, 2);
+        fourth = SqlType<T4>::column(s, 3);
+    }
+
+    T1 first; T2 second; T3 third; T4 fourth;
+};
+
+template <class T1, class T2, class T3>
+struct SqlTuple<T1, T2, T3, SqlNone, SqlNone>
+{
+    enum { Arity = 3 };
+    typedef T1 Type1; typedef T2 Type2; typedef T3 Type3; typedef SqlNone Type4; typedef SqlNone Type5;
+
+    SqlTuple() : first(), second(), third() {}
+    SqlTuple(const T1 &a, const T2 &b, const T3 &c) : first(a), second(b), third(c) {}
+
+    int bind(sqlite3_stmt *s) const
+    {
+        int rc = SqlType<T1>::bind(s, 1, first);
+        if (rc == SQLITE_OK) rc = SqlType<T2>::bind(s, 2, second);
+        if (rc == SQLITE_OK) rc = SqlType<T3>::bind(s, 3, third);
+        return rc;
+    }
+    void read(sqlite3_stmt *s)
+    {
+        first = SqlType<T1>::column(s, 0);
+        second = SqlType<T2>::column(s, 1);
+        third = SqlType<T3>::column(s, 2);
+    }
+
+    T1 first; T2 second; T3 third;
+};
+
+template <class T1, class T2>
+struct SqlTuple<T1, T2, SqlNone, SqlNone, SqlNone>
+{
+    enum { Arity = 2 };
+    typedef T1 Type1; typedef T2 Type2; typedef SqlNone Type3; typedef SqlNone Type4; typedef SqlNone Type5;
+
+    SqlTuple() : first(), second() {}
+    SqlTuple(const T1 &a, const T2 &b) : first(a), second(b) {}
+
+    int bind(sqlite3_stmt *s) const
+    {
+        int rc = SqlType<T1>::bind(s, 1, first);
+        if (rc == SQLITE_OK) rc = SqlType<T2>::bind(s, 2, second);
+        return rc;
+    }
+    void read(sqlite3_stmt *s)
+    {
+        first = SqlType<T1>::column(s, 0);
+        second = SqlType<T2>::column(s, 1);
+    }
+
+    T1 first; T2 second;
+};
+
+template <class T1>
+struct SqlTuple<T1, SqlNone, SqlNone, SqlNone, SqlNone>
+{
+    enum { Arity = 1 };
+    typedef T1 Type1; typedef SqlNone Type2; typedef SqlNone Type3; typedef SqlNone Type4; typedef SqlNone Type5;
+
+    SqlTuple() : first() {}
+    SqlTuple(const T1 &a) : first(a) {}
+
+    int bind(sqlite3_stmt *s) const
+    {
+        return SqlType<T1>::bind(s, 1, first);
+    }
+    void read(sqlite3_stmt *s)
+    {
+        first = SqlType<T1>::column(s, 0);
+    }
+
+    T1 first;
+};
+
+template <>
+struct SqlTuple<SqlNone, SqlNone, SqlNone, SqlNone, SqlNone>
+{
+    enum { Arity = 0 };
+    typedef SqlNone Type1; typedef SqlNone Type2; typedef SqlNone Type3; typedef SqlNone Type4; typedef SqlNone Type5;
+
+    int bind(sqlite3_stmt *) const { return SQLITE_OK; }
+    void read(sqlite3_stmt *) {}
+};
+
+// Only SqlArity<true> is defined, so a failed check is a compile error.
+template <bool> struct SqlArity;
+template <> struct SqlArity<true> { enum { Ok = 1 }; };
+
+/*
+ * @brief A prepared statement for one query declaration.
+ *
+ * A query is declared once, as a struct with the SQL and the types of its
+ * parameters and result columns:
+ *
+ *   struct EventAtRow
+ *   {
+ *       typedef SqlTuple<qint64> Params;
+ *       typedef SqlTuple<qint64, QString> Row;
+ *       static const char *sql() { return "SELECT eventID, textEvent FROM events WHERE eventID = ?"; }
+ *   };
+ *
+ *   TypedQuery<EventAtRow> query;
+ *   EventAtRow::Row row;
+ *   if (query.prepare(handle) && query.exec(eventId) && query.next(row)) ...
+ *
+ * Values go straight between the statement and the typed fields, without
+ * QVariant. exec() takes exactly the declared parameters: a call with the
+ * wrong number or types of arguments does not compile. prepare() checks the
+ * placeholders and result columns of the SQL against the declaration.
+ *
+ * The statement stays prepared between calls and must be finalized (or the
+ * TypedQuery destroyed) before its connection is closed.
+ */
+template <class Query>
+class TypedQuery
+{
+public:
+    typedef typename Query::Params Params;
+    typedef typename Query::Row Row;
+
+    TypedQuery() : m_handle(0), m_statement(0), m_step(SQLITE_DONE) {}
+    ~TypedQuery() { finalize(); }
+
+    // A no-op when already prepared on 'handle'.
+    bool prepare(sqlite3 *handle)
+    {
+        if (m_statement && m_handle == handle)
+            return true;
+        finalize();
+        m_handle = handle;
+        if (!handle) {
+            m_lastError = "No SQLite connection";
+            return false;
+        }
+        if (sqlite3_prepare_v2(handle, Query::sql(), -1, &m_statement, 0) != SQLITE_OK) {
+            m_lastError = QString::fromUtf8(sqlite3_errmsg(handle));
+            finalize();
+            return false;
+        }
+        if (sqlite3_bind_parameter_count(m_statement) != int(Params::Arity)
+            || sqlite3_column_count(m_statement) != int(Row::Arity)) {
+            m_lastError = QString("Query declares %1 parameters and %2 columns, its SQL has %3 and %4")
+                          .arg(int(Params::Arity)).arg(int(Row::Arity))
+                          .arg(sqlite3_bind_parameter_count(m_statement))
+                          .arg(sqlite3_column_count(m_statement));
+            finalize();
+            return false;
+        }
+        return true;
+    }
+
+    void finalize()
+    {
+        if (m_statement)
+            sqlite3_finalize(m_statement);
+        m_statement = 0;
+        m_handle = 0;
+        m_step = SQLITE_DONE;
+    }
+
+    bool exec()
+    {
+        (void)sizeof(SqlArity<Params::Arity == 0>);
+        return run(Params());
+    }
+    bool exec(const typename Params::Type1 &a)
+    {
+        (void)sizeof(SqlArity<Params::Arity == 1>);
+        return run(Params(a));
+    }
+    bool exec(const typename Params::Type1 &a, const typename Params::Type2 &b)
+    {
+        (void)sizeof(SqlArity<Params::Arity == 2>);
+        return run(Params(a, b));
+    }
+    bool exec(const typename Params::Type1 &a, const typename Params::Type2 &b,
+              const typename Params::Type3 &c)
+    {
+        (void)sizeof(SqlArity<Params::Arity == 3>);
+        return run(Params(a, b, c));
+    }
+    bool exec(const typename Params::Type1 &a, const typename Params::Type2 &b,
+              const typename Params::Type3 &c, const typename Params::Type4 &d)
+    {
+        (void)sizeof(SqlArity<Params::Arity == 4>);
+        return run(Params(a, b, c, d));
+    }
+    bool exec(const typename Params::Type1 &a, const typename Params::Type2 &b,
+              const typename Params::Type3 &c, const typename Params::Type4 &d,
+              const typename Params::Type5 &e)
+    {
+        (void)sizeof(SqlArity<Params::Arity == 5>);
+        return run(Params(a, b, c, d, e));
+    }
+
+    // The next result row; false when there is none left (or on error).
+    bool next(Row &row)
+    {
+        if (m_step != SQLITE_ROW)
+            return false;
+        row.read(m_statement);
+        step();
+        return true;
+    }
+
+    // Releases the statement's read lock before all rows were read.
+    void finish()
+    {
+        if (m_statement)
+            sqlite3_reset(m_statement);
+        m_step = SQLITE_DONE;
+    }
+
+    qint64 lastInsertId() const
+    {
+        return m_handle ? sqlite3_last_insert_rowid(m_handle) : -1;
+    }
+    int changes() const
+    {
+        return m_handle ? sqlite3_changes(m_handle) : 0;
+    }
+    QString lastError() const
+    {
+        return m_lastError;
+    }
+
+private:
+    bool run(const Params &params)
+    {
+        if (!m_statement) {
+            m_lastError = "Query is not prepared";
+            return false;
+        }
+        sqlite3_reset(m_statement);
+        if (params.bind(m_statement) != SQLITE_OK) {
+            m_lastError = QString::fromUtf8(sqlite3_errmsg(m_handle));
+            return false;
+        }
+        return step();
+    }
+
+    bool step()
+    {
+        m_step = sqlite3_step(m_statement);
+        if (m_step == SQLITE_ROW)
+            return true;
+        if (m_step != SQLITE_DONE)
+            m_lastError = QString::fromUtf8(sqlite3_errmsg(m_handle));
+        // Done (or failed): reset right away, so no read lock is held.
+        sqlite3_reset(m_statement);
+        return m_step == SQLITE_DONE;
+    }
+
+    sqlite3 *m_handle;
+    sqlite3_stmt *m_statement;
+    int m_step;
+    QString m_lastError;
+
+    // A prepared statement belongs to one owner.
+    TypedQuery(const TypedQuery &);
+    TypedQuery &operator=(const TypedQuery &);
+};
+
+#endif /* TYPEDQUERY_HPP_ */
@@ -0,0 +1,239 @@
+/*
+ * voicerecorder.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "voicerecorder.hpp"
+#include "imaadpcm.hpp"
+#include "voicesource.hpp"
+
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <QVector>
+#include <QtEndian>
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define VOICE_FRAME_MS 20
+#define VOICE_RING_MS 2000
+#define VOICE_POLL_MS 5
+#define VOICE_FLUSH_FRAMES 50
+#define VOICE_CODEC_IMA_ADPCM 1
+#define VOICE_HEADER_BYTES 12
+#define VOICE_FRAME_HEADER_BYTES 8
+
+static qint64 threadCpuUs()
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return qint64(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
+
+// -----------------------------------------------------------------------------------------------
+// VoiceRecorder
+
+VoiceRecorder::VoiceRecorder(QObject *parent)
+    : QObject(parent)
+    , m_captureThread(0)
+    , m_encodeThread(0)
+    , m_source(0)
+    , m_worker(0)
+    , m_ring(0)
+{
+}
+
+VoiceRecorder::~VoiceRecorder()
+{
+    stop();
+    shutdown();
+}
+
+bool VoiceRecorder::isRecording() const
+{
+    return m_encodeThread != 0;
+}
+
+bool VoiceRecorder::start(VoiceSource *source, const QString &fileName)
+{
+    if (isRecording() || source->sampleRate() <= 0) {
+        delete source;
+        return false;
+    }
+
+    m_ring = new SampleRing(source->sampleRate() * VOICE_RING_MS / 1000);
+    m_source = source;
+    m_source->setRing(m_ring);
+    m_worker = new VoiceWorker(m_ring, source->sampleRate(), source->isRealTime(), fileName);
+
+    // The encoder is running before the first sample arrives.
+    m_encodeThread = new QThread(this);
+    m_worker->moveToThread(m_encodeThread);
+    connect(m_encodeThread, SIGNAL(started()), m_worker, SLOT(run()));
+    connect(m_worker, SIGNAL(finished(const QString&, const QString&)), m_encodeThread, SLOT(quit()));
+    connect(m_worker, SIGNAL(error(const QString&)), m_encodeThread, SLOT(quit()));
+    connect(m_worker, SIGNAL(finished(const QString&, const QString&)),
+            this, SLOT(onWorkerFinished(const QString&, const QString&)));
+    connect(m_worker, SIGNAL(error(const QString&)), this, SLOT(onWorkerError(const QString&)));
+    m_encodeThread->start(QThread::HighPriority);
+
+    m_captureThread = new QThread(this);
+    m_source->moveToThread(m_captureThread);
+    connect(m_captureThread, SIGNAL(started()), m_source, SLOT(run()));
+    connect(m_source, SIGNAL(ended()), m_captureThread, SLOT(quit()));
+    connect(m_source, SIGNAL(error(const QString&)), this, SIGNAL(error(const QString&)));
+    m_captureThread->start(QThread::TimeCriticalPriority);
+    return true;
+}
+
+void VoiceRecorder::stop()
+{
+    if (m_source)
+        m_source->stop();
+}
+
+VoiceStats VoiceRecorder::stats() const
+{
+    return m_stats;
+}
+
+void VoiceRecorder::onWorkerFinished(const QString &fileName, const QString &sha1)
+{
+    shutdown();
+    emit finished(fileName, sha1);
+}
+
+void VoiceRecorder::onWorkerError(const QString &message)
+{
+    stop();
+    shutdown();
+    emit error(message);
+}
+
+void VoiceRecorder::shutdown()
+{
+    if (!m_encodeThread)
+        return;
+
+    // The worker only finishes after the source closed the ring, so the
+    // capture thread is on its way out as well.
+    m_captureThread->quit();
+    m_captureThread->wait();
+    m_encodeThread->quit();
+    m_encodeThread->wait();
+
+    m_stats = m_worker->stats();
+    m_stats.droppedSamples = m_ring->dropped();
+
+    delete m_source;
+    m_source = 0;
+    delete m_worker;
+    m_worker = 0;
+    delete m_ring;
+    m_ring = 0;
+    delete m_captureThread;
+    m_captureThread = 0;
+    delete m_encodeThread;
+    m_encodeThread = 0;
+}
+
+// -----------------------------------------------------------------------------------------------
+// VoiceWorker
+
+VoiceWorker::VoiceWorker(SampleRing *ring, int sampleRate, bool realTime, const QString &fileName)
+    : m_ring(ring)
+    , m_realTime(realTime)
+    , m_fileName(fileName)
+{
+    m_stats.sampleRate = sampleRate;
+}
+
+VoiceStats VoiceWorker::stats() const
+{
+    return m_stats;
+}
+
+void VoiceWorker::run()
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    const int frameSamples = m_stats.sampleRate * VOICE_FRAME_MS / 1000;
+    QVector<qint16> samples(frameSamples);
+    QByteArray frame(VOICE_FRAME_HEADER_BYTES + ImaAdpcm::frameBytes(frameSamples), '\0');
+    uchar *out = reinterpret_cast<uchar *>(frame.data());
+
+    QFile file(m_fileName);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    ImaAdpcm encoder;
+
+    QByteArray header(VOICE_HEADER_BYTES, '\0');
+    uchar *h = reinterpret_cast<uchar *>(header.data());
+    memcpy(h, "DWV1", 4);
+    qToLittleEndian<quint32>(quint32(m_stats.sampleRate), h + 4);
+    qToLittleEndian<quint16>(quint16(frameSamples), h + 8);
+    qToLittleEndian<quint16>(VOICE_CODEC_IMA_ADPCM, h + 10);
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(header) != header.size()) {
+        // Nothing reads the ring any more; the recording is lost, capture must end.
+        emit error(QString("Cannot write %1: %2").arg(m_fileName, file.errorString()));
+        return;
+    }
+    hash.addData(header);
+    m_stats.bytesWritten = header.size();
+
+    qint64 closedAt = -1;
+    for (;;) {
+        // Checked before the samples are counted, so none written before close are missed.
+        const bool closed = m_ring->isClosed();
+        if (closed && closedAt < 0)
+            closedAt = clock.elapsed();
+
+        while (m_ring->available() >= frameSamples || (closed && m_ring->available() > 0)) {
+            const qint64 cpuStart = threadCpuUs();
+            const int count = m_ring->read(samples.data(), frameSamples);
+            const int payload = encoder.encode(samples.constData(), count, out + VOICE_FRAME_HEADER_BYTES);
+            qToLittleEndian<quint16>(quint16(payload), out);
+            qToLittleEndian<quint16>(quint16(count), out + 2);
+            qToLittleEndian<quint32>(quint32(crc32(0, out + VOICE_FRAME_HEADER_BYTES, payload)), out + 4);
+
+            const int bytes = VOICE_FRAME_HEADER_BYTES + payload;
+            if (file.write(frame.constData(), bytes) != bytes) {
+                emit error(QString("Cannot write %1: %2").arg(m_fileName, file.errorString()));
+                return;
+            }
+            hash.addData(frame.constData(), bytes);
+            m_stats.bytesWritten += bytes;
+            m_stats.samples += count;
+            if (++m_stats.frames % VOICE_FLUSH_FRAMES == 0)
+                file.flush();
+
+            const qint64 cpu = threadCpuUs() - cpuStart;
+            m_stats.encodeCpuUs += cpu;
+            m_stats.maxFrameCpuUs = qMax(m_stats.maxFrameCpuUs, cpu);
+            if (m_realTime) {
+                const qint64 latency = clock.elapsed() - m_stats.samples * 1000 / m_stats.sampleRate;
+                m_stats.totalLatencyMs += qMax<qint64>(0, latency);
+                m_stats.maxLatencyMs = qMax(m_stats.maxLatencyMs, latency);
+            }
+        }
+
+        if (closed)
+            break;
+        usleep(VOICE_POLL_MS * 1000);
+    }
+
+    if (!file.flush() || fsync(file.handle()) != 0) {
+        emit error(QString("Cannot write %1: %2").arg(m_fileName, file.errorString()));
+        return;
+    }
+    file.close();
+    m_stats.stopToSavedMs = clock.elapsed() - closedAt;
+
+    emit finished(m_fileName, hash.result().toHex());
+}
@@ -0,0 +1,124 @@
+/*
+ * voicerecorder.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef VOICERECORDER_HPP_
+#define VOICERECORDER_HPP_
+
+#include <QObject>
+#include <QString>
+
+class QThread;
+class SampleRing;
+class VoiceSource;
+class VoiceWorker;
+
+/*
+ * What a recording cost. Latencies are measured against the audio clock
+ * (when the last sample of a frame was captured) and are only kept for
+ * real-time sources.
+ */
+struct VoiceStats
+{
+    VoiceStats()
+        : sampleRate(0), frames(0), samples(0), droppedSamples(0), bytesWritten(0)
+        , encodeCpuUs(0), maxFrameCpuUs(0), totalLatencyMs(0), maxLatencyMs(0), stopToSavedMs(0) {}
+
+    // Encoder CPU time per second of audio, in percent.
+    double cpuPercent() const
+    {
+        return samples && sampleRate ? 100.0 * encodeCpuUs / (1e6 * samples / sampleRate) : 0;
+    }
+
+    int sampleRate;
+    qint64 frames;
+    qint64 samples;
+    qint64 droppedSamples;
+    qint64 bytesWritten;
+    qint64 encodeCpuUs;      // thread CPU time spent encoding and writing frames
+    qint64 maxFrameCpuUs;
+    qint64 totalLatencyMs;   // capture to frame written, summed over frames
+    qint64 maxLatencyMs;
+    qint64 stopToSavedMs;    // end of capture to the file synced to disk
+};
+
+/*
+ * @brief Records a voice note while it is being spoken.
+ *
+ * The source runs on a capture thread and only writes into a lock-free
+ * SampleRing. An encoder thread takes VOICE_FRAME_MS frames out of the ring,
+ * encodes them with IMA ADPCM and appends them to the note file:
+ *
+ *   header  ["DWV1"][u32 sample rate][u16 samples per frame][u16 codec]
+ *   frames  [u16 payload length][u16 samples][u32 crc32 of payload][payload]
+ *
+ * Nothing but the ring holds raw audio, so memory use does not grow with the
+ * length of the note, and at stop() only the samples still in the ring are
+ * left to encode. A torn frame at the end of a crashed recording fails its
+ * crc and is where a reader stops.
+ */
+class VoiceRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    VoiceRecorder(QObject *parent = 0);
+    ~VoiceRecorder();
+
+    bool isRecording() const;
+
+    // Takes ownership of 'source'.
+    bool start(VoiceSource *source, const QString &fileName);
+    // Ends capture; finished() follows once the rest is encoded and synced.
+    void stop();
+
+    // Of the last finished recording.
+    VoiceStats stats() const;
+
+Q_SIGNALS:
+    void finished(const QString &fileName, const QString &sha1);
+    void error(const QString &message);
+
+private Q_SLOTS:
+    void onWorkerFinished(const QString &fileName, const QString &sha1);
+    void onWorkerError(const QString &message);
+
+private:
+    void shutdown();
+
+    QThread *m_captureThread;
+    QThread *m_encodeThread;
+    VoiceSource *m_source;
+    VoiceWorker *m_worker;
+    SampleRing *m_ring;
+    VoiceStats m_stats;
+};
+
+class VoiceWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    VoiceWorker(SampleRing *ring, int sampleRate, bool realTime, const QString &fileName);
+
+    // Read once finished() or error() was emitted.
+    VoiceStats stats() const;
+
+public Q_SLOTS:
+    void run();
+
+Q_SIGNALS:
+    void finished(const QString &fileName, const QString &sha1);
+    void error(const QString &message);
+
+private:
+    SampleRing *m_ring;
+    bool m_realTime;
+    QString m_fileName;
+    VoiceStats m_stats;
+};
+
+#endif /* VOICERECORDER_HPP_ */
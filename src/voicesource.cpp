@@ -0,0 +1,361 @@
+/*
+ * voicesource.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "voicesource.hpp"
+
+#include <QtEndian>
+#include <QtDebug>
+
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __QNX__
+#include <sys/asoundlib.h>
+#endif
+
+#define VOICE_READ_SAMPLES 512
+#define VOICE_CAPTURE_RATE 16000
+
+// -----------------------------------------------------------------------------------------------
+// SampleRing
+
+SampleRing::SampleRing(int capacity)
+    : m_buffer(0)
+    , m_capacity(1)
+    , m_head(0)
+    , m_tail(0)
+    , m_closed(0)
+    , m_dropped(0)
+{
+    while (m_capacity < capacity)
+        m_capacity <<= 1;
+    m_buffer = new qint16[m_capacity];
+}
+
+SampleRing::~SampleRing()
+{
+    delete[] m_buffer;
+}
+
+int SampleRing::write(const qint16 *samples, int count)
+{
+    // The head is only written here; the tail is published by the consumer.
+    const quint32 head = quint32(int(m_head));
+    const quint32 tail = quint32(m_tail.fetchAndAddAcquire(0));
+    const int taken = qMin(count, m_capacity - int(head - tail));
+
+    const int start = int(head & quint32(m_capacity - 1));
+    const int first = qMin(taken, m_capacity - start);
+    memcpy(m_buffer + start, samples, first * sizeof(qint16));
+    memcpy(m_buffer, samples + first, (taken - first) * sizeof(qint16));
+
+    m_head.fetchAndStoreRelease(int(head + quint32(taken)));
+    if (taken < count)
+        m_dropped.fetchAndAddRelaxed(count - taken);
+    return taken;
+}
+
+void SampleRing::close()
+{
+    m_closed.fetchAndStoreRelease(1);
+}
+
+int SampleRing::available() const
+{
+    const quint32 head = quint32(const_cast<QAtomicInt &>(m_head).fetchAndAddAcquire(0));
+    return int(head - quint32(int(m_tail)));
+}
+
+int SampleRing::read(qint16 *samples, int count)
+{
+    const quint32 tail = quint32(int(m_tail));
+    const int taken = qMin(count, available());
+
+    const int start = int(tail & quint32(m_capacity - 1));
+    const int first = qMin(taken, m_capacity - start);
+    memcpy(samples, m_buffer + start, first * sizeof(qint16));
+    memcpy(samples + first, m_buffer, (taken - first) * sizeof(qint16));
+
+    m_tail.fetchAndStoreRelease(int(tail + quint32(taken)));
+    return taken;
+}
+
+bool SampleRing::isClosed() const
+{
+    return const_cast<QAtomicInt &>(m_closed).fetchAndAddAcquire(0) != 0;
+}
+
+int SampleRing::dropped() const
+{
+    return int(m_dropped);
+}
+
+// -----------------------------------------------------------------------------------------------
+// VoiceSource
+
+VoiceSource::VoiceSource()
+    : m_ring(0)
+    , m_stopRequested(0)
+{
+}
+
+VoiceSource::~VoiceSource()
+{
+}
+
+void VoiceSource::setRing(SampleRing *ring)
+{
+    m_ring = ring;
+}
+
+void VoiceSource::stop()
+{
+    m_stopRequested.fetchAndStoreOrdered(1);
+}
+
+bool VoiceSource::stopRequested() const
+{
+    return int(m_stopRequested) != 0;
+}
+
+void VoiceSource::run()
+{
+    if (!openCapture()) {
+        m_ring->close();
+        emit error(m_lastError);
+        emit ended();
+        return;
+    }
+
+    qint16 buffer[VOICE_READ_SAMPLES];
+    while (!stopRequested()) {
+        const int read = readSamples(buffer, VOICE_READ_SAMPLES);
+        if (read < 0)
+            emit error(m_lastError);
+        if (read <= 0)
+            break;
+        m_ring->write(buffer, read);
+    }
+
+    closeCapture();
+    m_ring->close();
+    emit ended();
+}
+
+// -----------------------------------------------------------------------------------------------
+// WavFileSource
+
+WavFileSource::WavFileSource(const QString &fileName, bool realTime)
+    : m_file(fileName)
+    , m_realTime(realTime)
+    , m_sampleRate(0)
+    , m_channels(0)
+    , m_dataLeft(0)
+    , m_delivered(0)
+{
+}
+
+bool WavFileSource::open()
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_lastError = m_file.errorString();
+        return false;
+    }
+
+    const QByteArray riff = m_file.read(12);
+    if (riff.size() != 12 || !riff.startsWith("RIFF") || riff.mid(8, 4) != "WAVE") {
+        m_lastError = "Not a WAV file";
+        return false;
+    }
+
+    // Walk the chunks up to "data"; "fmt " has to come first.
+    for (;;) {
+        const QByteArray header = m_file.read(8);
+        if (header.size() != 8) {
+            m_lastError = "No audio data";
+            return false;
+        }
+        const qint64 size = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(header.constData()) + 4);
+
+        if (header.startsWith("fmt ")) {
+            const QByteArray format = m_file.read(size + (size & 1));
+            const uchar *f = reinterpret_cast<const uchar *>(format.constData());
+            if (format.size() < 16 || qFromLittleEndian<quint16>(f) != 1
+                || qFromLittleEndian<quint16>(f + 14) != 16) {
+                m_lastError = "Only 16-bit PCM WAV files are supported";
+                return false;
+            }
+            m_channels = qFromLittleEndian<quint16>(f + 2);
+            m_sampleRate = int(qFromLittleEndian<quint32>(f + 4));
+        } else if (header.startsWith("data")) {
+            if (m_channels < 1 || m_channels > 2 || m_sampleRate <= 0) {
+                m_lastError = "Unsupported WAV format";
+                return false;
+            }
+            m_dataLeft = size;
+            return true;
+        } else if (!m_file.seek(m_file.pos() + size + (size & 1))) {
+            m_lastError = m_file.errorString();
+            return false;
+        }
+    }
+}
+
+QString WavFileSource::lastError() const
+{
+    return m_lastError;
+}
+
+int WavFileSource::sampleRate() const
+{
+    return m_sampleRate;
+}
+
+bool WavFileSource::isRealTime() const
+{
+    return m_realTime;
+}
+
+bool WavFileSource::openCapture()
+{
+    m_clock.start();
+    return m_file.isOpen();
+}
+
+int WavFileSource::readSamples(qint16 *buffer, int max)
+{
+    const int frameBytes = 2 * m_channels;
+    const QByteArray data = m_file.read(qMin<qint64>(m_dataLeft, qint64(max) * frameBytes));
+    const int count = data.size() / frameBytes;
+    m_dataLeft -= data.size();
+
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+    for (int i = 0; i < count; ++i) {
+        if (m_channels == 2) {
+            buffer[i] = qint16((int(qFromLittleEndian<qint16>(p + 4 * i))
+                              + int(qFromLittleEndian<qint16>(p + 4 * i + 2))) / 2);
+        } else {
+            buffer[i] = qFromLittleEndian<qint16>(p + 2 * i);
+        }
+    }
+
+    // Hand the samples over no sooner than a microphone would.
+    m_delivered += count;
+    if (m_realTime) {
+        const qint64 due = m_delivered * 1000 / m_sampleRate;
+        const qint64 early = due - m_clock.elapsed();
+        if (early > 0)
+            usleep(useconds_t(early * 1000));
+    }
+    return count;
+}
+
+#ifdef __QNX__
+// -----------------------------------------------------------------------------------------------
+// PcmCaptureSource
+
+PcmCaptureSource::PcmCaptureSource()
+    : m_pcm(0)
+    , m_fragmentUsed(0)
+    , m_fragmentFilled(0)
+{
+}
+
+int PcmCaptureSource::sampleRate() const
+{
+    return VOICE_CAPTURE_RATE;
+}
+
+bool PcmCaptureSource::isRealTime() const
+{
+    return true;
+}
+
+bool PcmCaptureSource::openCapture()
+{
+    int card = 0;
+    int device = 0;
+    int rc = snd_pcm_open_preferred(&m_pcm, &card, &device, SND_PCM_OPEN_CAPTURE);
+    if (rc < 0) {
+        m_pcm = 0;
+        m_lastError = QString("Cannot open the microphone: %1").arg(snd_strerror(rc));
+        return false;
+    }
+
+    snd_pcm_channel_info_t info;
+    memset(&info, 0, sizeof(info));
+    info.channel = SND_PCM_CHANNEL_CAPTURE;
+    snd_pcm_plugin_info(m_pcm, &info);
+
+    snd_pcm_channel_params_t params;
+    memset(&params, 0, sizeof(params));
+    params.mode = SND_PCM_MODE_BLOCK;
+    params.channel = SND_PCM_CHANNEL_CAPTURE;
+    params.start_mode = SND_PCM_START_DATA;
+    params.stop_mode = SND_PCM_STOP_STOP;
+    params.buf.block.frag_size = info.max_fragment_size;
+    params.buf.block.frags_max = -1;
+    params.buf.block.frags_min = 1;
+    params.format.interleave = 1;
+    params.format.rate = VOICE_CAPTURE_RATE;
+    params.format.voices = 1;
+    params.format.format = SND_PCM_SFMT_S16_LE;
+
+    snd_pcm_channel_setup_t setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.channel = SND_PCM_CHANNEL_CAPTURE;
+    if ((rc = snd_pcm_plugin_params(m_pcm, &params)) < 0
+        || (rc = snd_pcm_plugin_setup(m_pcm, &setup)) < 0
+        || (rc = snd_pcm_plugin_prepare(m_pcm, SND_PCM_CHANNEL_CAPTURE)) < 0) {
+        m_lastError = QString("Cannot set up the microphone: %1").arg(snd_strerror(rc));
+        closeCapture();
+        return false;
+    }
+
+    m_fragment.resize(setup.buf.block.frag_size);
+    m_fragmentUsed = m_fragmentFilled = 0;
+    return true;
+}
+
+void PcmCaptureSource::closeCapture()
+{
+    if (m_pcm) {
+        snd_pcm_plugin_flush(m_pcm, SND_PCM_CHANNEL_CAPTURE);
+        snd_pcm_close(m_pcm);
+    }
+    m_pcm = 0;
+}
+
+int PcmCaptureSource::readSamples(qint16 *buffer, int max)
+{
+    // Block mode reads whole fragments; hand them out 'max' samples at a time.
+    while (m_fragmentUsed == m_fragmentFilled) {
+        if (stopRequested())
+            return 0;
+
+        const int read = snd_pcm_plugin_read(m_pcm, m_fragment.data(), m_fragment.size());
+        if (read < m_fragment.size()) {
+            snd_pcm_channel_status_t status;
+            memset(&status, 0, sizeof(status));
+            status.channel = SND_PCM_CHANNEL_CAPTURE;
+            if (snd_pcm_plugin_status(m_pcm, &status) < 0) {
+                m_lastError = "Microphone status unavailable";
+                return -1;
+            }
+            // An overrun loses the fragment; capture carries on.
+            if (status.status == SND_PCM_STATUS_READY || status.status == SND_PCM_STATUS_OVERRUN)
+                snd_pcm_plugin_prepare(m_pcm, SND_PCM_CHANNEL_CAPTURE);
+        }
+        m_fragmentUsed = 0;
+        m_fragmentFilled = qMax(0, read) / int(sizeof(qint16));
+    }
+
+    const int count = qMin(max, m_fragmentFilled - m_fragmentUsed);
+    memcpy(buffer, m_fragment.constData() + m_fragmentUsed * sizeof(qint16), count * sizeof(qint16));
+    m_fragmentUsed += count;
+    return count;
+}
+#endif
@@ -0,0 +1,161 @@
+/*
+ * voicesource.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef VOICESOURCE_HPP_
+#define VOICESOURCE_HPP_
+
+#include <QObject>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+
+/*
+ * @brief Lock-free ring of 16-bit samples for one producer and one consumer.
+ *
+ * The capture thread writes, the encoder thread reads; neither ever waits
+ * for the other. When the ring is full the newest samples are dropped and
+ * counted, so a stalled encoder cannot hold up capture.
+ */
+class SampleRing
+{
+public:
+    // 'capacity' is rounded up to a power of two.
+    explicit SampleRing(int capacity);
+    ~SampleRing();
+
+    // Producer side. Returns the samples taken.
+    int write(const qint16 *samples, int count);
+    // Called by the producer after its last write.
+    void close();
+
+    // Consumer side.
+    int available() const;
+    int read(qint16 *samples, int count);
+    bool isClosed() const;
+
+    int dropped() const;
+
+private:
+    qint16 *m_buffer;
+    int m_capacity;
+    QAtomicInt m_head;      // samples written so far (wraps)
+    QAtomicInt m_tail;      // samples read so far (wraps)
+    QAtomicInt m_closed;
+    QAtomicInt m_dropped;
+
+    SampleRing(const SampleRing &);
+    SampleRing &operator=(const SampleRing &);
+};
+
+/*
+ * @brief Where a voice note's samples come from: 16-bit mono PCM.
+ *
+ * run() is moved to a capture thread by VoiceRecorder. It pushes samples into
+ * the ring until stop() is called or the input ends, then closes the ring.
+ */
+class VoiceSource : public QObject
+{
+    Q_OBJECT
+
+public:
+    VoiceSource();
+    virtual ~VoiceSource();
+
+    virtual int sampleRate() const = 0;
+    // False for sources that deliver faster than real time (files read flat out).
+    virtual bool isRealTime() const = 0;
+
+    void setRing(SampleRing *ring);
+    void stop();
+
+public Q_SLOTS:
+    void run();
+
+Q_SIGNALS:
+    void ended();
+    void error(const QString &message);
+
+protected:
+    virtual bool openCapture() { return true; }
+    virtual void closeCapture() {}
+    // Blocks until samples are there. Returns the samples read, 0 at the end
+    // of the input and -1 on error (with m_lastError set).
+    virtual int readSamples(qint16 *buffer, int max) = 0;
+    bool stopRequested() const;
+
+    QString m_lastError;
+
+private:
+    SampleRing *m_ring;
+    QAtomicInt m_stopRequested;
+};
+
+/*
+ * @brief Feeds a 16-bit PCM WAV file in as if it were the microphone.
+ *
+ * Stereo files are mixed down. Paced to real time unless 'realTime' is false.
+ */
+class WavFileSource : public VoiceSource
+{
+    Q_OBJECT
+
+public:
+    WavFileSource(const QString &fileName, bool realTime = true);
+
+    // Reads the header; must succeed before the source is started.
+    bool open();
+    QString lastError() const;
+
+    virtual int sampleRate() const;
+    virtual bool isRealTime() const;
+
+protected:
+    virtual bool openCapture();
+    virtual int readSamples(qint16 *buffer, int max);
+
+private:
+    QFile m_file;
+    bool m_realTime;
+    int m_sampleRate;
+    int m_channels;
+    qint64 m_dataLeft;
+    qint64 m_delivered;
+    QElapsedTimer m_clock;
+};
+
+#ifdef __QNX__
+struct snd_pcm;
+
+/*
+ * @brief The microphone, through the QNX PCM capture channel.
+ */
+class PcmCaptureSource : public VoiceSource
+{
+    Q_OBJECT
+
+public:
+    PcmCaptureSource();
+
+    virtual int sampleRate() const;
+    virtual bool isRealTime() const;
+
+protected:
+    virtual bool openCapture();
+    virtual void closeCapture();
+    virtual int readSamples(qint16 *buffer, int max);
+
+private:
+    snd_pcm *m_pcm;
+    QByteArray m_fragment;
+    int m_fragmentUsed;
+    int m_fragmentFilled;
+};
+#endif
+
+#endif /* VOICESOURCE_HPP_ */
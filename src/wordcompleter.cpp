@@ -0,0 +1,811 @@
+/*
+ * wordcompleter.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "wordcompleter.hpp"
+#include "cryptovfs.hpp"
+#include "iovfs.hpp"
+
+#include <QDateTime>
+#include <QThread>
+#include <QtAlgorithms>
+#include <QtEndian>
+#include <QtSql/QtSql>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define COMPLETION_FORMAT 1
+#define COMPLETION_HEADER_BYTES 32
+#define COMPLETION_NODE_BYTES (16 + 4 * COMPLETION_TOP_K)
+#define COMPLETION_WORD_BYTES 12
+#define COMPLETION_NONE 0xffffffffu
+#define COMPLETION_DELTA_FORMAT 1
+#define COMPLETION_DELTA_HEADER_BYTES 12
+
+#define COMPLETION_CONNECTION "DWriter-completion"
+
+static const char COMPLETION_MAGIC[4] = { 'D', 'W', 'C', '1' };
+static const char COMPLETION_DELTA_MAGIC[4] = { 'D', 'W', 'C', 'D' };
+
+// Header fields
+enum { HeaderFormat = 4, HeaderLastEventId = 8, HeaderNodes = 16, HeaderWords = 20,
+       HeaderTextUnits = 24, HeaderStamp = 28 };
+// Delta header fields
+enum { DeltaFormat = 4, DeltaStamp = 8 };
+// Node fields
+enum { NodeUnit = 0, NodeFirstChild = 4, NodeChildren = 8, NodeWord = 12, NodeTop = 16 };
+// Word fields
+enum { WordTextOffset = 0, WordLength = 4, WordCount = 8 };
+
+struct BuildNode
+{
+    BuildNode() : unit(0), firstChild(0), children(0), word(COMPLETION_NONE)
+    {
+        for (int k = 0; k < COMPLETION_TOP_K; ++k)
+            top[k] = COMPLETION_NONE;
+    }
+
+    quint32 unit;
+    quint32 firstChild;
+    quint32 children;
+    quint32 word;
+    quint32 top[COMPLETION_TOP_K];
+};
+
+// The sorted words [first, last) that share the node's prefix of 'depth' units.
+struct BuildSpan
+{
+    int node;
+    int first;
+    int last;
+    int depth;
+};
+
+static int compareWord(const QString &word, const QChar *other, int length)
+{
+    const int common = qMin(word.size(), length);
+    for (int i = 0; i < common; ++i) {
+        if (word.at(i) != other[i])
+            return word.at(i).unicode() < other[i].unicode() ? -1 : 1;
+    }
+    return word.size() - length;
+}
+
+// The recent words are sorted, so the ones starting with 'prefix' follow each other.
+static bool hasPrefix(const QString &word, const QString &prefix)
+{
+    if (word.size() < prefix.size())
+        return false;
+    for (int i = 0; i < prefix.size(); ++i) {
+        if (word.at(i) != prefix.at(i).toLower())
+            return false;
+    }
+    return true;
+}
+
+static bool beforePrefix(const QString &word, const QString &prefix)
+{
+    const int common = qMin(word.size(), prefix.size());
+    for (int i = 0; i < common; ++i) {
+        const QChar unit = prefix.at(i).toLower();
+        if (word.at(i) != unit)
+            return word.at(i).unicode() < unit.unicode();
+    }
+    return word.size() < prefix.size();
+}
+
+// -----------------------------------------------------------------------------------------------
+// WordCompleter
+
+WordCompleter::WordCompleter(const QString &databaseName, const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , m_databaseName(databaseName)
+    , m_fileName(fileName)
+    , m_thread(0)
+    , m_builder(0)
+    , m_rebuildPending(false)
+    , m_map(0)
+    , m_size(0)
+    , m_nodes(0)
+    , m_words(0)
+    , m_lastEventId(0)
+    , m_stamp(0)
+    , m_deltaLastEventId(0)
+    , m_deltaBytes(0)
+{
+}
+
+WordCompleter::~WordCompleter()
+{
+    stop();
+    close();
+}
+
+bool WordCompleter::open(QSqlDatabase database)
+{
+    // A trie written before the journal was encrypted goes with the plaintext.
+    if (CryptoVfs::hasKeys()) {
+        if (m_memory.isEmpty())
+            close();
+        QFile::remove(m_fileName);
+        QFile::remove(deltaFileName());
+    } else if (mapFile()) {
+        loadDelta();
+    }
+
+    // Entries that neither the trie nor its delta has seen came in by an
+    // import or a sync, or were written while the delta could not be saved.
+    qint64 lastEventId = 0;
+    QSqlQuery query(database);
+    if (query.exec("SELECT MAX(eventID) FROM events WHERE deletedAt IS NULL") && query.next())
+        lastEventId = query.value(0).toLongLong();
+    if (!m_map || qMax(m_lastEventId, m_deltaLastEventId) < lastEventId
+        || m_recent.size() >= COMPLETION_REBUILD_WORDS || m_deltaBytes >= COMPLETION_DELTA_MAX_BYTES)
+        rebuild();
+    return m_map != 0;
+}
+
+void WordCompleter::close()
+{
+    if (m_map && m_memory.isEmpty())
+        m_file.unmap(const_cast<uchar *>(m_map));
+    m_file.close();
+    m_memory.clear();
+    m_map = 0;
+    m_size = 0;
+    m_nodes = 0;
+    m_words = 0;
+    m_lastEventId = 0;
+    m_stamp = 0;
+}
+
+void WordCompleter::rebuild()
+{
+    if (isBuilding()) {
+        m_rebuildPending = true;
+        return;
+    }
+    stop();
+    m_rebuildPending = false;
+
+    // Until the build is done, what was counted so far stays apart from what comes next.
+    m_building = m_recent;
+    m_recent.clear();
+
+    m_thread = new QThread(this);
+    m_builder = new CompletionBuilder(m_databaseName, CryptoVfs::hasKeys() ? QString() : m_fileName);
+    m_builder->moveToThread(m_thread);
+
+    connect(m_thread, SIGNAL(started()), m_builder, SLOT(run()));
+    connect(m_builder, SIGNAL(finished(bool, int)), m_thread, SLOT(quit()));
+    connect(m_builder, SIGNAL(finished(bool, int)), this, SLOT(onBuilt(bool, int)));
+
+    m_thread->start(QThread::LowPriority);
+}
+
+bool WordCompleter::isBuilding() const
+{
+    return m_thread && m_thread->isRunning();
+}
+
+void WordCompleter::stop()
+{
+    if (!m_thread)
+        return;
+
+    m_builder->stop();
+    m_thread->quit();
+    m_thread->wait();
+
+    delete m_builder;
+    m_builder = 0;
+    delete m_thread;
+    m_thread = 0;
+}
+
+void WordCompleter::onBuilt(bool ok, int words)
+{
+    const QByteArray data = m_builder ? m_builder->takeData() : QByteArray();
+    stop();
+
+    if (ok) {
+        close();
+        if (!data.isEmpty()) {
+            m_memory = data;
+            ok = adopt(reinterpret_cast<const uchar *>(m_memory.constData()), m_memory.size());
+        } else {
+            ok = mapFile();
+        }
+    }
+
+    if (!ok) {
+        // The words are kept for the next try.
+        for (int i = 0; i < m_building.size(); ++i)
+            addWord(m_recent, m_building.at(i).word, m_building.at(i).count);
+        m_building.clear();
+        qWarning() << "WordCompleter: the completions could not be rebuilt";
+    } else {
+        m_building.clear();
+        // The words counted during the build are all that the new trie lacks.
+        if (m_memory.isEmpty() && !writeDelta())
+            qWarning() << "WordCompleter: could not write" << deltaFileName();
+        qDebug() << "WordCompleter:" << words << "words";
+        emit rebuilt(words);
+    }
+
+    if (m_rebuildPending)
+        rebuild();
+}
+
+void WordCompleter::addText(const QString &text, qint64 eventId)
+{
+    const QStringList found = words(text);
+    RecentWords entry;
+    for (int i = 0; i < found.size(); ++i)
+        addWord(entry, found.at(i), 1);
+    if (!CryptoVfs::hasKeys() && !entry.isEmpty())
+        appendDelta(eventId, entry);
+    for (int i = 0; i < entry.size(); ++i)
+        addWord(m_recent, entry.at(i).word, entry.at(i).count);
+
+    if (m_recent.size() >= COMPLETION_REBUILD_WORDS || m_deltaBytes >= COMPLETION_DELTA_MAX_BYTES)
+        rebuild();
+}
+
+void WordCompleter::addWord(RecentWords &recent, const QString &word, quint32 count)
+{
+    int low = 0;
+    int high = recent.size();
+    while (low < high) {
+        const int middle = (low + high) / 2;
+        if (compareWord(recent.at(middle).word, word.unicode(), word.size()) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low < recent.size() && recent.at(low).word == word) {
+        recent[low].count += count;
+    } else {
+        RecentWord entry;
+        entry.word = word;
+        entry.count = count;
+        recent.insert(low, entry);
+    }
+}
+
+int WordCompleter::complete(const QString &prefix, CompletionHit *hits, int maxHits) const
+{
+    int found = 0;
+    if (prefix.isEmpty() || prefix.size() >= COMPLETION_MAX_WORD || maxHits <= 0)
+        return 0;
+
+    // The node of the prefix already knows its most used words.
+    const qint64 index = m_map ? findNode(prefix.unicode(), prefix.size()) : -1;
+    if (index >= 0) {
+        const uchar *prefixNode = node(quint32(index));
+        const ushort *text = reinterpret_cast<const ushort *>(
+            m_map + COMPLETION_HEADER_BYTES + m_nodes * COMPLETION_NODE_BYTES
+            + m_words * COMPLETION_WORD_BYTES);
+        for (int k = 0; k < COMPLETION_TOP_K; ++k) {
+            const quint32 id = qFromLittleEndian<quint32>(prefixNode + NodeTop + 4 * k);
+            if (id == COMPLETION_NONE)
+                break;
+            const uchar *word = m_map + COMPLETION_HEADER_BYTES + m_nodes * COMPLETION_NODE_BYTES
+                              + id * COMPLETION_WORD_BYTES;
+            const int length = int(qFromLittleEndian<quint32>(word + WordLength));
+            if (length <= prefix.size())
+                continue;
+
+            QChar units[COMPLETION_MAX_WORD];
+            const ushort *start = text + qFromLittleEndian<quint32>(word + WordTextOffset);
+            for (int i = 0; i < length; ++i)
+                units[i] = QChar(qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(start + i)));
+            const quint32 count = qFromLittleEndian<quint32>(word + WordCount)
+                                + recentCount(m_recent, units, length)
+                                + recentCount(m_building, units, length);
+            addHit(hits, found, maxHits, units, length, count);
+        }
+    }
+
+    // Words written since the build may rank among them.
+    addRecent(m_recent, prefix, hits, found, maxHits);
+    addRecent(m_building, prefix, hits, found, maxHits);
+    return found;
+}
+
+QStringList WordCompleter::words(const QString &text)
+{
+    QStringList found;
+    int start = -1;
+    for (int i = 0; i <= text.size(); ++i) {
+        const bool inWord = i < text.size()
+                            && (text.at(i).isLetterOrNumber()
+                                || (text.at(i) == '\'' && start >= 0 && i + 1 < text.size()
+                                    && text.at(i + 1).isLetter()));
+        if (inWord && start < 0) {
+            start = i;
+        } else if (!inWord && start >= 0) {
+            const int length = i - start;
+            if (length >= COMPLETION_MIN_WORD && length <= COMPLETION_MAX_WORD)
+                found << text.mid(start, length).toLower();
+            start = -1;
+        }
+    }
+    return found;
+}
+
+QByteArray WordCompleter::build(const QHash<QString, quint32> &counts, qint64 lastEventId,
+                                quint32 stamp)
+{
+    QStringList sorted = counts.keys();
+    qSort(sorted);
+    QVector<quint32> wordCounts(sorted.size());
+    for (int i = 0; i < sorted.size(); ++i)
+        wordCounts[i] = counts.value(sorted.at(i));
+
+    // Breadth first, so the children of every node are allocated together.
+    QVector<BuildNode> nodes(1);
+    QVector<BuildSpan> spans;
+    BuildSpan root = { 0, 0, sorted.size(), 0 };
+    spans << root;
+    for (int s = 0; s < spans.size(); ++s) {
+        const BuildSpan span = spans.at(s);
+
+        // The most used words below the node, ties in alphabetical order.
+        quint32 *top = nodes[span.node].top;
+        for (int i = span.first; i < span.last; ++i) {
+            int k = COMPLETION_TOP_K;
+            while (k > 0 && (top[k - 1] == COMPLETION_NONE || wordCounts.at(i) > wordCounts.at(top[k - 1])))
+                --k;
+            if (k == COMPLETION_TOP_K)
+                continue;
+            for (int j = COMPLETION_TOP_K - 1; j > k; --j)
+                top[j] = top[j - 1];
+            top[k] = quint32(i);
+        }
+
+        // A word as long as the prefix sorts first.
+        int first = span.first;
+        if (first < span.last && sorted.at(first).size() == span.depth)
+            nodes[span.node].word = quint32(first++);
+
+        nodes[span.node].firstChild = quint32(nodes.size());
+        while (first < span.last) {
+            const ushort unit = sorted.at(first).at(span.depth).unicode();
+            int last = first + 1;
+            while (last < span.last && sorted.at(last).at(span.depth).unicode() == unit)
+                ++last;
+
+            BuildNode child;
+            child.unit = unit;
+            nodes << child;
+            ++nodes[span.node].children;
+            BuildSpan childSpan = { nodes.size() - 1, first, last, span.depth + 1 };
+            spans << childSpan;
+            first = last;
+        }
+    }
+
+    quint32 textUnits = 0;
+    for (int i = 0; i < sorted.size(); ++i)
+        textUnits += sorted.at(i).size();
+
+    QByteArray data(COMPLETION_HEADER_BYTES + nodes.size() * COMPLETION_NODE_BYTES
+                    + sorted.size() * COMPLETION_WORD_BYTES + 2 * textUnits, '\0');
+    uchar *out = reinterpret_cast<uchar *>(data.data());
+    memcpy(out, COMPLETION_MAGIC, sizeof(COMPLETION_MAGIC));
+    qToLittleEndian<quint32>(COMPLETION_FORMAT, out + HeaderFormat);
+    qToLittleEndian<qint64>(lastEventId, out + HeaderLastEventId);
+    qToLittleEndian<quint32>(quint32(nodes.size()), out + HeaderNodes);
+    qToLittleEndian<quint32>(quint32(sorted.size()), out + HeaderWords);
+    qToLittleEndian<quint32>(textUnits, out + HeaderTextUnits);
+    qToLittleEndian<quint32>(stamp, out + HeaderStamp);
+
+    uchar *entry = out + COMPLETION_HEADER_BYTES;
+    for (int i = 0; i < nodes.size(); ++i, entry += COMPLETION_NODE_BYTES) {
+        const BuildNode &node = nodes.at(i);
+        qToLittleEndian<quint32>(node.unit, entry + NodeUnit);
+        qToLittleEndian<quint32>(node.firstChild, entry + NodeFirstChild);
+        qToLittleEndian<quint32>(node.children, entry + NodeChildren);
+        qToLittleEndian<quint32>(node.word, entry + NodeWord);
+        for (int k = 0; k < COMPLETION_TOP_K; ++k)
+            qToLittleEndian<quint32>(node.top[k], entry + NodeTop + 4 * k);
+    }
+
+    uchar *text = entry + sorted.size() * COMPLETION_WORD_BYTES;
+    quint32 offset = 0;
+    for (int i = 0; i < sorted.size(); ++i, entry += COMPLETION_WORD_BYTES) {
+        const QString &word = sorted.at(i);
+        qToLittleEndian<quint32>(offset, entry + WordTextOffset);
+        qToLittleEndian<quint32>(quint32(word.size()), entry + WordLength);
+        qToLittleEndian<quint32>(wordCounts.at(i), entry + WordCount);
+        for (int c = 0; c < word.size(); ++c)
+            qToLittleEndian<quint16>(word.at(c).unicode(), text + 2 * (offset + c));
+        offset += word.size();
+    }
+    return data;
+}
+
+bool WordCompleter::write(const QString &fileName, const QByteArray &data)
+{
+    // Written beside the old trie and renamed, so a crash leaves one or the other.
+    const QString temporary = fileName + ".tmp";
+    QFile file(temporary);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    const bool ok = file.write(data) == data.size() && file.flush() && fsync(file.handle()) == 0;
+    file.close();
+    if (!ok) {
+        QFile::remove(temporary);
+        return false;
+    }
+    return ::rename(QFile::encodeName(temporary).constData(),
+                    QFile::encodeName(fileName).constData()) == 0;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Delta file
+
+QString WordCompleter::deltaFileName() const
+{
+    return m_fileName + ".delta";
+}
+
+QByteArray WordCompleter::deltaRecord(qint64 eventId, const RecentWords &words)
+{
+    int bytes = 12;
+    for (int i = 0; i < words.size(); ++i)
+        bytes += 8 + 2 * words.at(i).word.size();
+
+    QByteArray record(bytes, '\0');
+    uchar *out = reinterpret_cast<uchar *>(record.data());
+    qToLittleEndian<qint64>(eventId, out);
+    qToLittleEndian<quint32>(quint32(words.size()), out + 8);
+    out += 12;
+    for (int i = 0; i < words.size(); ++i) {
+        const QString &word = words.at(i).word;
+        qToLittleEndian<quint32>(words.at(i).count, out);
+        qToLittleEndian<quint32>(quint32(word.size()), out + 4);
+        out += 8;
+        for (int c = 0; c < word.size(); ++c, out += 2)
+            qToLittleEndian<quint16>(word.at(c).unicode(), out);
+    }
+    return record;
+}
+
+bool WordCompleter::loadDelta()
+{
+    m_recent.clear();
+    m_deltaLastEventId = 0;
+    m_deltaBytes = 0;
+
+    QFile file(deltaFileName());
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray data = file.readAll();
+    file.close();
+    const uchar *in = reinterpret_cast<const uchar *>(data.constData());
+    if (data.size() < COMPLETION_DELTA_HEADER_BYTES
+        || memcmp(in, COMPLETION_DELTA_MAGIC, sizeof(COMPLETION_DELTA_MAGIC)) != 0
+        || qFromLittleEndian<quint32>(in + DeltaFormat) != COMPLETION_DELTA_FORMAT
+        || qFromLittleEndian<quint32>(in + DeltaStamp) != m_stamp) {
+        QFile::remove(deltaFileName());
+        return false;
+    }
+
+    // A record cut short by a crash ends the delta; it is written again without it.
+    const uchar *end = in + data.size();
+    const uchar *record = in + COMPLETION_DELTA_HEADER_BYTES;
+    RecentWords words;
+    while (end - record >= 12) {
+        const qint64 eventId = qFromLittleEndian<qint64>(record);
+        const quint32 count = qFromLittleEndian<quint32>(record + 8);
+        const uchar *word = record + 12;
+        words.clear();
+        for (quint32 i = 0; i < count; ++i) {
+            if (end - word < 8)
+                break;
+            const quint32 length = qFromLittleEndian<quint32>(word + 4);
+            if (length > COMPLETION_MAX_WORD || end - word - 8 < qint64(2 * length))
+                break;
+            RecentWord entry;
+            entry.count = qFromLittleEndian<quint32>(word);
+            entry.word.resize(int(length));
+            for (quint32 c = 0; c < length; ++c)
+                entry.word[int(c)] = QChar(qFromLittleEndian<quint16>(word + 8 + 2 * c));
+            words << entry;
+            word += 8 + 2 * length;
+        }
+        if (quint32(words.size()) != count)
+            break;
+        for (int i = 0; i < words.size(); ++i)
+            addWord(m_recent, words.at(i).word, words.at(i).count);
+        m_deltaLastEventId = qMax(m_deltaLastEventId, eventId);
+        record = word;
+    }
+
+    m_deltaBytes = record - in;
+    if (record != end)
+        return writeDelta();
+    return true;
+}
+
+bool WordCompleter::writeDelta()
+{
+    // What is counted in memory is exactly what the mapped trie lacks.
+    QByteArray data(COMPLETION_DELTA_HEADER_BYTES, '\0');
+    uchar *out = reinterpret_cast<uchar *>(data.data());
+    memcpy(out, COMPLETION_DELTA_MAGIC, sizeof(COMPLETION_DELTA_MAGIC));
+    qToLittleEndian<quint32>(COMPLETION_DELTA_FORMAT, out + DeltaFormat);
+    qToLittleEndian<quint32>(m_stamp, out + DeltaStamp);
+    if (!m_building.isEmpty())
+        data += deltaRecord(m_deltaLastEventId, m_building);
+    if (!m_recent.isEmpty())
+        data += deltaRecord(m_deltaLastEventId, m_recent);
+
+    m_deltaBytes = data.size();
+    return write(deltaFileName(), data);
+}
+
+void WordCompleter::appendDelta(qint64 eventId, const RecentWords &words)
+{
+    // Without a trie there is nothing for the delta to add to yet.
+    if (!m_map)
+        return;
+
+    QFile file(deltaFileName());
+    if (m_deltaBytes == 0 && !writeDelta()) {
+        qWarning() << "WordCompleter: could not write" << deltaFileName();
+        return;
+    }
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append))
+        return;
+    const QByteArray record = deltaRecord(eventId, words);
+    if (file.write(record) == record.size()) {
+        m_deltaLastEventId = qMax(m_deltaLastEventId, eventId);
+        m_deltaBytes += record.size();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------
+// Trie file
+
+bool WordCompleter::mapFile()
+{
+    close();
+    m_file.setFileName(m_fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 size = m_file.size();
+    const uchar *map = size >= COMPLETION_HEADER_BYTES ? m_file.map(0, size) : 0;
+    if (!map || !adopt(map, size)) {
+        if (map)
+            m_file.unmap(const_cast<uchar *>(map));
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+bool WordCompleter::adopt(const uchar *data, qint64 size)
+{
+    if (size < COMPLETION_HEADER_BYTES || memcmp(data, COMPLETION_MAGIC, sizeof(COMPLETION_MAGIC)) != 0
+        || qFromLittleEndian<quint32>(data + HeaderFormat) != COMPLETION_FORMAT)
+        return false;
+
+    // Every child, word and text unit must lie inside the trie.
+    const quint32 nodes = qFromLittleEndian<quint32>(data + HeaderNodes);
+    const quint32 words = qFromLittleEndian<quint32>(data + HeaderWords);
+    const quint32 textUnits = qFromLittleEndian<quint32>(data + HeaderTextUnits);
+    bool ok = nodes > 0 && COMPLETION_HEADER_BYTES + qint64(nodes) * COMPLETION_NODE_BYTES
+                           + qint64(words) * COMPLETION_WORD_BYTES + 2 * qint64(textUnits) <= size;
+    const uchar *entry = data + COMPLETION_HEADER_BYTES;
+    for (quint32 i = 0; ok && i < nodes; ++i, entry += COMPLETION_NODE_BYTES) {
+        const quint32 word = qFromLittleEndian<quint32>(entry + NodeWord);
+        ok = qint64(qFromLittleEndian<quint32>(entry + NodeFirstChild))
+             + qFromLittleEndian<quint32>(entry + NodeChildren) <= nodes
+             && (word == COMPLETION_NONE || word < words);
+        for (int k = 0; ok && k < COMPLETION_TOP_K; ++k) {
+            const quint32 top = qFromLittleEndian<quint32>(entry + NodeTop + 4 * k);
+            ok = top == COMPLETION_NONE || top < words;
+        }
+    }
+    for (quint32 i = 0; ok && i < words; ++i, entry += COMPLETION_WORD_BYTES) {
+        const quint32 length = qFromLittleEndian<quint32>(entry + WordLength);
+        ok = length <= COMPLETION_MAX_WORD
+             && qint64(qFromLittleEndian<quint32>(entry + WordTextOffset)) + length <= textUnits;
+    }
+    if (!ok)
+        return false;
+
+    m_map = data;
+    m_size = size;
+    m_nodes = nodes;
+    m_words = words;
+    m_lastEventId = qFromLittleEndian<qint64>(data + HeaderLastEventId);
+    m_stamp = qFromLittleEndian<quint32>(data + HeaderStamp);
+    return true;
+}
+
+const uchar *WordCompleter::node(quint32 index) const
+{
+    return m_map + COMPLETION_HEADER_BYTES + index * COMPLETION_NODE_BYTES;
+}
+
+qint64 WordCompleter::findNode(const QChar *word, int length) const
+{
+    quint32 index = 0;
+    for (int i = 0; i < length; ++i) {
+        const quint32 unit = word[i].toLower().unicode();
+        const uchar *parent = node(index);
+        quint32 low = qFromLittleEndian<quint32>(parent + NodeFirstChild);
+        quint32 high = low + qFromLittleEndian<quint32>(parent + NodeChildren);
+
+        // Binary search over the children, which are sorted by unit.
+        while (low < high) {
+            const quint32 middle = low + (high - low) / 2;
+            if (qFromLittleEndian<quint32>(node(middle) + NodeUnit) < unit) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        if (low == qFromLittleEndian<quint32>(parent + NodeFirstChild)
+                   + qFromLittleEndian<quint32>(parent + NodeChildren)
+            || qFromLittleEndian<quint32>(node(low) + NodeUnit) != unit)
+            return -1;
+        index = low;
+    }
+    return index;
+}
+
+quint32 WordCompleter::mappedCount(const QChar *word, int length) const
+{
+    const qint64 index = m_map ? findNode(word, length) : -1;
+    if (index < 0)
+        return 0;
+    const quint32 id = qFromLittleEndian<quint32>(node(quint32(index)) + NodeWord);
+    if (id == COMPLETION_NONE)
+        return 0;
+    return qFromLittleEndian<quint32>(m_map + COMPLETION_HEADER_BYTES + m_nodes * COMPLETION_NODE_BYTES
+                                      + id * COMPLETION_WORD_BYTES + WordCount);
+}
+
+quint32 WordCompleter::recentCount(const RecentWords &recent, const QChar *word, int length)
+{
+    int low = 0;
+    int high = recent.size() - 1;
+    while (low <= high) {
+        const int middle = (low + high) / 2;
+        const int order = compareWord(recent.at(middle).word, word, length);
+        if (order < 0) {
+            low = middle + 1;
+        } else if (order > 0) {
+            high = middle - 1;
+        } else {
+            return recent.at(middle).count;
+        }
+    }
+    return 0;
+}
+
+void WordCompleter::addHit(CompletionHit *hits, int &found, int maxHits, const QChar *word,
+                           int length, quint32 count)
+{
+    int position = found;
+    for (int i = 0; i < found; ++i) {
+        if (hits[i].length == length && memcmp(hits[i].text, word, length * sizeof(QChar)) == 0)
+            return;
+        if (position == found && hits[i].count < count)
+            position = i;
+    }
+    if (position >= maxHits)
+        return;
+
+    if (found < maxHits)
+        ++found;
+    for (int i = found - 1; i > position; --i)
+        hits[i] = hits[i - 1];
+    memcpy(hits[position].text, word, length * sizeof(QChar));
+    hits[position].length = length;
+    hits[position].count = count;
+}
+
+void WordCompleter::addRecent(const RecentWords &recent, const QString &prefix, CompletionHit *hits,
+                              int &found, int maxHits) const
+{
+    int low = 0;
+    int high = recent.size();
+    while (low < high) {
+        const int middle = (low + high) / 2;
+        if (beforePrefix(recent.at(middle).word, prefix)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    for (int i = low; i < recent.size() && hasPrefix(recent.at(i).word, prefix); ++i) {
+        const QString &word = recent.at(i).word;
+        if (word.size() <= prefix.size())
+            continue;
+        const quint32 count = mappedCount(word.unicode(), word.size())
+                            + recentCount(m_recent, word.unicode(), word.size())
+                            + recentCount(m_building, word.unicode(), word.size());
+        addHit(hits, found, maxHits, word.unicode(), word.size(), count);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------
+// CompletionBuilder
+
+CompletionBuilder::CompletionBuilder(const QString &databaseName, const QString &fileName)
+    : m_databaseName(databaseName)
+    , m_fileName(fileName)
+    , m_stopRequested(0)
+{
+}
+
+void CompletionBuilder::stop()
+{
+    m_stopRequested.fetchAndStoreOrdered(1);
+}
+
+QByteArray CompletionBuilder::takeData()
+{
+    QByteArray data = m_data;
+    m_data.clear();
+    return data;
+}
+
+void CompletionBuilder::run()
+{
+    IoScope io("word completion");
+    bool ok = false;
+    int words = 0;
+    {
+        QSqlDatabase database = QSqlDatabase::addDatabase("QSQLITE", COMPLETION_CONNECTION);
+        database.setDatabaseName(m_databaseName);
+        database.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000");
+
+        if (!database.open()) {
+            qWarning() << "CompletionBuilder: " << database.lastError().text();
+        } else {
+            QHash<QString, quint32> counts;
+            qint64 lastEventId = 0;
+            QSqlQuery query(database);
+            query.setForwardOnly(true);
+            if (query.exec("SELECT eventID, textEvent FROM events WHERE deletedAt IS NULL")) {
+                while (!m_stopRequested && query.next()) {
+                    lastEventId = qMax(lastEventId, query.value(0).toLongLong());
+                    const QStringList found = WordCompleter::words(query.value(1).toString());
+                    for (int i = 0; i < found.size(); ++i)
+                        ++counts[found.at(i)];
+                }
+                ok = !m_stopRequested && !query.lastError().isValid();
+            }
+            query.finish();
+            database.close();
+
+            if (ok) {
+                // The stamp tells the delta of this trie from that of the one before.
+                m_data = WordCompleter::build(counts, lastEventId,
+                                              quint32(QDateTime::currentMSecsSinceEpoch()));
+                words = counts.size();
+                if (!m_fileName.isEmpty()) {
+                    ok = WordCompleter::write(m_fileName, m_data);
+                    m_data.clear();
+                }
+            }
+        }
+    }
+    QSqlDatabase::removeDatabase(COMPLETION_CONNECTION);
+
+    emit finished(ok, words);
+}
@@ -0,0 +1,181 @@
+/*
+ * wordcompleter.hpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+
+#ifndef WORDCOMPLETER_HPP_
+#define WORDCOMPLETER_HPP_
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QtSql/QSqlDatabase>
+
+class QThread;
+class CompletionBuilder;
+
+#define COMPLETION_TOP_K 5              // completions kept at every node of the trie
+#define COMPLETION_MIN_WORD 3           // shorter words are not worth completing
+#define COMPLETION_MAX_WORD 32
+#define COMPLETION_REBUILD_WORDS 500    // new distinct words that start a rebuild
+#define COMPLETION_DELTA_MAX_BYTES (256 * 1024)     // a larger overlay file starts one too
+
+struct CompletionHit
+{
+    QChar text[COMPLETION_MAX_WORD];    // lower case
+    int length;
+    quint32 count;                      // times the word was written
+};
+
+/*
+ * @brief Completes words from the ones in the journal, most used first.
+ *
+ * The words of all entries are counted on a background thread into a trie
+ * written to 'fileName', which is memory-mapped from then on, so it is not
+ * rebuilt at every start. Layout (little endian):
+ *
+ *   header  [magic][u32 format][i64 last eventID][u32 nodes][u32 words]
+ *           [u32 text units][u32 build stamp]
+ *   nodes   nodes x [u32 UTF-16 unit][u32 first child][u32 children]
+ *                   [u32 word ending here][u32 x COMPLETION_TOP_K top words]
+ *   words   words x [u32 text offset][u32 length][u32 count]
+ *   text    UTF-16 words, lower case
+ *
+ * Node 0 is the root. The children of a node are next to each other and
+ * sorted by unit. Every node keeps the most used words below it, so a
+ * completion is a walk down the prefix and a read of its node.
+ *
+ * Words of entries saved since the build are counted in memory and merged
+ * into the results, until enough of them have piled up for a rebuild. They
+ * are also appended to 'fileName'.delta, read back at the next start, so a
+ * few new entries do not rebuild the trie at every launch:
+ *
+ *   header  [magic][u32 format][u32 build stamp of the trie it adds to]
+ *   record  [i64 eventID][u32 words] words x [u32 count][u32 length][UTF-16]
+ *
+ * A delta whose stamp is not the trie's is from before the last build and
+ * is dropped.
+ *
+ * Once the journal is encrypted, the words are no longer written out in the
+ * clear: the trie is built into memory at every start instead.
+ */
+class WordCompleter : public QObject
+{
+    Q_OBJECT
+
+public:
+    WordCompleter(const QString &databaseName, const QString &fileName, QObject *parent = 0);
+    ~WordCompleter();
+
+    // Maps the file, and rebuilds it in the background if it is missing or
+    // older than the newest entry in 'database'.
+    bool open(QSqlDatabase database);
+    void close();
+
+    // A rebuild asked for during one starts when it is done.
+    void rebuild();
+    bool isBuilding() const;
+    void stop();
+
+    // Counts the words of a saved entry.
+    void addText(const QString &text, qint64 eventId);
+
+    // Fills 'hits' with up to 'maxHits' of the most used words longer than
+    // 'prefix' that start with it, ignoring case; best first. Allocates nothing.
+    int complete(const QString &prefix, CompletionHit *hits, int maxHits) const;
+
+    // The words of 'text' as they are counted: letters and digits, lower case.
+    static QStringList words(const QString &text);
+
+    // The trie file for 'counts', as laid out above.
+    static QByteArray build(const QHash<QString, quint32> &counts, qint64 lastEventId,
+                            quint32 stamp);
+    static bool write(const QString &fileName, const QByteArray &data);
+
+Q_SIGNALS:
+    void rebuilt(int words);
+
+private Q_SLOTS:
+    void onBuilt(bool ok, int words);
+
+private:
+    struct RecentWord
+    {
+        QString word;
+        quint32 count;
+    };
+    typedef QVector<RecentWord> RecentWords;
+
+    static void addWord(RecentWords &recent, const QString &word, quint32 count);
+    static QByteArray deltaRecord(qint64 eventId, const RecentWords &words);
+    QString deltaFileName() const;
+    bool loadDelta();
+    bool writeDelta();
+    void appendDelta(qint64 eventId, const RecentWords &words);
+    bool mapFile();
+    bool adopt(const uchar *data, qint64 size);
+    const uchar *node(quint32 index) const;
+    qint64 findNode(const QChar *word, int length) const;
+    quint32 mappedCount(const QChar *word, int length) const;
+    static quint32 recentCount(const RecentWords &recent, const QChar *word, int length);
+    static void addHit(CompletionHit *hits, int &found, int maxHits, const QChar *word, int length,
+                       quint32 count);
+    void addRecent(const RecentWords &recent, const QString &prefix, CompletionHit *hits,
+                   int &found, int maxHits) const;
+
+    QString m_databaseName;
+    QString m_fileName;
+    QThread *m_thread;
+    CompletionBuilder *m_builder;
+    bool m_rebuildPending;
+
+    QFile m_file;
+    QByteArray m_memory;        // the trie of an encrypted journal
+    const uchar *m_map;
+    qint64 m_size;
+    quint32 m_nodes;
+    quint32 m_words;
+    qint64 m_lastEventId;
+    quint32 m_stamp;
+
+    // The newest entry in the delta file, and its size.
+    qint64 m_deltaLastEventId;
+    qint64 m_deltaBytes;
+
+    // Counted since the build, sorted by word; the second set is being built into the file.
+    RecentWords m_recent;
+    RecentWords m_building;
+};
+
+class CompletionBuilder : public QObject
+{
+    Q_OBJECT
+
+public:
+    // An empty 'fileName' keeps the trie in memory, see takeData().
+    CompletionBuilder(const QString &databaseName, const QString &fileName);
+
+    void stop();
+    QByteArray takeData();
+
+public Q_SLOTS:
+    void run();
+
+Q_SIGNALS:
+    void finished(bool ok, int words);
+
+private:
+    QString m_databaseName;
+    QString m_fileName;
+    QAtomicInt m_stopRequested;
+    QByteArray m_data;
+};
+
+#endif /* WORDCOMPLETER_HPP_ */
@@ -0,0 +1,14 @@
+# Storage tests that run on a desktop Linux build, without the device or the
+# BB10 runtime:
+#
+#   qmake tests.pro && make && ./tst_storage
+
+TEMPLATE = app
+TARGET = tst_storage
+CONFIG += console qtestlib warn_on
+CONFIG -= app_bundle
+
+include(../core.pri)
+
+SOURCES +=  \
+    tst_storage.cpp
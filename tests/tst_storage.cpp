@@ -0,0 +1,451 @@
+/*
+ * tst_storage.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "journalexporter.hpp"
+#include "logstorage.hpp"
+#include "memorystorage.hpp"
+#include "revisionstore.hpp"
+#include "rowindex.hpp"
+#include "shardedstorage.hpp"
+#include "sqlitestorage.hpp"
+#include "syncclient.hpp"
+#include "syncserver.hpp"
+#include "textdelta.hpp"
+#include "trashstore.hpp"
+
+#include <QDateTime>
+#include <QDir>
+#include <QtTest/QtTest>
+
+/*
+ * @brief The write and read paths of the storage backends, on a desktop build.
+ *
+ * Runs against MemoryStorage, which is the on-device schema and SQL in a
+ * private :memory: database, and against LogStorage in a scratch directory.
+ * The helpers above the backends (deltas, row index, export, sync against
+ * the in-process SyncServer) are checked on the same journals.
+ */
+class StorageTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void memoryStartsEmpty();
+    void memoryInstancesAreSeparate();
+    void addAndRead();
+    void rangeKeepsRowOrder();
+    void updateKeepsRevisions();
+    void trashHidesEntry();
+    void searchMatchesTextAndDates();
+    void bufferedWritesFlush();
+    void logStorageReopens();
+    void shardsImportJournal();
+    void textDeltaRoundTrips();
+    void rowIndexFollowsTrash();
+    void exportVerifiesAndDetectsDamage();
+    void syncCarriesEntriesAndEdits();
+
+private:
+    static QString stamp(int day);
+    static void removeDirectory(const QString &path);
+};
+
+QString StorageTest::stamp(int day)
+{
+    return QDateTime(QDate(2026, 1, 1).addDays(day), QTime(9, 30)).toString();
+}
+
+void StorageTest::removeDirectory(const QString &path)
+{
+    QDir directory(path);
+    const QStringList files = directory.entryList(QDir::Files | QDir::Hidden);
+    for (int i = 0; i < files.size(); ++i)
+        directory.remove(files.at(i));
+    QDir().rmdir(path);
+}
+
+void StorageTest::memoryStartsEmpty()
+{
+    MemoryStorage storage;
+    QVERIFY2(storage.open(), qPrintable(storage.lastError()));
+    QCOMPARE(storage.count(), 0);
+    EventRecord record;
+    QVERIFY(!storage.event(0, record));
+    QVERIFY(storage.range(0, 10).isEmpty());
+}
+
+void StorageTest::memoryInstancesAreSeparate()
+{
+    MemoryStorage first;
+    MemoryStorage second;
+    QVERIFY(first.open());
+    QVERIFY(second.open());
+    QVERIFY(first.addRecord(stamp(0), "only in the first") >= 0);
+    QCOMPARE(first.count(), 1);
+    QCOMPARE(second.count(), 0);
+}
+
+void StorageTest::addAndRead()
+{
+    MemoryStorage storage;
+    QVERIFY(storage.open());
+    const qint64 eventId = storage.addRecord(stamp(3), "A walk by the river #outside");
+    QVERIFY2(eventId >= 0, qPrintable(storage.lastError()));
+    QCOMPARE(storage.count(), 1);
+
+    EventRecord record;
+    QVERIFY(storage.event(0, record));
+    QCOMPARE(record.eventId, eventId);
+    QCOMPARE(record.timeStamp, stamp(3));
+    QCOMPARE(record.createdAt, eventTimeFromString(stamp(3)));
+    QCOMPARE(record.textEvent, QString("A walk by the river #outside"));
+
+    EventRecord byId;
+    QVERIFY(storage.eventById(eventId, byId));
+    QCOMPARE(byId.textEvent, record.textEvent);
+}
+
+void StorageTest::rangeKeepsRowOrder()
+{
+    MemoryStorage storage;
+    QVERIFY(storage.open());
+    for (int i = 0; i < 50; ++i)
+        QVERIFY(storage.addRecord(stamp(i), QString("entry %1").arg(i)) >= 0);
+
+    const QList<EventRecord> page = storage.range(10, 20);
+    QCOMPARE(page.size(), 20);
+    for (int i = 0; i < page.size(); ++i)
+        QCOMPARE(page.at(i).textEvent, QString("entry %1").arg(10 + i));
+    QCOMPARE(storage.range(45, 20).size(), 5);
+    QCOMPARE(storage.rangeFrom(page.first().eventId, 3).last().textEvent, QString("entry 12"));
+}
+
+void StorageTest::updateKeepsRevisions()
+{
+    MemoryStorage storage;
+    QVERIFY(storage.open());
+    const qint64 eventId = storage.addRecord(stamp(0), "first draft");
+    QVERIFY(storage.updateRecord(eventId, "second draft"));
+    QVERIFY(storage.updateRecord(eventId, "final text"));
+
+    EventRecord record;
+    QVERIFY(storage.eventById(eventId, record));
+    QCOMPARE(record.textEvent, QString("final text"));
+
+    RevisionStore revisions(storage.database());
+    QCOMPARE(revisions.revisions(eventId).size(), 3);
+    QString text;
+    QVERIFY(revisions.materialize(eventId, 0, text));
+    QCOMPARE(text, QString("first draft"));
+    QVERIFY(revisions.materialize(eventId, 1, text));
+    QCOMPARE(text, QString("second draft"));
+
+    QVERIFY(!storage.updateRecord(eventId + 1, "no such entry"));
+}
+
+void StorageTest::trashHidesEntry()
+{
+    MemoryStorage storage;
+    QVERIFY(storage.open());
+    const qint64 kept = storage.addRecord(stamp(0), "kept");
+    const qint64 trashed = storage.addRecord(stamp(1), "trashed");
+
+    TrashStore trash(storage.database());
+    QVERIFY2(trash.trash(trashed, QDateTime::currentDateTime().toTime_t()), qPrintable(trash.lastError()));
+    QCOMPARE(storage.count(), 1);
+    EventRecord record;
+    QVERIFY(storage.event(0, record));
+    QCOMPARE(record.eventId, kept);
+    QCOMPARE(trash.entries().size(), 1);
+
+    QVERIFY(trash.restore(trashed));
+    QCOMPARE(storage.count(), 2);
+}
+
+void StorageTest::searchMatchesTextAndDates()
+{
+    MemoryStorage storage;
+    QVERIFY(storage.open());
+    storage.addRecord(stamp(0), "Coffee with Anna");
+    storage.addRecord(stamp(10), "Long run, then coffee");
+    storage.addRecord(stamp(20), "Rain all day");
+
+    QList<EventRecord> found = storage.search(eventTimeFromString(stamp(0)),
+                                              eventTimeFromString(stamp(30)), "coffee");
+    QCOMPARE(found.size(), 2);
+    QCOMPARE(found.first().textEvent, QString("Coffee with Anna"));
+
+    found = storage.search(eventTimeFromString(stamp(5)), eventTimeFromString(stamp(30)), "coffee");
+    QCOMPARE(found.size(), 1);
+    QCOMPARE(found.first().textEvent, QString("Long run, then coffee"));
+}
+
+void StorageTest::bufferedWritesFlush()
+{
+    MemoryStorage storage;
+    QVERIFY(storage.open());
+    for (int i = 0; i < 10; ++i)
+        QVERIFY(storage.addRecord(stamp(i), "buffered", StorageBackend::Buffered) >= 0);
+    QVERIFY(storage.flush());
+    QCOMPARE(storage.count(), 10);
+}
+
+void StorageTest::logStorageReopens()
+{
+    const QString directory = QDir::temp().filePath(
+        QString("dwriter-log-%1").arg(QCoreApplication::applicationPid()));
+    removeDirectory(directory);
+    QVERIFY(QDir().mkpath(directory));
+
+    {
+        LogStorage storage(directory);
+        QVERIFY2(storage.open(), qPrintable(storage.lastError()));
+        for (int i = 0; i < 300; ++i)
+            QVERIFY(storage.addRecord(stamp(i), QString("log entry %1").arg(i)) >= 0);
+        storage.close();
+    }
+
+    LogStorage storage(directory);
+    QVERIFY2(storage.open(), qPrintable(storage.lastError()));
+    QCOMPARE(storage.count(), 300);
+    EventRecord record;
+    QVERIFY(storage.event(257, record));
+    QCOMPARE(record.textEvent, QString("log entry 257"));
+    QCOMPARE(storage.range(295, 10).size(), 5);
+    storage.close();
+
+    removeDirectory(directory);
+}
+
+void StorageTest::shardsImportJournal()
+{
+    const QString directory = QDir::temp().filePath(
+        QString("dwriter-shards-%1").arg(QCoreApplication::applicationPid()));
+    removeDirectory(directory);
+    QVERIFY(QDir().mkpath(directory));
+    const QString journal = directory + "/DWriteData.db";
+
+    // Twenty entries on each side of New Year; the first of the new year is
+    // in the trash.
+    {
+        SqliteStorage storage(journal, "DWriter-test-journal");
+        QVERIFY2(storage.open(), qPrintable(storage.lastError()));
+        qint64 trashed = -1;
+        for (int i = -20; i < 20; ++i) {
+            const qint64 eventId = storage.addRecord(stamp(i), QString("entry %1").arg(i));
+            QVERIFY(eventId >= 0);
+            if (i == 0)
+                trashed = eventId;
+        }
+        TrashStore trash(storage.database());
+        QVERIFY2(trash.trash(trashed, QDateTime::currentDateTime().toTime_t()), qPrintable(trash.lastError()));
+        storage.close();
+    }
+
+    ShardedStorage shards(directory);
+    QVERIFY2(shards.open(), qPrintable(shards.lastError()));
+    QVERIFY2(shards.importJournal(journal), qPrintable(shards.lastError()));
+    // A second run finds every entry copied already.
+    QVERIFY2(shards.importJournal(journal), qPrintable(shards.lastError()));
+
+    QCOMPARE(shards.count(), 39);
+    QCOMPARE(shards.shardFiles().size(), 2);
+    const QList<EventRecord> records = shards.range(0, 40);
+    QCOMPARE(records.size(), 39);
+    for (int i = 0; i < records.size(); ++i)
+        QCOMPARE(records.at(i).textEvent, QString("entry %1").arg(i < 20 ? i - 20 : i - 19));
+    EventRecord record;
+    QVERIFY2(shards.event(20, record), qPrintable(shards.lastError()));
+    QCOMPARE(record.textEvent, QString("entry 1"));
+    QVERIFY(shards.search(eventTimeFromString(stamp(-20)), eventTimeFromString(stamp(20)), "entry 0").isEmpty());
+    shards.close();
+
+    removeDirectory(directory);
+}
+
+void StorageTest::textDeltaRoundTrips()
+{
+    QByteArray base;
+    for (int i = 0; i < 200; ++i)
+        base += "line " + QByteArray::number(i) + " of a long entry\n";
+
+    QList<QByteArray> targets;
+    targets << base
+            << QByteArray()
+            << QByteArray("all new")
+            << QByteArray(base).insert(base.size() / 2, "an insertion in the middle")
+            << QByteArray(base).remove(100, 300)
+            << QByteArray(base).replace(2000, 5, "changed")
+            << "a prefix " + base + " and a suffix";
+
+    for (int i = 0; i < targets.size(); ++i) {
+        const QByteArray delta = TextDelta::encode(base, targets.at(i));
+        QByteArray target;
+        QVERIFY2(TextDelta::apply(base, delta, target), qPrintable(QString("target %1").arg(i)));
+        QCOMPARE(target, targets.at(i));
+    }
+
+    // A small edit costs about the size of the edit, not of the text.
+    const QByteArray edited = QByteArray(base).replace(2000, 5, "changed");
+    const QByteArray delta = TextDelta::encode(base, edited);
+    QVERIFY(delta.size() < 64);
+
+    QByteArray target;
+    QVERIFY(!TextDelta::apply(base, delta.left(delta.size() - 1), target));
+    QVERIFY(TextDelta::apply(QByteArray(), TextDelta::encode(QByteArray(), "from nothing"), target));
+    QCOMPARE(target, QByteArray("from nothing"));
+}
+
+void StorageTest::rowIndexFollowsTrash()
+{
+    MemoryStorage storage;
+    QVERIFY(storage.open());
+    QList<qint64> eventIds;
+    for (int i = 0; i < 10; ++i)
+        eventIds << storage.addRecord(stamp(i), QString("entry %1").arg(i));
+
+    TrashStore trash(storage.database());
+    const qint64 now = QDateTime::currentDateTime().toTime_t();
+    QVERIFY(trash.trash(eventIds.at(2), now));
+    QVERIFY(trash.trash(eventIds.at(7), now));
+
+    RowIndex index;
+    QVERIFY(index.load(storage.database()));
+    QVERIFY(index.isLoaded());
+    QCOMPARE(index.count(), storage.count());
+    for (int row = 0; row < storage.count(); ++row) {
+        EventRecord record;
+        QVERIFY(storage.event(row, record));
+        QCOMPARE(index.eventAt(row), record.eventId);
+        QCOMPARE(index.rowOf(record.eventId), row);
+    }
+    QCOMPARE(index.eventAt(index.count()), qint64(-1));
+    // A trashed entry would sit where the next one is.
+    QCOMPARE(index.rowOf(eventIds.at(2)), 2);
+
+    const qint64 added = storage.addRecord(stamp(10), "entry 10");
+    index.addEvent(added);
+    QCOMPARE(index.count(), 9);
+    QCOMPARE(index.eventAt(8), added);
+
+    index.removeEvent(eventIds.at(0));
+    QCOMPARE(index.count(), 8);
+    QCOMPARE(index.eventAt(0), eventIds.at(1));
+    QCOMPARE(index.rowOf(added), 7);
+}
+
+void StorageTest::exportVerifiesAndDetectsDamage()
+{
+    const QString directory = QDir::temp().filePath(
+        QString("dwriter-export-%1").arg(QCoreApplication::applicationPid()));
+    removeDirectory(directory);
+    QVERIFY(QDir().mkpath(directory));
+    const QString journal = directory + "/DWriteData.db";
+    const QString exported = directory + "/journal.jsonl";
+
+    {
+        SqliteStorage storage(journal, "DWriter-test-export");
+        QVERIFY2(storage.open(), qPrintable(storage.lastError()));
+        qint64 trashed = -1;
+        for (int i = 0; i < 30; ++i)
+            trashed = storage.addRecord(stamp(i), QString("entry %1 with \"quotes\"").arg(i));
+        TrashStore trash(storage.database());
+        QVERIFY(trash.trash(trashed, QDateTime::currentDateTime().toTime_t()));
+        storage.close();
+    }
+
+    // The worker runs on this thread, as the export thread would run it.
+    {
+        ExportWorker worker(QStringList() << journal, exported);
+        QSignalSpy finished(&worker, SIGNAL(finished(const QString&, int)));
+        QSignalSpy failed(&worker, SIGNAL(error(const QString&)));
+        worker.run();
+        QCOMPARE(failed.count(), 0);
+        QCOMPARE(finished.count(), 1);
+        QCOMPARE(finished.at(0).at(1).toInt(), 29);
+    }
+
+    QString errorText;
+    QVERIFY2(JournalExporter::verify(exported, &errorText), qPrintable(errorText));
+
+    // One flipped byte is found.
+    QFile file(exported);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.size() > 10);
+    QVERIFY(file.seek(file.size() / 2));
+    char byte = 0;
+    QVERIFY(file.getChar(&byte));
+    QVERIFY(file.seek(file.size() / 2));
+    QVERIFY(file.putChar(byte ^ 0x20));
+    file.close();
+    QVERIFY(!JournalExporter::verify(exported, &errorText));
+    QVERIFY(!errorText.isEmpty());
+
+    removeDirectory(directory);
+}
+
+void StorageTest::syncCarriesEntriesAndEdits()
+{
+    MemoryStorage phone;
+    MemoryStorage tablet;
+    QVERIFY(phone.open());
+    QVERIFY(tablet.open());
+
+    SyncServer server;
+    LoopbackTransport phoneLink(&server);
+    LoopbackTransport tabletLink(&server);
+    SyncClient phoneSync(phone.database());
+    SyncClient tabletSync(tablet.database());
+
+    QList<qint64> eventIds;
+    for (int i = 0; i < 3; ++i)
+        eventIds << phone.addRecord(stamp(i), QString("entry %1").arg(i));
+    QCOMPARE(phoneSync.pendingChanges(), 3);
+
+    // SyncStats add up over calls; each sync gets its own.
+    SyncStats first;
+    QVERIFY2(phoneSync.sync(&phoneLink, &first), qPrintable(phoneSync.lastError()));
+    QCOMPARE(first.pushed, 3);
+    QCOMPARE(phoneSync.pendingChanges(), 0);
+
+    SyncStats received;
+    QVERIFY2(tabletSync.sync(&tabletLink, &received), qPrintable(tabletSync.lastError()));
+    QCOMPARE(received.pulled, 3);
+    QCOMPARE(tablet.count(), 3);
+    EventRecord record;
+    QVERIFY(tablet.event(0, record));
+    QCOMPARE(record.textEvent, QString("entry 0"));
+    // Applied changes are not logged to be sent back.
+    QCOMPARE(tabletSync.pendingChanges(), 0);
+
+    // An edit on the phone reaches the tablet, whose text stays in its history.
+    // It sorts after the old text, so it also wins a tie on updatedAt.
+    QVERIFY(phone.updateRecord(eventIds.at(0), "updated entry 0"));
+    SyncStats edit;
+    QVERIFY2(phoneSync.sync(&phoneLink, &edit), qPrintable(phoneSync.lastError()));
+    QCOMPARE(edit.pushed, 1);
+    SyncStats editReceived;
+    QVERIFY2(tabletSync.sync(&tabletLink, &editReceived), qPrintable(tabletSync.lastError()));
+    QCOMPARE(editReceived.applied, 1);
+
+    QVERIFY(tablet.event(0, record));
+    QCOMPARE(record.textEvent, QString("updated entry 0"));
+    RevisionStore revisions(tablet.database());
+    QString text;
+    QVERIFY(revisions.materialize(record.eventId, 0, text));
+    QCOMPARE(text, QString("entry 0"));
+
+    // Nothing changed since: a sync is one round trip each way at most.
+    const int roundTrips = tabletLink.roundTrips();
+    SyncStats idle;
+    QVERIFY(tabletSync.sync(&tabletLink, &idle));
+    QCOMPARE(idle.pulled, 0);
+    QVERIFY(tabletLink.roundTrips() - roundTrips <= 2);
+}
+
+QTEST_MAIN(StorageTest)
+
+#include "tst_storage.moc"
@@ -0,0 +1,911 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "iovfs.hpp"
+#include "journalimporter.hpp"
+#include "journalqueries.hpp"
+#include "logstorage.hpp"
+#include "memorystorage.hpp"
+#include "similarityindex.hpp"
+#include "sqlitestorage.hpp"
+#include "textcounter.hpp"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+#include <QtAlgorithms>
+#include <QtSql/QtSql>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#define BENCH_EPOCH 1700000000u     // the first entry; one every BENCH_INTERVAL seconds after it
+#define BENCH_INTERVAL 600u
+#define BENCH_PAGE_SIZE 20
+#define BENCH_SIMILAR_COUNT 10      // what a similarTo() lookup asks for
+#define BENCH_TOPIC_WORDS 4000      // the vocabulary of the similarity corpus
+#define BENCH_COUNT_BYTES (64 * 1024 * 1024)    // UTF-16 counted by each TextCounter path
+
+static const char *const VOCABULARY[] = {
+    "morning", "coffee", "walk", "rain", "work", "meeting", "friend", "dinner",
+    "book", "train", "garden", "music", "tired", "happy", "call", "letter",
+    "river", "market", "project", "weekend", "quiet", "family", "run", "sleep",
+    "storm", "bread", "window", "travel", "plan", "idea", "night", "summer"
+};
+#define VOCABULARY_SIZE int(sizeof(VOCABULARY) / sizeof(VOCABULARY[0]))
+
+struct BenchConfig
+{
+    BenchConfig()
+        : entries(10000), reads(10000), durability(StorageBackend::Flushed), seed(1)
+        , dropCaches(false), similarityEntries(10000), queries(200), minJaccard(0.5)
+        , importEntries(0) {}
+
+    int entries;
+    int reads;
+    StorageBackend::Durability durability;
+    QString directory;
+    quint32 seed;
+    bool dropCaches;      // needs root; otherwise the cold open reads from the page cache
+    int similarityEntries;    // 0 skips the similarity benchmark
+    int queries;
+    double minJaccard;    // entries at least this similar to a query are the ones to find
+    int importEntries;    // 0 skips the import benchmark; 1000000 is the figure to check
+};
+
+struct BenchResult
+{
+    BenchResult()
+        : appendMs(0), appendPerSecond(0), coldOpenUs(-1), cacheDropped(false)
+        , readP50Us(0), readP99Us(0), readMaxUs(0), pageP50Us(0), pageP99Us(0), errors(0) {}
+
+    qint64 appendMs;
+    qint64 appendPerSecond;
+    qint64 coldOpenUs;    // -1 for a backend that does not outlive close()
+    bool cacheDropped;
+    qint64 readP50Us;
+    qint64 readP99Us;
+    qint64 readMaxUs;
+    qint64 pageP50Us;
+    qint64 pageP99Us;
+    int errors;
+    QMap<QString, IoCounters> io;   // SQLite file I/O by phase; empty for LogStorage
+};
+
+struct SimilarityResult
+{
+    SimilarityResult()
+        : queries(0), expected(0), found(0), lookupP50Us(0), lookupP99Us(0), lookupMaxUs(0)
+        , bruteForceMeanUs(0), errors(0) {}
+
+    int queries;
+    int expected;         // entries at least minJaccard similar, up to BENCH_SIMILAR_COUNT a query
+    int found;            // of those, returned by similarTo()
+    qint64 lookupP50Us;
+    qint64 lookupP99Us;
+    qint64 lookupMaxUs;
+    qint64 bruteForceMeanUs;  // exact Jaccard against every entry, per query
+    int errors;
+};
+
+struct LookupResult
+{
+    LookupResult()
+        : lookups(0), sqlQueryP50Us(0), sqlQueryP99Us(0), sqlQueryMeanNs(0)
+        , typedP50Us(0), typedP99Us(0), typedMeanNs(0), mismatches(0), errors(0) {}
+
+    int lookups;
+    qint64 sqlQueryP50Us;     // QSqlQuery prepared per call, read through QVariant
+    qint64 sqlQueryP99Us;
+    qint64 sqlQueryMeanNs;
+    qint64 typedP50Us;        // TypedQuery<EventById>
+    qint64 typedP99Us;
+    qint64 typedMeanNs;
+    int mismatches;           // lookups where the two disagreed
+    int errors;
+};
+
+struct CountResult
+{
+    CountResult()
+        : texts(0), bytes(0), passes(0), vectorMs(0), vectorMBps(0), scalarMs(0), scalarMBps(0)
+        , mismatches(0) {}
+
+    int texts;
+    qint64 bytes;             // UTF-16 bytes in the corpus
+    int passes;
+    qint64 vectorMs;          // TextCounter::count()
+    double vectorMBps;
+    qint64 scalarMs;          // TextCounter::countScalar()
+    double scalarMBps;
+    int mismatches;           // texts the two count differently
+};
+
+struct ImportResult
+{
+    ImportResult() : importMs(0), importPerSecond(0), imported(0), errors(0) {}
+
+    qint64 importMs;
+    qint64 importPerSecond;
+    int imported;         // entries in the journal afterwards
+    int errors;
+    QMap<QString, IoCounters> io;
+};
+
+static quint32 nextRandom(quint32 &state)
+{
+    // xorshift32; the seed only has to reproduce a run.
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static QString entryText(quint32 &random, int serial)
+{
+    QString text = QString("entry %1:").arg(serial);
+    const int words = 20 + int(nextRandom(random) % 120);
+    for (int i = 0; i < words; ++i)
+        text += QString(" ") + VOCABULARY[nextRandom(random) % VOCABULARY_SIZE];
+    return text;
+}
+
+static qint64 percentile(const QVector<qint64> &sorted, int percent)
+{
+    if (sorted.isEmpty())
+        return 0;
+    return sorted.at(qMin(sorted.size() - 1, sorted.size() * percent / 100));
+}
+
+static bool dropPageCache()
+{
+    sync();
+    QFile caches("/proc/sys/vm/drop_caches");
+    return caches.open(QIODevice::WriteOnly) && caches.write("3\n") == 2;
+}
+
+static void removeFiles(const QString &path)
+{
+    QDir directory(path);
+    const QStringList files = directory.entryList(QDir::Files | QDir::Hidden);
+    for (int i = 0; i < files.size(); ++i)
+        directory.remove(files.at(i));
+}
+
+// -----------------------------------------------------------------------------------------------
+// Backends
+
+class BenchBackend
+{
+public:
+    virtual ~BenchBackend() {}
+
+    virtual const char *name() const = 0;
+    // A fresh, empty store.
+    virtual void remove() = 0;
+    virtual StorageBackend *create() = 0;
+    virtual bool persistent() const { return true; }
+};
+
+class SqliteBench : public BenchBackend
+{
+public:
+    SqliteBench(const QString &directory) : m_directory(directory) {}
+
+    virtual const char *name() const { return "sqlite"; }
+    virtual void remove()
+    {
+        QDir(m_directory).mkpath("sqlite");
+        removeFiles(path());
+    }
+    virtual StorageBackend *create()
+    {
+        return new SqliteStorage(QDir(path()).filePath("DWriteData.db"), "DWriter-bench");
+    }
+
+private:
+    QString path() const { return QDir(m_directory).filePath("sqlite"); }
+
+    QString m_directory;
+};
+
+class LogBench : public BenchBackend
+{
+public:
+    LogBench(const QString &directory) : m_directory(directory) {}
+
+    virtual const char *name() const { return "log"; }
+    virtual void remove() { removeFiles(path()); }
+    virtual StorageBackend *create() { return new LogStorage(path()); }
+
+private:
+    QString path() const { return QDir(m_directory).filePath("log"); }
+
+    QString m_directory;
+};
+
+class MemoryBench : public BenchBackend
+{
+public:
+    virtual const char *name() const { return "memory"; }
+    virtual void remove() {}
+    virtual StorageBackend *create() { return new MemoryStorage; }
+    virtual bool persistent() const { return false; }
+};
+
+// -----------------------------------------------------------------------------------------------
+// Measurements
+
+static void measureReads(StorageBackend *storage, const BenchConfig &config, BenchResult &result)
+{
+    const int count = storage->count();
+    if (count <= 0)
+        return;
+
+    quint32 random = config.seed;
+    QVector<qint64> reads;
+    QVector<qint64> pages;
+    reads.reserve(config.reads);
+    pages.reserve(config.reads / BENCH_PAGE_SIZE + 1);
+    QElapsedTimer timer;
+    for (int i = 0; i < config.reads; ++i) {
+        const int row = int(nextRandom(random) % quint32(count));
+        EventRecord record;
+        timer.start();
+        {
+            IoScope io("bench read");
+            if (!storage->event(row, record))
+                ++result.errors;
+        }
+        reads << timer.nsecsElapsed() / 1000;
+
+        if (i % BENCH_PAGE_SIZE == 0) {
+            IoScope io("bench page");
+            timer.start();
+            storage->range(row, BENCH_PAGE_SIZE);
+            pages << timer.nsecsElapsed() / 1000;
+        }
+    }
+    qSort(reads);
+    qSort(pages);
+    result.readP50Us = percentile(reads, 50);
+    result.readP99Us = percentile(reads, 99);
+    result.readMaxUs = reads.isEmpty() ? 0 : reads.last();
+    result.pageP50Us = percentile(pages, 50);
+    result.pageP99Us = percentile(pages, 99);
+}
+
+static BenchResult runBackend(BenchBackend &backend, const BenchConfig &config)
+{
+    BenchResult result;
+    backend.remove();
+    IoVfs::reset();
+
+    StorageBackend *storage = backend.create();
+    if (!storage->open()) {
+        fprintf(stderr, "%s: %s\n", backend.name(), qPrintable(storage->lastError()));
+        delete storage;
+        ++result.errors;
+        return result;
+    }
+
+    quint32 random = config.seed;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < config.entries; ++i) {
+        const QString stamp = QDateTime::fromTime_t(BENCH_EPOCH + uint(i) * BENCH_INTERVAL).toString();
+        const QString text = entryText(random, i);
+        IoScope io("bench append");
+        if (storage->addRecord(stamp, text, config.durability) < 0)
+            ++result.errors;
+    }
+    {
+        IoScope io("bench flush");
+        if (!storage->flush())
+            ++result.errors;
+    }
+    result.appendMs = timer.elapsed();
+    result.appendPerSecond = config.entries * 1000LL / qMax<qint64>(1, result.appendMs);
+
+    if (backend.persistent()) {
+        storage->close();
+        delete storage;
+        if (config.dropCaches)
+            result.cacheDropped = dropPageCache();
+
+        // Open to the first row on screen, which is the newest entry.
+        IoScope io("bench cold open");
+        timer.start();
+        storage = backend.create();
+        EventRecord record;
+        if (!storage->open() || !storage->event(storage->count() - 1, record))
+            ++result.errors;
+        result.coldOpenUs = timer.nsecsElapsed() / 1000;
+    }
+
+    measureReads(storage, config, result);
+    storage->close();
+    delete storage;
+    result.io = IoVfs::totals();
+    backend.remove();
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Similarity
+
+static QString topicWord(quint32 &random)
+{
+    // The smaller of two draws, so some words are common and most are rare, as in prose.
+    const quint32 word = qMin(nextRandom(random), nextRandom(random)) % BENCH_TOPIC_WORDS;
+    return QString("w%1").arg(word);
+}
+
+static QString similarityText(quint32 &random, const QVector<QString> &earlier)
+{
+    // A third of the entries revisit an earlier one: the same text with some
+    // of its words replaced, dropped or added, so there are near duplicates
+    // of every degree to find.
+    if (!earlier.isEmpty() && nextRandom(random) % 3 == 0) {
+        QStringList words = earlier.at(nextRandom(random) % earlier.size()).split(' ');
+        const int percent = 5 + int(nextRandom(random) % 50);
+        for (int i = 0; i < words.size(); ++i) {
+            if (int(nextRandom(random) % 100) >= percent)
+                continue;
+            switch (nextRandom(random) % 3) {
+            case 0:
+                words[i] = topicWord(random);
+                break;
+            case 1:
+                words.removeAt(i--);
+                break;
+            default:
+                words.insert(i++, topicWord(random));
+                break;
+            }
+        }
+        return words.join(" ");
+    }
+
+    QStringList words;
+    const int count = 20 + int(nextRandom(random) % 100);
+    for (int i = 0; i < count; ++i)
+        words << topicWord(random);
+    return words.join(" ");
+}
+
+static bool moreSimilarPair(const QPair<double, qint64> &a, const QPair<double, qint64> &b)
+{
+    return a.first > b.first;
+}
+
+static SimilarityResult runSimilarity(const BenchConfig &config)
+{
+    SimilarityResult result;
+    MemoryStorage storage;
+    if (!storage.open()) {
+        fprintf(stderr, "similarity: %s\n", qPrintable(storage.lastError()));
+        ++result.errors;
+        return result;
+    }
+
+    // addRecord() writes the signatures and the LSH buckets as the app does.
+    quint32 random = config.seed;
+    QVector<QString> texts;
+    QVector<qint64> eventIds;
+    QVector<QVector<quint64> > shingles;
+    texts.reserve(config.similarityEntries);
+    for (int i = 0; i < config.similarityEntries; ++i) {
+        const QString text = similarityText(random, texts);
+        const QString stamp = QDateTime::fromTime_t(BENCH_EPOCH + uint(i) * BENCH_INTERVAL).toString();
+        const qint64 eventId = storage.addRecord(stamp, text, StorageBackend::Buffered);
+        if (eventId < 0) {
+            ++result.errors;
+            continue;
+        }
+        texts << text;
+        eventIds << eventId;
+        shingles << SimilarityIndex::shingles(text);
+    }
+    if (!storage.flush() || texts.isEmpty()) {
+        ++result.errors;
+        return result;
+    }
+
+    SimilarityIndex index(storage.database());
+    QVector<qint64> lookups;
+    qint64 bruteForceUs = 0;
+    QElapsedTimer timer;
+    for (int q = 0; q < config.queries; ++q) {
+        const int query = int(nextRandom(random) % quint32(texts.size()));
+
+        // The answer: every other entry at least minJaccard similar, best first.
+        timer.start();
+        QList<QPair<double, qint64> > exact;
+        for (int i = 0; i < texts.size(); ++i) {
+            if (i == query)
+                continue;
+            const double jaccard = SimilarityIndex::jaccard(shingles.at(query), shingles.at(i));
+            if (jaccard >= config.minJaccard)
+                exact << qMakePair(jaccard, eventIds.at(i));
+        }
+        qStableSort(exact.begin(), exact.end(), moreSimilarPair);
+        bruteForceUs += timer.nsecsElapsed() / 1000;
+
+        timer.start();
+        const QList<SimilarEntry> similar = index.similarTo(eventIds.at(query), BENCH_SIMILAR_COUNT);
+        lookups << timer.nsecsElapsed() / 1000;
+
+        QSet<qint64> returned;
+        for (int i = 0; i < similar.size(); ++i)
+            returned << similar.at(i).eventId;
+        for (int i = 0; i < exact.size() && i < BENCH_SIMILAR_COUNT; ++i) {
+            ++result.expected;
+            if (returned.contains(exact.at(i).second))
+                ++result.found;
+        }
+        ++result.queries;
+    }
+
+    qSort(lookups);
+    result.lookupP50Us = percentile(lookups, 50);
+    result.lookupP99Us = percentile(lookups, 99);
+    result.lookupMaxUs = lookups.isEmpty() ? 0 : lookups.last();
+    result.bruteForceMeanUs = bruteForceUs / qMax(1, result.queries);
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Lookup by eventID
+
+// The same random eventIDs through QSqlQuery, prepared for each call as
+// SqliteStorage read them before, and through the TypedQuery it keeps
+// prepared now. Both run warm, one after the other, on one connection.
+static void measureLookups(const QSqlDatabase &database, const QVector<qint64> &eventIds,
+                           const BenchConfig &config, quint32 &random, LookupResult &result)
+{
+    TypedQuery<EventById> typed;
+    if (!typed.prepare(sqliteHandle(database))) {
+        fprintf(stderr, "lookup: %s\n", qPrintable(typed.lastError()));
+        ++result.errors;
+        return;
+    }
+
+    QVector<qint64> sqlQueryUs;
+    QVector<qint64> typedUs;
+    sqlQueryUs.reserve(config.reads);
+    typedUs.reserve(config.reads);
+    qint64 sqlQueryNs = 0;
+    qint64 typedNs = 0;
+    QElapsedTimer timer;
+    for (int i = 0; i < config.reads; ++i) {
+        const qint64 eventId = eventIds.at(nextRandom(random) % quint32(eventIds.size()));
+
+        EventRecord viaSqlQuery;
+        timer.start();
+        bool sqlQueryFound;
+        {
+            QSqlQuery sqlQuery(database);
+            sqlQuery.prepare("SELECT eventID, createdAt, timeStamp, textEvent FROM events "
+                             "WHERE eventID = :eventID");
+            sqlQuery.bindValue(":eventID", eventId);
+            sqlQueryFound = sqlQuery.exec() && sqlQuery.next();
+            if (sqlQueryFound) {
+                viaSqlQuery.eventId = sqlQuery.value(0).toLongLong();
+                viaSqlQuery.createdAt = sqlQuery.value(1).toLongLong();
+                viaSqlQuery.timeStamp = sqlQuery.value(2).toString();
+                viaSqlQuery.textEvent = sqlQuery.value(3).toString();
+            }
+        }
+        qint64 elapsed = timer.nsecsElapsed();
+        sqlQueryNs += elapsed;
+        sqlQueryUs << elapsed / 1000;
+
+        EventRow row;
+        timer.start();
+        const bool typedFound = typed.exec(eventId) && typed.next(row);
+        typed.finish();
+        elapsed = timer.nsecsElapsed();
+        typedNs += elapsed;
+        typedUs << elapsed / 1000;
+
+        if (!sqlQueryFound || !typedFound)
+            ++result.errors;
+        else if (viaSqlQuery.eventId != row.first || viaSqlQuery.createdAt != row.second
+                 || viaSqlQuery.timeStamp != row.third || viaSqlQuery.textEvent != row.fourth)
+            ++result.mismatches;
+        ++result.lookups;
+    }
+
+    qSort(sqlQueryUs);
+    qSort(typedUs);
+    result.sqlQueryP50Us = percentile(sqlQueryUs, 50);
+    result.sqlQueryP99Us = percentile(sqlQueryUs, 99);
+    result.sqlQueryMeanNs = sqlQueryNs / qMax(1, result.lookups);
+    result.typedP50Us = percentile(typedUs, 50);
+    result.typedP99Us = percentile(typedUs, 99);
+    result.typedMeanNs = typedNs / qMax(1, result.lookups);
+}
+
+static LookupResult runLookup(const BenchConfig &config)
+{
+    LookupResult result;
+    const QDir directory(QDir(config.directory).filePath("lookup"));
+    QDir().mkpath(directory.path());
+    removeFiles(directory.path());
+
+    SqliteStorage storage(directory.filePath("DWriteData.db"), "DWriter-bench-lookup");
+    if (!storage.open()) {
+        fprintf(stderr, "lookup: %s\n", qPrintable(storage.lastError()));
+        ++result.errors;
+        return result;
+    }
+    quint32 random = config.seed;
+    QVector<qint64> eventIds;
+    eventIds.reserve(config.entries);
+    for (int i = 0; i < config.entries; ++i) {
+        const QString stamp = QDateTime::fromTime_t(BENCH_EPOCH + uint(i) * BENCH_INTERVAL).toString();
+        const qint64 eventId = storage.addRecord(stamp, entryText(random, i), StorageBackend::Buffered);
+        if (eventId < 0)
+            ++result.errors;
+        else
+            eventIds << eventId;
+    }
+    if (storage.flush() && !eventIds.isEmpty())
+        measureLookups(storage.database(), eventIds, config, random, result);
+    else
+        ++result.errors;
+    storage.close();
+    removeFiles(directory.path());
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Word and character counts
+
+// An entry with some of what the character count has to skip or keep:
+// accented letters, combining marks, surrogate pairs, a zero-width joiner
+// and non-ASCII spaces.
+static QString countingText(quint32 &random, int serial)
+{
+    static const ushort EXTRAS[][3] = {
+        { 0x00e9, 0, 0 },             // precomposed e acute
+        { 'e', 0x0301, 0 },           // e and a combining acute
+        { 0xd83d, 0xde00, 0 },        // an emoji outside the BMP
+        { 0x200d, 0, 0 },             // zero-width joiner
+        { 0x00a0, 0, 0 },             // no-break space
+        { 0x3000, 0, 0 },             // ideographic space
+        { 0x4e2d, 0x6587, 0 }         // CJK, no spaces
+    };
+    QString text = entryText(random, serial);
+    const int extras = int(nextRandom(random) % 8);
+    for (int i = 0; i < extras; ++i) {
+        const ushort *extra = EXTRAS[nextRandom(random) % (sizeof(EXTRAS) / sizeof(EXTRAS[0]))];
+        text += ' ';
+        for (int c = 0; c < 3 && extra[c]; ++c)
+            text += QChar(extra[c]);
+    }
+    return text;
+}
+
+static double megabytesPerSecond(qint64 bytes, qint64 ns)
+{
+    return ns > 0 ? bytes * 1000.0 / ns : 0.0;
+}
+
+static CountResult runCount(const BenchConfig &config)
+{
+    CountResult result;
+    quint32 random = config.seed;
+    QVector<QString> texts;
+    texts.reserve(config.entries);
+    for (int i = 0; i < config.entries; ++i) {
+        texts << countingText(random, i);
+        result.bytes += texts.last().size() * qint64(sizeof(QChar));
+    }
+    result.texts = texts.size();
+    result.passes = int(qMax<qint64>(1, BENCH_COUNT_BYTES / qMax<qint64>(1, result.bytes)));
+
+    for (int i = 0; i < texts.size(); ++i) {
+        const TextCounts vector = TextCounter::count(texts.at(i));
+        const TextCounts scalar = TextCounter::countScalar(texts.at(i));
+        if (vector.words != scalar.words || vector.characters != scalar.characters)
+            ++result.mismatches;
+    }
+
+    // The sums keep the calls from being optimized away.
+    qint64 vectorSum = 0;
+    qint64 scalarSum = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int pass = 0; pass < result.passes; ++pass) {
+        for (int i = 0; i < texts.size(); ++i) {
+            const TextCounts counts = TextCounter::count(texts.at(i));
+            vectorSum += counts.words + counts.characters;
+        }
+    }
+    const qint64 vectorNs = timer.nsecsElapsed();
+    timer.start();
+    for (int pass = 0; pass < result.passes; ++pass) {
+        for (int i = 0; i < texts.size(); ++i) {
+            const TextCounts counts = TextCounter::countScalar(texts.at(i));
+            scalarSum += counts.words + counts.characters;
+        }
+    }
+    const qint64 scalarNs = timer.nsecsElapsed();
+    if (vectorSum != scalarSum)
+        ++result.mismatches;
+
+    const qint64 bytes = result.bytes * result.passes;
+    result.vectorMs = vectorNs / 1000000;
+    result.vectorMBps = megabytesPerSecond(bytes, vectorNs);
+    result.scalarMs = scalarNs / 1000000;
+    result.scalarMBps = megabytesPerSecond(bytes, scalarNs);
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Import
+
+static ImportResult runImport(const BenchConfig &config)
+{
+    ImportResult result;
+    const QDir directory(QDir(config.directory).filePath("import"));
+    QDir().mkpath(directory.path());
+    removeFiles(directory.path());
+    const QString source = directory.filePath("journal.jsonl");
+    const QString databaseName = directory.filePath("DWriteData.db");
+
+    // A JSON-lines diary with a #tag in every entry, so the tags, buckets,
+    // change log and totals are all written.
+    QFile file(source);
+    if (!file.open(QIODevice::WriteOnly)) {
+        fprintf(stderr, "import: %s\n", qPrintable(file.errorString()));
+        ++result.errors;
+        return result;
+    }
+    quint32 random = config.seed;
+    for (int i = 0; i < config.importEntries; ++i) {
+        const QByteArray line = "{\"timestamp\":" + QByteArray::number(BENCH_EPOCH + uint(i) * BENCH_INTERVAL)
+                              + ",\"text\":\"" + entryText(random, i).toUtf8() + " #"
+                              + VOCABULARY[nextRandom(random) % VOCABULARY_SIZE] + "\"}\n";
+        if (file.write(line) != line.size())
+            ++result.errors;
+    }
+    file.close();
+
+    // The schema as the app creates it, then the import as DatabaseIo runs it,
+    // on this thread instead of a worker thread.
+    {
+        SqliteStorage storage(databaseName, "DWriter-bench-import");
+        if (!storage.open()) {
+            fprintf(stderr, "import: %s\n", qPrintable(storage.lastError()));
+            ++result.errors;
+            return result;
+        }
+        storage.close();
+    }
+    IoVfs::reset();
+    QElapsedTimer timer;
+    timer.start();
+    {
+        ImportWorker worker(databaseName, QStringList() << source);
+        worker.run();
+    }
+    result.importMs = timer.elapsed();
+    result.importPerSecond = config.importEntries * 1000LL / qMax<qint64>(1, result.importMs);
+    result.io = IoVfs::totals();
+
+    SqliteStorage storage(databaseName, "DWriter-bench-import");
+    if (storage.open()) {
+        result.imported = storage.count();
+        storage.close();
+    }
+    if (result.imported != config.importEntries)
+        ++result.errors;
+    removeFiles(directory.path());
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------
+// Output
+
+static QByteArray resultJson(const BenchResult &result)
+{
+    return "{\"appendMs\":" + QByteArray::number(result.appendMs)
+         + ",\"appendPerSecond\":" + QByteArray::number(result.appendPerSecond)
+         + ",\"coldOpenUs\":" + QByteArray::number(result.coldOpenUs)
+         + ",\"cacheDropped\":" + (result.cacheDropped ? "true" : "false")
+         + ",\"readP50Us\":" + QByteArray::number(result.readP50Us)
+         + ",\"readP99Us\":" + QByteArray::number(result.readP99Us)
+         + ",\"readMaxUs\":" + QByteArray::number(result.readMaxUs)
+         + ",\"pageP50Us\":" + QByteArray::number(result.pageP50Us)
+         + ",\"pageP99Us\":" + QByteArray::number(result.pageP99Us)
+         + ",\"errors\":" + QByteArray::number(result.errors)
+         + ",\"io\":" + IoVfs::toJson(result.io) + '}';
+}
+
+static QByteArray similarityJson(const SimilarityResult &result, const BenchConfig &config)
+{
+    const double recall = result.expected ? double(result.found) / result.expected : 1.0;
+    return "{\"entries\":" + QByteArray::number(config.similarityEntries)
+         + ",\"queries\":" + QByteArray::number(result.queries)
+         + ",\"k\":" + QByteArray::number(BENCH_SIMILAR_COUNT)
+         + ",\"minJaccard\":" + QByteArray::number(config.minJaccard)
+         + ",\"expected\":" + QByteArray::number(result.expected)
+         + ",\"found\":" + QByteArray::number(result.found)
+         + ",\"recall\":" + QByteArray::number(recall, 'f', 4)
+         + ",\"lookupP50Us\":" + QByteArray::number(result.lookupP50Us)
+         + ",\"lookupP99Us\":" + QByteArray::number(result.lookupP99Us)
+         + ",\"lookupMaxUs\":" + QByteArray::number(result.lookupMaxUs)
+         + ",\"bruteForceMeanUs\":" + QByteArray::number(result.bruteForceMeanUs)
+         + ",\"errors\":" + QByteArray::number(result.errors) + '}';
+}
+
+static QByteArray lookupJson(const LookupResult &result)
+{
+    return "{\"lookups\":" + QByteArray::number(result.lookups)
+         + ",\"sqlQuery\":{\"p50Us\":" + QByteArray::number(result.sqlQueryP50Us)
+         + ",\"p99Us\":" + QByteArray::number(result.sqlQueryP99Us)
+         + ",\"meanNs\":" + QByteArray::number(result.sqlQueryMeanNs)
+         + "},\"typedQuery\":{\"p50Us\":" + QByteArray::number(result.typedP50Us)
+         + ",\"p99Us\":" + QByteArray::number(result.typedP99Us)
+         + ",\"meanNs\":" + QByteArray::number(result.typedMeanNs)
+         + "},\"mismatches\":" + QByteArray::number(result.mismatches)
+         + ",\"errors\":" + QByteArray::number(result.errors) + '}';
+}
+
+static QByteArray countJson(const CountResult &result)
+{
+    return "{\"texts\":" + QByteArray::number(result.texts)
+         + ",\"bytes\":" + QByteArray::number(result.bytes)
+         + ",\"passes\":" + QByteArray::number(result.passes)
+         + ",\"count\":{\"ms\":" + QByteArray::number(result.vectorMs)
+         + ",\"MBps\":" + QByteArray::number(result.vectorMBps, 'f', 1)
+         + "},\"countScalar\":{\"ms\":" + QByteArray::number(result.scalarMs)
+         + ",\"MBps\":" + QByteArray::number(result.scalarMBps, 'f', 1)
+         + "},\"mismatches\":" + QByteArray::number(result.mismatches) + '}';
+}
+
+static QByteArray importJson(const ImportResult &result, const BenchConfig &config)
+{
+    return "{\"entries\":" + QByteArray::number(config.importEntries)
+         + ",\"imported\":" + QByteArray::number(result.imported)
+         + ",\"importMs\":" + QByteArray::number(result.importMs)
+         + ",\"importPerSecond\":" + QByteArray::number(result.importPerSecond)
+         + ",\"errors\":" + QByteArray::number(result.errors)
+         + ",\"io\":" + IoVfs::toJson(result.io) + '}';
+}
+
+static const char *durabilityName(StorageBackend::Durability durability)
+{
+    switch (durability) {
+    case StorageBackend::Buffered:
+        return "buffered";
+    case StorageBackend::Flushed:
+        return "flushed";
+    default:
+        return "synced";
+    }
+}
+
+static bool parseArguments(const QStringList &arguments, BenchConfig &config)
+{
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString option = arguments.at(i);
+        const QString value = i + 1 < arguments.size() ? arguments.at(i + 1) : QString();
+        bool ok = true;
+        if (option == "--drop-caches") {
+            config.dropCaches = true;
+            continue;
+        } else if (option == "--entries") {
+            config.entries = value.toInt(&ok);
+        } else if (option == "--reads") {
+            config.reads = value.toInt(&ok);
+        } else if (option == "--similarity-entries") {
+            config.similarityEntries = value.toInt(&ok);
+        } else if (option == "--queries") {
+            config.queries = value.toInt(&ok);
+        } else if (option == "--min-jaccard") {
+            config.minJaccard = value.toDouble(&ok);
+            ok = ok && config.minJaccard > 0.0 && config.minJaccard <= 1.0;
+        } else if (option == "--import-entries") {
+            config.importEntries = value.toInt(&ok);
+        } else if (option == "--seed") {
+            config.seed = value.toUInt(&ok);
+            ok = ok && config.seed != 0;
+        } else if (option == "--directory") {
+            config.directory = value;
+            ok = !value.isEmpty();
+        } else if (option == "--durability") {
+            if (value == "buffered")
+                config.durability = StorageBackend::Buffered;
+            else if (value == "flushed")
+                config.durability = StorageBackend::Flushed;
+            else if (value == "synced")
+                config.durability = StorageBackend::Synced;
+            else
+                ok = false;
+        } else {
+            ok = false;
+        }
+        if (!ok || value.isEmpty()) {
+            fprintf(stderr, "bench: bad option %s\n", qPrintable(option));
+            return false;
+        }
+        ++i;
+    }
+    return config.entries > 0 && config.reads >= 0 && config.similarityEntries >= 0
+           && config.queries > 0 && config.importEntries >= 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    BenchConfig config;
+    config.directory = QDir::temp().filePath(QString("dwriter-bench-%1").arg(app.applicationPid()));
+    if (!parseArguments(app.arguments(), config)) {
+        fprintf(stderr, "usage: bench [--entries N] [--reads N] [--durability buffered|flushed|synced]\n"
+                        "             [--directory DIR] [--seed N] [--drop-caches]\n"
+                        "             [--similarity-entries N] [--queries N] [--min-jaccard X]\n"
+                        "             [--import-entries N]\n");
+        return 2;
+    }
+    QDir().mkpath(config.directory);
+    // Before the first connection, so every file SQLite opens is counted.
+    IoVfs::install();
+
+    SqliteBench sqlite(config.directory);
+    LogBench log(config.directory);
+    MemoryBench memory;
+    BenchBackend *backends[] = { &sqlite, &log, &memory };
+
+    QByteArray json = "{\"entries\":" + QByteArray::number(config.entries)
+                    + ",\"reads\":" + QByteArray::number(config.reads)
+                    + ",\"durability\":\"" + durabilityName(config.durability)
+                    + "\",\"seed\":" + QByteArray::number(config.seed) + ",\"backends\":{";
+    int errors = 0;
+    for (int i = 0; i < int(sizeof(backends) / sizeof(backends[0])); ++i) {
+        const BenchResult result = runBackend(*backends[i], config);
+        errors += result.errors;
+        if (i)
+            json += ',';
+        json += '"' + QByteArray(backends[i]->name()) + "\":" + resultJson(result);
+    }
+    json += '}';
+
+    if (config.reads > 0) {
+        const LookupResult lookup = runLookup(config);
+        errors += lookup.errors + lookup.mismatches;
+        json += ",\"getEvent\":" + lookupJson(lookup);
+    }
+    {
+        const CountResult counted = runCount(config);
+        errors += counted.mismatches;
+        json += ",\"textCounter\":" + countJson(counted);
+    }
+    if (config.similarityEntries > 0) {
+        const SimilarityResult similarity = runSimilarity(config);
+        errors += similarity.errors;
+        json += ",\"similarity\":" + similarityJson(similarity, config);
+    }
+    if (config.importEntries > 0) {
+        const ImportResult imported = runImport(config);
+        errors += imported.errors;
+        json += ",\"import\":" + importJson(imported, config);
+    }
+    json += "}\n";
+
+    fputs(json.constData(), stdout);
+    return errors ? 1 : 0;
+}
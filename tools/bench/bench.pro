@@ -0,0 +1,22 @@
+# Compares the storage backends: append throughput, read latency, cold open.
+# Times a lookup by eventID through QSqlQuery and through TypedQuery<EventById>.
+# Compares the throughput of TextCounter::count() and countScalar().
+# Then measures the recall of the similarity index against exact Jaccard
+# similarity, and its lookup latency.
+#
+#   bench [--entries N] [--reads N] [--durability buffered|flushed|synced]
+#         [--directory DIR] [--seed N] [--drop-caches]
+#         [--similarity-entries N] [--queries N] [--min-jaccard X]
+#
+# Prints one JSON object to stdout. The SQLite backends report their file I/O
+# per phase, counted by IoVfs.
+
+TEMPLATE = app
+TARGET = bench
+CONFIG += console warn_on
+CONFIG -= app_bundle
+
+include(../../core.pri)
+
+SOURCES +=  \
+    bench.cpp
@@ -0,0 +1,189 @@
+/*
+ * crash.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "crashharness.hpp"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+
+#include <stdio.h>
+
+static const char *durabilityName(StorageBackend::Durability durability)
+{
+    switch (durability) {
+    case StorageBackend::Buffered:
+        return "buffered";
+    case StorageBackend::Flushed:
+        return "flushed";
+    default:
+        return "synced";
+    }
+}
+
+static QByteArray jsonString(const QString &text)
+{
+    QByteArray json = "\"";
+    const QByteArray utf8 = text.toUtf8();
+    for (int i = 0; i < utf8.size(); ++i) {
+        const char c = utf8.at(i);
+        if (c == '"' || c == '\\')
+            json += '\\';
+        if (uchar(c) < 0x20)
+            json += "\\u00" + QByteArray::number(uchar(c), 16).rightJustified(2, '0');
+        else
+            json += c;
+    }
+    return json + '"';
+}
+
+static QByteArray reportJson(const DurabilityReport &report)
+{
+    return QByteArray("{\"durability\":\"") + durabilityName(report.durability) + '"'
+         + ",\"passed\":" + (report.passed() ? "true" : "false")
+         + ",\"writeAheadLog\":" + (report.writeAheadLog ? "true" : "false")
+         + ",\"writes\":" + QByteArray::number(report.writes)
+         + ",\"meanWriteUs\":" + QByteArray::number(report.meanWriteUs)
+         + ",\"p99WriteUs\":" + QByteArray::number(report.p99WriteUs)
+         + ",\"flushUs\":" + QByteArray::number(report.flushUs)
+         + ",\"crashPoints\":" + QByteArray::number(report.crashPoints)
+         + ",\"corruptions\":" + QByteArray::number(report.corruptions)
+         + ",\"appCrashFailures\":" + QByteArray::number(report.appCrashFailures)
+         + ",\"powerLossFailures\":" + QByteArray::number(report.powerLossFailures)
+         + ",\"firstFailure\":" + jsonString(report.firstFailure) + '}';
+}
+
+// QDir in Qt 4 cannot remove a tree.
+static void removeDirectory(const QString &path)
+{
+    QDir dir(path);
+    const QFileInfoList entries = dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden);
+    for (int i = 0; i < entries.size(); ++i) {
+        if (entries.at(i).isDir())
+            removeDirectory(entries.at(i).absoluteFilePath());
+        else
+            QFile::remove(entries.at(i).absoluteFilePath());
+    }
+    QDir().rmdir(path);
+}
+
+struct CrashOptions
+{
+    CrashOptions() : all(true), durability(StorageBackend::Synced), writes(0), crashPoints(0)
+        , flushEvery(0), seed(1) {}
+
+    QString directory;
+    bool all;
+    StorageBackend::Durability durability;
+    int writes;               // 0: the harness default
+    int crashPoints;
+    int flushEvery;
+    quint32 seed;
+};
+
+static bool parseArguments(const QStringList &arguments, CrashOptions &options)
+{
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString option = arguments.at(i);
+        const QString value = i + 1 < arguments.size() ? arguments.at(i + 1) : QString();
+        bool ok = true;
+        if (option == "--directory") {
+            options.directory = value;
+        } else if (option == "--writes") {
+            options.writes = value.toInt(&ok);
+            ok = ok && options.writes > 0;
+        } else if (option == "--crash-points") {
+            options.crashPoints = value.toInt(&ok);
+            ok = ok && options.crashPoints > 0;
+        } else if (option == "--flush-every") {
+            options.flushEvery = value.toInt(&ok);
+            ok = ok && options.flushEvery > 0;
+        } else if (option == "--seed") {
+            options.seed = value.toUInt(&ok);
+            ok = ok && options.seed != 0;
+        } else if (option == "--durability") {
+            options.all = value == "all";
+            if (value == "buffered")
+                options.durability = StorageBackend::Buffered;
+            else if (value == "flushed")
+                options.durability = StorageBackend::Flushed;
+            else if (value == "synced")
+                options.durability = StorageBackend::Synced;
+            else if (!options.all)
+                ok = false;
+        } else {
+            ok = false;
+        }
+        if (!ok || value.isEmpty()) {
+            fprintf(stderr, "crash: bad option %s\n", qPrintable(option));
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    CrashOptions options;
+    if (!parseArguments(app.arguments(), options)) {
+        fprintf(stderr, "usage: crash [--directory DIR] [--durability buffered|flushed|synced|all]\n"
+                        "             [--writes N] [--crash-points N] [--flush-every N] [--seed N]\n");
+        return 2;
+    }
+
+    // The harness owns the directory while it runs; a scratch one is removed after.
+    const bool scratch = options.directory.isEmpty();
+    if (scratch)
+        options.directory = QDir::temp().filePath(QString("dwriter-crash-%1").arg(app.applicationPid()));
+
+    CrashHarness harness(options.directory, options.seed);
+    if (options.writes)
+        harness.setWrites(options.writes);
+    if (options.crashPoints)
+        harness.setCrashPoints(options.crashPoints);
+    if (options.flushEvery)
+        harness.setFlushEvery(options.flushEvery);
+
+    QList<StorageBackend::Durability> levels;
+    if (options.all)
+        levels << StorageBackend::Buffered << StorageBackend::Flushed << StorageBackend::Synced;
+    else
+        levels << options.durability;
+
+    // run() clears the error of the previous level, so each one is checked here.
+    QList<DurabilityReport> reports;
+    QString error;
+    for (int i = 0; i < levels.size() && error.isEmpty(); ++i) {
+        reports << harness.run(levels.at(i));
+        error = harness.lastError();
+    }
+    if (scratch)
+        removeDirectory(options.directory);
+
+    if (!error.isEmpty()) {
+        fprintf(stderr, "crash: %s\n", qPrintable(error));
+        return 1;
+    }
+
+    bool passed = true;
+    QByteArray json = "{\"seed\":" + QByteArray::number(options.seed) + ",\"reports\":[";
+    for (int i = 0; i < reports.size(); ++i) {
+        if (i)
+            json += ',';
+        json += reportJson(reports.at(i));
+        passed = passed && reports.at(i).passed();
+    }
+    json += "]}";
+
+    fputs(json.constData(), stdout);
+    fputs("\n", stdout);
+    return passed ? 0 : 1;
+}
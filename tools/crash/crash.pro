@@ -0,0 +1,18 @@
+# Cuts a scratch journal short at sampled I/O operations through CrashHarness
+# and checks what each durability level kept.
+#
+#   crash [--directory DIR] [--durability buffered|flushed|synced|all]
+#         [--writes N] [--crash-points N] [--flush-every N] [--seed N]
+#
+# Prints the reports as one JSON object to stdout. Exits with 1 when a level
+# lost a promised entry or left a corrupt journal.
+
+TEMPLATE = app
+TARGET = crash
+CONFIG += console warn_on
+CONFIG -= app_bundle
+
+include(../../core.pri)
+
+SOURCES +=  \
+    crash.cpp
@@ -0,0 +1,134 @@
+/*
+ * replay.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "logstorage.hpp"
+#include "memorystorage.hpp"
+#include "sqlitestorage.hpp"
+#include "tracereplay.hpp"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QStringList>
+
+#include <stdio.h>
+
+#define REPLAY_SEED_EPOCH 1700000000u   // seeded entries are an hour apart from here on
+#define REPLAY_SEED_FLUSH 500
+
+static const char *const KIND_NAMES[TraceKindCount] = {
+    "count", "event", "eventById", "range", "search", "add", "edit", "delete", "restore",
+    "flush", "tags", "mood", "rowForTime", "timeAtRow", "filter", "modelRow"
+};
+
+static QByteArray statsJson(const ReplayStats &stats)
+{
+    return "{\"operations\":" + QByteArray::number(stats.operations)
+         + ",\"errors\":" + QByteArray::number(stats.errors)
+         + ",\"p50Us\":" + QByteArray::number(stats.p50Us)
+         + ",\"p90Us\":" + QByteArray::number(stats.p90Us)
+         + ",\"p99Us\":" + QByteArray::number(stats.p99Us)
+         + ",\"maxUs\":" + QByteArray::number(stats.maxUs)
+         + ",\"recordedP50Us\":" + QByteArray::number(stats.recordedP50Us)
+         + ",\"recordedP99Us\":" + QByteArray::number(stats.recordedP99Us) + '}';
+}
+
+static bool seed(StorageBackend &storage, int entries)
+{
+    // Entries of a few hundred characters, about what a journal holds.
+    for (int i = 0; i < entries; ++i) {
+        const QString stamp = QDateTime::fromTime_t(REPLAY_SEED_EPOCH + uint(i) * 3600u).toString();
+        const QString text = QString("Seeded entry %1. ").arg(i).repeated(12);
+        const bool last = i + 1 == entries || (i + 1) % REPLAY_SEED_FLUSH == 0;
+        if (storage.addRecord(stamp, text, last ? StorageBackend::Synced : StorageBackend::Buffered) < 0)
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QString traceName;
+    QString backendName = "sqlite";
+    QString journal;
+    TraceReplay::Speed speed = TraceReplay::Maximum;
+    int seedEntries = 0;
+
+    const QStringList arguments = app.arguments();
+    bool ok = true;
+    for (int i = 1; ok && i < arguments.size(); ++i) {
+        const QString option = arguments.at(i);
+        if (!option.startsWith("--")) {
+            ok = traceName.isEmpty();
+            traceName = option;
+            continue;
+        }
+        if (i + 1 >= arguments.size()) {
+            ok = false;
+            break;
+        }
+        const QString value = arguments.at(++i);
+        if (option == "--backend") {
+            backendName = value;
+            ok = value == "sqlite" || value == "log" || value == "memory";
+        } else if (option == "--journal") {
+            journal = value;
+        } else if (option == "--speed") {
+            ok = value == "recorded" || value == "maximum";
+            speed = value == "recorded" ? TraceReplay::Recorded : TraceReplay::Maximum;
+        } else if (option == "--seed-entries") {
+            seedEntries = value.toInt(&ok);
+            ok = ok && seedEntries >= 0;
+        } else {
+            ok = false;
+        }
+    }
+    if (!ok || traceName.isEmpty() || (journal.isEmpty() && backendName != "memory")) {
+        fprintf(stderr, "usage: replay TRACE [--backend sqlite|log|memory] [--journal PATH]\n"
+                        "              [--speed recorded|maximum] [--seed-entries N]\n");
+        return 2;
+    }
+
+    StorageBackend *storage;
+    if (backendName == "memory")
+        storage = new MemoryStorage;
+    else if (backendName == "log")
+        storage = new LogStorage(journal);
+    else
+        storage = new SqliteStorage(journal, "DWriter-replay");
+
+    if (!storage->open() || !seed(*storage, seedEntries)) {
+        fprintf(stderr, "replay: %s\n", qPrintable(storage->lastError()));
+        delete storage;
+        return 1;
+    }
+
+    TraceReplay replay(storage);
+    const ReplayReport report = replay.run(traceName, speed);
+    storage->close();
+    delete storage;
+    if (!report.error.isEmpty()) {
+        fprintf(stderr, "replay: %s\n", qPrintable(report.error));
+        return 1;
+    }
+
+    QByteArray json = "{\"backend\":\"" + backendName.toUtf8()
+                    + "\",\"speed\":\"" + (speed == TraceReplay::Recorded ? "recorded" : "maximum")
+                    + "\",\"records\":" + QByteArray::number(report.records)
+                    + ",\"skipped\":" + QByteArray::number(report.skipped)
+                    + ",\"elapsedMs\":" + QByteArray::number(report.elapsedMs)
+                    + ",\"lagMs\":" + QByteArray::number(report.lagMs) + ",\"kinds\":{";
+    for (int kind = 0; kind < TraceKindCount; ++kind) {
+        if (kind)
+            json += ',';
+        json += QByteArray("\"") + KIND_NAMES[kind] + "\":" + statsJson(report.kinds[kind]);
+    }
+    json += "}}\n";
+
+    fputs(json.constData(), stdout);
+    return 0;
+}
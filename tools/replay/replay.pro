@@ -0,0 +1,19 @@
+# Replays a query trace, recorded with DatabaseIo::startTrace(), against a
+# storage backend and reports the latency of each kind of operation.
+#
+#   replay TRACE [--backend sqlite|log|memory] [--journal PATH]
+#          [--speed recorded|maximum] [--seed-entries N]
+#
+# --journal is the database file for sqlite and the directory for log; use a
+# copy, since the replay writes to it. --seed-entries fills the backend first,
+# for a memory backend or a fresh journal. Prints one JSON object to stdout.
+
+TEMPLATE = app
+TARGET = replay
+CONFIG += console warn_on
+CONFIG -= app_bundle
+
+include(../../core.pri)
+
+SOURCES +=  \
+    replay.cpp
@@ -0,0 +1,186 @@
+/*
+ * stress.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: daviddong
+ */
+#include "stressharness.hpp"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+
+#include <stdio.h>
+
+static const char *const OPERATION_NAMES[StressOperationCount] = {
+    "insert", "edit", "scroll", "search"
+};
+
+static QByteArray jsonString(const QString &text)
+{
+    QByteArray json = "\"";
+    const QByteArray utf8 = text.toUtf8();
+    for (int i = 0; i < utf8.size(); ++i) {
+        const char c = utf8.at(i);
+        if (c == '"' || c == '\\')
+            json += '\\';
+        if (uchar(c) < 0x20)
+            json += "\\u00" + QByteArray::number(uchar(c), 16).rightJustified(2, '0');
+        else
+            json += c;
+    }
+    return json + '"';
+}
+
+static QByteArray jsonStrings(const QStringList &texts)
+{
+    QByteArray json = "[";
+    for (int i = 0; i < texts.size(); ++i) {
+        if (i)
+            json += ',';
+        json += jsonString(texts.at(i));
+    }
+    return json + ']';
+}
+
+static QByteArray statsJson(const StressStats stats[StressOperationCount])
+{
+    QByteArray json = "{";
+    for (int op = 0; op < StressOperationCount; ++op) {
+        const StressStats &s = stats[op];
+        if (op)
+            json += ',';
+        json += QByteArray("\"") + OPERATION_NAMES[op] + "\":{\"operations\":" + QByteArray::number(s.operations)
+              + ",\"errors\":" + QByteArray::number(s.errors)
+              + ",\"busyWaits\":" + QByteArray::number(s.busyWaits)
+              + ",\"busyWaitUs\":" + QByteArray::number(s.busyWaitUs)
+              + ",\"maxBusyWaitUs\":" + QByteArray::number(s.maxBusyWaitUs)
+              + ",\"p50Us\":" + QByteArray::number(s.p50Us)
+              + ",\"p99Us\":" + QByteArray::number(s.p99Us)
+              + ",\"maxUs\":" + QByteArray::number(s.maxUs) + '}';
+    }
+    return json + '}';
+}
+
+static QByteArray reportJson(const StressReport &report, const StressConfig &config)
+{
+    QByteArray json = "{\"seed\":" + QByteArray::number(config.seed)
+                    + ",\"seconds\":" + QByteArray::number(config.seconds)
+                    + ",\"writers\":" + QByteArray::number(config.writers)
+                    + ",\"scrollers\":" + QByteArray::number(config.scrollers)
+                    + ",\"searchers\":" + QByteArray::number(config.searchers)
+                    + ",\"passed\":" + (report.passed() ? "true" : "false")
+                    + ",\"entries\":" + QByteArray::number(report.entries)
+                    + ",\"edits\":" + QByteArray::number(report.edits)
+                    + ",\"sqliteHighwater\":" + QByteArray::number(report.sqliteHighwater)
+                    + ",\"totals\":" + statsJson(report.totals) + ",\"windows\":[";
+    for (int w = 0; w < report.windows.size(); ++w) {
+        const StressWindow &window = report.windows.at(w);
+        if (w)
+            json += ',';
+        json += "{\"startMs\":" + QByteArray::number(window.startMs)
+              + ",\"sqliteBytes\":" + QByteArray::number(window.sqliteBytes)
+              + ",\"residentBytes\":" + QByteArray::number(window.residentBytes)
+              + ",\"operations\":" + statsJson(window.stats) + '}';
+    }
+    json += "],\"maintenance\":[";
+    for (int i = 0; i < report.maintenance.size(); ++i) {
+        const MaintenanceStats &task = report.maintenance.at(i);
+        if (i)
+            json += ',';
+        json += "{\"task\":" + jsonString(task.task)
+              + ",\"runs\":" + QByteArray::number(task.runs)
+              + ",\"totalMs\":" + QByteArray::number(task.totalMs) + '}';
+    }
+    json += "],\"io\":" + IoVfs::toJson(report.io)
+          + ",\"errors\":" + jsonStrings(report.errors)
+          + ",\"violations\":" + jsonStrings(report.violations) + '}';
+    return json;
+}
+
+static bool parseArguments(const QStringList &arguments, StressConfig &config, QString &databaseName)
+{
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString option = arguments.at(i);
+        const QString value = i + 1 < arguments.size() ? arguments.at(i + 1) : QString();
+        bool ok = true;
+        if (option == "--no-maintenance") {
+            config.maintenance = false;
+            continue;
+        } else if (option == "--database") {
+            databaseName = value;
+        } else if (option == "--seconds") {
+            config.seconds = value.toInt(&ok);
+        } else if (option == "--window-ms") {
+            config.windowMs = value.toInt(&ok);
+        } else if (option == "--writers") {
+            config.writers = value.toInt(&ok);
+        } else if (option == "--scrollers") {
+            config.scrollers = value.toInt(&ok);
+        } else if (option == "--searchers") {
+            config.searchers = value.toInt(&ok);
+        } else if (option == "--seed-entries") {
+            config.seedEntries = value.toInt(&ok);
+        } else if (option == "--page-size") {
+            config.pageSize = value.toInt(&ok);
+        } else if (option == "--edit-percent") {
+            config.editPercent = value.toInt(&ok);
+        } else if (option == "--flush-every") {
+            config.flushEvery = value.toInt(&ok);
+        } else if (option == "--seed") {
+            config.seed = value.toUInt(&ok);
+            ok = ok && config.seed != 0;
+        } else if (option == "--durability") {
+            if (value == "buffered")
+                config.durability = StorageBackend::Buffered;
+            else if (value == "flushed")
+                config.durability = StorageBackend::Flushed;
+            else if (value == "synced")
+                config.durability = StorageBackend::Synced;
+            else
+                ok = false;
+        } else {
+            ok = false;
+        }
+        if (!ok || value.isEmpty()) {
+            fprintf(stderr, "stress: bad option %s\n", qPrintable(option));
+            return false;
+        }
+        ++i;
+    }
+    return config.seconds > 0 && config.writers >= 0 && config.scrollers >= 0
+           && config.searchers >= 0 && config.seedEntries >= 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    StressConfig config;
+    const QString scratch = QDir::temp().filePath(QString("dwriter-stress-%1.db").arg(app.applicationPid()));
+    QString databaseName = scratch;
+    if (!parseArguments(app.arguments(), config, databaseName)) {
+        fprintf(stderr, "usage: stress [--database FILE] [--seconds N] [--window-ms N] [--writers N]\n"
+                        "              [--scrollers N] [--searchers N] [--no-maintenance] [--seed-entries N]\n"
+                        "              [--page-size N] [--edit-percent N] [--flush-every N]\n"
+                        "              [--durability buffered|flushed|synced] [--seed N]\n");
+        return 2;
+    }
+
+    StressHarness harness(databaseName);
+    const StressReport report = harness.run(config);
+    if (databaseName == scratch) {
+        const char *const suffixes[] = { "", "-wal", "-shm", "-journal" };
+        for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); ++i)
+            QFile::remove(databaseName + suffixes[i]);
+    }
+    if (!harness.lastError().isEmpty()) {
+        fprintf(stderr, "stress: %s\n", qPrintable(harness.lastError()));
+        return 1;
+    }
+
+    fputs(reportJson(report, config).constData(), stdout);
+    fputs("\n", stdout);
+    return report.passed() && report.errors.isEmpty() ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+# Soaks the storage layer with concurrent writers, readers and maintenance
+# through StressHarness.
+#
+#   stress [--database FILE] [--seconds N] [--window-ms N] [--writers N]
+#          [--scrollers N] [--searchers N] [--no-maintenance] [--seed-entries N]
+#          [--page-size N] [--edit-percent N] [--flush-every N]
+#          [--durability buffered|flushed|synced] [--seed N]
+#
+# Prints the report as one JSON object to stdout, with the file I/O of each
+# kind of operation counted by IoVfs. Exits with 1 when an invariant did not
+# hold or operations failed.
+
+TEMPLATE = app
+TARGET = stress
+CONFIG += console warn_on
+CONFIG -= app_bundle
+
+include(../../core.pri)
+
+SOURCES +=  \
+    stress.cpp
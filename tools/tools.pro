@@ -0,0 +1,10 @@
+# Desktop Linux tools that run the storage layer through core.pri:
+#
+#   qmake tools.pro && make
+
+TEMPLATE = subdirs
+SUBDIRS +=  \
+    bench \
+    crash \
+    replay \
+    stress